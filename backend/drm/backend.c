@@ -66,6 +66,7 @@ static void backend_destroy(struct wlr_backend *backend) {
 
 	free(drm->name);
 	wlr_session_close_file(drm->session, drm->dev);
+	wl_event_source_remove(drm->fb_cache_timer);
 	wl_event_source_remove(drm->drm_event);
 	free(drm);
 }
@@ -238,6 +239,7 @@ struct wlr_backend *wlr_drm_backend_create(struct wlr_session *session,
 
 	drm->session = session;
 	wl_list_init(&drm->fbs);
+	wl_list_init(&drm->fb_cache);
 	wl_list_init(&drm->connectors);
 	wl_list_init(&drm->page_flips);
 
@@ -267,6 +269,13 @@ struct wlr_backend *wlr_drm_backend_create(struct wlr_session *session,
 		goto error_fd;
 	}
 
+	drm->fb_cache_timer = wl_event_loop_add_timer(session->event_loop,
+		drm_fb_cache_handle_timer, drm);
+	if (!drm->fb_cache_timer) {
+		wlr_log(WLR_ERROR, "Failed to create FB cache timer");
+		goto error_drm_event;
+	}
+
 	drm->session_active.notify = handle_session_active;
 	wl_signal_add(&session->events.active, &drm->session_active);
 
@@ -292,6 +301,8 @@ error_mgpu_renderer:
 	finish_drm_resources(drm);
 error_event:
 	wl_list_remove(&drm->session_active.link);
+	wl_event_source_remove(drm->fb_cache_timer);
+error_drm_event:
 	wl_event_source_remove(drm->drm_event);
 error_fd:
 	wl_list_remove(&drm->dev_remove.link);
@@ -27,6 +27,7 @@
 #include "render/color.h"
 #include "types/wlr_output.h"
 #include "util/env.h"
+#include "util/time.h"
 #include "config.h"
 
 #if HAVE_LIBLIFTOFF
@@ -1017,10 +1018,16 @@ static bool drm_connector_test(struct wlr_output *output,
 	return drm_connector_commit_state(conn, state, true);
 }
 
+static void drm_connector_update_render_estimate(struct wlr_drm_connector *conn);
+
 static bool drm_connector_commit(struct wlr_output *output,
 		const struct wlr_output_state *state) {
 	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
-	return drm_connector_commit_state(conn, state, false);
+	bool ok = drm_connector_commit_state(conn, state, false);
+	if (ok && (state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		drm_connector_update_render_estimate(conn);
+	}
+	return ok;
 }
 
 size_t drm_crtc_get_gamma_lut_size(struct wlr_drm_backend *drm,
@@ -1252,6 +1259,11 @@ static void drm_connector_destroy_output(struct wlr_output *output) {
 	conn->status = DRM_MODE_DISCONNECTED;
 	drm_connector_set_pending_page_flip(conn, NULL);
 
+	if (conn->frame_sched.timer != NULL) {
+		wl_event_source_remove(conn->frame_sched.timer);
+	}
+	memset(&conn->frame_sched, 0, sizeof(conn->frame_sched));
+
 	struct wlr_drm_mode *mode, *mode_tmp;
 	wl_list_for_each_safe(mode, mode_tmp, &conn->output.modes, wlr_mode.link) {
 		wl_list_remove(&mode->wlr_mode.link);
@@ -1309,6 +1321,26 @@ static const struct wlr_drm_format_set *drm_connector_get_primary_formats(
 	return &conn->crtc->primary->formats;
 }
 
+static bool drm_connector_import_buffer(struct wlr_output *output,
+		struct wlr_buffer *buffer) {
+	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+	struct wlr_drm_backend *drm = conn->backend;
+	if (!drm->session->active || conn->crtc == NULL) {
+		return false;
+	}
+	if (drm->mgpu_renderer.wlr_rend) {
+		// The buffer will be blitted, there is nothing to import
+		return true;
+	}
+
+	struct wlr_drm_fb *fb = NULL;
+	if (!drm_fb_import(&fb, drm, buffer, &conn->crtc->primary->formats)) {
+		return false;
+	}
+	drm_fb_clear(&fb);
+	return true;
+}
+
 static const struct wlr_output_impl output_impl = {
 	.set_cursor = drm_connector_set_cursor,
 	.move_cursor = drm_connector_move_cursor,
@@ -1319,6 +1351,7 @@ static const struct wlr_output_impl output_impl = {
 	.get_cursor_formats = drm_connector_get_cursor_formats,
 	.get_cursor_sizes = drm_connector_get_cursor_sizes,
 	.get_primary_formats = drm_connector_get_primary_formats,
+	.import_buffer = drm_connector_import_buffer,
 };
 
 bool wlr_output_is_drm(const struct wlr_output *output) {
@@ -2008,6 +2041,125 @@ static int mhz_to_nsec(int mhz) {
 	return 1000000000000LL / mhz;
 }
 
+static int64_t get_current_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_to_nsec(&now);
+}
+
+static bool drm_connector_frame_sched_active(struct wlr_drm_connector *conn) {
+	return conn->frame_sched.enabled && conn->refresh > 0 &&
+		conn->output.adaptive_sync_status != WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED;
+}
+
+static void drm_connector_send_frame(struct wlr_drm_connector *conn) {
+	conn->frame_sched.frame_ns = get_current_time_nsec();
+	wlr_output_send_frame(&conn->output);
+}
+
+static int handle_frame_sched_timer(void *data) {
+	struct wlr_drm_connector *conn = data;
+	if (conn->status == DRM_MODE_CONNECTED && conn->backend->session->active) {
+		drm_connector_send_frame(conn);
+	}
+	return 0;
+}
+
+static void drm_connector_schedule_frame(struct wlr_drm_connector *conn) {
+	if (!drm_connector_frame_sched_active(conn)) {
+		drm_connector_send_frame(conn);
+		return;
+	}
+
+	int64_t next_vblank_ns = conn->frame_sched.vblank_ns + mhz_to_nsec(conn->refresh);
+	int64_t send_ns = next_vblank_ns - conn->frame_sched.margin_ns -
+		conn->frame_sched.render_ns;
+	// Timers have a millisecond granularity, round down
+	int64_t delay_ms = (send_ns - get_current_time_nsec()) / 1000000;
+	if (delay_ms <= 0) {
+		drm_connector_send_frame(conn);
+		return;
+	}
+
+	wl_event_source_timer_update(conn->frame_sched.timer, delay_ms);
+}
+
+static void drm_connector_update_render_estimate(struct wlr_drm_connector *conn) {
+	int64_t frame_ns = conn->frame_sched.frame_ns;
+	conn->frame_sched.frame_ns = 0;
+	if (!drm_connector_frame_sched_active(conn) || frame_ns == 0) {
+		return;
+	}
+
+	int64_t now = get_current_time_nsec();
+	int64_t duration = now - frame_ns;
+	int64_t refresh_ns = mhz_to_nsec(conn->refresh);
+	if (duration > refresh_ns) {
+		// The compositor didn't render right away on the frame event
+		return;
+	}
+
+	// Grow immediately to avoid missing more frames, shrink slowly
+	int64_t *render_ns = &conn->frame_sched.render_ns;
+	if (duration > *render_ns) {
+		*render_ns = duration;
+	} else {
+		*render_ns -= (*render_ns - duration) / 16;
+	}
+
+	int64_t deadline_ns = conn->frame_sched.vblank_ns + refresh_ns -
+		conn->frame_sched.margin_ns;
+	if (conn->frame_sched.vblank_ns != 0 && now > deadline_ns) {
+		wlr_drm_conn_log(conn, WLR_DEBUG, "Missed commit deadline by %.3f ms, "
+			"render estimate is now %.3f ms", (double)(now - deadline_ns) / 1e6,
+			(double)*render_ns / 1e6);
+	}
+}
+
+bool wlr_drm_connector_set_frame_scheduling(struct wlr_output *output,
+		bool enabled, int64_t margin_ns) {
+	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+
+	if (enabled && conn->frame_sched.timer == NULL) {
+		conn->frame_sched.timer = wl_event_loop_add_timer(output->event_loop,
+			handle_frame_sched_timer, conn);
+		if (conn->frame_sched.timer == NULL) {
+			wlr_drm_conn_log(conn, WLR_ERROR, "Failed to create frame timer");
+			return false;
+		}
+	}
+	// When disabling, keep the timer around: a delayed frame event may still
+	// be pending
+
+	conn->frame_sched.enabled = enabled;
+	conn->frame_sched.margin_ns = margin_ns;
+	conn->frame_sched.render_ns = 0;
+	return true;
+}
+
+bool wlr_drm_connector_get_render_deadline(struct wlr_output *output,
+		struct timespec *deadline) {
+	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+	if (!drm_connector_frame_sched_active(conn) ||
+			conn->frame_sched.vblank_ns == 0) {
+		return false;
+	}
+
+	int64_t refresh_ns = mhz_to_nsec(conn->refresh);
+	int64_t deadline_ns = conn->frame_sched.vblank_ns + refresh_ns -
+		conn->frame_sched.margin_ns;
+
+	// If the deadline has already passed, the frame will be displayed on a
+	// later vblank
+	int64_t now = get_current_time_nsec();
+	if (deadline_ns < now) {
+		deadline_ns += ((now - deadline_ns) / refresh_ns + 1) * refresh_ns;
+	}
+
+	timespec_from_nsec(deadline, deadline_ns);
+	return true;
+}
+
 static void handle_page_flip(int fd, unsigned seq,
 		unsigned tv_sec, unsigned tv_usec, unsigned crtc_id, void *data) {
 	struct wlr_drm_page_flip *page_flip = data;
@@ -2083,8 +2235,10 @@ static void handle_page_flip(int fd, unsigned seq,
 	};
 	wlr_output_send_present(&conn->output, &present_event);
 
+	conn->frame_sched.vblank_ns = timespec_to_nsec(&present_event.when);
+
 	if (drm->session->active) {
-		wlr_output_send_frame(&conn->output);
+		drm_connector_schedule_frame(conn);
 	}
 }
 
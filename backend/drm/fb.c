@@ -1,5 +1,7 @@
 #include <drm_fourcc.h>
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <wlr/render/drm_format_set.h>
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/util/addon.h>
@@ -9,6 +11,7 @@
 #include "backend/drm/drm.h"
 #include "backend/drm/fb.h"
 #include "render/pixel_format.h"
+#include "util/time.h"
 
 void drm_fb_clear(struct wlr_drm_fb **fb_ptr) {
 	if (*fb_ptr == NULL) {
@@ -26,9 +29,123 @@ struct wlr_drm_fb *drm_fb_lock(struct wlr_drm_fb *fb) {
 	return fb;
 }
 
+static void drm_fb_mark_in_use(struct wlr_drm_fb *fb) {
+	struct wlr_drm_backend *drm = fb->backend;
+
+	drm->fbs_in_use++;
+	if (drm->fbs_in_use > drm->fb_cache_cap &&
+			drm->fb_cache_cap < DRM_FB_CACHE_MAX_SIZE) {
+		drm->fb_cache_cap = drm->fbs_in_use;
+	}
+}
+
+static void drm_fb_cache_insert(struct wlr_drm_fb *fb) {
+	struct wlr_drm_backend *drm = fb->backend;
+
+	wlr_addon_finish(&fb->addon);
+	fb->wlr_buf = NULL;
+	drm->fbs_in_use--;
+	wl_list_insert(&drm->fb_cache, &fb->cache_link);
+	drm->fb_cache_len++;
+
+	while (drm->fb_cache_len > drm->fb_cache_cap) {
+		struct wlr_drm_fb *oldest =
+			wl_container_of(drm->fb_cache.prev, oldest, cache_link);
+		drm_fb_destroy(oldest);
+	}
+
+	wl_event_source_timer_update(drm->fb_cache_timer, DRM_FB_CACHE_TIMEOUT_MS);
+}
+
 static void drm_fb_handle_destroy(struct wlr_addon *addon) {
 	struct wlr_drm_fb *fb = wl_container_of(addon, fb, addon);
-	drm_fb_destroy(fb);
+	if (fb->has_key) {
+		// The DMA-BUF may outlive the buffer, e.g. when a client destroys
+		// and re-creates its wl_buffer objects
+		drm_fb_cache_insert(fb);
+	} else {
+		drm_fb_destroy(fb);
+	}
+}
+
+void drm_fb_cache_clear(struct wlr_drm_backend *drm) {
+	struct wlr_drm_fb *fb, *fb_tmp;
+	wl_list_for_each_safe(fb, fb_tmp, &drm->fb_cache, cache_link) {
+		drm_fb_destroy(fb);
+	}
+}
+
+int drm_fb_cache_handle_timer(void *data) {
+	struct wlr_drm_backend *drm = data;
+	drm_fb_cache_clear(drm);
+
+	uint64_t total = drm->fb_cache_stats.hits + drm->fb_cache_stats.misses;
+	if (drm->fb_cache_stats.misses > 0) {
+		wlr_log(WLR_DEBUG, "FB cache hit rate: %"PRIu64"/%"PRIu64", "
+			"average import: %.3f ms", drm->fb_cache_stats.hits, total,
+			(double)drm->fb_cache_stats.import_ns /
+			drm->fb_cache_stats.misses / 1e6);
+	}
+
+	// Start over sizing the cache, swapchains may have shrunk since
+	drm->fb_cache_cap = drm->fbs_in_use;
+	if (drm->fb_cache_cap > DRM_FB_CACHE_MAX_SIZE) {
+		drm->fb_cache_cap = DRM_FB_CACHE_MAX_SIZE;
+	}
+	return 0;
+}
+
+static bool get_fb_key(struct wlr_drm_fb_key *key,
+		const struct wlr_dmabuf_attributes *attribs) {
+	*key = (struct wlr_drm_fb_key){
+		.width = attribs->width,
+		.height = attribs->height,
+		.format = attribs->format,
+		.modifier = attribs->modifier,
+		.n_planes = attribs->n_planes,
+	};
+	for (int i = 0; i < attribs->n_planes; i++) {
+		struct stat st;
+		if (fstat(attribs->fd[i], &st) != 0) {
+			wlr_log_errno(WLR_DEBUG, "fstat failed");
+			return false;
+		}
+		key->offset[i] = attribs->offset[i];
+		key->stride[i] = attribs->stride[i];
+		key->dev[i] = st.st_dev;
+		key->ino[i] = st.st_ino;
+	}
+	return true;
+}
+
+static bool fb_key_equal(const struct wlr_drm_fb_key *a,
+		const struct wlr_drm_fb_key *b) {
+	if (a->width != b->width || a->height != b->height ||
+			a->format != b->format || a->modifier != b->modifier ||
+			a->n_planes != b->n_planes) {
+		return false;
+	}
+	for (int i = 0; i < a->n_planes; i++) {
+		if (a->offset[i] != b->offset[i] || a->stride[i] != b->stride[i] ||
+				a->dev[i] != b->dev[i] || a->ino[i] != b->ino[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static struct wlr_drm_fb *drm_fb_cache_take(struct wlr_drm_backend *drm,
+		const struct wlr_drm_fb_key *key) {
+	struct wlr_drm_fb *fb;
+	wl_list_for_each(fb, &drm->fb_cache, cache_link) {
+		if (fb_key_equal(&fb->key, key)) {
+			wl_list_remove(&fb->cache_link);
+			wl_list_init(&fb->cache_link);
+			drm->fb_cache_len--;
+			return fb;
+		}
+	}
+	return NULL;
 }
 
 static const struct wlr_addon_interface fb_addon_impl = {
@@ -159,12 +276,6 @@ static struct wlr_drm_fb *drm_fb_create(struct wlr_drm_backend *drm,
 		return NULL;
 	}
 
-	struct wlr_drm_fb *fb = calloc(1, sizeof(*fb));
-	if (!fb) {
-		wlr_log_errno(WLR_ERROR, "Allocation failed");
-		return NULL;
-	}
-
 	if (formats && !wlr_drm_format_set_has(formats, attribs.format,
 			attribs.modifier)) {
 		// The format isn't supported by the plane. Try stripping the alpha
@@ -177,10 +288,34 @@ static struct wlr_drm_fb *drm_fb_create(struct wlr_drm_backend *drm,
 			wlr_log(WLR_DEBUG, "Buffer format 0x%"PRIX32" with modifier "
 				"0x%"PRIX64" cannot be scanned out",
 				attribs.format, attribs.modifier);
-			goto error_fb;
+			return NULL;
 		}
 	}
 
+	struct wlr_drm_fb_key key;
+	bool has_key = get_fb_key(&key, &attribs);
+
+	struct wlr_drm_fb *fb = NULL;
+	if (has_key) {
+		fb = drm_fb_cache_take(drm, &key);
+	}
+	if (fb != NULL) {
+		drm->fb_cache_stats.hits++;
+		fb->wlr_buf = buf;
+		wlr_addon_init(&fb->addon, &buf->addons, drm, &fb_addon_impl);
+		drm_fb_mark_in_use(fb);
+		return fb;
+	}
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	fb = calloc(1, sizeof(*fb));
+	if (!fb) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
 	uint32_t handles[4] = {0};
 	for (int i = 0; i < attribs.n_planes; ++i) {
 		int ret = drmPrimeFDToHandle(drm->fd, attribs.fd[i], &handles[i]);
@@ -201,15 +336,26 @@ static struct wlr_drm_fb *drm_fb_create(struct wlr_drm_backend *drm,
 
 	fb->backend = drm;
 	fb->wlr_buf = buf;
+	fb->key = key;
+	fb->has_key = has_key;
 
 	wlr_addon_init(&fb->addon, &buf->addons, drm, &fb_addon_impl);
 	wl_list_insert(&drm->fbs, &fb->link);
+	wl_list_init(&fb->cache_link);
+	if (has_key) {
+		drm_fb_mark_in_use(fb);
+	}
+
+	struct timespec end, duration;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	timespec_sub(&duration, &end, &start);
+	drm->fb_cache_stats.misses++;
+	drm->fb_cache_stats.import_ns += timespec_to_nsec(&duration);
 
 	return fb;
 
 error_bo_handle:
 	close_all_bo_handles(drm, handles);
-error_fb:
 	free(fb);
 	return NULL;
 }
@@ -218,7 +364,15 @@ void drm_fb_destroy(struct wlr_drm_fb *fb) {
 	struct wlr_drm_backend *drm = fb->backend;
 
 	wl_list_remove(&fb->link);
-	wlr_addon_finish(&fb->addon);
+	wl_list_remove(&fb->cache_link);
+	if (fb->wlr_buf != NULL) {
+		wlr_addon_finish(&fb->addon);
+		if (fb->has_key) {
+			drm->fbs_in_use--;
+		}
+	} else {
+		drm->fb_cache_len--;
+	}
 
 	int ret = drmModeCloseFB(drm->fd, fb->id);
 	if (ret == -EINVAL) {
@@ -2,6 +2,7 @@
 #include <drm_fourcc.h>
 #include <drm_mode.h>
 #include <drm.h>
+#include <limits.h>
 #include <libdisplay-info/cvt.h>
 #include <libdisplay-info/edid.h>
 #include <libdisplay-info/info.h>
@@ -121,143 +122,145 @@ const char *drm_connector_status_str(drmModeConnection status) {
 	return "<unsupported>";
 }
 
-static bool is_taken(size_t n, const uint32_t arr[static n], uint32_t key) {
-	for (size_t i = 0; i < n; ++i) {
-		if (arr[i] == key) {
-			return true;
-		}
-	}
-	return false;
-}
-
 /*
- * Store all of the non-recursive state in a struct, so we aren't literally
- * passing 12 arguments to a function.
- */
-struct match_state {
-	const size_t num_conns;
-	const uint32_t *conns;
-	const size_t num_crtcs;
-	size_t score;
-	size_t replaced;
-	uint32_t *res;
-	uint32_t *best;
-	const uint32_t *orig;
-	bool exit_early;
-};
-
-/**
- * Step to process a CRTC.
+ * Weight of assigning connector conn to CRTC crtc, or -1 if the assignment is
+ * impossible.
  *
- * This is a naive implementation of maximum bipartite matching.
- *
- * score: The number of connectors we've matched so far.
- * replaced: The number of changes from the original solution.
- * crtc_index: The index of the current CRTC.
- *
- * This tries to match a solution as close to st->orig as it can.
- *
- * Returns whether we've set a new best element with this solution.
+ * Matching a connector which wants a CRTC always beats keeping any number of
+ * previous assignments, so the number of matched connectors is maximized
+ * first. Among those solutions, the one keeping the most previous
+ * assignments wins. The previous assignment is always allowed, even if the
+ * connector doesn't want a CRTC anymore.
  */
-static bool match_connectors_with_crtcs_(struct match_state *st,
-		size_t score, size_t replaced, size_t crtc_index) {
-	// Finished
-	if (crtc_index >= st->num_crtcs) {
-		if (score > st->score ||
-				(score == st->score && replaced < st->replaced)) {
-			st->score = score;
-			st->replaced = replaced;
-			memcpy(st->best, st->res, sizeof(st->best[0]) * st->num_crtcs);
-
-			st->exit_early = (st->score == st->num_crtcs
-					|| st->score == st->num_conns)
-					&& st->replaced == 0;
+static int match_weight(size_t num_crtcs, const uint32_t conns[],
+		const uint32_t prev_crtcs[], size_t crtc, size_t conn) {
+	bool is_prev = prev_crtcs[crtc] == conn;
+	if (!is_prev && !(conns[conn] & (1u << crtc))) {
+		return -1;
+	}
+	int weight = conns[conn] != 0 ? (int)num_crtcs + 1 : 0;
+	if (is_prev) {
+		weight += 1;
+	}
+	return weight;
+}
 
-			return true;
-		} else {
-			return false;
+void match_connectors_with_crtcs(size_t num_conns,
+		const uint32_t conns[static num_conns],
+		size_t num_crtcs, const uint32_t prev_crtcs[static num_crtcs],
+		uint32_t new_crtcs[static num_crtcs]) {
+	// Connectors which can't be matched with any CRTC don't take part
+	bool has_prev[num_conns];
+	for (size_t i = 0; i < num_conns; i++) {
+		has_prev[i] = false;
+	}
+	for (size_t i = 0; i < num_crtcs; i++) {
+		if (prev_crtcs[i] != UNMATCHED) {
+			has_prev[prev_crtcs[i]] = true;
+		}
+	}
+	size_t cands[num_conns];
+	size_t num_cands = 0;
+	for (size_t i = 0; i < num_conns; i++) {
+		if (conns[i] != 0 || has_prev[i]) {
+			cands[num_cands++] = i;
 		}
 	}
-
-	bool has_best = false;
 
 	/*
-	 * Attempt to use the current solution first, to try and avoid
-	 * recalculating everything
+	 * This is the Hungarian algorithm computing a maximum weight assignment
+	 * of CRTCs (rows) to connectors (columns), in O(num_crtcs² × num_cands).
+	 *
+	 * There is one extra column per CRTC standing for "unmatched" with a
+	 * weight of 0, so that every CRTC can always be assigned. Arrays are
+	 * 1-indexed, column 0 is a sentinel used to start augmenting paths.
 	 */
-	if (st->orig[crtc_index] != UNMATCHED && !is_taken(crtc_index, st->res, st->orig[crtc_index])) {
-		st->res[crtc_index] = st->orig[crtc_index];
-		size_t crtc_score = st->conns[st->res[crtc_index]] != 0 ? 1 : 0;
-		if (match_connectors_with_crtcs_(st, score + crtc_score, replaced, crtc_index + 1)) {
-			has_best = true;
-		}
-	}
-	if (st->exit_early) {
-		return true;
+	size_t num_cols = num_cands + num_crtcs;
+	int row_pot[num_crtcs + 1];
+	int col_pot[num_cols + 1];
+	size_t col_match[num_cols + 1]; // row assigned to each column, 0 if none
+	size_t way[num_cols + 1];
+	int min_slack[num_cols + 1];
+	bool visited[num_cols + 1];
+
+	for (size_t i = 0; i <= num_crtcs; i++) {
+		row_pot[i] = 0;
 	}
-
-	if (st->orig[crtc_index] != UNMATCHED) {
-		++replaced;
+	for (size_t j = 0; j <= num_cols; j++) {
+		col_pot[j] = 0;
+		col_match[j] = 0;
 	}
 
-	for (size_t candidate = 0; candidate < st->num_conns; ++candidate) {
-		// We tried this earlier
-		if (candidate == st->orig[crtc_index]) {
-			continue;
+	for (size_t row = 1; row <= num_crtcs; row++) {
+		col_match[0] = row;
+		size_t col = 0;
+		for (size_t j = 0; j <= num_cols; j++) {
+			min_slack[j] = INT_MAX;
+			visited[j] = false;
 		}
 
-		// Not compatible
-		if (!(st->conns[candidate] & (1 << crtc_index))) {
-			continue;
-		}
-
-		// Already taken
-		if (is_taken(crtc_index, st->res, candidate)) {
-			continue;
-		}
-
-		st->res[crtc_index] = candidate;
-		size_t crtc_score = st->conns[candidate] != 0 ? 1 : 0;
-		if (match_connectors_with_crtcs_(st, score + crtc_score, replaced, crtc_index + 1)) {
-			has_best = true;
-		}
-
-		if (st->exit_early) {
-			return true;
-		}
+		// Grow an alternating tree from row until we reach a free column
+		do {
+			visited[col] = true;
+			size_t cur_row = col_match[col];
+			int delta = INT_MAX;
+			size_t next_col = 0;
+			for (size_t j = 1; j <= num_cols; j++) {
+				if (visited[j]) {
+					continue;
+				}
+
+				int weight = -1;
+				if (j <= num_cands) {
+					weight = match_weight(num_crtcs, conns, prev_crtcs,
+						cur_row - 1, cands[j - 1]);
+				} else if (j - num_cands == cur_row) {
+					// Each CRTC has its own "unmatched" column
+					weight = 0;
+				}
+
+				if (weight >= 0) {
+					// We minimize the cost, which is the negated weight
+					int slack = -weight - row_pot[cur_row] - col_pot[j];
+					if (slack < min_slack[j]) {
+						min_slack[j] = slack;
+						way[j] = col;
+					}
+				}
+				if (min_slack[j] < delta) {
+					delta = min_slack[j];
+					next_col = j;
+				}
+			}
+			assert(next_col != 0);
+
+			for (size_t j = 0; j <= num_cols; j++) {
+				if (visited[j]) {
+					row_pot[col_match[j]] += delta;
+					col_pot[j] -= delta;
+				} else if (min_slack[j] != INT_MAX) {
+					min_slack[j] -= delta;
+				}
+			}
+			col = next_col;
+		} while (col_match[col] != 0);
+
+		// Flip the augmenting path
+		do {
+			size_t prev_col = way[col];
+			col_match[col] = col_match[prev_col];
+			col = prev_col;
+		} while (col != 0);
 	}
 
-	// Maybe this CRTC can't be matched
-	st->res[crtc_index] = UNMATCHED;
-	if (match_connectors_with_crtcs_(st, score, replaced, crtc_index + 1)) {
-		has_best = true;
+	for (size_t i = 0; i < num_crtcs; i++) {
+		new_crtcs[i] = UNMATCHED;
 	}
-
-	return has_best;
-}
-
-void match_connectors_with_crtcs(size_t num_conns,
-		const uint32_t conns[static num_conns],
-		size_t num_crtcs, const uint32_t prev_crtcs[static num_crtcs],
-		uint32_t new_crtcs[static num_crtcs]) {
-	uint32_t solution[num_crtcs];
-	for (size_t i = 0; i < num_crtcs; ++i) {
-		solution[i] = UNMATCHED;
+	for (size_t j = 1; j <= num_cands; j++) {
+		if (col_match[j] != 0) {
+			new_crtcs[col_match[j] - 1] = cands[j - 1];
+		}
 	}
-
-	struct match_state st = {
-		.num_conns = num_conns,
-		.num_crtcs = num_crtcs,
-		.score = 0,
-		.replaced = SIZE_MAX,
-		.conns = conns,
-		.res = solution,
-		.best = new_crtcs,
-		.orig = prev_crtcs,
-		.exit_early = false,
-	};
-
-	match_connectors_with_crtcs_(&st, 0, 0, 0);
 }
 
 void generate_cvt_mode(drmModeModeInfo *mode, int hdisplay, int vdisplay,
@@ -21,6 +21,16 @@ struct libinput *wlr_backend_get_libinput(struct wlr_backend *wlr_backend) {
 	return backend->libinput_context;
 }
 
+void wlr_libinput_backend_set_coalesce_motion(struct wlr_backend *wlr_backend,
+		bool enabled) {
+	struct wlr_libinput_backend *backend =
+		get_libinput_backend_from_backend(wlr_backend);
+	if (!enabled) {
+		flush_pending_motion(backend);
+	}
+	backend->coalesce_motion = enabled;
+}
+
 static int libinput_open_restricted(const char *path,
 		int flags, void *_backend) {
 	struct wlr_libinput_backend *backend = _backend;
@@ -65,6 +75,7 @@ static int handle_libinput_readable(int fd, uint32_t mask, void *_backend) {
 		handle_libinput_event(backend, event);
 		libinput_event_destroy(event);
 	}
+	flush_pending_motion(backend);
 	return 0;
 }
 
@@ -83,9 +94,15 @@ static enum wlr_log_importance libinput_log_priority_to_wlr(
 static void log_libinput(struct libinput *libinput_context,
 		enum libinput_log_priority priority, const char *fmt, va_list args) {
 	enum wlr_log_importance importance = libinput_log_priority_to_wlr(priority);
-	static char wlr_fmt[1024];
-	snprintf(wlr_fmt, sizeof(wlr_fmt), "[libinput] %s", fmt);
-	_wlr_vlog(importance, wlr_fmt, args);
+	if (importance > wlr_log_get_verbosity()) {
+		return;
+	}
+
+	char msg[1024];
+	if (vsnprintf(msg, sizeof(msg), fmt, args) < 0) {
+		return;
+	}
+	_wlr_log(importance, "[libinput] %s", msg);
 }
 
 static bool backend_start(struct wlr_backend *wlr_backend) {
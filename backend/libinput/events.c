@@ -31,6 +31,8 @@ void destroy_libinput_input_device(struct wlr_libinput_input_device *dev) {
 		finish_device_tablet_pad(dev);
 	}
 
+	motion_batch_finish(&dev->motion_batch);
+
 	libinput_device_unref(dev->handle);
 	wl_list_remove(&dev->link);
 	free(dev);
@@ -75,6 +77,7 @@ static void handle_device_added(struct wlr_libinput_backend *backend,
 	}
 
 	dev->handle = libinput_dev;
+	motion_batch_init(&dev->motion_batch);
 	libinput_device_ref(libinput_dev);
 	libinput_device_set_user_data(libinput_dev, dev);
 
@@ -135,6 +138,18 @@ static void handle_device_removed(struct wlr_libinput_backend *backend,
 	destroy_libinput_input_device(dev);
 }
 
+void flush_pending_motion(struct wlr_libinput_backend *backend) {
+	if (!backend->has_pending_motion) {
+		return;
+	}
+	backend->has_pending_motion = false;
+
+	struct wlr_libinput_input_device *dev;
+	wl_list_for_each(dev, &backend->devices, link) {
+		motion_batch_flush(&dev->motion_batch);
+	}
+}
+
 void handle_libinput_event(struct wlr_libinput_backend *backend,
 		struct libinput_event *event) {
 	struct libinput_device *libinput_dev = libinput_event_get_device(event);
@@ -147,6 +162,15 @@ void handle_libinput_event(struct wlr_libinput_backend *backend,
 		return;
 	}
 
+	if (event_type == LIBINPUT_EVENT_POINTER_MOTION && backend->coalesce_motion) {
+		queue_pointer_motion(event, dev);
+		backend->has_pending_motion = true;
+		return;
+	}
+
+	// Preserve the order of events
+	flush_pending_motion(backend);
+
 	switch (event_type) {
 	case LIBINPUT_EVENT_DEVICE_ADDED:
 		handle_device_added(backend, libinput_dev);
@@ -39,6 +39,81 @@ void handle_pointer_motion(struct libinput_event *event,
 	wl_signal_emit_mutable(&pointer->events.frame, pointer);
 }
 
+void motion_batch_init(struct wlr_libinput_motion_batch *batch) {
+	*batch = (struct wlr_libinput_motion_batch){0};
+	wl_array_init(&batch->samples);
+}
+
+void motion_batch_finish(struct wlr_libinput_motion_batch *batch) {
+	wl_array_release(&batch->samples);
+}
+
+void motion_batch_add(struct wlr_libinput_motion_batch *batch,
+		struct wlr_pointer *pointer, const struct wlr_pointer_motion_sample *sample) {
+	struct wlr_pointer_motion_sample *slot =
+		wl_array_add(&batch->samples, sizeof(*slot));
+	if (slot == NULL) {
+		// Don't lose motion: emit what we have and start over
+		wlr_log(WLR_ERROR, "Allocation failed");
+		motion_batch_flush(batch);
+		struct wlr_pointer_motion_event event = {
+			.pointer = pointer,
+			.time_msec = usec_to_msec(sample->time_usec),
+			.delta_x = sample->delta_x,
+			.delta_y = sample->delta_y,
+			.unaccel_dx = sample->unaccel_dx,
+			.unaccel_dy = sample->unaccel_dy,
+		};
+		wl_signal_emit_mutable(&pointer->events.motion, &event);
+		wl_signal_emit_mutable(&pointer->events.frame, pointer);
+		return;
+	}
+	*slot = *sample;
+
+	batch->event.pointer = pointer;
+	batch->event.time_msec = usec_to_msec(sample->time_usec);
+	batch->event.delta_x += sample->delta_x;
+	batch->event.delta_y += sample->delta_y;
+	batch->event.unaccel_dx += sample->unaccel_dx;
+	batch->event.unaccel_dy += sample->unaccel_dy;
+}
+
+void motion_batch_flush(struct wlr_libinput_motion_batch *batch) {
+	if (batch->samples.size == 0) {
+		return;
+	}
+
+	struct wlr_pointer *pointer = batch->event.pointer;
+	struct wlr_pointer_motion_event event = batch->event;
+	event.samples = batch->samples.data;
+	event.samples_len = batch->samples.size / sizeof(struct wlr_pointer_motion_sample);
+	if (event.samples_len == 1) {
+		event.samples = NULL;
+		event.samples_len = 0;
+	}
+
+	// Reset before emitting, the samples array stays valid during the emission
+	batch->event = (struct wlr_pointer_motion_event){0};
+	batch->samples.size = 0;
+
+	wl_signal_emit_mutable(&pointer->events.motion, &event);
+	wl_signal_emit_mutable(&pointer->events.frame, pointer);
+}
+
+void queue_pointer_motion(struct libinput_event *event,
+		struct wlr_libinput_input_device *dev) {
+	struct libinput_event_pointer *pevent =
+		libinput_event_get_pointer_event(event);
+	struct wlr_pointer_motion_sample sample = {
+		.time_usec = libinput_event_pointer_get_time_usec(pevent),
+		.delta_x = libinput_event_pointer_get_dx(pevent),
+		.delta_y = libinput_event_pointer_get_dy(pevent),
+		.unaccel_dx = libinput_event_pointer_get_dx_unaccelerated(pevent),
+		.unaccel_dy = libinput_event_pointer_get_dy_unaccelerated(pevent),
+	};
+	motion_batch_add(&dev->motion_batch, &dev->pointer, &sample);
+}
+
 void handle_pointer_motion_abs(struct libinput_event *event,
 		struct wlr_pointer *pointer) {
 	struct libinput_event_pointer *pevent =
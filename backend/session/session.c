@@ -72,11 +72,15 @@ static enum wlr_log_importance libseat_log_level_to_wlr(
 static void log_libseat(enum libseat_log_level level,
 		const char *fmt, va_list args) {
 	enum wlr_log_importance importance = libseat_log_level_to_wlr(level);
+	if (importance > wlr_log_get_verbosity()) {
+		return;
+	}
 
-	static char wlr_fmt[1024];
-	snprintf(wlr_fmt, sizeof(wlr_fmt), "[libseat] %s", fmt);
-
-	_wlr_vlog(importance, wlr_fmt, args);
+	char msg[1024];
+	if (vsnprintf(msg, sizeof(msg), fmt, args) < 0) {
+		return;
+	}
+	_wlr_log(importance, "[libseat] %s", msg);
 }
 
 static int libseat_session_init(struct wlr_session *session,
@@ -115,6 +115,18 @@ struct wlr_drm_backend {
 	struct wl_listener dev_remove;
 
 	struct wl_list fbs; // wlr_drm_fb.link
+	struct wl_list fb_cache; // wlr_drm_fb.cache_link, most recent first
+	size_t fb_cache_len;
+	// Largest number of cacheable FBs in use at once since the cache was
+	// last emptied, i.e. the room needed to keep the swapchains in use
+	size_t fb_cache_cap;
+	size_t fbs_in_use; // cacheable FBs whose buffer is alive
+	struct wl_event_source *fb_cache_timer;
+
+	struct {
+		uint64_t hits, misses;
+		int64_t import_ns; // total time spent importing missed FBs
+	} fb_cache_stats;
 	struct wl_list connectors; // wlr_drm_connector.link
 
 	struct wl_list page_flips; // wlr_drm_page_flip.link
@@ -223,6 +235,16 @@ struct wlr_drm_connector {
 	uint32_t hdr_output_metadata;
 
 	int32_t refresh;
+
+	// Deadline-based frame scheduling, see wlr_drm_connector_set_frame_scheduling()
+	struct {
+		bool enabled;
+		int64_t margin_ns;
+		struct wl_event_source *timer;
+		int64_t vblank_ns; // last vblank timestamp, 0 if unknown
+		int64_t frame_ns; // when the last frame event was sent, 0 if none
+		int64_t render_ns; // estimated time between frame event and commit
+	} frame_sched;
 };
 
 struct wlr_drm_backend *get_drm_backend_from_backend(
@@ -3,15 +3,47 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <sys/types.h>
+#include <wlr/render/dmabuf.h>
 #include <wlr/util/addon.h>
 
 struct wlr_drm_format_set;
 
+/**
+ * Upper bound for the number of FBs kept around after their buffer has been
+ * destroyed. The cache is sized after the number of buffers seen in use at
+ * once, so that whole client swapchains fit, but can't grow past this.
+ */
+#define DRM_FB_CACHE_MAX_SIZE 32
+/**
+ * Delay after which FBs are evicted from the cache if they haven't been
+ * re-used.
+ */
+#define DRM_FB_CACHE_TIMEOUT_MS 1000
+
+/**
+ * Identity of the DMA-BUF an FB has been imported from.
+ */
+struct wlr_drm_fb_key {
+	int32_t width, height;
+	uint32_t format;
+	uint64_t modifier;
+	int n_planes;
+	uint32_t offset[WLR_DMABUF_MAX_PLANES];
+	uint32_t stride[WLR_DMABUF_MAX_PLANES];
+	dev_t dev[WLR_DMABUF_MAX_PLANES];
+	ino_t ino[WLR_DMABUF_MAX_PLANES];
+};
+
 struct wlr_drm_fb {
-	struct wlr_buffer *wlr_buf;
+	struct wlr_buffer *wlr_buf; // NULL if cached
 	struct wlr_addon addon;
 	struct wlr_drm_backend *backend;
 	struct wl_list link; // wlr_drm_backend.fbs
+	struct wl_list cache_link; // wlr_drm_backend.fb_cache
+
+	struct wlr_drm_fb_key key;
+	bool has_key;
 
 	uint32_t id;
 };
@@ -19,6 +51,11 @@ struct wlr_drm_fb {
 bool drm_fb_import(struct wlr_drm_fb **fb, struct wlr_drm_backend *drm,
 		struct wlr_buffer *buf, const struct wlr_drm_format_set *formats);
 void drm_fb_destroy(struct wlr_drm_fb *fb);
+/**
+ * Destroy all FBs whose buffer has been destroyed.
+ */
+void drm_fb_cache_clear(struct wlr_drm_backend *drm);
+int drm_fb_cache_handle_timer(void *data);
 
 void drm_fb_clear(struct wlr_drm_fb **fb);
 void drm_fb_copy(struct wlr_drm_fb **new, struct wlr_drm_fb *old);
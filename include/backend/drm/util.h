@@ -31,7 +31,9 @@ void generate_cvt_mode(drmModeModeInfo *mode, int hdisplay, int vdisplay,
  * prev_crtcs contains connector indices each CRTC was previously matched with,
  * or UNMATCHED.
  *
- * new_crtcs is populated with the new connector indices.
+ * new_crtcs is populated with the new connector indices. The number of matched
+ * connectors is maximized first, then the number of CRTCs keeping their
+ * previous connector.
  */
 void match_connectors_with_crtcs(size_t num_conns,
 	const uint32_t conns[static num_conns],
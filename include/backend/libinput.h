@@ -24,6 +24,18 @@ struct wlr_libinput_backend {
 	struct wl_listener session_signal;
 
 	struct wl_list devices; // wlr_libinput_device.link
+
+	bool coalesce_motion;
+	bool has_pending_motion;
+};
+
+/**
+ * Accumulates relative motion samples of a pointer, to be emitted as a single
+ * motion event.
+ */
+struct wlr_libinput_motion_batch {
+	struct wlr_pointer_motion_event event;
+	struct wl_array samples; // struct wlr_pointer_motion_sample
 };
 
 struct wlr_libinput_input_device {
@@ -37,6 +49,8 @@ struct wlr_libinput_input_device {
 	struct wl_list tablet_tools; // see backend/libinput/tablet_tool.c
 	struct wlr_tablet_pad tablet_pad;
 
+	struct wlr_libinput_motion_batch motion_batch;
+
 	struct wl_list link;
 };
 
@@ -63,6 +77,18 @@ void init_device_pointer(struct wlr_libinput_input_device *dev);
 struct wlr_libinput_input_device *device_from_pointer(struct wlr_pointer *kb);
 void handle_pointer_motion(struct libinput_event *event,
 	struct wlr_pointer *pointer);
+void queue_pointer_motion(struct libinput_event *event,
+	struct wlr_libinput_input_device *dev);
+
+void motion_batch_init(struct wlr_libinput_motion_batch *batch);
+void motion_batch_finish(struct wlr_libinput_motion_batch *batch);
+void motion_batch_add(struct wlr_libinput_motion_batch *batch,
+	struct wlr_pointer *pointer, const struct wlr_pointer_motion_sample *sample);
+/**
+ * Emit the accumulated motion, if any, and reset the batch.
+ */
+void motion_batch_flush(struct wlr_libinput_motion_batch *batch);
+void flush_pending_motion(struct wlr_libinput_backend *backend);
 void handle_pointer_motion_abs(struct libinput_event *event,
 	struct wlr_pointer *pointer);
 void handle_pointer_button(struct libinput_event *event,
@@ -0,0 +1,14 @@
+#ifndef RENDER_ALLOCATOR_ALLOCATOR_H
+#define RENDER_ALLOCATOR_ALLOCATOR_H
+
+#include <wlr/render/allocator.h>
+
+/**
+ * Creates an allocator for buffers which can be used by both the renderer and
+ * the consumer described by backend_caps. drm_fd may be negative if no DRM
+ * device is available.
+ */
+struct wlr_allocator *allocator_autocreate_with_drm_fd(
+	uint32_t backend_caps, struct wlr_renderer *renderer, int drm_fd);
+
+#endif
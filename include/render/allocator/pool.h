@@ -0,0 +1,96 @@
+#ifndef RENDER_ALLOCATOR_POOL_H
+#define RENDER_ALLOCATOR_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include <wlr/render/allocator.h>
+
+struct wlr_buffer_pool_entry;
+
+enum wlr_buffer_pool_hugepages {
+	WLR_BUFFER_POOL_HUGEPAGES_NONE,
+	WLR_BUFFER_POOL_HUGEPAGES_TRANSPARENT,
+	WLR_BUFFER_POOL_HUGEPAGES_EXPLICIT,
+};
+
+/**
+ * Keeps the memory of destroyed buffers for a while, so that new buffers with
+ * the same size and format can reuse it instead of allocating a file, sizing
+ * and mapping it again. Used by the shm and udmabuf allocators, whose buffers
+ * embed a struct wlr_buffer_pool_entry.
+ *
+ * Allocators have no event loop, so expiry happens lazily, when buffers are
+ * created or destroyed: idle buffers older than a second are destroyed then,
+ * as well as the least recently used ones if the pool grows too big. An idle
+ * allocator keeps its pool until it's destroyed, which the size cap bounds.
+ */
+struct wlr_buffer_pool {
+	struct wlr_allocator *allocator;
+	bool enabled;
+
+	// How the memory of new buffers is backed, the allocator falls back to
+	// regular pages if huge pages are unavailable
+	enum wlr_buffer_pool_hugepages hugepages;
+	// Size of explicit huge pages, smaller buffers use regular pages
+	size_t huge_page_size;
+	// Whether the pages of new buffers are faulted in upfront
+	bool prefault;
+
+	struct wl_list buffers; // wlr_buffer_pool_entry.link, in use
+	struct wl_list idle; // wlr_buffer_pool_entry.link, most recent first
+
+	// Releases the memory of an entry and frees it
+	void (*destroy)(struct wlr_buffer_pool_entry *entry);
+	// Optional, called when an entry becomes idle
+	void (*reclaim)(struct wlr_buffer_pool_entry *entry);
+};
+
+struct wlr_buffer_pool_entry {
+	struct wlr_buffer_pool *pool; // NULL once the allocator is destroyed
+	struct wl_list link;
+
+	int width, height;
+	uint32_t format;
+	size_t size; // in bytes
+	int64_t idle_since_msec;
+};
+
+/**
+ * Set up a pool. Pooling can be disabled with WLR_ALLOCATOR_NO_POOL, and
+ * reclaim is only used with WLR_ALLOCATOR_POOL_RECLAIM. The memory options
+ * are read from WLR_ALLOCATOR_HUGEPAGES and WLR_ALLOCATOR_PREFAULT.
+ */
+void buffer_pool_init(struct wlr_buffer_pool *pool,
+	struct wlr_allocator *allocator,
+	void (*destroy)(struct wlr_buffer_pool_entry *entry),
+	void (*reclaim)(struct wlr_buffer_pool_entry *entry));
+/**
+ * Destroy idle entries and detach the ones in use, which are destroyed
+ * normally from then on.
+ */
+void buffer_pool_finish(struct wlr_buffer_pool *pool);
+/**
+ * Check whether a new buffer of the given size should be backed by explicit
+ * huge pages. Buffers smaller than a huge page would waste most of it.
+ */
+bool buffer_pool_use_hugetlb(const struct wlr_buffer_pool *pool, size_t size);
+/**
+ * Take an idle entry with the same size and format, if any.
+ */
+struct wlr_buffer_pool_entry *buffer_pool_acquire(struct wlr_buffer_pool *pool,
+	int width, int height, uint32_t format);
+/**
+ * Track a newly allocated entry.
+ */
+void buffer_pool_add(struct wlr_buffer_pool *pool,
+	struct wlr_buffer_pool_entry *entry, int width, int height,
+	uint32_t format, size_t size);
+/**
+ * Called when the buffer of an entry is destroyed. Returns true if the entry
+ * was kept for reuse, false if the caller needs to release it.
+ */
+bool buffer_pool_release(struct wlr_buffer_pool_entry *entry);
+
+#endif
@@ -3,16 +3,22 @@
 
 #include <wlr/render/allocator.h>
 #include <wlr/types/wlr_buffer.h>
+#include "render/allocator/pool.h"
 
 struct wlr_shm_buffer {
 	struct wlr_buffer base;
 	struct wlr_shm_attributes shm;
 	void *data;
 	size_t size;
+	bool hugetlb; // backed by explicit huge pages
+
+	struct wlr_buffer_pool_entry pool_entry;
 };
 
 struct wlr_shm_allocator {
 	struct wlr_allocator base;
+
+	struct wlr_buffer_pool pool;
 };
 
 /**
@@ -3,6 +3,7 @@
 
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/render/allocator.h>
+#include "render/allocator/pool.h"
 
 struct wlr_udmabuf_buffer {
 	struct wlr_buffer base;
@@ -10,12 +11,15 @@ struct wlr_udmabuf_buffer {
 	size_t size;
 	struct wlr_shm_attributes shm;
 	struct wlr_dmabuf_attributes dmabuf;
+
+	struct wlr_buffer_pool_entry pool_entry;
 };
 
 struct wlr_udmabuf_allocator {
 	struct wlr_allocator base;
 
 	int fd;
+	struct wlr_buffer_pool pool;
 };
 
 struct wlr_allocator *wlr_udmabuf_allocator_create(void);
@@ -55,6 +55,9 @@ struct wlr_gles2_renderer {
 		bool OES_texture_half_float_linear;
 		bool EXT_texture_norm16;
 		bool EXT_disjoint_timer_query;
+		// GL_NV_pixel_buffer_object, GL_EXT_map_buffer_range and
+		// GL_OES_mapbuffer, for asynchronous read-back
+		bool pixel_buffer_object;
 	} exts;
 
 	struct {
@@ -71,6 +74,8 @@ struct wlr_gles2_renderer {
 		PFNGLGETQUERYOBJECTIVEXTPROC glGetQueryObjectivEXT;
 		PFNGLGETQUERYOBJECTUI64VEXTPROC glGetQueryObjectui64vEXT;
 		PFNGLGETINTEGER64VEXTPROC glGetInteger64vEXT;
+		PFNGLMAPBUFFERRANGEEXTPROC glMapBufferRangeEXT;
+		PFNGLUNMAPBUFFEROESPROC glUnmapBufferOES;
 	} procs;
 
 	struct {
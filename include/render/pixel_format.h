@@ -47,6 +47,34 @@ int32_t pixel_format_info_min_stride(const struct wlr_pixel_format_info *info, i
 bool pixel_format_info_check_stride(const struct wlr_pixel_format_info *info,
 	int32_t stride, int32_t width);
 
+#define PIXEL_FORMAT_INDEX_BITS 8
+#define PIXEL_FORMAT_INDEX_SIZE (1 << PIXEL_FORMAT_INDEX_BITS)
+
+/**
+ * A hash index from DRM FourCC to a position in a renderer format table,
+ * replacing a linear scan of the table.
+ *
+ * Must be zero-initialized, then filled with pixel_format_index_add().
+ * Renderers fill a static index from their table on first lookup.
+ */
+struct pixel_format_index {
+	uint32_t formats[PIXEL_FORMAT_INDEX_SIZE];
+	uint16_t positions[PIXEL_FORMAT_INDEX_SIZE];
+	size_t len;
+};
+
+/**
+ * Add a format to the index. If the format is already present, the existing
+ * position is kept, so that lookups return the first match in table order.
+ */
+void pixel_format_index_add(struct pixel_format_index *index,
+	uint32_t fmt, size_t position);
+/**
+ * Look up the table position of a format. Returns false if not found.
+ */
+bool pixel_format_index_find(const struct pixel_format_index *index,
+	uint32_t fmt, size_t *position);
+
 /**
  * Convert an enum wl_shm_format to a DRM FourCC.
  */
@@ -414,6 +414,10 @@ VkCommandBuffer vulkan_record_stage_cb(struct wlr_vk_renderer *renderer);
 // Submits the current stage command buffer and waits until it has
 // finished execution.
 bool vulkan_submit_stage_wait(struct wlr_vk_renderer *renderer, int wait_sync_file_fd);
+// Submits the current stage command buffer without waiting. Returns a
+// sync_file signalled once it has finished execution, or -1 on error.
+int vulkan_submit_stage_sync_file(struct wlr_vk_renderer *renderer,
+	int wait_sync_file_fd, uint64_t *timeline_point);
 
 struct wlr_vk_render_timer {
 	struct wlr_render_timer base;
@@ -495,6 +499,9 @@ bool vulkan_wait_command_buffer(struct wlr_vk_command_buffer *cb,
 	struct wlr_vk_renderer *renderer);
 VkSemaphore vulkan_command_buffer_wait_sync_file(struct wlr_vk_renderer *renderer,
 	struct wlr_vk_command_buffer *render_cb, size_t sem_index, int sync_file_fd);
+// Creates the exportable binary semaphore of the command buffer, if needed
+bool vulkan_command_buffer_ensure_binary_semaphore(struct wlr_vk_renderer *renderer,
+	struct wlr_vk_command_buffer *cb);
 
 bool vulkan_sync_render_pass_release(struct wlr_vk_renderer *renderer,
 	struct wlr_vk_render_pass *pass);
@@ -56,6 +56,23 @@ bool dmabuf_buffer_drop(struct wlr_dmabuf_buffer *buffer);
  */
 struct wlr_client_buffer *wlr_client_buffer_create(struct wlr_buffer *buffer,
 	struct wlr_renderer *renderer);
+/**
+ * Creates a struct wlr_client_buffer from a given struct wlr_buffer without
+ * uploading it. The buffer is kept locked until the texture is requested via
+ * wlr_client_buffer_get_texture(), or until a timer on the event loop
+ * expires.
+ */
+struct wlr_client_buffer *client_buffer_create_deferred(struct wlr_buffer *buffer,
+	struct wlr_renderer *renderer, struct wl_event_loop *loop);
+/**
+ * Replace the buffer's content without uploading it, accumulating damage
+ * until the texture is requested.
+ *
+ * Fails if there's more than one reference to the buffer, if the upload
+ * can't be deferred or if the size changed.
+ */
+bool client_buffer_defer_damage(struct wlr_client_buffer *client_buffer,
+	struct wlr_buffer *next, const pixman_region32_t *damage);
 /**
  * Try to update the buffer's content.
  *
@@ -0,0 +1,55 @@
+#ifndef TYPES_WLR_COMPOSITOR_H
+#define TYPES_WLR_COMPOSITOR_H
+
+#include <stdbool.h>
+#include <wayland-server-core.h>
+
+struct wlr_output;
+struct wlr_surface;
+struct surface_frame_waiter;
+
+/**
+ * Called when an output displaying the surface emits a frame event, or when
+ * the fallback timer expires if the surface isn't displayed on any output
+ * (in which case output is NULL).
+ */
+typedef void (*surface_frame_waiter_func_t)(struct surface_frame_waiter *waiter,
+	struct wlr_output *output);
+
+/**
+ * Waits for the next output refresh cycle of a surface.
+ *
+ * This is used by protocols which release cached commits in the output frame
+ * path.
+ */
+struct surface_frame_waiter {
+	struct wlr_surface *surface;
+	surface_frame_waiter_func_t callback;
+	bool armed;
+	// Whether the waiter fires on presentation rather than on frame events
+	bool wait_present;
+
+	struct wl_list outputs; // surface_frame_waiter_output.link
+	struct wl_event_source *timer;
+};
+
+bool surface_frame_waiter_init(struct surface_frame_waiter *waiter,
+	struct wlr_surface *surface, surface_frame_waiter_func_t callback);
+void surface_frame_waiter_finish(struct surface_frame_waiter *waiter);
+/**
+ * Wait for the next frame event of the outputs the surface is displayed on,
+ * and schedule a frame on these. The callback is invoked once, the waiter
+ * needs to be armed again to wait for subsequent frames.
+ */
+void surface_frame_waiter_arm(struct surface_frame_waiter *waiter);
+/**
+ * Same as surface_frame_waiter_arm(), but wait until the current surface state
+ * has been latched: the callback is invoked on the present event of the first
+ * output commit with a buffer. If an output goes through a refresh cycle
+ * without committing a buffer, the surface state needed no repaint and the
+ * callback is invoked on the next frame event.
+ */
+void surface_frame_waiter_arm_present(struct surface_frame_waiter *waiter);
+void surface_frame_waiter_disarm(struct surface_frame_waiter *waiter);
+
+#endif
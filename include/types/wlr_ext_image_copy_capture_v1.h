@@ -0,0 +1,18 @@
+#ifndef TYPES_WLR_EXT_IMAGE_COPY_CAPTURE_V1_H
+#define TYPES_WLR_EXT_IMAGE_COPY_CAPTURE_V1_H
+
+#include <wlr/types/wlr_ext_image_copy_capture_v1.h>
+
+struct wlr_output;
+
+/**
+ * Same as wlr_ext_image_copy_capture_frame_v1_copy_and_ready(), for a buffer
+ * being committed on the output. The texture import and read-back are shared
+ * with the output's other capture clients.
+ */
+void image_copy_capture_frame_copy_output_and_ready(
+	struct wlr_ext_image_copy_capture_frame_v1 *frame,
+	struct wlr_output *output, struct wlr_buffer *src,
+	const struct timespec *presentation_time);
+
+#endif
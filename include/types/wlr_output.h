@@ -31,6 +31,31 @@ bool output_prepare_commit(struct wlr_output *output, const struct wlr_output_st
 void output_apply_commit(struct wlr_output *output, const struct wlr_output_state *state);
 void output_send_commit_event(struct wlr_output *output, const struct wlr_output_state *state);
 
+/**
+ * Capture clients copying the buffer being committed from the output commit
+ * event share its texture import and read-backs. Outside of the commit event,
+ * or for other buffers, nothing is shared.
+ */
+void output_capture_begin(struct wlr_output *output,
+	const struct wlr_output_state *state);
+void output_capture_end(struct wlr_output *output);
+/**
+ * Import a buffer for capture. The texture must be released with
+ * output_capture_release_texture().
+ */
+struct wlr_texture *output_capture_acquire_texture(struct wlr_output *output,
+	struct wlr_buffer *buffer);
+void output_capture_release_texture(struct wlr_output *output,
+	struct wlr_texture *texture);
+/**
+ * Same as wlr_texture_read_pixels_async(), from the output's renderer and
+ * event loop.
+ */
+struct wlr_texture_readback *output_capture_read_pixels_async(
+	struct wlr_output *output, struct wlr_buffer *buffer,
+	const struct wlr_texture_read_pixels_options *options,
+	wlr_texture_readback_ready_callback callback, void *data);
+
 void output_state_get_buffer_src_box(const struct wlr_output_state *state,
 	struct wlr_fbox *out);
 void output_state_get_buffer_dst_box(const struct wlr_output_state *state,
@@ -0,0 +1,31 @@
+#ifndef UTIL_LOG_H
+#define UTIL_LOG_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wlr/util/log.h>
+
+#define LOG_COLOR_RESET "\x1B[0m"
+
+/**
+ * The default logger, writing to stderr.
+ */
+void log_stderr(enum wlr_log_importance verbosity, const char *fmt,
+	va_list args);
+
+/**
+ * Get the time elapsed since logging was initialized, in nanoseconds.
+ */
+int64_t log_get_elapsed_nsec(void);
+
+/**
+ * Format the timestamp and importance written in front of each message by
+ * the default logger, either colored or with a plain-text header. Returns
+ * the same value as snprintf().
+ */
+int log_format_prefix(char *buf, size_t size, int64_t elapsed_nsec,
+	enum wlr_log_importance verbosity, bool colored);
+
+#endif
@@ -7,5 +7,18 @@
 int create_shm_file(void);
 int allocate_shm_file(size_t size);
 bool allocate_shm_file_pair(size_t size, int *rw_fd, int *ro_fd);
+/**
+ * Allocate a memfd backed by explicit huge pages. The size is rounded up to a
+ * multiple of the huge page size. flags are additional memfd_create() flags.
+ *
+ * Huge pages are only reserved when the file is mapped or used, so this
+ * succeeds even if none are available.
+ */
+int allocate_hugetlb_file(size_t *size, unsigned int flags);
+/**
+ * Get the size of the huge pages backing files allocated with
+ * allocate_hugetlb_file(), or 0 if explicit huge pages are unsupported.
+ */
+size_t get_huge_page_size(void);
 
 #endif
@@ -100,4 +100,33 @@ const drmModeModeInfo *wlr_drm_mode_get_info(struct wlr_output_mode *mode);
 enum wl_output_transform wlr_drm_connector_get_panel_orientation(
 	struct wlr_output *output);
 
+/**
+ * Enable or disable deadline-based frame scheduling for the connector.
+ *
+ * By default, the frame event is sent as soon as the previous page-flip
+ * completes, leaving the compositor a whole refresh cycle to render. When
+ * frame scheduling is enabled, the backend predicts the next vblank from
+ * page-flip timestamps and delays the frame event so that the commit lands
+ * margin_ns before the vblank. The time needed by the compositor between the
+ * frame event and the commit is measured and the frame event is sent early
+ * enough to accommodate it. This reduces the input-to-photon latency.
+ *
+ * Frame scheduling is ignored while adaptive sync is enabled. The setting is
+ * reset when the output is destroyed.
+ *
+ * Returns false on error.
+ */
+bool wlr_drm_connector_set_frame_scheduling(struct wlr_output *output,
+	bool enabled, int64_t margin_ns);
+
+/**
+ * Get the time by which the compositor needs to commit a new frame for it to
+ * be displayed on the next vblank, on the CLOCK_MONOTONIC clock.
+ *
+ * Returns false if frame scheduling is disabled or if the next vblank cannot
+ * be predicted yet.
+ */
+bool wlr_drm_connector_get_render_deadline(struct wlr_output *output,
+	struct timespec *deadline);
+
 #endif
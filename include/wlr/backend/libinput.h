@@ -33,6 +33,20 @@ struct libinput_tablet_tool *wlr_libinput_get_tablet_tool_handle(
  */
 struct libinput *wlr_backend_get_libinput(struct wlr_backend *wlr_backend);
 
+/**
+ * Enable or disable relative pointer motion coalescing.
+ *
+ * When enabled, relative motion events read from libinput in a single
+ * dispatch are merged into one struct wlr_pointer_motion_event per device,
+ * which carries the individual samples. Motion is always flushed before any
+ * other event, so the relative order of events is preserved. This reduces the
+ * number of motion events with high polling rate mice.
+ *
+ * Disabled by default.
+ */
+void wlr_libinput_backend_set_coalesce_motion(struct wlr_backend *backend,
+	bool enabled);
+
 bool wlr_backend_is_libinput(const struct wlr_backend *backend);
 bool wlr_input_device_is_libinput(struct wlr_input_device *device);
 
@@ -100,6 +100,13 @@ struct wlr_output_impl {
 	 */
 	const struct wlr_drm_format_set *(*get_primary_formats)(
 		struct wlr_output *output, uint32_t buffer_caps);
+	/**
+	 * Prepare a buffer for being displayed on the primary plane, e.g. by
+	 * importing it into KMS. This is only a hint, the buffer isn't committed.
+	 *
+	 * Returns false if the buffer is known to be unsuitable for scan-out.
+	 */
+	bool (*import_buffer)(struct wlr_output *output, struct wlr_buffer *buffer);
 };
 
 /**
@@ -9,6 +9,8 @@
 #ifndef WLR_ALLOCATOR_H
 #define WLR_ALLOCATOR_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <wayland-server-core.h>
 
 struct wlr_allocator;
@@ -25,6 +27,20 @@ struct wlr_allocator_interface {
 void wlr_allocator_init(struct wlr_allocator *alloc,
 	const struct wlr_allocator_interface *impl, uint32_t buffer_caps);
 
+/**
+ * Buffer allocation statistics, see wlr_allocator_get_stats().
+ */
+struct wlr_allocator_stats {
+	// Number of buffers created
+	uint64_t created;
+	// Number of buffers which reused the memory of a destroyed buffer
+	uint64_t recycled;
+	// Total and maximum time spent creating a buffer, in nanoseconds
+	uint64_t create_nsec, max_create_nsec;
+	// Number and total size in bytes of destroyed buffers kept for reuse
+	size_t pooled, pooled_bytes;
+};
+
 /**
  * An allocator is responsible for allocating memory for pixel buffers.
  *
@@ -44,6 +60,10 @@ struct wlr_allocator {
 	struct {
 		struct wl_signal destroy;
 	} events;
+
+	struct {
+		struct wlr_allocator_stats stats;
+	} WLR_PRIVATE;
 };
 
 /**
@@ -77,4 +97,10 @@ void wlr_allocator_destroy(struct wlr_allocator *alloc);
 struct wlr_buffer *wlr_allocator_create_buffer(struct wlr_allocator *alloc,
 	int width, int height, const struct wlr_drm_format *format);
 
+/**
+ * Get buffer allocation statistics.
+ */
+void wlr_allocator_get_stats(struct wlr_allocator *alloc,
+	struct wlr_allocator_stats *stats);
+
 #endif
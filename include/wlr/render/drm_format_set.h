@@ -21,7 +21,7 @@ struct wlr_drm_format {
 	size_t len;
 	// The capacity of the array; do not use.
 	size_t capacity;
-	// The actual modifiers
+	// The actual modifiers, sorted in ascending order
 	uint64_t *modifiers;
 };
 
@@ -53,7 +53,9 @@ struct wlr_drm_format_set {
 	size_t len;
 	// The capacity of the array; private to wlroots
 	size_t capacity;
-	// A pointer to an array of `struct wlr_drm_format *` of length `len`.
+	// A pointer to an array of `struct wlr_drm_format *` of length `len`,
+	// sorted by format in ascending order. Lookups rely on this order: the
+	// array must not be written to directly, use wlr_drm_format_set_add().
 	struct wlr_drm_format *formats;
 };
 
@@ -42,12 +42,42 @@ struct wlr_texture_impl {
 	bool (*read_pixels)(struct wlr_texture *texture,
 		const struct wlr_texture_read_pixels_options *options);
 	uint32_t (*preferred_read_format)(struct wlr_texture *texture);
+	/* Optional, the options are validated and src_box is nonempty. Returns
+	 * a fence FD signalled once the pixels are available, or -1 if they
+	 * already are. */
+	struct wlr_texture_readback *(*read_pixels_async)(struct wlr_texture *texture,
+		const struct wlr_texture_read_pixels_options *options, int *fence_fd);
 	void (*destroy)(struct wlr_texture *texture);
 };
 
 void wlr_texture_init(struct wlr_texture *texture, struct wlr_renderer *rendener,
 	const struct wlr_texture_impl *impl, uint32_t width, uint32_t height);
 
+struct wlr_texture_readback_impl {
+	/* Pixel rows start at the top-left corner of the read-back's src_box */
+	bool (*begin_data_ptr_access)(struct wlr_texture_readback *readback,
+		const void **data, uint32_t *stride);
+	void (*end_data_ptr_access)(struct wlr_texture_readback *readback);
+	void (*destroy)(struct wlr_texture_readback *readback);
+};
+
+void wlr_texture_readback_init(struct wlr_texture_readback *readback,
+	const struct wlr_texture_readback_impl *impl, uint32_t format,
+	const struct wlr_box *src_box);
+/**
+ * Invoke the callback from the event loop once the fence FD signals, or on the
+ * next idle if it's -1. Takes ownership of the FD. On error, the read-back is
+ * destroyed and false is returned.
+ */
+bool wlr_texture_readback_start(struct wlr_texture_readback *readback,
+	int fence_fd, struct wl_event_loop *loop,
+	wlr_texture_readback_ready_callback callback, void *data);
+/**
+ * Stop waiting for the read-back, mark it as cancelled and invoke its
+ * callback, which must destroy it.
+ */
+void wlr_texture_readback_cancel(struct wlr_texture_readback *readback);
+
 struct wlr_render_pass {
 	const struct wlr_render_pass_impl *impl;
 };
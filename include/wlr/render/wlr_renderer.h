@@ -61,6 +61,8 @@ struct wlr_renderer {
 
 	struct {
 		const struct wlr_renderer_impl *impl;
+		// Asynchronous read-backs, cancelled when the renderer is destroyed
+		struct wl_list readbacks; // wlr_texture_readback.link
 	} WLR_PRIVATE;
 };
 
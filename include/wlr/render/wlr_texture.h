@@ -18,6 +18,7 @@
 struct wlr_buffer;
 struct wlr_renderer;
 struct wlr_texture_impl;
+struct wlr_texture_readback_impl;
 
 struct wlr_texture {
 	const struct wlr_texture_impl *impl;
@@ -46,6 +47,73 @@ bool wlr_texture_read_pixels(struct wlr_texture *texture,
 
 uint32_t wlr_texture_preferred_read_format(struct wlr_texture *texture);
 
+struct wlr_texture_readback;
+
+typedef void (*wlr_texture_readback_ready_callback)(
+	struct wlr_texture_readback *readback);
+
+/**
+ * An asynchronous read-back of a texture region, see
+ * wlr_texture_read_pixels_async().
+ */
+struct wlr_texture_readback {
+	const struct wlr_texture_readback_impl *impl;
+	uint32_t format;
+	struct wlr_box src_box;
+	bool ready;
+	// Set if the renderer was destroyed before the read-back completed
+	bool cancelled;
+
+	void *data;
+
+	struct {
+		int fence_fd;
+		struct wl_event_source *event_source;
+		wlr_texture_readback_ready_callback callback;
+
+		struct wl_list link; // wlr_renderer.readbacks
+	} WLR_PRIVATE;
+};
+
+/**
+ * Start reading back pixels from a texture without waiting for the GPU.
+ *
+ * The format, source box and wait timeline of the options are used, the
+ * destination fields are ignored. The callback is invoked from the event loop
+ * once the pixels are available, they can then be copied with
+ * wlr_texture_readback_copy(). The callback may destroy the read-back. The
+ * texture can be destroyed right away.
+ *
+ * If the renderer is destroyed first, the read-back is cancelled: the callback
+ * is invoked with the cancelled flag set, copies fail, and the callback must
+ * destroy the read-back.
+ *
+ * Returns NULL if the renderer doesn't support asynchronous read-back for
+ * this texture and format, callers should fall back to
+ * wlr_texture_read_pixels().
+ */
+struct wlr_texture_readback *wlr_texture_read_pixels_async(
+	struct wlr_texture *texture,
+	const struct wlr_texture_read_pixels_options *options,
+	struct wl_event_loop *loop, wlr_texture_readback_ready_callback callback,
+	void *data);
+
+/**
+ * Copy pixels out of a read-back. The format of the options must match the
+ * one of the read-back, and the source box must lie within the read-back's
+ * source box. An empty source box copies the whole read-back. The wait
+ * timeline of the options is ignored.
+ *
+ * Blocks if the read-back isn't ready yet.
+ */
+bool wlr_texture_readback_copy(struct wlr_texture_readback *readback,
+	const struct wlr_texture_read_pixels_options *options);
+
+/**
+ * Destroy a read-back, cancelling it if it isn't ready yet.
+ */
+void wlr_texture_readback_destroy(struct wlr_texture_readback *readback);
+
 /**
  * Create a new texture from raw pixel data. `stride` is in bytes. The returned
  * texture is mutable.
@@ -160,6 +160,10 @@ struct wlr_client_buffer {
 	/**
 	 * The buffer's texture, if any. A buffer will not have a texture if the
 	 * client destroys the buffer before it has been released.
+	 *
+	 * If the upload is deferred (see wlr_compositor_set_deferred_upload()),
+	 * the texture may be stale or NULL: use wlr_client_buffer_get_texture()
+	 * instead.
 	 */
 	struct wlr_texture *texture;
 	/**
@@ -172,6 +176,14 @@ struct wlr_client_buffer {
 		struct wl_listener renderer_destroy;
 
 		size_t n_ignore_locks;
+
+		// Deferred upload state. upload_buffer is locked and holds the
+		// latest contents, upload_damage is the region which changed since
+		// the texture was last updated.
+		struct wlr_renderer *renderer;
+		struct wlr_buffer *upload_buffer;
+		pixman_region32_t upload_damage;
+		struct wl_event_source *upload_timer;
 	} WLR_PRIVATE;
 };
 
@@ -181,6 +193,15 @@ struct wlr_client_buffer {
  */
 struct wlr_client_buffer *wlr_client_buffer_get(struct wlr_buffer *buffer);
 
+/**
+ * Get the client buffer's texture. If an upload has been deferred, the
+ * texture is updated first and the source buffer is released.
+ *
+ * Returns NULL if the texture couldn't be created.
+ */
+struct wlr_texture *wlr_client_buffer_get_texture(
+	struct wlr_client_buffer *buffer);
+
 /**
  * A single-pixel buffer.  Used by clients to draw solid-color rectangles.
  */
@@ -0,0 +1,34 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_COMMIT_TIMING_V1_H
+#define WLR_TYPES_WLR_COMMIT_TIMING_V1_H
+
+#include <wayland-server-core.h>
+
+/**
+ * Implementation of the commit-timing-v1 protocol.
+ *
+ * Commits with a target timestamp are held back using
+ * wlr_surface_lock_pending(), and released on the frame event of an output
+ * the surface is displayed on (see wlr_surface_send_enter()) once the next
+ * refresh is expected to happen at or after the target. Timestamps use the
+ * CLOCK_MONOTONIC clock, as advertised by wlr_presentation.
+ */
+struct wlr_commit_timing_manager_v1 {
+	struct wl_global *global;
+
+	struct {
+		struct wl_listener display_destroy;
+	} WLR_PRIVATE;
+};
+
+struct wlr_commit_timing_manager_v1 *wlr_commit_timing_manager_v1_create(
+	struct wl_display *display, uint32_t version);
+
+#endif
@@ -266,6 +266,10 @@ struct wlr_surface {
 		struct wl_list synced; // wlr_surface_synced.link
 		size_t synced_len;
 
+		// Released cached states, kept around for reuse
+		struct wl_list cached_pool; // wlr_surface_state.cached_state_link
+		size_t cached_pool_len;
+
 		struct wl_resource *pending_buffer_resource;
 		struct wl_listener pending_buffer_resource_destroy;
 	} WLR_PRIVATE;
@@ -285,6 +289,8 @@ struct wlr_compositor {
 	struct {
 		struct wl_listener display_destroy;
 		struct wl_listener renderer_destroy;
+
+		bool deferred_upload;
 	} WLR_PRIVATE;
 };
 
@@ -578,4 +584,22 @@ struct wlr_compositor *wlr_compositor_create(struct wl_display *display,
 void wlr_compositor_set_renderer(struct wlr_compositor *compositor,
 	struct wlr_renderer *renderer);
 
+/**
+ * Defer the upload of shared memory buffers until their texture is needed.
+ *
+ * By default, wl_shm buffers are uploaded to the GPU on surface commit and
+ * released right away. With deferred uploads enabled, the buffer is kept
+ * locked and damage is accumulated across commits, and the upload happens
+ * once when the texture is requested via wlr_surface_get_texture() or
+ * wlr_client_buffer_get_texture(), e.g. when rendering. Surfaces which are
+ * hidden or commit faster than the output refresh rate are not uploaded on
+ * every commit.
+ *
+ * Because the client can't reuse a buffer before it's released, a deferred
+ * upload is performed anyway after a short timeout if the texture hasn't
+ * been requested.
+ */
+void wlr_compositor_set_deferred_upload(struct wlr_compositor *compositor,
+	bool enabled);
+
 #endif
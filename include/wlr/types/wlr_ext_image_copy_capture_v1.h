@@ -15,6 +15,8 @@
 #include <time.h>
 
 struct wlr_renderer;
+struct wlr_swapchain;
+struct wlr_texture_readback;
 
 struct wlr_ext_image_copy_capture_manager_v1 {
 	struct wl_global *global;
@@ -42,7 +44,18 @@ struct wlr_ext_image_copy_capture_session_v1 {
 		struct wl_listener source_constraints_update;
 		struct wl_listener source_frame;
 
-		pixman_region32_t damage;
+		pixman_region32_t damage; // in source coordinates
+
+		// See wlr_ext_image_copy_capture_session_v1_set_max_buffer_size()
+		int max_buffer_width, max_buffer_height;
+		// See wlr_ext_image_copy_capture_session_v1_set_shm_formats()
+		uint32_t *shm_formats;
+		size_t shm_formats_len;
+		// Scaled shared memory copies with renderers which can't render to
+		// shared memory, the allocator is created for staging_renderer
+		struct wlr_allocator *staging_allocator;
+		struct wlr_renderer *staging_renderer;
+		struct wlr_swapchain *staging;
 	} WLR_PRIVATE;
 };
 
@@ -58,12 +71,39 @@ struct wlr_ext_image_copy_capture_frame_v1 {
 
 	struct {
 		struct wlr_ext_image_copy_capture_session_v1 *session;
+
+		// Pending shared memory copy, if any
+		struct wlr_texture_readback *readback;
+		enum wl_output_transform transform;
+		struct timespec presentation_time;
 	} WLR_PRIVATE;
 };
 
 struct wlr_ext_image_copy_capture_manager_v1 *wlr_ext_image_copy_capture_manager_v1_create(
 	struct wl_display *display, uint32_t version);
 
+/**
+ * Limit the size of the buffers the client allocates for the session. Larger
+ * sources are downscaled by the renderer while copying, keeping their aspect
+ * ratio. This saves copy bandwidth and client work for clients which only
+ * need a small image, e.g. window switcher thumbnails or a downscaled stream.
+ *
+ * Zero means no limit. Compositors typically call this from the manager's
+ * new_session event.
+ */
+void wlr_ext_image_copy_capture_session_v1_set_max_buffer_size(
+	struct wlr_ext_image_copy_capture_session_v1 *session,
+	int width, int height);
+/**
+ * Advertise shared memory formats in addition to the ones of the source, e.g.
+ * a 16-bit format to halve the copy bandwidth. Frames are converted while
+ * copying, the formats must be supported by wlr_texture_read_pixels() or be
+ * renderable.
+ */
+bool wlr_ext_image_copy_capture_session_v1_set_shm_formats(
+	struct wlr_ext_image_copy_capture_session_v1 *session,
+	const uint32_t *formats, size_t formats_len);
+
 /**
  * Notify the client that the frame is ready.
  *
@@ -83,5 +123,20 @@ void wlr_ext_image_copy_capture_frame_v1_fail(struct wlr_ext_image_copy_capture_
  */
 bool wlr_ext_image_copy_capture_frame_v1_copy_buffer(struct wlr_ext_image_copy_capture_frame_v1 *frame,
 	struct wlr_buffer *src, struct wlr_renderer *renderer);
+/**
+ * Copy a struct wlr_buffer into the client-provided buffer for the frame, and
+ * notify the client once done.
+ *
+ * Shared memory buffers are read back asynchronously if the renderer supports
+ * it, the frame then becomes ready from the event loop without blocking the
+ * caller on the GPU.
+ *
+ * This function destroys the frame, either right away or once the copy
+ * completes.
+ */
+void wlr_ext_image_copy_capture_frame_v1_copy_and_ready(
+	struct wlr_ext_image_copy_capture_frame_v1 *frame,
+	struct wlr_buffer *src, struct wlr_renderer *renderer,
+	enum wl_output_transform transform, const struct timespec *presentation_time);
 
 #endif
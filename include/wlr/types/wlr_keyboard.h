@@ -42,6 +42,7 @@ enum wlr_keyboard_modifier {
 #define WLR_KEYBOARD_KEYS_CAP 32
 
 struct wlr_keyboard_impl;
+struct wlr_keyboard_shared_keymap;
 
 struct wlr_keyboard_modifiers {
 	xkb_mod_mask_t depressed;
@@ -95,6 +96,11 @@ struct wlr_keyboard {
 	} events;
 
 	void *data;
+
+	struct {
+		// Owns keymap_string and keymap_fd
+		struct wlr_keyboard_shared_keymap *shared_keymap;
+	} WLR_PRIVATE;
 };
 
 struct wlr_keyboard_key_event {
@@ -59,6 +59,8 @@ struct wlr_linux_dmabuf_v1 {
 		struct wlr_linux_dmabuf_feedback_v1_compiled *default_feedback;
 		struct wlr_drm_format_set default_formats; // for legacy clients
 		struct wl_list surfaces; // wlr_linux_dmabuf_v1_surface.link
+		// wlr_linux_dmabuf_feedback_v1_compiled.link
+		struct wl_list compiled_feedbacks;
 
 		int main_device_fd; // to sanity check FDs sent by clients, -1 if unavailable
 
@@ -99,6 +101,9 @@ void wlr_linux_dmabuf_v1_set_check_dmabuf_callback(struct wlr_linux_dmabuf_v1 *l
  * Set a surface's DMA-BUF feedback.
  *
  * Passing a NULL feedback resets it to the default feedback.
+ *
+ * Surfaces with equal feedback share the same format table. Setting a
+ * feedback equal to the current one doesn't send any event.
  */
 bool wlr_linux_dmabuf_v1_set_surface_feedback(
 	struct wlr_linux_dmabuf_v1 *linux_dmabuf, struct wlr_surface *surface,
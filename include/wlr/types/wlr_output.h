@@ -170,6 +170,18 @@ struct wlr_output_state {
 struct wlr_output_impl;
 struct wlr_render_pass;
 
+/**
+ * Capture statistics, see wlr_output_get_capture_stats().
+ */
+struct wlr_output_capture_stats {
+	// Committed buffers imported as textures for capture clients, and imports
+	// avoided because another client already imported the buffer
+	uint64_t imports, imports_saved;
+	// Read-backs started for capture clients, and read-backs avoided because
+	// another client requested the same region and format
+	uint64_t readbacks, readbacks_saved;
+};
+
 /**
  * A compositor output region. This typically corresponds to a monitor that
  * displays part of the compositor space.
@@ -278,6 +290,15 @@ struct wlr_output {
 		struct wlr_output_image_description image_description_value;
 		struct wlr_color_transform *color_transform;
 		struct wlr_color_primaries default_primaries_value;
+
+		// Shared by capture clients during the commit event, see
+		// types/output/capture.c
+		struct {
+			struct wlr_buffer *buffer;
+			struct wlr_texture *texture;
+			struct wl_list readbacks; // output_capture_readback.link
+			struct wlr_output_capture_stats stats;
+		} capture;
 	} WLR_PRIVATE;
 };
 
@@ -460,6 +481,15 @@ const struct wlr_drm_format_set *wlr_output_get_primary_formats(
  * during screen capture.
  */
 bool wlr_output_is_direct_scanout_allowed(struct wlr_output *output);
+/**
+ * Hint that the buffer is likely to be submitted for direct scan-out soon.
+ *
+ * Backends may use this to perform expensive setup work, such as importing the
+ * buffer into KMS, before the buffer reaches the output commit. Returns false
+ * if the buffer is known to be unsuitable for scan-out.
+ */
+bool wlr_output_import_buffer(struct wlr_output *output,
+	struct wlr_buffer *buffer);
 
 
 struct wlr_output_cursor *wlr_output_cursor_create(struct wlr_output *output);
@@ -665,6 +695,12 @@ bool wlr_output_state_copy(struct wlr_output_state *dst,
  */
 bool wlr_output_configure_primary_swapchain(struct wlr_output *output,
 	const struct wlr_output_state *state, struct wlr_swapchain **swapchain);
+/**
+ * Get capture statistics. Capture clients copying the same output buffer
+ * during a commit share the texture import and the read-backs.
+ */
+void wlr_output_get_capture_stats(struct wlr_output *output,
+	struct wlr_output_capture_stats *stats);
 /**
  * Begin a render pass on this output.
  *
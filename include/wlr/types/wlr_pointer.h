@@ -50,11 +50,29 @@ struct wlr_pointer {
 	void *data;
 };
 
+struct wlr_pointer_motion_sample {
+	uint64_t time_usec;
+	double delta_x, delta_y;
+	double unaccel_dx, unaccel_dy;
+};
+
 struct wlr_pointer_motion_event {
 	struct wlr_pointer *pointer;
 	uint32_t time_msec;
 	double delta_x, delta_y;
 	double unaccel_dx, unaccel_dy;
+
+	/**
+	 * If the backend has coalesced multiple motion events into this one, the
+	 * individual samples in chronological order. The deltas above are the sum
+	 * of the samples' deltas and time_msec is the time of the last sample.
+	 * Compositors can forward the samples to clients which want full-rate
+	 * relative motion, e.g. via wlr_relative_pointer_manager_v1.
+	 *
+	 * NULL if the event hasn't been coalesced.
+	 */
+	const struct wlr_pointer_motion_sample *samples;
+	size_t samples_len;
 };
 
 struct wlr_pointer_motion_absolute_event {
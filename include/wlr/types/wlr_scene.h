@@ -247,6 +247,9 @@ struct wlr_scene_output {
 		 */
 		uint8_t dmabuf_feedback_debounce;
 		bool prev_scanout;
+		// The buffer node picked for direct scan-out in the last frame, new
+		// buffers it displays are imported by the backend ahead of the commit
+		struct wlr_scene_buffer *scanout_candidate;
 
 		bool gamma_lut_changed;
 		struct wlr_gamma_control_v1 *gamma_lut;
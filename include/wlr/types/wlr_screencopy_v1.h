@@ -10,6 +10,7 @@
 #define WLR_TYPES_WLR_SCREENCOPY_V1_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/util/box.h>
@@ -21,6 +22,20 @@
  * Consider using `wlr_ext_image_capture_source_v1` instead.
  */
 
+struct screencopy_readback;
+
+/**
+ * Copy statistics, see wlr_screencopy_manager_v1_get_stats().
+ */
+struct wlr_screencopy_v1_stats {
+	// Number of frames copied into shared memory buffers
+	uint64_t shm_frames;
+	// Number of those frames for which only the damage was copied
+	uint64_t shm_damage_frames;
+	// Bytes copied into shared memory buffers, in total and for the last frame
+	uint64_t shm_bytes, last_shm_bytes;
+};
+
 struct wlr_screencopy_manager_v1 {
 	struct wl_global *global;
 	struct wl_list frames; // wlr_screencopy_frame_v1.link
@@ -33,6 +48,9 @@ struct wlr_screencopy_manager_v1 {
 
 	struct {
 		struct wl_listener display_destroy;
+
+		bool damage_only_copy;
+		struct wlr_screencopy_v1_stats stats;
 	} WLR_PRIVATE;
 };
 
@@ -65,10 +83,31 @@ struct wlr_screencopy_frame_v1 {
 	struct {
 		struct wl_listener output_commit;
 		struct wl_listener output_destroy;
+
+		// Pending shared memory copy, if any
+		struct screencopy_readback *readback;
 	} WLR_PRIVATE;
 };
 
 struct wlr_screencopy_manager_v1 *wlr_screencopy_manager_v1_create(
 	struct wl_display *display);
 
+/**
+ * Only copy the damaged regions of copy_with_damage frames into shared memory
+ * buffers which already hold the previous frame. Disabled by default.
+ *
+ * The protocol doesn't forbid clients from writing to their buffers between
+ * frames, in which case they would end up with stale contents: only enable
+ * this if clients are known to leave their buffers untouched.
+ */
+void wlr_screencopy_manager_v1_set_damage_only_copy(
+	struct wlr_screencopy_manager_v1 *manager, bool enabled);
+
+/**
+ * Get copy statistics.
+ */
+void wlr_screencopy_manager_v1_get_stats(
+	struct wlr_screencopy_manager_v1 *manager,
+	struct wlr_screencopy_v1_stats *stats);
+
 #endif
@@ -30,6 +30,9 @@ struct wlr_xcursor_manager_theme {
 struct wlr_xcursor_manager {
 	char *name;
 	uint32_t size;
+	// Load themes with wlr_xcursor_theme_load_lazy(), false by default. Only
+	// affects themes loaded afterwards.
+	bool lazy;
 	struct wl_list scaled_themes; // wlr_xcursor_manager_theme.link
 };
 
@@ -44,6 +47,9 @@ void wlr_xcursor_manager_destroy(struct wlr_xcursor_manager *manager);
 
 /**
  * Ensures an xcursor theme at the given scale factor is loaded in the manager.
+ *
+ * If the lazy field is set, cursors are only decoded the first time they are
+ * retrieved, see wlr_xcursor_theme_load_lazy().
  */
 bool wlr_xcursor_manager_load(struct wlr_xcursor_manager *manager,
 	float scale);
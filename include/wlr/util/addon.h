@@ -14,6 +14,12 @@
 struct wlr_addon_set {
 	struct {
 		struct wl_list addons;
+		size_t len;
+
+		// Open-addressing index keyed by (owner, impl), only allocated once
+		// the set grows large
+		struct wlr_addon **index;
+		size_t index_cap; // power of two, or zero without an index
 	} WLR_PRIVATE;
 };
 
@@ -30,6 +36,7 @@ struct wlr_addon {
 
 	struct {
 		const void *owner;
+		struct wlr_addon_set *set;
 		struct wl_list link;
 	} WLR_PRIVATE;
 };
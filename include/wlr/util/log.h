@@ -18,6 +18,8 @@
 
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
 
@@ -48,6 +50,58 @@ void wlr_log_init(enum wlr_log_importance verbosity, wlr_log_func_t callback);
  */
 enum wlr_log_importance wlr_log_get_verbosity(void);
 
+/**
+ * Options for the asynchronous logger, see wlr_log_init_async().
+ */
+struct wlr_log_async_options {
+	// Size of the ring buffer in bytes, rounded up to a power of two. Zero
+	// picks a default of 1 MiB.
+	size_t buffer_size;
+	// File descriptor messages are written to, stderr if negative. It isn't
+	// closed by wlroots.
+	int fd;
+	// Write format string addresses and raw arguments instead of text, to be
+	// decoded offline with wlr_log_decode_binary(). Format strings passed to
+	// _wlr_log() and _wlr_vlog() must never change, e.g. string literals.
+	bool binary;
+};
+
+/**
+ * Set the log verbosity and replace the callback with an asynchronous logger.
+ *
+ * Messages are formatted into a preallocated lock-free ring buffer, and
+ * written out by a background thread every few milliseconds. Messages which
+ * don't fit in the ring buffer are dropped and counted instead of blocking
+ * the caller, see wlr_log_get_dropped(). If options is NULL, defaults are
+ * used.
+ *
+ * Returns false if the logger couldn't be started.
+ */
+bool wlr_log_init_async(enum wlr_log_importance verbosity,
+	const struct wlr_log_async_options *options);
+
+/**
+ * Write out pending messages, stop the asynchronous logger and restore the
+ * default logger.
+ *
+ * No other thread may be logging while this function is called.
+ */
+void wlr_log_finish_async(void);
+
+/**
+ * Get the number of messages dropped by the asynchronous logger because its
+ * ring buffer was full.
+ */
+uint64_t wlr_log_get_dropped(void);
+
+/**
+ * Decode the output of the asynchronous logger in binary mode, read from
+ * in_fd, into text written to out_fd.
+ *
+ * Returns false if the input is malformed.
+ */
+bool wlr_log_decode_binary(int in_fd, int out_fd);
+
 #ifdef __GNUC__
 #define _WLR_ATTRIB_PRINTF(start, end) __attribute__((format(printf, start, end)))
 #else
@@ -41,6 +41,7 @@
 #ifndef WLR_XCURSOR_H
 #define WLR_XCURSOR_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <wlr/util/edges.h>
 
@@ -74,14 +75,25 @@ struct wlr_xcursor {
 	uint32_t total_delay; /* total duration of the animation in ms */
 };
 
+struct wlr_xcursor_theme_entry;
+
 /**
  * Container for an Xcursor theme.
+ *
+ * For themes loaded with wlr_xcursor_theme_load_lazy(), cursors only contains
+ * the cursors which have been requested so far.
  */
 struct wlr_xcursor_theme {
 	unsigned int cursor_count;
 	struct wlr_xcursor **cursors;
 	char *name;
 	int size;
+
+	struct {
+		// Cursors by name, including the ones not decoded yet
+		struct wlr_xcursor_theme_entry *index;
+		size_t index_cap, index_len;
+	} WLR_PRIVATE;
 };
 
 /**
@@ -101,6 +113,23 @@ struct wlr_xcursor_theme {
  */
 struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size);
 
+/**
+ * Loads the named Xcursor theme, without decoding its cursors.
+ *
+ * The cursor files of the theme are only listed. Each cursor is decoded the
+ * first time it's requested with wlr_xcursor_theme_get_cursor(). This avoids
+ * spending time and memory on the many cursors of a theme which are never
+ * shown.
+ *
+ * If no cursor file could be found, a fallback theme is loaded. If a cursor
+ * appears more than once, the next file is tried when one can't be decoded,
+ * then the fallback cursor with the same name, if any.
+ *
+ * On error, NULL is returned.
+ */
+struct wlr_xcursor_theme *wlr_xcursor_theme_load_lazy(const char *name,
+	int size);
+
 /**
  * Destroy a cursor theme.
  *
@@ -240,6 +240,11 @@ struct wlr_xwayland_surface {
 	struct {
 		char *wm_name, *net_wm_name;
 
+		// Property requests left before emitting the associate event
+		size_t associate_requests;
+		// Property requests whose reply hasn't been read yet
+		size_t property_requests;
+
 		struct wl_listener surface_commit;
 		struct wl_listener surface_map;
 		struct wl_listener surface_unmap;
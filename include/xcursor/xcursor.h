@@ -36,7 +36,7 @@ struct xcursor_image {
 	uint32_t xhot; /* hot spot x (must be inside image) */
 	uint32_t yhot; /* hot spot y (must be inside image) */
 	uint32_t delay; /* animation delay to next frame (ms) */
-	uint32_t *pixels; /* pointer to pixels */
+	uint32_t *pixels; /* pointer to pixels, allocated with malloc() */
 };
 
 /*
@@ -55,4 +55,15 @@ void
 xcursor_load_theme(const char *theme, int size,
 		   void (*load_callback)(struct xcursor_images *, void *),
 		   void *user_data);
+
+void
+xcursor_scan_theme(const char *theme,
+		   void (*file_callback)(const char *, const char *, void *),
+		   void *user_data);
+
+struct xcursor_images *
+xcursor_load_file(const char *path, const char *name, int size);
+
+struct xcursor_images *
+xcursor_load_file_stdio(const char *path, const char *name, int size);
 #endif
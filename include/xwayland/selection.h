@@ -6,6 +6,8 @@
 #include <wayland-util.h>
 
 #define INCR_CHUNK_SIZE (64 * 1024)
+// Upper bound for adaptive chunk sizes, the server's limit may be lower
+#define SELECTION_CHUNK_SIZE_MAX (16 * 1024 * 1024)
 
 #define XDND_VERSION 5
 
@@ -22,6 +24,8 @@ struct wlr_xwm_selection_transfer {
 	bool incr;
 	bool flush_property_on_delete;
 	bool property_set;
+	// Grows as the transfer goes on, see xwm_selection_transfer_grow_chunk()
+	size_t chunk_size;
 	struct wl_array source_data;
 	int wl_client_fd;
 	struct wl_event_source *event_source;
@@ -34,6 +38,11 @@ struct wlr_xwm_selection_transfer {
 	int property_start;
 	xcb_get_property_reply_t *property_reply;
 	xcb_window_t incoming_window;
+	// The property is read in slices, the next one being requested while
+	// the current one is written to the Wayland client
+	xcb_get_property_cookie_t property_cookie;
+	bool property_requested;
+	uint32_t property_offset; // in 32-bit units
 };
 
 struct wlr_xwm_selection {
@@ -62,6 +71,8 @@ void xwm_selection_transfer_init(struct wlr_xwm_selection_transfer *transfer,
 	struct wlr_xwm_selection *selection);
 void xwm_selection_transfer_destroy(
 	struct wlr_xwm_selection_transfer *transfer);
+void xwm_selection_transfer_grow_chunk(
+	struct wlr_xwm_selection_transfer *transfer);
 
 void xwm_selection_transfer_destroy_outgoing(
 	struct wlr_xwm_selection_transfer *transfer);
@@ -78,6 +89,9 @@ void xwm_handle_selection_destroy_notify(struct wlr_xwm *xwm,
 		xcb_destroy_notify_event_t *event);
 
 void xwm_get_incr_chunk(struct wlr_xwm_selection_transfer *transfer);
+bool xwm_selection_transfer_read_property_reply(
+	struct wlr_xwm_selection_transfer *transfer);
+int xwm_read_selection_replies(struct wlr_xwm *xwm);
 void xwm_handle_selection_notify(struct wlr_xwm *xwm,
 	xcb_selection_notify_event_t *event);
 int xwm_handle_xfixes_selection_notify(struct wlr_xwm *xwm,
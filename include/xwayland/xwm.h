@@ -131,10 +131,24 @@ struct wlr_xwm {
 
 	// Surfaces in creation order
 	struct wl_list surfaces; // wlr_xwayland_surface.link
+	// Open-addressing index of surfaces by window ID, empty if allocation
+	// failed
+	struct wlr_xwayland_surface **surface_index;
+	size_t surface_index_cap, surface_index_len;
+	// Surfaces left out of the index for a newer one with the same window ID
+	size_t surface_index_shadowed;
 	// Surfaces in bottom-to-top stacking order, for _NET_CLIENT_LIST_STACKING
 	struct wl_list surfaces_in_stack_order; // wlr_xwayland_surface.stack_link
 	struct wl_list unpaired_surfaces; // wlr_xwayland_surface.unpaired_link
 	struct wl_list pending_startup_ids; // pending_startup_id
+	struct wl_list property_requests; // xwm_property_request.link
+	// Pending read of the events and replies received by blocking calls
+	struct wl_event_source *read_idle;
+
+	struct wl_array net_client_list; // xcb_window_t, in map order
+	// Pending writes of the root window properties
+	struct wl_event_source *net_client_list_idle;
+	bool net_client_list_dirty, net_client_list_stacking_dirty;
 
 	struct wlr_drag *drag;
 	struct wlr_xwayland_surface *drag_focus;
@@ -188,5 +202,13 @@ xcb_void_cookie_t xwm_send_event_with_size(xcb_connection_t *c,
 	uint32_t event_mask, const void *event, uint32_t length);
 
 void xwm_schedule_flush(struct wlr_xwm *xwm);
+/**
+ * Schedule a read of the X11 events and replies received while waiting for a
+ * reply. This must be called after blocking xcb_*_reply() calls: the data is
+ * queued by xcb and the connection FD won't be readable for it anymore.
+ * Don't call it after flushing: reading schedules a flush, and the two would
+ * keep scheduling each other.
+ */
+void xwm_schedule_read(struct wlr_xwm *xwm);
 
 #endif
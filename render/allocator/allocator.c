@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include <wlr/backend.h>
 #include <wlr/config.h>
@@ -9,9 +10,11 @@
 #include <wlr/util/log.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
+#include "render/allocator/allocator.h"
 #include "render/allocator/drm_dumb.h"
 #include "render/allocator/shm.h"
 #include "render/wlr_renderer.h"
+#include "util/time.h"
 
 #if WLR_HAS_GBM_ALLOCATOR
 #include "render/allocator/gbm.h"
@@ -95,17 +98,10 @@ static int reopen_drm_node(int drm_fd, bool allow_render_node) {
 	return new_fd;
 }
 
-struct wlr_allocator *wlr_allocator_autocreate(struct wlr_backend *backend,
-		struct wlr_renderer *renderer) {
-	uint32_t backend_caps = backend->buffer_caps;
+struct wlr_allocator *allocator_autocreate_with_drm_fd(
+		uint32_t backend_caps, struct wlr_renderer *renderer, int drm_fd) {
 	uint32_t renderer_caps = renderer->render_buffer_caps;
 
-	// Note, drm_fd may be negative if unavailable
-	int drm_fd = wlr_backend_get_drm_fd(backend);
-	if (drm_fd < 0) {
-		drm_fd = wlr_renderer_get_drm_fd(renderer);
-	}
-
 	struct wlr_allocator *alloc = NULL;
 
 	uint32_t gbm_caps = WLR_BUFFER_CAP_DMABUF;
@@ -169,6 +165,17 @@ struct wlr_allocator *wlr_allocator_autocreate(struct wlr_backend *backend,
 	return NULL;
 }
 
+struct wlr_allocator *wlr_allocator_autocreate(struct wlr_backend *backend,
+		struct wlr_renderer *renderer) {
+	// Note, drm_fd may be negative if unavailable
+	int drm_fd = wlr_backend_get_drm_fd(backend);
+	if (drm_fd < 0) {
+		drm_fd = wlr_renderer_get_drm_fd(renderer);
+	}
+	return allocator_autocreate_with_drm_fd(backend->buffer_caps, renderer,
+		drm_fd);
+}
+
 void wlr_allocator_destroy(struct wlr_allocator *alloc) {
 	if (alloc == NULL) {
 		return;
@@ -182,11 +189,22 @@ void wlr_allocator_destroy(struct wlr_allocator *alloc) {
 
 struct wlr_buffer *wlr_allocator_create_buffer(struct wlr_allocator *alloc,
 		int width, int height, const struct wlr_drm_format *format) {
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
 	struct wlr_buffer *buffer =
 		alloc->impl->create_buffer(alloc, width, height, format);
 	if (buffer == NULL) {
 		return NULL;
 	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	uint64_t elapsed_nsec = timespec_to_nsec(&end) - timespec_to_nsec(&start);
+	alloc->stats.created++;
+	alloc->stats.create_nsec += elapsed_nsec;
+	if (elapsed_nsec > alloc->stats.max_create_nsec) {
+		alloc->stats.max_create_nsec = elapsed_nsec;
+	}
+
 	if (alloc->buffer_caps & WLR_BUFFER_CAP_DATA_PTR) {
 		assert(buffer->impl->begin_data_ptr_access &&
 			buffer->impl->end_data_ptr_access);
@@ -199,3 +217,8 @@ struct wlr_buffer *wlr_allocator_create_buffer(struct wlr_allocator *alloc,
 	}
 	return buffer;
 }
+
+void wlr_allocator_get_stats(struct wlr_allocator *alloc,
+		struct wlr_allocator_stats *stats) {
+	*stats = alloc->stats;
+}
@@ -0,0 +1,156 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <wlr/render/allocator.h>
+#include <wlr/util/log.h>
+#include "render/allocator/pool.h"
+#include "util/env.h"
+#include "util/shm.h"
+#include "util/time.h"
+
+#define POOL_MAX_IDLE_MSEC 1000
+// Enough for a 4K buffer or a few 1080p ones. This is also how much memory
+// an allocator which stops allocating may keep around, see pool_expire().
+#define POOL_MAX_BYTES ((size_t)64 * 1024 * 1024)
+
+static const char *hugepages_options[] = {
+	[WLR_BUFFER_POOL_HUGEPAGES_NONE] = "none",
+	[WLR_BUFFER_POOL_HUGEPAGES_TRANSPARENT] = "transparent",
+	[WLR_BUFFER_POOL_HUGEPAGES_EXPLICIT] = "explicit",
+	NULL,
+};
+
+void buffer_pool_init(struct wlr_buffer_pool *pool,
+		struct wlr_allocator *allocator,
+		void (*destroy)(struct wlr_buffer_pool_entry *entry),
+		void (*reclaim)(struct wlr_buffer_pool_entry *entry)) {
+	assert(destroy);
+	*pool = (struct wlr_buffer_pool){
+		.allocator = allocator,
+		.enabled = !env_parse_bool("WLR_ALLOCATOR_NO_POOL"),
+		.hugepages = env_parse_switch("WLR_ALLOCATOR_HUGEPAGES",
+			hugepages_options),
+		.prefault = env_parse_bool("WLR_ALLOCATOR_PREFAULT"),
+		.destroy = destroy,
+	};
+	if (reclaim != NULL && env_parse_bool("WLR_ALLOCATOR_POOL_RECLAIM")) {
+		pool->reclaim = reclaim;
+	}
+	if (pool->hugepages == WLR_BUFFER_POOL_HUGEPAGES_EXPLICIT) {
+		pool->huge_page_size = get_huge_page_size();
+		if (pool->huge_page_size == 0) {
+			wlr_log(WLR_INFO, "Explicit huge pages unsupported, "
+				"using regular pages");
+			pool->hugepages = WLR_BUFFER_POOL_HUGEPAGES_NONE;
+		}
+	}
+	wl_list_init(&pool->buffers);
+	wl_list_init(&pool->idle);
+}
+
+static void entry_destroy(struct wlr_buffer_pool_entry *entry) {
+	struct wlr_allocator_stats *stats = &entry->pool->allocator->stats;
+	assert(stats->pooled > 0 && stats->pooled_bytes >= entry->size);
+	stats->pooled--;
+	stats->pooled_bytes -= entry->size;
+
+	wl_list_remove(&entry->link);
+	entry->pool->destroy(entry);
+}
+
+static void pool_expire(struct wlr_buffer_pool *pool, int64_t now_msec,
+		size_t max_bytes) {
+	const struct wlr_allocator_stats *stats = &pool->allocator->stats;
+
+	// The least recently used entries are at the end
+	struct wlr_buffer_pool_entry *entry, *tmp;
+	wl_list_for_each_reverse_safe(entry, tmp, &pool->idle, link) {
+		if (now_msec - entry->idle_since_msec < POOL_MAX_IDLE_MSEC &&
+				stats->pooled_bytes <= max_bytes) {
+			break;
+		}
+		entry_destroy(entry);
+	}
+}
+
+void buffer_pool_finish(struct wlr_buffer_pool *pool) {
+	struct wlr_buffer_pool_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &pool->idle, link) {
+		entry_destroy(entry);
+	}
+	wl_list_for_each_safe(entry, tmp, &pool->buffers, link) {
+		entry->pool = NULL;
+		wl_list_remove(&entry->link);
+		wl_list_init(&entry->link);
+	}
+}
+
+bool buffer_pool_use_hugetlb(const struct wlr_buffer_pool *pool, size_t size) {
+	return pool->hugepages == WLR_BUFFER_POOL_HUGEPAGES_EXPLICIT &&
+		size >= pool->huge_page_size;
+}
+
+struct wlr_buffer_pool_entry *buffer_pool_acquire(struct wlr_buffer_pool *pool,
+		int width, int height, uint32_t format) {
+	if (!pool->enabled) {
+		return NULL;
+	}
+	pool_expire(pool, get_current_time_msec(), POOL_MAX_BYTES);
+
+	struct wlr_buffer_pool_entry *entry;
+	wl_list_for_each(entry, &pool->idle, link) {
+		if (entry->width != width || entry->height != height ||
+				entry->format != format) {
+			continue;
+		}
+
+		struct wlr_allocator_stats *stats = &pool->allocator->stats;
+		stats->pooled--;
+		stats->pooled_bytes -= entry->size;
+		stats->recycled++;
+
+		wl_list_remove(&entry->link);
+		wl_list_insert(&pool->buffers, &entry->link);
+		return entry;
+	}
+	return NULL;
+}
+
+void buffer_pool_add(struct wlr_buffer_pool *pool,
+		struct wlr_buffer_pool_entry *entry, int width, int height,
+		uint32_t format, size_t size) {
+	*entry = (struct wlr_buffer_pool_entry){
+		.pool = pool,
+		.width = width,
+		.height = height,
+		.format = format,
+		.size = size,
+	};
+	wl_list_insert(&pool->buffers, &entry->link);
+}
+
+bool buffer_pool_release(struct wlr_buffer_pool_entry *entry) {
+	struct wlr_buffer_pool *pool = entry->pool;
+	if (pool == NULL) {
+		return false;
+	}
+
+	wl_list_remove(&entry->link);
+	if (!pool->enabled || entry->size > POOL_MAX_BYTES) {
+		return false;
+	}
+
+	int64_t now_msec = get_current_time_msec();
+	pool_expire(pool, now_msec, POOL_MAX_BYTES - entry->size);
+
+	struct wlr_allocator_stats *stats = &pool->allocator->stats;
+	stats->pooled++;
+	stats->pooled_bytes += entry->size;
+
+	entry->idle_since_msec = now_msec;
+	wl_list_insert(&pool->idle, &entry->link);
+
+	if (pool->reclaim != NULL) {
+		pool->reclaim(entry);
+	}
+	return true;
+}
@@ -1,3 +1,5 @@
+#undef _POSIX_C_SOURCE
+#define _DEFAULT_SOURCE // for MADV_REMOVE, MADV_HUGEPAGE and MAP_POPULATE
 #include <assert.h>
 #include <drm_fourcc.h>
 #include <stdlib.h>
@@ -9,6 +11,7 @@
 #include <wlr/util/log.h>
 
 #include "render/pixel_format.h"
+#include "render/allocator/pool.h"
 #include "render/allocator/shm.h"
 #include "util/shm.h"
 
@@ -21,14 +24,20 @@ static struct wlr_shm_buffer *shm_buffer_from_buffer(
 	return buffer;
 }
 
-static void buffer_destroy(struct wlr_buffer *wlr_buffer) {
-	struct wlr_shm_buffer *buffer = shm_buffer_from_buffer(wlr_buffer);
-	wlr_buffer_finish(wlr_buffer);
+static void buffer_release(struct wlr_shm_buffer *buffer) {
 	munmap(buffer->data, buffer->size);
 	close(buffer->shm.fd);
 	free(buffer);
 }
 
+static void buffer_destroy(struct wlr_buffer *wlr_buffer) {
+	struct wlr_shm_buffer *buffer = shm_buffer_from_buffer(wlr_buffer);
+	wlr_buffer_finish(wlr_buffer);
+	if (!buffer_pool_release(&buffer->pool_entry)) {
+		buffer_release(buffer);
+	}
+}
+
 static bool buffer_get_shm(struct wlr_buffer *wlr_buffer,
 		struct wlr_shm_attributes *shm) {
 	struct wlr_shm_buffer *buffer = shm_buffer_from_buffer(wlr_buffer);
@@ -39,7 +48,7 @@ static bool buffer_get_shm(struct wlr_buffer *wlr_buffer,
 static bool shm_buffer_begin_data_ptr_access(struct wlr_buffer *wlr_buffer,
 		uint32_t flags, void **data, uint32_t *format, size_t *stride) {
 	struct wlr_shm_buffer *buffer = shm_buffer_from_buffer(wlr_buffer);
-	*data = buffer->data;
+	*data = (char *)buffer->data + buffer->shm.offset;
 	*format = buffer->shm.format;
 	*stride = buffer->shm.stride;
 	return true;
@@ -56,9 +65,126 @@ static const struct wlr_buffer_impl buffer_impl = {
 	.end_data_ptr_access = shm_buffer_end_data_ptr_access,
 };
 
+static void pool_entry_destroy(struct wlr_buffer_pool_entry *entry) {
+	struct wlr_shm_buffer *buffer = wl_container_of(entry, buffer, pool_entry);
+	buffer_release(buffer);
+}
+
+static void pool_entry_reclaim(struct wlr_buffer_pool_entry *entry) {
+#ifdef MADV_REMOVE
+	// The mapping stays valid, pages are zero-filled on next access. Huge
+	// pages are kept, they might not be available anymore on next access.
+	struct wlr_shm_buffer *buffer = wl_container_of(entry, buffer, pool_entry);
+	if (buffer->hugetlb) {
+		return;
+	}
+	if (madvise(buffer->data, buffer->size, MADV_REMOVE) != 0) {
+		wlr_log_errno(WLR_DEBUG, "madvise(MADV_REMOVE) failed");
+	}
+#endif
+}
+
+static void buffer_prefault(struct wlr_shm_buffer *buffer) {
+#ifdef MADV_POPULATE_WRITE
+	if (madvise(buffer->data, buffer->size, MADV_POPULATE_WRITE) != 0) {
+		wlr_log_errno(WLR_DEBUG, "madvise(MADV_POPULATE_WRITE) failed");
+	}
+#endif
+}
+
+static bool buffer_map(struct wlr_shm_buffer *buffer,
+		const struct wlr_buffer_pool *pool, bool hugetlb) {
+	bool transparent = !hugetlb &&
+		pool->hugepages == WLR_BUFFER_POOL_HUGEPAGES_TRANSPARENT;
+
+	int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+	// With transparent huge pages, populate once the mapping is advised
+	if (pool->prefault && !transparent) {
+		flags |= MAP_POPULATE;
+	}
+#endif
+
+	buffer->data = mmap(NULL, buffer->size, PROT_READ | PROT_WRITE, flags,
+		buffer->shm.fd, 0);
+	if (buffer->data == MAP_FAILED) {
+		// With explicit huge pages, this fails if none can be reserved
+		if (!hugetlb) {
+			wlr_log_errno(WLR_ERROR, "mmap failed");
+		}
+		return false;
+	}
+
+	if (transparent) {
+#ifdef MADV_HUGEPAGE
+		if (madvise(buffer->data, buffer->size, MADV_HUGEPAGE) != 0) {
+			wlr_log_errno(WLR_DEBUG, "madvise(MADV_HUGEPAGE) failed");
+		}
+#endif
+		if (pool->prefault) {
+			buffer_prefault(buffer);
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Back the buffer with explicit huge pages. The file is sized up to a multiple
+ * of the huge page size and the pixels are placed at its end, so that shm
+ * consumers, which map offset + stride * height bytes, map whole huge pages.
+ */
+static bool buffer_alloc_hugetlb(struct wlr_shm_buffer *buffer,
+		const struct wlr_buffer_pool *pool) {
+	size_t pixels_size = buffer->size;
+	size_t size = pixels_size;
+	buffer->shm.fd = allocate_hugetlb_file(&size, 0);
+	if (buffer->shm.fd < 0) {
+		return false;
+	}
+
+	buffer->size = size;
+	if (!buffer_map(buffer, pool, true)) {
+		// No huge pages left, later buffers may still get some
+		wlr_log(WLR_DEBUG, "Explicit huge pages unavailable, "
+			"falling back to regular pages");
+		close(buffer->shm.fd);
+		buffer->size = pixels_size;
+		return false;
+	}
+
+	buffer->shm.offset = size - pixels_size;
+	buffer->hugetlb = true;
+	return true;
+}
+
+static const struct wlr_allocator_interface allocator_impl;
+
+static struct wlr_shm_allocator *shm_allocator_from_allocator(
+		struct wlr_allocator *wlr_allocator) {
+	assert(wlr_allocator->impl == &allocator_impl);
+	struct wlr_shm_allocator *allocator =
+		wl_container_of(wlr_allocator, allocator, base);
+	return allocator;
+}
+
 static struct wlr_buffer *allocator_create_buffer(
 		struct wlr_allocator *wlr_allocator, int width, int height,
 		const struct wlr_drm_format *format) {
+	struct wlr_shm_allocator *allocator =
+		shm_allocator_from_allocator(wlr_allocator);
+
+	struct wlr_buffer_pool_entry *entry =
+		buffer_pool_acquire(&allocator->pool, width, height, format->format);
+	if (entry != NULL) {
+		struct wlr_shm_buffer *buffer = wl_container_of(entry, buffer, pool_entry);
+		wlr_buffer_init(&buffer->base, &buffer_impl, width, height);
+		if (allocator->pool.reclaim != NULL && allocator->pool.prefault) {
+			buffer_prefault(buffer);
+		}
+		return &buffer->base;
+	}
+
 	const struct wlr_pixel_format_info *info =
 		drm_get_pixel_format_info(format->format);
 	if (info == NULL) {
@@ -75,32 +201,37 @@ static struct wlr_buffer *allocator_create_buffer(
 	// TODO: consider using a single file for multiple buffers
 	int stride = pixel_format_info_min_stride(info, width); // TODO: align?
 	buffer->size = stride * height;
-	buffer->shm.fd = allocate_shm_file(buffer->size);
-	if (buffer->shm.fd < 0) {
-		free(buffer);
-		return NULL;
-	}
-
 	buffer->shm.format = format->format;
 	buffer->shm.width = width;
 	buffer->shm.height = height;
 	buffer->shm.stride = stride;
 	buffer->shm.offset = 0;
 
-	buffer->data = mmap(NULL, buffer->size, PROT_READ | PROT_WRITE, MAP_SHARED,
-		buffer->shm.fd, 0);
-	if (buffer->data == MAP_FAILED) {
-		wlr_log_errno(WLR_ERROR, "mmap failed");
-		close(buffer->shm.fd);
-		free(buffer);
-		return NULL;
+	if (!buffer_pool_use_hugetlb(&allocator->pool, buffer->size) ||
+			!buffer_alloc_hugetlb(buffer, &allocator->pool)) {
+		buffer->shm.fd = allocate_shm_file(buffer->size);
+		if (buffer->shm.fd < 0) {
+			free(buffer);
+			return NULL;
+		}
+		if (!buffer_map(buffer, &allocator->pool, false)) {
+			close(buffer->shm.fd);
+			free(buffer);
+			return NULL;
+		}
 	}
 
+	buffer_pool_add(&allocator->pool, &buffer->pool_entry, width, height,
+		format->format, buffer->size);
+
 	return &buffer->base;
 }
 
 static void allocator_destroy(struct wlr_allocator *wlr_allocator) {
-	free(wlr_allocator);
+	struct wlr_shm_allocator *allocator =
+		shm_allocator_from_allocator(wlr_allocator);
+	buffer_pool_finish(&allocator->pool);
+	free(allocator);
 }
 
 static const struct wlr_allocator_interface allocator_impl = {
@@ -115,6 +246,8 @@ struct wlr_allocator *wlr_shm_allocator_create(void) {
 	}
 	wlr_allocator_init(&allocator->base, &allocator_impl,
 		WLR_BUFFER_CAP_DATA_PTR | WLR_BUFFER_CAP_SHM);
+	buffer_pool_init(&allocator->pool, &allocator->base, pool_entry_destroy,
+		pool_entry_reclaim);
 
 	wlr_log(WLR_DEBUG, "Created shm allocator");
 	return &allocator->base;
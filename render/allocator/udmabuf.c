@@ -14,8 +14,13 @@
 #include <wlr/render/drm_format_set.h>
 #include <wlr/util/log.h>
 
+#include "render/allocator/pool.h"
 #include "render/allocator/udmabuf.h"
 #include "render/pixel_format.h"
+#include "util/shm.h"
+
+// Alignment of the stride of buffers backed by explicit huge pages
+#define HUGETLB_STRIDE_ALIGN 256
 
 static bool buffer_get_shm(struct wlr_buffer *wlr_buffer, struct wlr_shm_attributes *shm) {
 	struct wlr_udmabuf_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
@@ -29,25 +34,59 @@ static bool buffer_get_dmabuf(struct wlr_buffer *wlr_buffer, struct wlr_dmabuf_a
 	return true;
 }
 
-static void buffer_destroy(struct wlr_buffer *wlr_buffer) {
-	struct wlr_udmabuf_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
-	wlr_buffer_finish(wlr_buffer);
+static void buffer_release(struct wlr_udmabuf_buffer *buffer) {
 	wlr_dmabuf_attributes_finish(&buffer->dmabuf);
 	close(buffer->shm.fd);
 	free(buffer);
 }
 
+static void buffer_destroy(struct wlr_buffer *wlr_buffer) {
+	struct wlr_udmabuf_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
+	wlr_buffer_finish(wlr_buffer);
+	if (!buffer_pool_release(&buffer->pool_entry)) {
+		buffer_release(buffer);
+	}
+}
+
 static const struct wlr_buffer_impl buffer_impl = {
 	.destroy = buffer_destroy,
 	.get_shm = buffer_get_shm,
 	.get_dmabuf = buffer_get_dmabuf,
 };
 
+static void pool_entry_destroy(struct wlr_buffer_pool_entry *entry) {
+	struct wlr_udmabuf_buffer *buffer = wl_container_of(entry, buffer, pool_entry);
+	buffer_release(buffer);
+}
+
+// Creates a DMA-BUF for the whole memfd, which must be page-aligned
+static int create_udmabuf(int udmabuf_fd, int memfd, size_t size) {
+	if (fcntl(memfd, F_ADD_SEALS, F_SEAL_SEAL | F_SEAL_SHRINK) < 0) {
+		return -1;
+	}
+
+	struct udmabuf_create udmabuf_create = {
+		.memfd = memfd,
+		.flags = UDMABUF_FLAGS_CLOEXEC,
+		.offset = 0,
+		.size = size,
+	};
+	return ioctl(udmabuf_fd, UDMABUF_CREATE, &udmabuf_create);
+}
+
 static struct wlr_buffer *allocator_create_buffer(
 		struct wlr_allocator *wlr_allocator, int width, int height,
 		const struct wlr_drm_format *format) {
 	struct wlr_udmabuf_allocator *allocator = wl_container_of(wlr_allocator, allocator, base);
 
+	struct wlr_buffer_pool_entry *entry =
+		buffer_pool_acquire(&allocator->pool, width, height, format->format);
+	if (entry != NULL) {
+		struct wlr_udmabuf_buffer *buffer = wl_container_of(entry, buffer, pool_entry);
+		wlr_buffer_init(&buffer->base, &buffer_impl, width, height);
+		return &buffer->base;
+	}
+
 	const struct wlr_pixel_format_info *info =
 		drm_get_pixel_format_info(format->format);
 	if (info == NULL) {
@@ -74,32 +113,52 @@ static struct wlr_buffer *allocator_create_buffer(
 		size += page_size - (size % page_size);
 	}
 
-	int memfd = memfd_create("wlroots", MFD_CLOEXEC | MFD_ALLOW_SEALING);
-	if (memfd < 0) {
-		wlr_log_errno(WLR_ERROR, "memfd_create() failed");
-		goto err_buffer;
-	}
-
-	if (ftruncate(memfd, size) < 0) {
-		wlr_log_errno(WLR_ERROR, "ftruncate() failed");
-		goto err_memfd;
+	int memfd = -1;
+	int dmabuf_fd = -1;
+	size_t offset = 0;
+	if (buffer_pool_use_hugetlb(&allocator->pool, size)) {
+		// The pixels are placed at the end of the file, so that shm consumers
+		// which map offset + stride * height bytes map whole huge pages. The
+		// stride is aligned so that the DMA-BUF offset is, too.
+		int hugetlb_stride = (stride + HUGETLB_STRIDE_ALIGN - 1) /
+			HUGETLB_STRIDE_ALIGN * HUGETLB_STRIDE_ALIGN;
+		size_t hugetlb_size = (size_t)hugetlb_stride * height;
+		// udmabuf only accepts hugetlb memfds on recent kernels, and pins
+		// the pages so this fails if none are available
+		memfd = allocate_hugetlb_file(&hugetlb_size, MFD_ALLOW_SEALING);
+		if (memfd >= 0) {
+			dmabuf_fd = create_udmabuf(allocator->fd, memfd, hugetlb_size);
+			if (dmabuf_fd >= 0) {
+				offset = hugetlb_size - (size_t)hugetlb_stride * height;
+				stride = hugetlb_stride;
+				size = hugetlb_size;
+			} else {
+				close(memfd);
+			}
+		}
+		if (dmabuf_fd < 0) {
+			wlr_log(WLR_DEBUG, "Explicit huge pages unavailable, "
+				"falling back to regular pages");
+		}
 	}
 
-	if (fcntl(memfd, F_ADD_SEALS, F_SEAL_SEAL | F_SEAL_SHRINK) < 0) {
-		wlr_log_errno(WLR_ERROR, "fcntl(F_ADD_SEALS) failed");
-		goto err_memfd;
-	}
-
-	struct udmabuf_create udmabuf_create = {
-		.memfd = memfd,
-		.flags = UDMABUF_FLAGS_CLOEXEC,
-		.offset = 0,
-		.size = size,
-	};
-	int dmabuf_fd = ioctl(allocator->fd, UDMABUF_CREATE, &udmabuf_create);
 	if (dmabuf_fd < 0) {
-		wlr_log_errno(WLR_ERROR, "ioctl(UDMABUF_CREATE) failed");
-		goto err_memfd;
+		memfd = memfd_create("wlroots", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+		if (memfd < 0) {
+			wlr_log_errno(WLR_ERROR, "memfd_create() failed");
+			goto err_buffer;
+		}
+
+		if (ftruncate(memfd, size) < 0) {
+			wlr_log_errno(WLR_ERROR, "ftruncate() failed");
+			goto err_memfd;
+		}
+
+		dmabuf_fd = create_udmabuf(allocator->fd, memfd, size);
+		if (dmabuf_fd < 0) {
+			wlr_log_errno(WLR_ERROR, "Failed to create udmabuf");
+			goto err_memfd;
+		}
 	}
 
 	buffer->size = size;
@@ -107,7 +166,7 @@ static struct wlr_buffer *allocator_create_buffer(
 		.width = width,
 		.height = height,
 		.format = format->format,
-		.offset = 0,
+		.offset = offset,
 		.stride = stride,
 		.fd = memfd,
 	};
@@ -117,11 +176,14 @@ static struct wlr_buffer *allocator_create_buffer(
 		.format = format->format,
 		.modifier = DRM_FORMAT_MOD_LINEAR,
 		.n_planes = 1,
-		.offset[0] = 0,
+		.offset[0] = offset,
 		.stride[0] = stride,
 		.fd[0] = dmabuf_fd,
 	};
 
+	buffer_pool_add(&allocator->pool, &buffer->pool_entry, width, height,
+		format->format, size);
+
 	return &buffer->base;
 
 err_memfd:
@@ -133,6 +195,7 @@ err_buffer:
 
 static void allocator_destroy(struct wlr_allocator *wlr_allocator) {
 	struct wlr_udmabuf_allocator *allocator = wl_container_of(wlr_allocator, allocator, base);
+	buffer_pool_finish(&allocator->pool);
 	close(allocator->fd);
 	free(allocator);
 }
@@ -158,6 +221,8 @@ struct wlr_allocator *wlr_udmabuf_allocator_create(void) {
 		WLR_BUFFER_CAP_SHM | WLR_BUFFER_CAP_DMABUF);
 
 	allocator->fd = fd;
+	// Pages are pinned by the DMA-BUF, so they can't be reclaimed
+	buffer_pool_init(&allocator->pool, &allocator->base, pool_entry_destroy, NULL);
 
 	return &allocator->base;
 }
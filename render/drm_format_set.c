@@ -27,13 +27,31 @@ void wlr_drm_format_set_finish(struct wlr_drm_format_set *set) {
 	set->formats = NULL;
 }
 
-static struct wlr_drm_format *format_set_get(const struct wlr_drm_format_set *set,
+/**
+ * Binary search for a format in the set, which is kept sorted by format code.
+ * Returns the index of the format if found, or the index at which it should be
+ * inserted otherwise.
+ */
+static size_t format_set_lower_bound(const struct wlr_drm_format_set *set,
 		uint32_t format) {
-	for (size_t i = 0; i < set->len; ++i) {
-		if (set->formats[i].format == format) {
-			return &set->formats[i];
+	size_t lo = 0, hi = set->len;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (set->formats[mid].format < format) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
 		}
 	}
+	return lo;
+}
+
+static struct wlr_drm_format *format_set_get(const struct wlr_drm_format_set *set,
+		uint32_t format) {
+	size_t idx = format_set_lower_bound(set, format);
+	if (idx < set->len && set->formats[idx].format == format) {
+		return &set->formats[idx];
+	}
 
 	return NULL;
 }
@@ -56,9 +74,9 @@ bool wlr_drm_format_set_add(struct wlr_drm_format_set *set, uint32_t format,
 		uint64_t modifier) {
 	assert(format != DRM_FORMAT_INVALID);
 
-	struct wlr_drm_format *existing = format_set_get(set, format);
-	if (existing) {
-		return wlr_drm_format_add(existing, modifier);
+	size_t idx = format_set_lower_bound(set, format);
+	if (idx < set->len && set->formats[idx].format == format) {
+		return wlr_drm_format_add(&set->formats[idx], modifier);
 	}
 
 	struct wlr_drm_format fmt;
@@ -82,10 +100,32 @@ bool wlr_drm_format_set_add(struct wlr_drm_format_set *set, uint32_t format,
 		set->formats = fmts;
 	}
 
-	set->formats[set->len++] = fmt;
+	memmove(&set->formats[idx + 1], &set->formats[idx],
+		(set->len - idx) * sizeof(set->formats[0]));
+	set->formats[idx] = fmt;
+	set->len++;
 	return true;
 }
 
+/**
+ * Binary search for a modifier in the format, whose modifiers are kept sorted.
+ * Returns the index of the modifier if found, or the index at which it should
+ * be inserted otherwise.
+ */
+static size_t format_lower_bound(const struct wlr_drm_format *fmt,
+		uint64_t modifier) {
+	size_t lo = 0, hi = fmt->len;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (fmt->modifiers[mid] < modifier) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
 bool wlr_drm_format_set_remove(struct wlr_drm_format_set *set, uint32_t format,
 		uint64_t modifier) {
 	struct wlr_drm_format *fmt = format_set_get(set, format);
@@ -93,14 +133,14 @@ bool wlr_drm_format_set_remove(struct wlr_drm_format_set *set, uint32_t format,
 		return false;
 	}
 
-	for (size_t idx = 0; idx < fmt->len; idx++) {
-		if (fmt->modifiers[idx] == modifier) {
-			memmove(&fmt->modifiers[idx], &fmt->modifiers[idx+1], (fmt->len - idx - 1) * sizeof(fmt->modifiers[0]));
-			fmt->len--;
-			return true;
-		}
+	size_t idx = format_lower_bound(fmt, modifier);
+	if (idx == fmt->len || fmt->modifiers[idx] != modifier) {
+		return false;
 	}
-	return false;
+
+	memmove(&fmt->modifiers[idx], &fmt->modifiers[idx+1], (fmt->len - idx - 1) * sizeof(fmt->modifiers[0]));
+	fmt->len--;
+	return true;
 }
 
 void wlr_drm_format_init(struct wlr_drm_format *fmt, uint32_t format) {
@@ -110,16 +150,13 @@ void wlr_drm_format_init(struct wlr_drm_format *fmt, uint32_t format) {
 }
 
 bool wlr_drm_format_has(const struct wlr_drm_format *fmt, uint64_t modifier) {
-	for (size_t i = 0; i < fmt->len; ++i) {
-		if (fmt->modifiers[i] == modifier) {
-			return true;
-		}
-	}
-	return false;
+	size_t idx = format_lower_bound(fmt, modifier);
+	return idx < fmt->len && fmt->modifiers[idx] == modifier;
 }
 
 bool wlr_drm_format_add(struct wlr_drm_format *fmt, uint64_t modifier) {
-	if (wlr_drm_format_has(fmt, modifier)) {
+	size_t idx = format_lower_bound(fmt, modifier);
+	if (idx < fmt->len && fmt->modifiers[idx] == modifier) {
 		return true;
 	}
 
@@ -136,7 +173,10 @@ bool wlr_drm_format_add(struct wlr_drm_format *fmt, uint64_t modifier) {
 		fmt->modifiers = new_modifiers;
 	}
 
-	fmt->modifiers[fmt->len++] = modifier;
+	memmove(&fmt->modifiers[idx + 1], &fmt->modifiers[idx],
+		(fmt->len - idx) * sizeof(fmt->modifiers[0]));
+	fmt->modifiers[idx] = modifier;
+	fmt->len++;
 	return true;
 }
 
@@ -203,13 +243,18 @@ bool wlr_drm_format_intersect(struct wlr_drm_format *dst,
 		.format = a->format,
 	};
 
-	for (size_t i = 0; i < a->len; i++) {
-		for (size_t j = 0; j < b->len; j++) {
-			if (a->modifiers[i] == b->modifiers[j]) {
-				assert(fmt.len < fmt.capacity);
-				fmt.modifiers[fmt.len++] = a->modifiers[i];
-				break;
-			}
+	// Both modifier lists are sorted, walk them in lockstep
+	size_t i = 0, j = 0;
+	while (i < a->len && j < b->len) {
+		if (a->modifiers[i] < b->modifiers[j]) {
+			i++;
+		} else if (a->modifiers[i] > b->modifiers[j]) {
+			j++;
+		} else {
+			assert(fmt.len < fmt.capacity);
+			fmt.modifiers[fmt.len++] = a->modifiers[i];
+			i++;
+			j++;
 		}
 	}
 
@@ -228,28 +273,35 @@ bool wlr_drm_format_set_intersect(struct wlr_drm_format_set *dst,
 		return false;
 	}
 
-	for (size_t i = 0; i < a->len; i++) {
-		for (size_t j = 0; j < b->len; j++) {
-			if (a->formats[i].format == b->formats[j].format) {
-				// When the two formats have no common modifier, keep
-				// intersecting the rest of the formats: they may be compatible
-				// with each other
-				out.formats[out.len] = (struct wlr_drm_format){0};
-				if (!wlr_drm_format_intersect(&out.formats[out.len],
-						&a->formats[i], &b->formats[j])) {
-					wlr_drm_format_set_finish(&out);
-					return false;
-				}
-
-				if (out.formats[out.len].len == 0) {
-					wlr_drm_format_finish(&out.formats[out.len]);
-				} else {
-					out.len++;
-				}
-
-				break;
-			}
+	// Both sets are sorted by format, walk them in lockstep
+	size_t i = 0, j = 0;
+	while (i < a->len && j < b->len) {
+		if (a->formats[i].format < b->formats[j].format) {
+			i++;
+			continue;
+		} else if (a->formats[i].format > b->formats[j].format) {
+			j++;
+			continue;
 		}
+
+		// When the two formats have no common modifier, keep
+		// intersecting the rest of the formats: they may be compatible
+		// with each other
+		out.formats[out.len] = (struct wlr_drm_format){0};
+		if (!wlr_drm_format_intersect(&out.formats[out.len],
+				&a->formats[i], &b->formats[j])) {
+			wlr_drm_format_set_finish(&out);
+			return false;
+		}
+
+		if (out.formats[out.len].len == 0) {
+			wlr_drm_format_finish(&out.formats[out.len]);
+		} else {
+			out.len++;
+		}
+
+		i++;
+		j++;
 	}
 
 	if (out.len == 0) {
@@ -262,18 +314,41 @@ bool wlr_drm_format_set_intersect(struct wlr_drm_format_set *dst,
 	return true;
 }
 
-static bool drm_format_set_extend(struct wlr_drm_format_set *dst,
-		const struct wlr_drm_format_set *src) {
-	for (size_t i = 0; i < src->len; i++) {
-		struct wlr_drm_format *format = &src->formats[i];
-		for (size_t j = 0; j < format->len; j++) {
-			if (!wlr_drm_format_set_add(dst, format->format, format->modifiers[j])) {
-				wlr_log_errno(WLR_ERROR, "Adding format/modifier to set failed");
-				return false;
-			}
+static bool drm_format_union(struct wlr_drm_format *dst,
+		const struct wlr_drm_format *a, const struct wlr_drm_format *b) {
+	assert(a->format == b->format);
+
+	size_t capacity = a->len + b->len;
+	uint64_t *modifiers = malloc(sizeof(*modifiers) * capacity);
+	if (!modifiers) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+
+	struct wlr_drm_format fmt = {
+		.capacity = capacity,
+		.len = 0,
+		.modifiers = modifiers,
+		.format = a->format,
+	};
+
+	// Both modifier lists are sorted, merge them
+	size_t i = 0, j = 0;
+	while (i < a->len || j < b->len) {
+		uint64_t modifier;
+		if (j == b->len || (i < a->len && a->modifiers[i] < b->modifiers[j])) {
+			modifier = a->modifiers[i++];
+		} else if (i == a->len || b->modifiers[j] < a->modifiers[i]) {
+			modifier = b->modifiers[j++];
+		} else {
+			modifier = a->modifiers[i];
+			i++;
+			j++;
 		}
+		fmt.modifiers[fmt.len++] = modifier;
 	}
 
+	*dst = fmt;
 	return true;
 }
 
@@ -281,17 +356,41 @@ bool wlr_drm_format_set_union(struct wlr_drm_format_set *dst,
 		const struct wlr_drm_format_set *a, const struct wlr_drm_format_set *b) {
 	struct wlr_drm_format_set out = {0};
 	out.capacity = a->len + b->len;
+	if (out.capacity == 0) {
+		// The union of two empty sets is empty
+		wlr_drm_format_set_finish(dst);
+		*dst = out;
+		return true;
+	}
+
 	out.formats = malloc(sizeof(*out.formats) * out.capacity);
 	if (out.formats == NULL) {
 		wlr_log_errno(WLR_ERROR, "Allocation failed");
 		return false;
 	}
 
-	// Add both a and b sets into out
-	if (!drm_format_set_extend(&out, a) ||
-		!drm_format_set_extend(&out, b)) {
-		wlr_drm_format_set_finish(&out);
-		return false;
+	// Both sets are sorted by format, merge them
+	size_t i = 0, j = 0;
+	while (i < a->len || j < b->len) {
+		bool ok;
+		struct wlr_drm_format *fmt = &out.formats[out.len];
+		*fmt = (struct wlr_drm_format){0};
+		if (j == b->len || (i < a->len &&
+				a->formats[i].format < b->formats[j].format)) {
+			ok = wlr_drm_format_copy(fmt, &a->formats[i++]);
+		} else if (i == a->len ||
+				b->formats[j].format < a->formats[i].format) {
+			ok = wlr_drm_format_copy(fmt, &b->formats[j++]);
+		} else {
+			ok = drm_format_union(fmt, &a->formats[i], &b->formats[j]);
+			i++;
+			j++;
+		}
+		if (!ok) {
+			wlr_drm_format_set_finish(&out);
+			return false;
+		}
+		out.len++;
 	}
 
 	wlr_drm_format_set_finish(dst);
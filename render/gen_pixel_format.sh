@@ -20,6 +20,16 @@ gen_info() {
 	'
 }
 
+gen_lookup() {
+	"$KDFS" show --json 'DRM_FORMAT_*' | jq -r '
+		[to_entries[] | select((.value.bytes_plane | length) == 1)]
+		| to_entries[]
+		|
+			"	case \(.value.key):\n" +
+			"		return &pixel_format_info[\(.key)];"
+	'
+}
+
 gen_opaque() {
 	"$KDFS" show --json 'DRM_FORMAT_*' | jq -r '
 		to_entries[]
@@ -59,6 +69,14 @@ $(gen_info)
 
 const size_t pixel_format_info_len = sizeof(pixel_format_info) / sizeof(pixel_format_info[0]);
 
+const struct wlr_pixel_format_info *drm_get_pixel_format_info(uint32_t format) {
+	switch (format) {
+$(gen_lookup)
+	default:
+		return NULL;
+	}
+}
+
 bool pixel_format_is_opaque(uint32_t format) {
 	switch (format) {
 $(gen_opaque)
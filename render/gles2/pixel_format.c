@@ -136,12 +136,18 @@ bool is_gles2_pixel_format_supported(const struct wlr_gles2_renderer *renderer,
 }
 
 const struct wlr_gles2_pixel_format *get_gles2_format_from_drm(uint32_t fmt) {
-	for (size_t i = 0; i < sizeof(formats) / sizeof(*formats); ++i) {
-		if (formats[i].drm_format == fmt) {
-			return &formats[i];
+	static struct pixel_format_index index = {0};
+	if (index.len == 0) {
+		for (size_t i = 0; i < sizeof(formats) / sizeof(*formats); ++i) {
+			pixel_format_index_add(&index, formats[i].drm_format, i);
 		}
 	}
-	return NULL;
+
+	size_t i;
+	if (!pixel_format_index_find(&index, fmt, &i)) {
+		return NULL;
+	}
+	return &formats[i];
 }
 
 const struct wlr_gles2_pixel_format *get_gles2_format_from_gl(
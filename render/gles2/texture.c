@@ -165,24 +165,18 @@ static bool gles2_texture_bind(struct wlr_gles2_texture *texture) {
 	return true;
 }
 
-static bool gles2_texture_read_pixels(struct wlr_texture *wlr_texture,
-		const struct wlr_texture_read_pixels_options *options) {
-	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
-
-	struct wlr_box src;
-	wlr_texture_read_pixels_options_get_src_box(options, wlr_texture, &src);
-
-	const struct wlr_gles2_pixel_format *fmt =
-		get_gles2_format_from_drm(options->format);
+static const struct wlr_gles2_pixel_format *get_read_format(
+		struct wlr_gles2_texture *texture, uint32_t format) {
+	const struct wlr_gles2_pixel_format *fmt = get_gles2_format_from_drm(format);
 	if (fmt == NULL || !is_gles2_pixel_format_supported(texture->renderer, fmt)) {
-		wlr_log(WLR_ERROR, "Cannot read pixels: unsupported pixel format 0x%"PRIX32, options->format);
-		return false;
+		wlr_log(WLR_ERROR, "Cannot read pixels: unsupported pixel format 0x%"PRIX32, format);
+		return NULL;
 	}
 
 	if (fmt->gl_format == GL_BGRA_EXT && !texture->renderer->exts.EXT_read_format_bgra) {
 		wlr_log(WLR_ERROR,
 			"Cannot read pixels: missing GL_EXT_read_format_bgra extension");
-		return false;
+		return NULL;
 	}
 
 	const struct wlr_pixel_format_info *drm_fmt =
@@ -190,8 +184,44 @@ static bool gles2_texture_read_pixels(struct wlr_texture *wlr_texture,
 	assert(drm_fmt);
 	if (pixel_format_info_pixels_per_block(drm_fmt) != 1) {
 		wlr_log(WLR_ERROR, "Cannot read pixels: block formats are not supported");
+		return NULL;
+	}
+
+	return fmt;
+}
+
+static bool wait_timeline(struct wlr_gles2_renderer *renderer,
+		struct wlr_drm_syncobj_timeline *timeline, uint64_t point) {
+	int sync_file_fd = wlr_drm_syncobj_timeline_export_sync_file(timeline, point);
+	if (sync_file_fd < 0) {
+		return false;
+	}
+
+	EGLSyncKHR sync = wlr_egl_create_sync(renderer->egl, sync_file_fd);
+	close(sync_file_fd);
+	if (sync == EGL_NO_SYNC_KHR) {
+		return false;
+	}
+
+	bool ok = wlr_egl_wait_sync(renderer->egl, sync);
+	wlr_egl_destroy_sync(renderer->egl, sync);
+	return ok;
+}
+
+static bool gles2_texture_read_pixels(struct wlr_texture *wlr_texture,
+		const struct wlr_texture_read_pixels_options *options) {
+	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
+
+	struct wlr_box src;
+	wlr_texture_read_pixels_options_get_src_box(options, wlr_texture, &src);
+
+	const struct wlr_gles2_pixel_format *fmt =
+		get_read_format(texture, options->format);
+	if (fmt == NULL) {
 		return false;
 	}
+	const struct wlr_pixel_format_info *drm_fmt =
+		drm_get_pixel_format_info(fmt->drm_format);
 
 	push_gles2_debug(texture->renderer);
 	struct wlr_egl_context prev_ctx;
@@ -203,25 +233,10 @@ static bool gles2_texture_read_pixels(struct wlr_texture *wlr_texture,
 		return false;
 	}
 
-	if (options->wait_timeline != NULL) {
-		int sync_file_fd =
-			wlr_drm_syncobj_timeline_export_sync_file(options->wait_timeline, options->wait_point);
-		if (sync_file_fd < 0) {
-			return false;
-		}
-
-		struct wlr_gles2_renderer *renderer = texture->renderer;
-		EGLSyncKHR sync = wlr_egl_create_sync(renderer->egl, sync_file_fd);
-		close(sync_file_fd);
-		if (sync == EGL_NO_SYNC_KHR) {
-			return false;
-		}
-
-		bool ok = wlr_egl_wait_sync(renderer->egl, sync);
-		wlr_egl_destroy_sync(renderer->egl, sync);
-		if (!ok) {
-			return false;
-		}
+	if (options->wait_timeline != NULL &&
+			!wait_timeline(texture->renderer, options->wait_timeline,
+				options->wait_point)) {
+		return false;
 	}
 
 	// Make sure any pending drawing is finished before we try to read it
@@ -254,6 +269,187 @@ static bool gles2_texture_read_pixels(struct wlr_texture *wlr_texture,
 	return glGetError() == GL_NO_ERROR;
 }
 
+struct wlr_gles2_texture_readback {
+	struct wlr_texture_readback base;
+	struct wlr_gles2_renderer *renderer;
+	GLuint pbo;
+	uint32_t stride;
+	size_t size;
+	void *mapped;
+};
+
+static const struct wlr_texture_readback_impl readback_impl;
+
+static struct wlr_gles2_texture_readback *gles2_get_readback(
+		struct wlr_texture_readback *wlr_readback) {
+	assert(wlr_readback->impl == &readback_impl);
+	struct wlr_gles2_texture_readback *readback =
+		wl_container_of(wlr_readback, readback, base);
+	return readback;
+}
+
+static bool gles2_readback_begin_data_ptr_access(
+		struct wlr_texture_readback *wlr_readback, const void **data,
+		uint32_t *stride) {
+	struct wlr_gles2_texture_readback *readback = gles2_get_readback(wlr_readback);
+	struct wlr_gles2_renderer *renderer = readback->renderer;
+	assert(readback->mapped == NULL);
+
+	struct wlr_egl_context prev_ctx;
+	if (!wlr_egl_make_current(renderer->egl, &prev_ctx)) {
+		return false;
+	}
+	push_gles2_debug(renderer);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, readback->pbo);
+	readback->mapped = renderer->procs.glMapBufferRangeEXT(GL_PIXEL_PACK_BUFFER_NV,
+		0, readback->size, GL_MAP_READ_BIT_EXT);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, 0);
+
+	pop_gles2_debug(renderer);
+	wlr_egl_restore_context(&prev_ctx);
+
+	if (readback->mapped == NULL) {
+		wlr_log(WLR_ERROR, "Failed to map pixel buffer object");
+		return false;
+	}
+
+	*data = readback->mapped;
+	*stride = readback->stride;
+	return true;
+}
+
+static void gles2_readback_end_data_ptr_access(
+		struct wlr_texture_readback *wlr_readback) {
+	struct wlr_gles2_texture_readback *readback = gles2_get_readback(wlr_readback);
+	struct wlr_gles2_renderer *renderer = readback->renderer;
+	assert(readback->mapped != NULL);
+
+	struct wlr_egl_context prev_ctx;
+	wlr_egl_make_current(renderer->egl, &prev_ctx);
+	push_gles2_debug(renderer);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, readback->pbo);
+	renderer->procs.glUnmapBufferOES(GL_PIXEL_PACK_BUFFER_NV);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, 0);
+	readback->mapped = NULL;
+
+	pop_gles2_debug(renderer);
+	wlr_egl_restore_context(&prev_ctx);
+}
+
+static void gles2_readback_destroy(struct wlr_texture_readback *wlr_readback) {
+	struct wlr_gles2_texture_readback *readback = gles2_get_readback(wlr_readback);
+	struct wlr_gles2_renderer *renderer = readback->renderer;
+
+	struct wlr_egl_context prev_ctx;
+	wlr_egl_make_current(renderer->egl, &prev_ctx);
+	push_gles2_debug(renderer);
+
+	glDeleteBuffers(1, &readback->pbo);
+
+	pop_gles2_debug(renderer);
+	wlr_egl_restore_context(&prev_ctx);
+
+	free(readback);
+}
+
+static const struct wlr_texture_readback_impl readback_impl = {
+	.begin_data_ptr_access = gles2_readback_begin_data_ptr_access,
+	.end_data_ptr_access = gles2_readback_end_data_ptr_access,
+	.destroy = gles2_readback_destroy,
+};
+
+static struct wlr_texture_readback *gles2_texture_read_pixels_async(
+		struct wlr_texture *wlr_texture,
+		const struct wlr_texture_read_pixels_options *options, int *fence_fd) {
+	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
+	struct wlr_gles2_renderer *renderer = texture->renderer;
+
+	// Without a native fence, we couldn't tell when the pixels land
+	if (!renderer->exts.pixel_buffer_object ||
+			!renderer->egl->procs.eglDupNativeFenceFDANDROID) {
+		return NULL;
+	}
+
+	const struct wlr_gles2_pixel_format *fmt =
+		get_read_format(texture, options->format);
+	if (fmt == NULL) {
+		return NULL;
+	}
+	const struct wlr_pixel_format_info *drm_fmt =
+		drm_get_pixel_format_info(fmt->drm_format);
+
+	const struct wlr_box *src = &options->src_box;
+	struct wlr_gles2_texture_readback *readback = calloc(1, sizeof(*readback));
+	if (readback == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	wlr_texture_readback_init(&readback->base, &readback_impl,
+		options->format, src);
+	readback->renderer = renderer;
+	readback->stride = pixel_format_info_min_stride(drm_fmt, src->width);
+	readback->size = (size_t)readback->stride * src->height;
+
+	struct wlr_egl_context prev_ctx;
+	if (!wlr_egl_make_current(renderer->egl, &prev_ctx)) {
+		free(readback);
+		return NULL;
+	}
+	push_gles2_debug(renderer);
+
+	int sync_file_fd = -1;
+	if (!gles2_texture_bind(texture)) {
+		goto out;
+	}
+
+	if (options->wait_timeline != NULL &&
+			!wait_timeline(renderer, options->wait_timeline, options->wait_point)) {
+		goto out;
+	}
+
+	glGetError(); // Clear the error flag
+
+	// GLES2 has no GL_STREAM_READ, the usage is only a hint anyways
+	glGenBuffers(1, &readback->pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, readback->pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER_NV, readback->size, NULL, GL_STREAM_DRAW);
+
+	// With a pixel pack buffer bound, the pointer is an offset into it and
+	// glReadPixels() returns without waiting for the GPU
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(src->x, src->y, src->width, src->height,
+		fmt->gl_format, fmt->gl_type, NULL);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, 0);
+
+	if (glGetError() != GL_NO_ERROR) {
+		goto out;
+	}
+
+	EGLSyncKHR sync = wlr_egl_create_sync(renderer->egl, -1);
+	if (sync == EGL_NO_SYNC_KHR) {
+		goto out;
+	}
+	// The native fence FD is only available once the commands are flushed
+	glFlush();
+	sync_file_fd = wlr_egl_dup_fence_fd(renderer->egl, sync);
+	wlr_egl_destroy_sync(renderer->egl, sync);
+
+out:
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	pop_gles2_debug(renderer);
+	wlr_egl_restore_context(&prev_ctx);
+
+	if (sync_file_fd < 0) {
+		gles2_readback_destroy(&readback->base);
+		return NULL;
+	}
+
+	*fence_fd = sync_file_fd;
+	return &readback->base;
+}
+
 static uint32_t gles2_texture_preferred_read_format(struct wlr_texture *wlr_texture) {
 	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
 
@@ -299,6 +495,7 @@ static const struct wlr_texture_impl texture_impl = {
 	.update_from_buffer = gles2_texture_update_from_buffer,
 	.read_pixels = gles2_texture_read_pixels,
 	.preferred_read_format = gles2_texture_preferred_read_format,
+	.read_pixels_async = gles2_texture_read_pixels_async,
 	.destroy = handle_gles2_texture_destroy,
 };
 
@@ -3,14 +3,48 @@
 #include <wlr/util/log.h>
 #include "render/pixel_format.h"
 
-const struct wlr_pixel_format_info *drm_get_pixel_format_info(uint32_t fmt) {
-	for (size_t i = 0; i < pixel_format_info_len; ++i) {
-		if (pixel_format_info[i].drm_format == fmt) {
-			return &pixel_format_info[i];
+static size_t pixel_format_index_hash(uint32_t fmt) {
+	// Fibonacci hashing: the multiplication mixes all four FourCC characters
+	// into the top bits
+	return (uint32_t)(fmt * 2654435769u) >> (32 - PIXEL_FORMAT_INDEX_BITS);
+}
+
+void pixel_format_index_add(struct pixel_format_index *index,
+		uint32_t fmt, size_t position) {
+	assert(fmt != DRM_FORMAT_INVALID);
+	// Keep the load factor at most 1/2 so that probe sequences stay short
+	assert(index->len < PIXEL_FORMAT_INDEX_SIZE / 2);
+	assert(position <= UINT16_MAX);
+
+	size_t slot = pixel_format_index_hash(fmt);
+	while (index->formats[slot] != DRM_FORMAT_INVALID) {
+		if (index->formats[slot] == fmt) {
+			return;
+		}
+		slot = (slot + 1) % PIXEL_FORMAT_INDEX_SIZE;
+	}
+
+	index->formats[slot] = fmt;
+	index->positions[slot] = position;
+	index->len++;
+}
+
+bool pixel_format_index_find(const struct pixel_format_index *index,
+		uint32_t fmt, size_t *position) {
+	if (fmt == DRM_FORMAT_INVALID) {
+		return false;
+	}
+
+	size_t slot = pixel_format_index_hash(fmt);
+	while (index->formats[slot] != DRM_FORMAT_INVALID) {
+		if (index->formats[slot] == fmt) {
+			*position = index->positions[slot];
+			return true;
 		}
+		slot = (slot + 1) % PIXEL_FORMAT_INDEX_SIZE;
 	}
 
-	return NULL;
+	return false;
 }
 
 uint32_t convert_wl_shm_format_to_drm(enum wl_shm_format fmt) {
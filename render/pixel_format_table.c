@@ -494,6 +494,175 @@ const struct wlr_pixel_format_info pixel_format_info[] = {
 
 const size_t pixel_format_info_len = sizeof(pixel_format_info) / sizeof(pixel_format_info[0]);
 
+const struct wlr_pixel_format_info *drm_get_pixel_format_info(uint32_t format) {
+	switch (format) {
+	case DRM_FORMAT_ABGR1555:
+		return &pixel_format_info[0];
+	case DRM_FORMAT_ABGR16161616:
+		return &pixel_format_info[1];
+	case DRM_FORMAT_ABGR16161616F:
+		return &pixel_format_info[2];
+	case DRM_FORMAT_ABGR2101010:
+		return &pixel_format_info[3];
+	case DRM_FORMAT_ABGR32323232F:
+		return &pixel_format_info[4];
+	case DRM_FORMAT_ABGR4444:
+		return &pixel_format_info[5];
+	case DRM_FORMAT_ABGR8888:
+		return &pixel_format_info[6];
+	case DRM_FORMAT_ARGB1555:
+		return &pixel_format_info[7];
+	case DRM_FORMAT_ARGB16161616:
+		return &pixel_format_info[8];
+	case DRM_FORMAT_ARGB16161616F:
+		return &pixel_format_info[9];
+	case DRM_FORMAT_ARGB2101010:
+		return &pixel_format_info[10];
+	case DRM_FORMAT_ARGB4444:
+		return &pixel_format_info[11];
+	case DRM_FORMAT_ARGB8888:
+		return &pixel_format_info[12];
+	case DRM_FORMAT_AVUY8888:
+		return &pixel_format_info[13];
+	case DRM_FORMAT_AXBXGXRX106106106106:
+		return &pixel_format_info[14];
+	case DRM_FORMAT_AYUV:
+		return &pixel_format_info[15];
+	case DRM_FORMAT_BGR161616:
+		return &pixel_format_info[16];
+	case DRM_FORMAT_BGR161616F:
+		return &pixel_format_info[17];
+	case DRM_FORMAT_BGR233:
+		return &pixel_format_info[18];
+	case DRM_FORMAT_BGR323232F:
+		return &pixel_format_info[19];
+	case DRM_FORMAT_BGR565:
+		return &pixel_format_info[20];
+	case DRM_FORMAT_BGR888:
+		return &pixel_format_info[21];
+	case DRM_FORMAT_BGRA1010102:
+		return &pixel_format_info[22];
+	case DRM_FORMAT_BGRA4444:
+		return &pixel_format_info[23];
+	case DRM_FORMAT_BGRA5551:
+		return &pixel_format_info[24];
+	case DRM_FORMAT_BGRA8888:
+		return &pixel_format_info[25];
+	case DRM_FORMAT_BGRX1010102:
+		return &pixel_format_info[26];
+	case DRM_FORMAT_BGRX4444:
+		return &pixel_format_info[27];
+	case DRM_FORMAT_BGRX5551:
+		return &pixel_format_info[28];
+	case DRM_FORMAT_BGRX8888:
+		return &pixel_format_info[29];
+	case DRM_FORMAT_GR1616:
+		return &pixel_format_info[30];
+	case DRM_FORMAT_GR1616F:
+		return &pixel_format_info[31];
+	case DRM_FORMAT_GR3232F:
+		return &pixel_format_info[32];
+	case DRM_FORMAT_GR88:
+		return &pixel_format_info[33];
+	case DRM_FORMAT_R10:
+		return &pixel_format_info[34];
+	case DRM_FORMAT_R12:
+		return &pixel_format_info[35];
+	case DRM_FORMAT_R16:
+		return &pixel_format_info[36];
+	case DRM_FORMAT_R16F:
+		return &pixel_format_info[37];
+	case DRM_FORMAT_R32F:
+		return &pixel_format_info[38];
+	case DRM_FORMAT_R8:
+		return &pixel_format_info[39];
+	case DRM_FORMAT_RG1616:
+		return &pixel_format_info[40];
+	case DRM_FORMAT_RG88:
+		return &pixel_format_info[41];
+	case DRM_FORMAT_RGB161616:
+		return &pixel_format_info[42];
+	case DRM_FORMAT_RGB332:
+		return &pixel_format_info[43];
+	case DRM_FORMAT_RGB565:
+		return &pixel_format_info[44];
+	case DRM_FORMAT_RGB888:
+		return &pixel_format_info[45];
+	case DRM_FORMAT_RGBA1010102:
+		return &pixel_format_info[46];
+	case DRM_FORMAT_RGBA4444:
+		return &pixel_format_info[47];
+	case DRM_FORMAT_RGBA5551:
+		return &pixel_format_info[48];
+	case DRM_FORMAT_RGBA8888:
+		return &pixel_format_info[49];
+	case DRM_FORMAT_RGBX1010102:
+		return &pixel_format_info[50];
+	case DRM_FORMAT_RGBX4444:
+		return &pixel_format_info[51];
+	case DRM_FORMAT_RGBX5551:
+		return &pixel_format_info[52];
+	case DRM_FORMAT_RGBX8888:
+		return &pixel_format_info[53];
+	case DRM_FORMAT_UYVY:
+		return &pixel_format_info[54];
+	case DRM_FORMAT_VUY888:
+		return &pixel_format_info[55];
+	case DRM_FORMAT_VYUY:
+		return &pixel_format_info[56];
+	case DRM_FORMAT_X0L2:
+		return &pixel_format_info[57];
+	case DRM_FORMAT_XBGR1555:
+		return &pixel_format_info[58];
+	case DRM_FORMAT_XBGR16161616:
+		return &pixel_format_info[59];
+	case DRM_FORMAT_XBGR16161616F:
+		return &pixel_format_info[60];
+	case DRM_FORMAT_XBGR2101010:
+		return &pixel_format_info[61];
+	case DRM_FORMAT_XBGR4444:
+		return &pixel_format_info[62];
+	case DRM_FORMAT_XBGR8888:
+		return &pixel_format_info[63];
+	case DRM_FORMAT_XRGB1555:
+		return &pixel_format_info[64];
+	case DRM_FORMAT_XRGB16161616:
+		return &pixel_format_info[65];
+	case DRM_FORMAT_XRGB16161616F:
+		return &pixel_format_info[66];
+	case DRM_FORMAT_XRGB2101010:
+		return &pixel_format_info[67];
+	case DRM_FORMAT_XRGB4444:
+		return &pixel_format_info[68];
+	case DRM_FORMAT_XRGB8888:
+		return &pixel_format_info[69];
+	case DRM_FORMAT_XVUY8888:
+		return &pixel_format_info[70];
+	case DRM_FORMAT_XVYU16161616:
+		return &pixel_format_info[71];
+	case DRM_FORMAT_XVYU2101010:
+		return &pixel_format_info[72];
+	case DRM_FORMAT_XYUV8888:
+		return &pixel_format_info[73];
+	case DRM_FORMAT_Y0L2:
+		return &pixel_format_info[74];
+	case DRM_FORMAT_Y216:
+		return &pixel_format_info[75];
+	case DRM_FORMAT_Y410:
+		return &pixel_format_info[76];
+	case DRM_FORMAT_Y416:
+		return &pixel_format_info[77];
+	case DRM_FORMAT_Y8:
+		return &pixel_format_info[78];
+	case DRM_FORMAT_YUYV:
+		return &pixel_format_info[79];
+	case DRM_FORMAT_YVYU:
+		return &pixel_format_info[80];
+	default:
+		return NULL;
+	}
+}
+
 bool pixel_format_is_opaque(uint32_t format) {
 	switch (format) {
 	case DRM_FORMAT_BGR161616:
@@ -1,6 +1,7 @@
 #include <drm_fourcc.h>
 #include <wlr/util/log.h>
 
+#include "render/pixel_format.h"
 #include "render/pixman.h"
 
 static const struct wlr_pixman_pixel_format formats[] = {
@@ -104,12 +105,18 @@ static const struct wlr_pixman_pixel_format formats[] = {
 };
 
 pixman_format_code_t get_pixman_format_from_drm(uint32_t fmt) {
-	for (size_t i = 0; i < sizeof(formats) / sizeof(*formats); ++i) {
-		if (formats[i].drm_format == fmt) {
-			return formats[i].pixman_format;
+	static struct pixel_format_index index = {0};
+	if (index.len == 0) {
+		for (size_t i = 0; i < sizeof(formats) / sizeof(*formats); ++i) {
+			pixel_format_index_add(&index, formats[i].drm_format, i);
 		}
 	}
 
+	size_t i;
+	if (pixel_format_index_find(&index, fmt, &i)) {
+		return formats[i].pixman_format;
+	}
+
 	wlr_log(WLR_ERROR, "DRM format 0x%"PRIX32" has no pixman equivalent", fmt);
 	return 0;
 }
@@ -554,21 +554,8 @@ static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 		.value = render_timeline_point,
 	};
 	if (renderer->dev->implicit_sync_interop || pass->signal_timeline != NULL) {
-		if (render_cb->binary_semaphore == VK_NULL_HANDLE) {
-			VkExportSemaphoreCreateInfo export_info = {
-				.sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO,
-				.handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT,
-			};
-			VkSemaphoreCreateInfo semaphore_info = {
-				.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-				.pNext = &export_info,
-			};
-			VkResult res = vkCreateSemaphore(renderer->dev->dev, &semaphore_info,
-				NULL, &render_cb->binary_semaphore);
-			if (res != VK_SUCCESS) {
-				wlr_vk_error("vkCreateSemaphore", res);
-				goto error;
-			}
+		if (!vulkan_command_buffer_ensure_binary_semaphore(renderer, render_cb)) {
+			goto error;
 		}
 
 		render_signal[render_signal_len++] = (VkSemaphoreSubmitInfoKHR){
@@ -241,12 +241,18 @@ const struct wlr_vk_format *vulkan_get_format_list(size_t *len) {
 }
 
 const struct wlr_vk_format *vulkan_get_format_from_drm(uint32_t drm_format) {
-	for (unsigned i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
-		if (formats[i].drm == drm_format) {
-			return &formats[i];
+	static struct pixel_format_index index = {0};
+	if (index.len == 0) {
+		for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+			pixel_format_index_add(&index, formats[i].drm, i);
 		}
 	}
-	return NULL;
+
+	size_t i;
+	if (!pixel_format_index_find(&index, drm_format, &i)) {
+		return NULL;
+	}
+	return &formats[i];
 }
 
 const VkImageUsageFlags vulkan_render_usage =
@@ -484,39 +484,74 @@ VkSemaphore vulkan_command_buffer_wait_sync_file(struct wlr_vk_renderer *rendere
 	return *sem_ptr;
 }
 
-bool vulkan_submit_stage_wait(struct wlr_vk_renderer *renderer, int wait_sync_file_fd) {
-	if (renderer->stage.cb == NULL) {
+bool vulkan_command_buffer_ensure_binary_semaphore(struct wlr_vk_renderer *renderer,
+		struct wlr_vk_command_buffer *cb) {
+	if (cb->binary_semaphore != VK_NULL_HANDLE) {
+		return true;
+	}
+
+	VkExportSemaphoreCreateInfo export_info = {
+		.sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO,
+		.handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT,
+	};
+	VkSemaphoreCreateInfo semaphore_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &export_info,
+	};
+	VkResult res = vkCreateSemaphore(renderer->dev->dev, &semaphore_info,
+		NULL, &cb->binary_semaphore);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreateSemaphore", res);
 		return false;
 	}
+	return true;
+}
+
+static struct wlr_vk_command_buffer *submit_stage(struct wlr_vk_renderer *renderer,
+		int wait_sync_file_fd, bool signal_binary_semaphore) {
+	if (renderer->stage.cb == NULL) {
+		return NULL;
+	}
 
 	struct wlr_vk_command_buffer *cb = renderer->stage.cb;
 	renderer->stage.cb = NULL;
 
 	uint64_t timeline_point = vulkan_end_command_buffer(cb, renderer);
 	if (timeline_point == 0) {
-		return false;
+		return NULL;
+	}
+
+	VkSemaphore signal_semaphores[2] = { renderer->timeline_semaphore };
+	// Values for binary semaphores are ignored
+	uint64_t signal_values[2] = { timeline_point };
+	uint32_t signal_len = 1;
+	if (signal_binary_semaphore) {
+		if (!vulkan_command_buffer_ensure_binary_semaphore(renderer, cb)) {
+			return NULL;
+		}
+		signal_semaphores[signal_len++] = cb->binary_semaphore;
 	}
 
 	VkSemaphore wait_semaphore;
 	VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
 	VkTimelineSemaphoreSubmitInfoKHR timeline_submit_info = {
 		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
-		.signalSemaphoreValueCount = 1,
-		.pSignalSemaphoreValues = &timeline_point,
+		.signalSemaphoreValueCount = signal_len,
+		.pSignalSemaphoreValues = signal_values,
 	};
 	VkSubmitInfo submit_info = {
 		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
 		.pNext = &timeline_submit_info,
 		.commandBufferCount = 1,
 		.pCommandBuffers = &cb->vk,
-		.signalSemaphoreCount = 1,
-		.pSignalSemaphores = &renderer->timeline_semaphore,
+		.signalSemaphoreCount = signal_len,
+		.pSignalSemaphores = signal_semaphores,
 	};
 
 	if (wait_sync_file_fd != -1) {
 		wait_semaphore = vulkan_command_buffer_wait_sync_file(renderer, cb, 0, wait_sync_file_fd);
 		if (wait_semaphore == VK_NULL_HANDLE) {
-			return false;
+			return NULL;
 		}
 		submit_info.waitSemaphoreCount = 1;
 		submit_info.pWaitSemaphores = &wait_semaphore;
@@ -528,6 +563,16 @@ bool vulkan_submit_stage_wait(struct wlr_vk_renderer *renderer, int wait_sync_fi
 	VkResult res = vkQueueSubmit(renderer->dev->queue, 1, &submit_info, VK_NULL_HANDLE);
 	if (res != VK_SUCCESS) {
 		wlr_vk_error("vkQueueSubmit", res);
+		return NULL;
+	}
+
+	return cb;
+}
+
+bool vulkan_submit_stage_wait(struct wlr_vk_renderer *renderer, int wait_sync_file_fd) {
+	struct wlr_vk_command_buffer *cb =
+		submit_stage(renderer, wait_sync_file_fd, false);
+	if (cb == NULL) {
 		return false;
 	}
 
@@ -536,10 +581,38 @@ bool vulkan_submit_stage_wait(struct wlr_vk_renderer *renderer, int wait_sync_fi
 	}
 
 	// We did a blocking wait so this is now the current point
-	stage_buffer_gc(renderer, timeline_point);
+	stage_buffer_gc(renderer, cb->timeline_point);
 	return true;
 }
 
+int vulkan_submit_stage_sync_file(struct wlr_vk_renderer *renderer,
+		int wait_sync_file_fd, uint64_t *timeline_point) {
+	struct wlr_vk_command_buffer *cb =
+		submit_stage(renderer, wait_sync_file_fd, true);
+	if (cb == NULL) {
+		return -1;
+	}
+
+	// Note: vkGetSemaphoreFdKHR implicitly resets the semaphore
+	const VkSemaphoreGetFdInfoKHR get_fence_fd_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR,
+		.semaphore = cb->binary_semaphore,
+		.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT,
+	};
+	int sync_file_fd = -1;
+	VkResult res = renderer->dev->api.vkGetSemaphoreFdKHR(renderer->dev->dev,
+		&get_fence_fd_info, &sync_file_fd);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkGetSemaphoreFdKHR", res);
+		// The submission still completes, but we can't tell when
+		vulkan_wait_command_buffer(cb, renderer);
+		return -1;
+	}
+
+	*timeline_point = cb->timeline_point;
+	return sync_file_fd;
+}
+
 struct wlr_vk_format_props *vulkan_format_props_from_drm(
 		struct wlr_vk_device *dev, uint32_t drm_fmt) {
 	for (size_t i = 0u; i < dev->format_prop_count; ++i) {
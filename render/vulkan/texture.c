@@ -6,6 +6,7 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <wlr/render/drm_syncobj.h>
 #include <wlr/render/wlr_texture.h>
 #include <wlr/render/vulkan.h>
 #include <wlr/util/log.h>
@@ -246,6 +247,262 @@ static bool vulkan_texture_read_pixels(struct wlr_texture *wlr_texture,
 		options->wait_timeline, options->wait_point);
 }
 
+struct wlr_vk_texture_readback {
+	struct wlr_texture_readback base;
+	struct wlr_vk_renderer *renderer;
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+	uint64_t timeline_point;
+	uint32_t stride;
+};
+
+static const struct wlr_texture_readback_impl readback_impl;
+
+static struct wlr_vk_texture_readback *vulkan_get_readback(
+		struct wlr_texture_readback *wlr_readback) {
+	assert(wlr_readback->impl == &readback_impl);
+	struct wlr_vk_texture_readback *readback =
+		wl_container_of(wlr_readback, readback, base);
+	return readback;
+}
+
+static bool readback_wait(struct wlr_vk_texture_readback *readback) {
+	struct wlr_vk_renderer *renderer = readback->renderer;
+	if (readback->timeline_point == 0) {
+		return true;
+	}
+
+	VkSemaphoreWaitInfoKHR wait_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,
+		.semaphoreCount = 1,
+		.pSemaphores = &renderer->timeline_semaphore,
+		.pValues = &readback->timeline_point,
+	};
+	VkResult res = renderer->dev->api.vkWaitSemaphoresKHR(renderer->dev->dev,
+		&wait_info, UINT64_MAX);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkWaitSemaphoresKHR", res);
+		return false;
+	}
+	return true;
+}
+
+static bool vulkan_readback_begin_data_ptr_access(
+		struct wlr_texture_readback *wlr_readback, const void **data,
+		uint32_t *stride) {
+	struct wlr_vk_texture_readback *readback = vulkan_get_readback(wlr_readback);
+	VkDevice dev = readback->renderer->dev->dev;
+
+	// Returns right away once the read-back is ready
+	if (!readback_wait(readback)) {
+		return false;
+	}
+
+	void *v;
+	VkResult res = vkMapMemory(dev, readback->memory, 0, VK_WHOLE_SIZE, 0, &v);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkMapMemory", res);
+		return false;
+	}
+
+	VkMappedMemoryRange mem_range = {
+		.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+		.memory = readback->memory,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE,
+	};
+	res = vkInvalidateMappedMemoryRanges(dev, 1, &mem_range);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkInvalidateMappedMemoryRanges", res);
+		vkUnmapMemory(dev, readback->memory);
+		return false;
+	}
+
+	*data = v;
+	*stride = readback->stride;
+	return true;
+}
+
+static void vulkan_readback_end_data_ptr_access(
+		struct wlr_texture_readback *wlr_readback) {
+	struct wlr_vk_texture_readback *readback = vulkan_get_readback(wlr_readback);
+	vkUnmapMemory(readback->renderer->dev->dev, readback->memory);
+}
+
+static void vulkan_readback_destroy(struct wlr_texture_readback *wlr_readback) {
+	struct wlr_vk_texture_readback *readback = vulkan_get_readback(wlr_readback);
+	VkDevice dev = readback->renderer->dev->dev;
+
+	// Submitted copies can't be cancelled, the buffer must outlive them
+	readback_wait(readback);
+
+	vkDestroyBuffer(dev, readback->buffer, NULL);
+	vkFreeMemory(dev, readback->memory, NULL);
+	free(readback);
+}
+
+static const struct wlr_texture_readback_impl readback_impl = {
+	.begin_data_ptr_access = vulkan_readback_begin_data_ptr_access,
+	.end_data_ptr_access = vulkan_readback_end_data_ptr_access,
+	.destroy = vulkan_readback_destroy,
+};
+
+static bool readback_alloc(struct wlr_vk_texture_readback *readback,
+		VkDeviceSize size) {
+	struct wlr_vk_renderer *renderer = readback->renderer;
+	VkDevice dev = renderer->dev->dev;
+
+	VkBufferCreateInfo buffer_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = size,
+		.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+	};
+	VkResult res = vkCreateBuffer(dev, &buffer_info, NULL, &readback->buffer);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkCreateBuffer", res);
+		return false;
+	}
+
+	VkMemoryRequirements mem_reqs;
+	vkGetBufferMemoryRequirements(dev, readback->buffer, &mem_reqs);
+
+	int mem_type = vulkan_find_mem_type(renderer->dev,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+		mem_reqs.memoryTypeBits);
+	if (mem_type < 0) {
+		wlr_log(WLR_ERROR, "Failed to find memory type for read-back");
+		return false;
+	}
+
+	VkMemoryAllocateInfo mem_alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = mem_reqs.size,
+		.memoryTypeIndex = mem_type,
+	};
+	res = vkAllocateMemory(dev, &mem_alloc_info, NULL, &readback->memory);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkAllocateMemory", res);
+		return false;
+	}
+
+	res = vkBindBufferMemory(dev, readback->buffer, readback->memory, 0);
+	if (res != VK_SUCCESS) {
+		wlr_vk_error("vkBindBufferMemory", res);
+		return false;
+	}
+
+	return true;
+}
+
+static struct wlr_texture_readback *vulkan_texture_read_pixels_async(
+		struct wlr_texture *wlr_texture,
+		const struct wlr_texture_read_pixels_options *options, int *fence_fd) {
+	struct wlr_vk_texture *texture = vulkan_get_texture(wlr_texture);
+	struct wlr_vk_renderer *renderer = texture->renderer;
+
+	// Buffer copies don't convert, and we need a sync_file to wait on
+	if (options->format != texture->format->drm ||
+			vulkan_format_is_ycbcr(texture->format) ||
+			!renderer->dev->sync_file_import_export) {
+		return NULL;
+	}
+
+	const struct wlr_pixel_format_info *fmt =
+		drm_get_pixel_format_info(options->format);
+	assert(fmt != NULL);
+
+	const struct wlr_box *src = &options->src_box;
+	struct wlr_vk_texture_readback *readback = calloc(1, sizeof(*readback));
+	if (readback == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	wlr_texture_readback_init(&readback->base, &readback_impl,
+		options->format, src);
+	readback->renderer = renderer;
+	readback->stride = pixel_format_info_min_stride(fmt, src->width);
+
+	if (!readback_alloc(readback, (VkDeviceSize)readback->stride * src->height)) {
+		goto error;
+	}
+
+	int wait_sync_file_fd = -1;
+	if (options->wait_timeline != NULL) {
+		wait_sync_file_fd = wlr_drm_syncobj_timeline_export_sync_file(
+			options->wait_timeline, options->wait_point);
+		if (wait_sync_file_fd < 0) {
+			wlr_log(WLR_ERROR, "Failed to export wait timeline point as sync_file");
+			goto error;
+		}
+	}
+
+	// Any pending upload to the texture is recorded in the stage command
+	// buffer, so record the copy after it
+	VkCommandBuffer cb = vulkan_record_stage_cb(renderer);
+	if (cb == VK_NULL_HANDLE) {
+		close(wait_sync_file_fd);
+		goto error;
+	}
+
+	vulkan_change_layout(cb, texture->image,
+		VK_IMAGE_LAYOUT_GENERAL,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_ACCESS_MEMORY_READ_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_ACCESS_TRANSFER_READ_BIT);
+
+	VkBufferImageCopy region = {
+		.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+		.imageSubresource.layerCount = 1,
+		.imageOffset = { .x = src->x, .y = src->y },
+		.imageExtent = {
+			.width = src->width,
+			.height = src->height,
+			.depth = 1,
+		},
+	};
+	vkCmdCopyImageToBuffer(cb, texture->image,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback->buffer, 1, &region);
+
+	vulkan_change_layout(cb, texture->image,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_ACCESS_TRANSFER_READ_BIT,
+		VK_IMAGE_LAYOUT_GENERAL,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_ACCESS_MEMORY_READ_BIT);
+
+	VkBufferMemoryBarrier host_barrier = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = readback->buffer,
+		.size = VK_WHOLE_SIZE,
+	};
+	vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &host_barrier, 0, NULL);
+
+	texture->last_used_cb = renderer->stage.cb;
+
+	int sync_file_fd = vulkan_submit_stage_sync_file(renderer,
+		wait_sync_file_fd, &readback->timeline_point);
+	if (sync_file_fd < 0) {
+		close(wait_sync_file_fd);
+		goto error;
+	}
+
+	*fence_fd = sync_file_fd;
+	return &readback->base;
+
+error:
+	vulkan_readback_destroy(&readback->base);
+	return NULL;
+}
+
 static uint32_t vulkan_texture_preferred_read_format(struct wlr_texture *wlr_texture) {
 	struct wlr_vk_texture *texture = vulkan_get_texture(wlr_texture);
 	return texture->format->drm;
@@ -255,6 +512,7 @@ static const struct wlr_texture_impl texture_impl = {
 	.update_from_buffer = vulkan_texture_update_from_buffer,
 	.read_pixels = vulkan_texture_read_pixels,
 	.preferred_read_format = vulkan_texture_preferred_read_format,
+	.read_pixels_async = vulkan_texture_read_pixels_async,
 	.destroy = vulkan_texture_unref,
 };
 
@@ -41,6 +41,7 @@ void wlr_renderer_init(struct wlr_renderer *renderer,
 
 	wl_signal_init(&renderer->events.destroy);
 	wl_signal_init(&renderer->events.lost);
+	wl_list_init(&renderer->readbacks);
 }
 
 void wlr_renderer_destroy(struct wlr_renderer *r) {
@@ -53,6 +54,14 @@ void wlr_renderer_destroy(struct wlr_renderer *r) {
 	assert(wl_list_empty(&r->events.destroy.listener_list));
 	assert(wl_list_empty(&r->events.lost.listener_list));
 
+	// Read-backs hold on to the renderer's resources, their callbacks destroy
+	// them while the renderer is still alive
+	while (!wl_list_empty(&r->readbacks)) {
+		struct wlr_texture_readback *readback =
+			wl_container_of(r->readbacks.next, readback, link);
+		wlr_texture_readback_cancel(readback);
+	}
+
 	if (r->impl && r->impl->destroy) {
 		r->impl->destroy(r);
 	} else {
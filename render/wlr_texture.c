@@ -3,8 +3,10 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <wlr/render/interface.h>
 #include <wlr/render/wlr_texture.h>
+#include <wlr/util/log.h>
 #include "render/pixel_format.h"
 #include "types/wlr_buffer.h"
 
@@ -70,6 +72,193 @@ uint32_t wlr_texture_preferred_read_format(struct wlr_texture *texture) {
 	return texture->impl->preferred_read_format(texture);
 }
 
+void wlr_texture_readback_init(struct wlr_texture_readback *readback,
+		const struct wlr_texture_readback_impl *impl, uint32_t format,
+		const struct wlr_box *src_box) {
+	assert(impl->begin_data_ptr_access && impl->end_data_ptr_access &&
+		impl->destroy);
+
+	*readback = (struct wlr_texture_readback){
+		.impl = impl,
+		.format = format,
+		.src_box = *src_box,
+		.fence_fd = -1,
+	};
+	wl_list_init(&readback->link);
+}
+
+static void readback_set_ready(struct wlr_texture_readback *readback) {
+	if (readback->event_source != NULL) {
+		wl_event_source_remove(readback->event_source);
+		readback->event_source = NULL;
+	}
+	if (readback->fence_fd >= 0) {
+		close(readback->fence_fd);
+		readback->fence_fd = -1;
+	}
+
+	readback->ready = true;
+	readback->callback(readback);
+}
+
+static int handle_readback_fence(int fd, uint32_t mask, void *data) {
+	struct wlr_texture_readback *readback = data;
+	if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+		wlr_log(WLR_ERROR, "Read-back fence FD error");
+	}
+	readback_set_ready(readback);
+	return 0;
+}
+
+static void handle_readback_idle(void *data) {
+	struct wlr_texture_readback *readback = data;
+	// Idle sources are removed once dispatched
+	readback->event_source = NULL;
+	readback_set_ready(readback);
+}
+
+struct wlr_texture_readback *wlr_texture_read_pixels_async(
+		struct wlr_texture *texture,
+		const struct wlr_texture_read_pixels_options *options,
+		struct wl_event_loop *loop, wlr_texture_readback_ready_callback callback,
+		void *data) {
+	assert(callback);
+	if (!texture->impl->read_pixels_async) {
+		return NULL;
+	}
+
+	const struct wlr_pixel_format_info *fmt =
+		drm_get_pixel_format_info(options->format);
+	if (fmt == NULL || pixel_format_info_pixels_per_block(fmt) != 1) {
+		return NULL;
+	}
+
+	struct wlr_box src;
+	wlr_texture_read_pixels_options_get_src_box(options, texture, &src);
+	if (src.x < 0 || src.y < 0 || src.width <= 0 || src.height <= 0 ||
+			(uint32_t)(src.x + src.width) > texture->width ||
+			(uint32_t)(src.y + src.height) > texture->height) {
+		return NULL;
+	}
+
+	struct wlr_texture_read_pixels_options async_options = {
+		.format = options->format,
+		.src_box = src,
+		.wait_timeline = options->wait_timeline,
+		.wait_point = options->wait_point,
+	};
+	int fence_fd = -1;
+	struct wlr_texture_readback *readback =
+		texture->impl->read_pixels_async(texture, &async_options, &fence_fd);
+	if (readback == NULL) {
+		return NULL;
+	}
+	wl_list_insert(&texture->renderer->readbacks, &readback->link);
+	if (!wlr_texture_readback_start(readback, fence_fd, loop, callback, data)) {
+		return NULL;
+	}
+	return readback;
+}
+
+bool wlr_texture_readback_start(struct wlr_texture_readback *readback,
+		int fence_fd, struct wl_event_loop *loop,
+		wlr_texture_readback_ready_callback callback, void *data) {
+	assert(callback);
+	readback->callback = callback;
+	readback->data = data;
+
+	// sync_file FDs become readable once signalled
+	if (fence_fd >= 0) {
+		readback->fence_fd = fence_fd;
+		readback->event_source = wl_event_loop_add_fd(loop, fence_fd,
+			WL_EVENT_READABLE, handle_readback_fence, readback);
+	} else {
+		readback->event_source = wl_event_loop_add_idle(loop,
+			handle_readback_idle, readback);
+	}
+	if (readback->event_source == NULL) {
+		wlr_log(WLR_ERROR, "Failed to add read-back to event loop");
+		wlr_texture_readback_destroy(readback);
+		return false;
+	}
+
+	return true;
+}
+
+void wlr_texture_readback_cancel(struct wlr_texture_readback *readback) {
+	if (readback->event_source != NULL) {
+		wl_event_source_remove(readback->event_source);
+		readback->event_source = NULL;
+	}
+	if (readback->fence_fd >= 0) {
+		close(readback->fence_fd);
+		readback->fence_fd = -1;
+	}
+	wl_list_remove(&readback->link);
+	wl_list_init(&readback->link);
+
+	readback->cancelled = true;
+	readback->callback(readback);
+}
+
+bool wlr_texture_readback_copy(struct wlr_texture_readback *readback,
+		const struct wlr_texture_read_pixels_options *options) {
+	if (readback->cancelled || options->format != readback->format) {
+		return false;
+	}
+
+	struct wlr_box src = readback->src_box;
+	if (!wlr_box_empty(&options->src_box)) {
+		struct wlr_box intersection;
+		if (!wlr_box_intersection(&intersection, &options->src_box, &src) ||
+				!wlr_box_equal(&intersection, &options->src_box)) {
+			return false;
+		}
+		src = options->src_box;
+	}
+
+	const void *data;
+	uint32_t stride;
+	if (!readback->impl->begin_data_ptr_access(readback, &data, &stride)) {
+		return false;
+	}
+
+	const struct wlr_pixel_format_info *fmt =
+		drm_get_pixel_format_info(readback->format);
+	uint32_t x = src.x - readback->src_box.x;
+	uint32_t y = src.y - readback->src_box.y;
+	const unsigned char *s = (const unsigned char *)data +
+		pixel_format_info_min_stride(fmt, x) + y * stride;
+	unsigned char *d = wlr_texture_read_pixel_options_get_data(options);
+	uint32_t row_size = pixel_format_info_min_stride(fmt, src.width);
+	if (row_size == stride && stride == options->stride) {
+		memcpy(d, s, (size_t)stride * src.height);
+	} else {
+		for (int32_t i = 0; i < src.height; i++) {
+			memcpy(d + (size_t)i * options->stride,
+				s + (size_t)i * stride, row_size);
+		}
+	}
+
+	readback->impl->end_data_ptr_access(readback);
+	return true;
+}
+
+void wlr_texture_readback_destroy(struct wlr_texture_readback *readback) {
+	if (readback == NULL) {
+		return;
+	}
+
+	if (readback->event_source != NULL) {
+		wl_event_source_remove(readback->event_source);
+	}
+	if (readback->fence_fd >= 0) {
+		close(readback->fence_fd);
+	}
+	wl_list_remove(&readback->link);
+	readback->impl->destroy(readback);
+}
+
 struct wlr_texture *wlr_texture_from_pixels(struct wlr_renderer *renderer,
 		uint32_t fmt, uint32_t stride, uint32_t width, uint32_t height,
 		const void *data) {
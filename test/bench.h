@@ -0,0 +1,87 @@
+#ifndef TEST_BENCH_H
+#define TEST_BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Helpers shared by benchmarks.
+ *
+ * Results are printed in the Go Benchmark Data Format, one line per result:
+ * the benchmark name, the number of operations, then value/unit pairs. This
+ * allows comparing runs with tools such as benchstat.
+ */
+
+#define BENCH_TARGET_NS 100000000
+#define BENCH_MIN_ITER  10
+
+// Meson's exit code for skipped tests
+#define BENCH_EXIT_SKIP 77
+
+static inline int64_t bench_get_time_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/**
+ * A calibrated loop: the body runs until both target_ns have elapsed and
+ * min_iters iterations are done.
+ *
+ *     struct bench_loop loop;
+ *     bench_loop_start(&loop, BENCH_TARGET_NS, BENCH_MIN_ITER);
+ *     do {
+ *             ...
+ *     } while (bench_loop_next(&loop));
+ */
+struct bench_loop {
+	int64_t target_ns;
+	int min_iters;
+
+	int64_t start_ns;
+	int64_t elapsed_ns;
+	int iters;
+};
+
+static inline void bench_loop_start(struct bench_loop *loop,
+		int64_t target_ns, int min_iters) {
+	*loop = (struct bench_loop){
+		.target_ns = target_ns,
+		.min_iters = min_iters,
+		.start_ns = bench_get_time_ns(),
+	};
+}
+
+static inline bool bench_loop_next(struct bench_loop *loop) {
+	loop->iters++;
+	loop->elapsed_ns = bench_get_time_ns() - loop->start_ns;
+	return loop->elapsed_ns < loop->target_ns || loop->iters < loop->min_iters;
+}
+
+/**
+ * Start a result line. Extra metrics can be appended with
+ * bench_result_metric(), the line is terminated by bench_result_end().
+ */
+static inline void bench_result_begin(const char *name, long long n,
+		double ns_per_op) {
+	printf("%-56s %10lld %14.1f ns/op", name, n, ns_per_op);
+}
+
+static inline void bench_result_metric(double value, const char *unit) {
+	printf(" %12.1f %s", value, unit);
+}
+
+static inline void bench_result_end(void) {
+	printf("\n");
+	fflush(stdout);
+}
+
+static inline void bench_result(const char *name, long long n,
+		double ns_per_op) {
+	bench_result_begin(name, n, ns_per_op);
+	bench_result_end();
+}
+
+#endif
@@ -0,0 +1,93 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wlr/util/addon.h>
+#include <wlr/util/log.h>
+#include "bench.h"
+
+#define MAX_ADDONS 1024
+
+/**
+ * Measures wlr_addon_find() as a set grows, e.g. a buffer carrying textures
+ * and DRM FBs for many renderers and outputs. Owners are looked up in a
+ * scattered order, and every other lookup misses.
+ */
+
+static void bench_addon_destroy(struct wlr_addon *addon) {
+	wlr_addon_finish(addon);
+}
+
+static const struct wlr_addon_interface bench_addon_impl = {
+	.name = "bench_addon",
+	.destroy = bench_addon_destroy,
+};
+
+// Owners are only compared by address
+static char owners[2 * MAX_ADDONS];
+static struct wlr_addon addons[MAX_ADDONS];
+
+static size_t find_all(struct wlr_addon_set *set, size_t n_addons) {
+	size_t found = 0;
+	for (size_t i = 0; i < 2 * n_addons; i++) {
+		// Visit owners in a scattered order, odd ones aren't in the set
+		size_t owner = (i * 7919) % (2 * n_addons);
+		found += wlr_addon_find(set, &owners[owner], &bench_addon_impl) != NULL;
+	}
+	return found;
+}
+
+static void run_find(size_t n_addons) {
+	struct wlr_addon_set set;
+	wlr_addon_set_init(&set);
+	for (size_t i = 0; i < n_addons; i++) {
+		wlr_addon_init(&addons[i], &set, &owners[2 * i], &bench_addon_impl);
+	}
+
+	size_t lookups = 0;
+	struct bench_loop loop;
+	bench_loop_start(&loop, BENCH_TARGET_NS, BENCH_MIN_ITER);
+	do {
+		size_t found = find_all(&set, n_addons);
+		assert(found == n_addons);
+		lookups += 2 * n_addons;
+	} while (bench_loop_next(&loop));
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkAddonFind/addons%zu", n_addons);
+	bench_result(name, lookups, (double)loop.elapsed_ns / lookups);
+
+	wlr_addon_set_finish(&set);
+}
+
+static void run_churn(size_t n_addons) {
+	struct bench_loop loop;
+	bench_loop_start(&loop, BENCH_TARGET_NS, BENCH_MIN_ITER);
+	do {
+		struct wlr_addon_set set;
+		wlr_addon_set_init(&set);
+		for (size_t i = 0; i < n_addons; i++) {
+			wlr_addon_init(&addons[i], &set, &owners[2 * i], &bench_addon_impl);
+		}
+		wlr_addon_set_finish(&set);
+	} while (bench_loop_next(&loop));
+
+	size_t ops = loop.iters * n_addons;
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkAddonInitFinish/addons%zu", n_addons);
+	bench_result(name, ops, (double)loop.elapsed_ns / ops);
+}
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	static const size_t sizes[] = { 1, 4, 8, 16, 64, 256, 1024 };
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		run_find(sizes[i]);
+	}
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		run_churn(sizes[i]);
+	}
+	return 0;
+}
@@ -0,0 +1,89 @@
+#include <assert.h>
+#include <drm_fourcc.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/interfaces/wlr_buffer.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/drm_format_set.h>
+#include <wlr/util/log.h>
+#include "render/allocator/shm.h"
+#include "render/drm_format_set.h"
+#include "bench.h"
+
+#define N_BUFFERS  3
+#define TARGET_NS  200000000
+
+/**
+ * Recreates a swapchain-sized set of shm buffers over and over, as happens
+ * when an output is reconfigured or when short-lived buffers are allocated
+ * for each capture. Each buffer is written to once, so that page faults are
+ * accounted for.
+ */
+
+static void touch_buffer(struct wlr_buffer *buffer) {
+	void *data;
+	uint32_t format;
+	size_t stride;
+	bool ok = wlr_buffer_begin_data_ptr_access(buffer,
+		WLR_BUFFER_DATA_PTR_ACCESS_WRITE, &data, &format, &stride);
+	assert(ok);
+	memset(data, 0xFF, stride * buffer->height);
+	wlr_buffer_end_data_ptr_access(buffer);
+}
+
+static void run(bool pool, int width, int height) {
+	struct wlr_allocator *allocator = wlr_shm_allocator_create();
+	assert(allocator);
+	struct wlr_shm_allocator *shm = wl_container_of(allocator, shm, base);
+	shm->pool.enabled = pool;
+
+	struct wlr_drm_format format;
+	wlr_drm_format_init(&format, DRM_FORMAT_XRGB8888);
+	bool ok = wlr_drm_format_add(&format, DRM_FORMAT_MOD_LINEAR);
+	assert(ok);
+
+	struct bench_loop loop;
+	bench_loop_start(&loop, TARGET_NS, BENCH_MIN_ITER);
+	do {
+		struct wlr_buffer *buffers[N_BUFFERS];
+		for (size_t i = 0; i < N_BUFFERS; i++) {
+			buffers[i] = wlr_allocator_create_buffer(allocator, width, height,
+				&format);
+			assert(buffers[i]);
+			touch_buffer(buffers[i]);
+		}
+		for (size_t i = 0; i < N_BUFFERS; i++) {
+			wlr_buffer_drop(buffers[i]);
+		}
+	} while (bench_loop_next(&loop));
+
+	struct wlr_allocator_stats stats;
+	wlr_allocator_get_stats(allocator, &stats);
+	assert(stats.created == (uint64_t)loop.iters * N_BUFFERS);
+	assert(pool || stats.recycled == 0);
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkShmBuffers/%s/%dx%d",
+		pool ? "pool" : "nopool", width, height);
+	bench_result_begin(name, loop.iters, (double)loop.elapsed_ns / loop.iters);
+	bench_result_metric((double)stats.create_nsec / stats.created, "create-ns");
+	bench_result_metric(100.0 * stats.recycled / stats.created, "%recycled");
+	bench_result_end();
+
+	wlr_drm_format_finish(&format);
+	wlr_allocator_destroy(allocator);
+}
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	static const int sizes[][2] = { { 256, 256 }, { 1920, 1080 }, { 3840, 2160 } };
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		run(false, sizes[i][0], sizes[i][1]);
+		run(true, sizes[i][0], sizes[i][1]);
+	}
+	return 0;
+}
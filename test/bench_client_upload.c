@@ -0,0 +1,207 @@
+#include <assert.h>
+#include <drm_fourcc.h>
+#include <pixman.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/backend/headless.h>
+#include <wlr/interfaces/wlr_buffer.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/util/log.h>
+
+#include "types/wlr_buffer.h"
+#include "bench.h"
+
+#define BUFFER_WIDTH    1280
+#define BUFFER_HEIGHT   720
+#define DAMAGE_SIZE     256
+#define COMMIT_RATE_HZ  1000
+#define REFRESH_RATE_HZ 60
+#define DURATION        1 // seconds
+#define MAX_BUFFERS     8
+
+/**
+ * Simulates a client committing partially damaged shared memory buffers at
+ * 1000 Hz, presented on a 60 Hz output. Compares uploading on each commit
+ * with deferring the upload until the output samples the texture.
+ */
+
+struct bench_buffer {
+	struct wlr_buffer base;
+	void *data;
+};
+
+struct bench_client {
+	struct bench_buffer *buffers[MAX_BUFFERS];
+	size_t buffers_len;
+	struct wlr_client_buffer *client_buffer;
+	size_t uploads;
+};
+
+static void bench_buffer_destroy(struct wlr_buffer *wlr_buffer) {
+	struct bench_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
+	wlr_buffer_finish(wlr_buffer);
+	free(buffer->data);
+	free(buffer);
+}
+
+static bool bench_buffer_begin_data_ptr_access(struct wlr_buffer *wlr_buffer,
+		uint32_t flags, void **data, uint32_t *format, size_t *stride) {
+	struct bench_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
+	*data = buffer->data;
+	*format = DRM_FORMAT_ARGB8888;
+	*stride = BUFFER_WIDTH * 4;
+	return true;
+}
+
+static void bench_buffer_end_data_ptr_access(struct wlr_buffer *wlr_buffer) {
+	// This space is intentionally left blank
+}
+
+static const struct wlr_buffer_impl bench_buffer_impl = {
+	.destroy = bench_buffer_destroy,
+	.begin_data_ptr_access = bench_buffer_begin_data_ptr_access,
+	.end_data_ptr_access = bench_buffer_end_data_ptr_access,
+};
+
+// Like a wl_shm client: draw into any buffer which has been released
+static struct bench_buffer *client_get_buffer(struct bench_client *client) {
+	for (size_t i = 0; i < client->buffers_len; i++) {
+		if (client->buffers[i]->base.n_locks == 0) {
+			return client->buffers[i];
+		}
+	}
+
+	assert(client->buffers_len < MAX_BUFFERS);
+	struct bench_buffer *buffer = calloc(1, sizeof(*buffer));
+	assert(buffer);
+	buffer->data = calloc(BUFFER_HEIGHT, BUFFER_WIDTH * 4);
+	assert(buffer->data);
+	wlr_buffer_init(&buffer->base, &bench_buffer_impl,
+		BUFFER_WIDTH, BUFFER_HEIGHT);
+	client->buffers[client->buffers_len++] = buffer;
+	return buffer;
+}
+
+static void client_draw(struct bench_buffer *buffer, int x, int y,
+		uint32_t color) {
+	uint32_t *pixels = buffer->data;
+	for (int row = y; row < y + DAMAGE_SIZE; row++) {
+		for (int col = x; col < x + DAMAGE_SIZE; col++) {
+			pixels[row * BUFFER_WIDTH + col] = color;
+		}
+	}
+}
+
+// Mirrors surface_apply_damage() in wlr_compositor.c
+static void commit(struct bench_client *client, struct wlr_renderer *renderer,
+		struct wl_event_loop *loop, struct wlr_buffer *next,
+		const pixman_region32_t *damage, bool defer) {
+	wlr_buffer_lock(next);
+
+	bool applied = false;
+	if (client->client_buffer != NULL) {
+		if (defer) {
+			applied = client_buffer_defer_damage(client->client_buffer,
+				next, damage);
+		} else {
+			applied = wlr_client_buffer_apply_damage(client->client_buffer,
+				next, damage);
+			client->uploads += applied;
+		}
+	}
+
+	if (!applied) {
+		struct wlr_client_buffer *client_buffer;
+		if (defer) {
+			client_buffer = client_buffer_create_deferred(next, renderer, loop);
+		} else {
+			client_buffer = wlr_client_buffer_create(next, renderer);
+			client->uploads++;
+		}
+		assert(client_buffer);
+		if (client->client_buffer != NULL) {
+			wlr_buffer_unlock(&client->client_buffer->base);
+		}
+		client->client_buffer = client_buffer;
+	}
+
+	wlr_buffer_unlock(next);
+}
+
+static void run(struct wlr_renderer *renderer, struct wl_event_loop *loop,
+		bool defer, bool visible) {
+	struct bench_client client = {0};
+
+	int64_t commit_interval_ns = 1000000000L / COMMIT_RATE_HZ;
+	int64_t refresh_interval_ns = 1000000000L / REFRESH_RATE_HZ;
+	int n_commits = COMMIT_RATE_HZ * DURATION;
+	int64_t next_refresh_ns = refresh_interval_ns;
+
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+
+	int64_t start_ns = bench_get_time_ns();
+	for (int i = 0; i < n_commits; i++) {
+		int x = (i * 37) % (BUFFER_WIDTH - DAMAGE_SIZE);
+		int y = (i * 23) % (BUFFER_HEIGHT - DAMAGE_SIZE);
+
+		struct bench_buffer *buffer = client_get_buffer(&client);
+		client_draw(buffer, x, y, 0xFF000000 | (uint32_t)i);
+		pixman_region32_fini(&damage);
+		pixman_region32_init_rect(&damage, x, y, DAMAGE_SIZE, DAMAGE_SIZE);
+		commit(&client, renderer, loop, &buffer->base, &damage, defer);
+
+		int64_t now_ns = (int64_t)i * commit_interval_ns;
+		if (now_ns >= next_refresh_ns) {
+			next_refresh_ns += refresh_interval_ns;
+			if (visible) {
+				bool pending = client.client_buffer->upload_buffer != NULL;
+				struct wlr_texture *texture =
+					wlr_client_buffer_get_texture(client.client_buffer);
+				assert(texture);
+				client.uploads += pending;
+			}
+		}
+	}
+	int64_t elapsed_ns = bench_get_time_ns() - start_ns;
+
+	pixman_region32_fini(&damage);
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkUpload/%s/%s",
+		defer ? "deferred" : "commit", visible ? "visible" : "hidden");
+	bench_result_begin(name, n_commits, (double)elapsed_ns / n_commits);
+	bench_result_metric(client.uploads, "uploads");
+	bench_result_metric(client.buffers_len, "buffers");
+	bench_result_end();
+
+	wlr_buffer_unlock(&client.client_buffer->base);
+	for (size_t i = 0; i < client.buffers_len; i++) {
+		wlr_buffer_drop(&client.buffers[i]->base);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	struct wl_event_loop *loop = wl_event_loop_create();
+	assert(loop);
+
+	wlr_log_init(WLR_ERROR, NULL);
+
+	struct wlr_backend *backend = wlr_headless_backend_create(loop);
+	assert(backend);
+	struct wlr_renderer *renderer = wlr_renderer_autocreate(backend);
+	assert(renderer);
+
+	run(renderer, loop, false, true);
+	run(renderer, loop, true, true);
+	run(renderer, loop, false, false);
+	run(renderer, loop, true, false);
+
+	wlr_renderer_destroy(renderer);
+	wlr_backend_destroy(backend);
+	wl_event_loop_destroy(loop);
+	return 0;
+}
@@ -0,0 +1,248 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/drm_format_set.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_linux_dmabuf_v1.h>
+#include <wlr/util/log.h>
+#include "bench.h"
+
+#define MAX_SURFACES 1024
+#define N_ROUNDS     100
+#define GROUP_SIZE   8
+
+// Object IDs allocated by the fake client
+#define DISPLAY_ID       1
+#define REGISTRY_ID      2
+#define COMPOSITOR_ID    3
+#define FIRST_SURFACE_ID 4
+
+// Request opcodes, see wayland.xml
+#define DISPLAY_GET_REGISTRY      1
+#define REGISTRY_BIND             0
+#define COMPOSITOR_CREATE_SURFACE 0
+
+// zwp_linux_dmabuf_feedback_v1.tranche_flags.scanout
+#define TRANCHE_FLAGS_SCANOUT 1
+
+/**
+ * Moves hundreds of surfaces between composition and scanout feedback, like
+ * the scene-graph does when windows move between outputs or in and out of
+ * direct scanout. The number of distinct feedbacks is small, so surfaces can
+ * share compiled format tables.
+ */
+
+enum bench_feedback {
+	FEEDBACK_COMPOSITION,
+	FEEDBACK_SCANOUT_A,
+	FEEDBACK_SCANOUT_B,
+	FEEDBACK_COUNT,
+};
+
+struct bench_server {
+	struct wl_display *display;
+	struct wl_event_loop *loop;
+	struct wlr_backend *backend;
+	struct wlr_renderer *renderer;
+	struct wlr_compositor *compositor;
+	struct wlr_linux_dmabuf_v1 *linux_dmabuf;
+	struct wl_listener new_surface;
+
+	struct wlr_surface *surfaces[MAX_SURFACES];
+	size_t surfaces_len;
+
+	struct wlr_linux_dmabuf_feedback_v1 feedbacks[FEEDBACK_COUNT];
+};
+
+static void handle_new_surface(struct wl_listener *listener, void *data) {
+	struct bench_server *server = wl_container_of(listener, server, new_surface);
+	assert(server->surfaces_len < MAX_SURFACES);
+	server->surfaces[server->surfaces_len++] = data;
+}
+
+static void write_request(int fd, uint32_t id, uint16_t opcode,
+		const uint32_t *args, size_t args_len) {
+	uint32_t msg[16];
+	assert(args_len + 2 <= sizeof(msg) / sizeof(msg[0]));
+	size_t size = (args_len + 2) * sizeof(uint32_t);
+	msg[0] = id;
+	msg[1] = (uint32_t)size << 16 | opcode;
+	memcpy(&msg[2], args, args_len * sizeof(uint32_t));
+	ssize_t n = write(fd, msg, size);
+	assert(n == (ssize_t)size);
+}
+
+static void dispatch(struct bench_server *server, int client_fd) {
+	wl_event_loop_dispatch(server->loop, 0);
+	wl_display_flush_clients(server->display);
+
+	char buf[4096];
+	while (read(client_fd, buf, sizeof(buf)) > 0) {
+		// Discard events
+	}
+}
+
+static void client_init(struct bench_server *server, int fd,
+		struct wl_client *client) {
+	write_request(fd, DISPLAY_ID, DISPLAY_GET_REGISTRY,
+		(uint32_t[]){ REGISTRY_ID }, 1);
+
+	// new_id without interface: name, interface string, version, id
+	uint32_t bind[] = {
+		wl_global_get_name(server->compositor->global, client),
+		sizeof("wl_compositor"),
+		0, 0, 0, 0, // "wl_compositor\0", padded to 16 bytes
+		6,
+		COMPOSITOR_ID,
+	};
+	memcpy(&bind[2], "wl_compositor", sizeof("wl_compositor"));
+	write_request(fd, REGISTRY_ID, REGISTRY_BIND,
+		bind, sizeof(bind) / sizeof(bind[0]));
+	dispatch(server, fd);
+
+	for (uint32_t i = 0; i < MAX_SURFACES; i++) {
+		write_request(fd, COMPOSITOR_ID, COMPOSITOR_CREATE_SURFACE,
+			(uint32_t[]){ FIRST_SURFACE_ID + i }, 1);
+		if (i % 64 == 63) {
+			dispatch(server, fd);
+		}
+	}
+	dispatch(server, fd);
+	assert(server->surfaces_len == MAX_SURFACES);
+}
+
+// A scanout tranche with every other format, followed by the fallback tranche
+static void init_scanout_feedback(struct wlr_linux_dmabuf_feedback_v1 *feedback,
+		dev_t main_device, const struct wlr_drm_format_set *formats,
+		size_t parity) {
+	*feedback = (struct wlr_linux_dmabuf_feedback_v1){
+		.main_device = main_device,
+	};
+
+	struct wlr_linux_dmabuf_feedback_v1_tranche *scanout =
+		wlr_linux_dmabuf_feedback_add_tranche(feedback);
+	assert(scanout);
+	scanout->target_device = main_device;
+	scanout->flags = TRANCHE_FLAGS_SCANOUT;
+	for (size_t i = parity; i < formats->len; i += 2) {
+		const struct wlr_drm_format *fmt = &formats->formats[i];
+		for (size_t j = 0; j < fmt->len; j++) {
+			bool ok = wlr_drm_format_set_add(&scanout->formats,
+				fmt->format, fmt->modifiers[j]);
+			assert(ok);
+		}
+	}
+
+	struct wlr_linux_dmabuf_feedback_v1_tranche *fallback =
+		wlr_linux_dmabuf_feedback_add_tranche(feedback);
+	assert(fallback);
+	fallback->target_device = main_device;
+	struct wlr_drm_format_set empty = {0};
+	bool ok = wlr_drm_format_set_union(&fallback->formats, &empty, formats);
+	assert(ok);
+}
+
+static void run(struct bench_server *server, size_t n_surfaces) {
+	int64_t start_ns = bench_get_time_ns();
+	for (size_t round = 0; round < N_ROUNDS; round++) {
+		for (size_t i = 0; i < n_surfaces; i++) {
+			// Windows move in groups, e.g. when switching workspaces
+			enum bench_feedback kind = (i / GROUP_SIZE + round) % FEEDBACK_COUNT;
+			bool ok = wlr_linux_dmabuf_v1_set_surface_feedback(server->linux_dmabuf,
+				server->surfaces[i], &server->feedbacks[kind]);
+			assert(ok);
+		}
+	}
+	int64_t elapsed_ns = bench_get_time_ns() - start_ns;
+	size_t n_ops = N_ROUNDS * n_surfaces;
+	int tables = wl_list_length(&server->linux_dmabuf->compiled_feedbacks);
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkFeedbackChurn/surfaces%zu", n_surfaces);
+	bench_result_begin(name, n_ops, (double)elapsed_ns / n_ops);
+	bench_result_metric(tables, "tables");
+	bench_result_end();
+
+	for (size_t i = 0; i < n_surfaces; i++) {
+		wlr_linux_dmabuf_v1_set_surface_feedback(server->linux_dmabuf,
+			server->surfaces[i], NULL);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	struct bench_server server = {0};
+	server.display = wl_display_create();
+	assert(server.display);
+	server.loop = wl_display_get_event_loop(server.display);
+
+	server.backend = wlr_headless_backend_create(server.loop);
+	assert(server.backend);
+	server.renderer = wlr_renderer_autocreate(server.backend);
+	assert(server.renderer);
+	if (wlr_renderer_get_drm_fd(server.renderer) < 0) {
+		fprintf(stderr, "Renderer has no DRM device, skipping\n");
+		wlr_renderer_destroy(server.renderer);
+		wlr_backend_destroy(server.backend);
+		wl_display_destroy(server.display);
+		return BENCH_EXIT_SKIP;
+	}
+
+	server.compositor = wlr_compositor_create(server.display, 6, NULL);
+	assert(server.compositor);
+	server.linux_dmabuf = wlr_linux_dmabuf_v1_create_with_renderer(server.display,
+		4, server.renderer);
+	assert(server.linux_dmabuf);
+	server.new_surface.notify = handle_new_surface;
+	wl_signal_add(&server.compositor->events.new_surface, &server.new_surface);
+
+	struct wlr_linux_dmabuf_feedback_v1 *composition =
+		&server.feedbacks[FEEDBACK_COMPOSITION];
+	bool ok = wlr_linux_dmabuf_feedback_v1_init_with_options(composition,
+		&(struct wlr_linux_dmabuf_feedback_v1_init_options){
+			.main_renderer = server.renderer,
+		});
+	assert(ok);
+	const struct wlr_drm_format_set *formats =
+		wlr_renderer_get_texture_formats(server.renderer, WLR_BUFFER_CAP_DMABUF);
+	assert(formats);
+	init_scanout_feedback(&server.feedbacks[FEEDBACK_SCANOUT_A],
+		composition->main_device, formats, 0);
+	init_scanout_feedback(&server.feedbacks[FEEDBACK_SCANOUT_B],
+		composition->main_device, formats, 1);
+
+	int fds[2];
+	int ret = socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds);
+	assert(ret == 0);
+	fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+
+	struct wl_client *client = wl_client_create(server.display, fds[0]);
+	assert(client);
+	client_init(&server, fds[1], client);
+
+	static const size_t sizes[] = { 16, 256, 1024 };
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		run(&server, sizes[i]);
+	}
+
+	for (size_t i = 0; i < FEEDBACK_COUNT; i++) {
+		wlr_linux_dmabuf_feedback_v1_finish(&server.feedbacks[i]);
+	}
+	wl_list_remove(&server.new_surface.link);
+	wl_client_destroy(client);
+	close(fds[1]);
+	wlr_renderer_destroy(server.renderer);
+	wlr_backend_destroy(server.backend);
+	wl_display_destroy(server.display);
+	return 0;
+}
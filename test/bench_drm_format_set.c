@@ -0,0 +1,143 @@
+#include <assert.h>
+#include <drm_fourcc.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wlr/render/drm_format_set.h>
+#include <wlr/util/log.h>
+#include "bench.h"
+
+#define N_MODIFIERS 16
+
+/**
+ * Exercises format sets shaped like the ones reported by renderers and DRM
+ * planes: a number of formats, each with a list of explicit modifiers plus
+ * LINEAR and INVALID. The second set overlaps half of the first one's
+ * formats and modifiers, like a display and a render format set do.
+ */
+
+enum bench_op {
+	OP_ADD,
+	OP_HAS,
+	OP_INTERSECT,
+	OP_UNION,
+};
+
+static const char *op_names[] = {
+	[OP_ADD] = "Add",
+	[OP_HAS] = "Has",
+	[OP_INTERSECT] = "Intersect",
+	[OP_UNION] = "Union",
+};
+
+static uint32_t format_code(size_t i) {
+	// Multiplying by an odd constant is a bijection, so codes are distinct,
+	// non-zero and not inserted in order
+	return (uint32_t)((i + 1) * 2654435761u);
+}
+
+static uint64_t modifier_code(size_t i) {
+	switch (i) {
+	case 0:
+		return DRM_FORMAT_MOD_INVALID;
+	case 1:
+		return DRM_FORMAT_MOD_LINEAR;
+	default:
+		return fourcc_mod_code(AMD, (i * 0x9E3779B97F4A7C15) >> 8);
+	}
+}
+
+static void build_set(struct wlr_drm_format_set *set, size_t n_formats,
+		size_t format_offset, size_t modifier_offset) {
+	for (size_t i = format_offset; i < format_offset + n_formats; i++) {
+		for (size_t j = modifier_offset; j < modifier_offset + N_MODIFIERS; j++) {
+			bool ok = wlr_drm_format_set_add(set, format_code(i),
+				modifier_code(j));
+			assert(ok);
+		}
+	}
+}
+
+static size_t run_op(enum bench_op op, size_t n_formats,
+		const struct wlr_drm_format_set *a, const struct wlr_drm_format_set *b) {
+	size_t result = 0;
+	struct wlr_drm_format_set out = {0};
+	switch (op) {
+	case OP_ADD:
+		build_set(&out, n_formats, 0, 0);
+		result = out.len;
+		break;
+	case OP_HAS:
+		// Half of the lookups miss
+		for (size_t i = 0; i < n_formats * 2; i++) {
+			result += wlr_drm_format_set_has(a, format_code(i),
+				modifier_code(i % (N_MODIFIERS * 2)));
+		}
+		break;
+	case OP_INTERSECT:
+		wlr_drm_format_set_intersect(&out, a, b);
+		result = out.len;
+		break;
+	case OP_UNION:
+		wlr_drm_format_set_union(&out, a, b);
+		result = out.len;
+		break;
+	}
+	wlr_drm_format_set_finish(&out);
+	return result;
+}
+
+static void run(enum bench_op op, size_t n_formats) {
+	struct wlr_drm_format_set a = {0}, b = {0};
+	build_set(&a, n_formats, 0, 0);
+	build_set(&b, n_formats, n_formats / 2, N_MODIFIERS / 2);
+
+	// Sanity check the results before timing
+	size_t expected = 0;
+	switch (op) {
+	case OP_ADD:
+		expected = n_formats;
+		break;
+	case OP_HAS:
+		for (size_t i = 0; i < n_formats; i++) {
+			expected += i % (N_MODIFIERS * 2) < N_MODIFIERS;
+		}
+		break;
+	case OP_INTERSECT:
+		expected = n_formats - n_formats / 2;
+		break;
+	case OP_UNION:
+		expected = n_formats + n_formats / 2;
+		break;
+	}
+	size_t result = run_op(op, n_formats, &a, &b);
+	assert(result == expected);
+
+	struct bench_loop loop;
+	bench_loop_start(&loop, BENCH_TARGET_NS, BENCH_MIN_ITER);
+	do {
+		result = run_op(op, n_formats, &a, &b);
+	} while (bench_loop_next(&loop));
+	assert(result == expected);
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkFormatSet/%s/formats%zu",
+		op_names[op], n_formats);
+	bench_result(name, loop.iters, (double)loop.elapsed_ns / loop.iters);
+
+	wlr_drm_format_set_finish(&a);
+	wlr_drm_format_set_finish(&b);
+}
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	static const size_t sizes[] = { 8, 32, 128, 512 };
+	for (int op = OP_ADD; op <= OP_UNION; op++) {
+		for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+			run(op, sizes[i]);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,126 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "backend/drm/util.h"
+#include "bench.h"
+
+#define MAX_CRTCS 32
+
+struct bench_case {
+	const char *name;
+	size_t num_conns;
+	size_t num_crtcs;
+	// Number of connectors which already have a CRTC
+	size_t num_lit;
+	// Whether each connector can only be driven by a subset of CRTCs
+	bool restricted;
+	// Whether only lit connectors and one extra connector want a CRTC
+	bool sparse;
+};
+
+static void setup_case(const struct bench_case *bc, uint32_t conns[],
+		uint32_t prev_crtcs[]) {
+	uint32_t all_crtcs = bc->num_crtcs == 32 ?
+		UINT32_MAX : (1u << bc->num_crtcs) - 1;
+	for (size_t i = 0; i < bc->num_conns; i++) {
+		if (bc->restricted) {
+			// Two neighbouring CRTCs, like e.g. MST hubs behind one DP port
+			size_t crtc = i % bc->num_crtcs;
+			conns[i] = (1u << crtc) | (1u << ((crtc + 1) % bc->num_crtcs));
+		} else {
+			conns[i] = all_crtcs;
+		}
+		if (bc->sparse && i + bc->num_lit + 1 < bc->num_conns) {
+			conns[i] = 0;
+		}
+	}
+
+	for (size_t i = 0; i < bc->num_crtcs; i++) {
+		prev_crtcs[i] = UNMATCHED;
+	}
+	// Light up connectors in reverse order, so that the lowest CRTCs aren't
+	// trivially the best choice
+	for (size_t i = 0; i < bc->num_lit && i < bc->num_crtcs; i++) {
+		size_t conn = bc->num_conns - 1 - i;
+		if (conns[conn] & (1u << i)) {
+			prev_crtcs[i] = conn;
+		}
+	}
+}
+
+static void check_result(const struct bench_case *bc, const uint32_t conns[],
+		const uint32_t prev_crtcs[], const uint32_t new_crtcs[]) {
+	size_t matched = 0;
+	for (size_t i = 0; i < bc->num_crtcs; i++) {
+		if (prev_crtcs[i] != UNMATCHED) {
+			// Lit connectors must not be moved
+			assert(new_crtcs[i] == prev_crtcs[i]);
+		}
+		if (new_crtcs[i] == UNMATCHED) {
+			continue;
+		}
+		assert(conns[new_crtcs[i]] & (1u << i));
+		for (size_t j = 0; j < i; j++) {
+			assert(new_crtcs[j] != new_crtcs[i]);
+		}
+		matched++;
+	}
+	if (!bc->restricted) {
+		size_t num_wanted = bc->sparse ? bc->num_lit + 1 : bc->num_conns;
+		size_t expected = num_wanted < bc->num_crtcs ?
+			num_wanted : bc->num_crtcs;
+		assert(matched == expected);
+	}
+}
+
+static void run_benchmark(const struct bench_case *bc) {
+	assert(bc->num_crtcs <= MAX_CRTCS);
+
+	uint32_t conns[bc->num_conns];
+	uint32_t prev_crtcs[MAX_CRTCS];
+	uint32_t new_crtcs[MAX_CRTCS];
+	setup_case(bc, conns, prev_crtcs);
+
+	match_connectors_with_crtcs(bc->num_conns, conns,
+		bc->num_crtcs, prev_crtcs, new_crtcs);
+	check_result(bc, conns, prev_crtcs, new_crtcs);
+
+	struct bench_loop loop;
+	bench_loop_start(&loop, BENCH_TARGET_NS, BENCH_MIN_ITER);
+	do {
+		match_connectors_with_crtcs(bc->num_conns, conns,
+			bc->num_crtcs, prev_crtcs, new_crtcs);
+	} while (bench_loop_next(&loop));
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkMatch/%s/%zux%zu/lit%zu",
+		bc->name, bc->num_conns, bc->num_crtcs, bc->num_lit);
+	bench_result(name, loop.iters, (double)loop.elapsed_ns / loop.iters);
+}
+
+int main(void) {
+	static const struct bench_case cases[] = {
+		{ "any", 4, 4, 0, false, false },
+		{ "any", 4, 4, 3, false, false },
+		{ "any", 8, 6, 4, false, false },
+		{ "any", 16, 8, 6, false, false },
+		{ "any", 32, 16, 8, false, false },
+		{ "any", 64, 32, 16, false, false },
+		{ "restricted", 8, 6, 4, true, false },
+		{ "restricted", 16, 8, 6, true, false },
+		{ "restricted", 32, 16, 8, true, false },
+		{ "restricted", 64, 32, 16, true, false },
+		{ "sparse", 8, 6, 2, false, true },
+		{ "sparse", 16, 8, 4, false, true },
+		{ "sparse", 32, 16, 6, false, true },
+		{ "sparse", 64, 32, 8, false, true },
+	};
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		run_benchmark(&cases[i]);
+	}
+	return 0;
+}
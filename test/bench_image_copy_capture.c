@@ -0,0 +1,424 @@
+#undef _POSIX_C_SOURCE
+#define _GNU_SOURCE // for memfd_create()
+#include <assert.h>
+#include <drm_fourcc.h>
+#include <pixman.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/pass.h>
+#include <wlr/render/pixman.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_ext_image_capture_source_v1.h>
+#include <wlr/types/wlr_ext_image_copy_capture_v1.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_shm.h>
+#include <wlr/util/log.h>
+#include "ext-image-capture-source-v1-client-protocol.h"
+#include "ext-image-copy-capture-v1-client-protocol.h"
+#include "bench.h"
+
+#define OUTPUT_WIDTH  3840
+#define OUTPUT_HEIGHT 2160
+#define CURSOR_SIZE   64
+#define N_FRAMES      100
+
+/**
+ * A client captures a 4K output with ext-image-copy-capture into a reused shm
+ * buffer, while the compositor renders a moving cursor-sized region on each
+ * frame. The compositor limits the buffer size, as it would for a 1080p
+ * stream or a window switcher thumbnail, and may offer a 16-bit format: the
+ * frames are then scaled and converted by the renderer instead of the client.
+ * The client runs on its own thread, the time spent in output commits is
+ * measured on the compositor side.
+ */
+
+struct bench_config {
+	const char *name;
+	int max_width, max_height; // 0 for no limit
+	uint32_t shm_format; // requested by the client
+};
+
+struct bench_client {
+	int fd;
+	const struct bench_config *config;
+	atomic_bool done;
+
+	struct wl_display *display;
+	struct wl_shm *shm;
+	struct wl_output *output;
+	struct ext_output_image_capture_source_manager_v1 *source_manager;
+	struct ext_image_copy_capture_manager_v1 *copy_manager;
+
+	uint32_t width, height;
+	bool has_format;
+
+	struct wl_buffer *buffer;
+	void *data;
+	size_t size;
+	bool frame_done;
+};
+
+static void registry_handle_global(void *data, struct wl_registry *registry,
+		uint32_t name, const char *interface, uint32_t version) {
+	struct bench_client *client = data;
+	if (strcmp(interface, wl_shm_interface.name) == 0) {
+		client->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (strcmp(interface, wl_output_interface.name) == 0) {
+		client->output = wl_registry_bind(registry, name, &wl_output_interface, 1);
+	} else if (strcmp(interface,
+			ext_output_image_capture_source_manager_v1_interface.name) == 0) {
+		client->source_manager = wl_registry_bind(registry, name,
+			&ext_output_image_capture_source_manager_v1_interface, 1);
+	} else if (strcmp(interface,
+			ext_image_copy_capture_manager_v1_interface.name) == 0) {
+		client->copy_manager = wl_registry_bind(registry, name,
+			&ext_image_copy_capture_manager_v1_interface, 1);
+	}
+}
+
+static void registry_handle_global_remove(void *data,
+		struct wl_registry *registry, uint32_t name) {
+	// This space is intentionally left blank
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_handle_global,
+	.global_remove = registry_handle_global_remove,
+};
+
+static void session_handle_buffer_size(void *data,
+		struct ext_image_copy_capture_session_v1 *session,
+		uint32_t width, uint32_t height) {
+	struct bench_client *client = data;
+	client->width = width;
+	client->height = height;
+	client->has_format = false;
+}
+
+static void session_handle_shm_format(void *data,
+		struct ext_image_copy_capture_session_v1 *session, uint32_t format) {
+	struct bench_client *client = data;
+	if (format == client->config->shm_format) {
+		client->has_format = true;
+	}
+}
+
+static void session_handle_dmabuf_device(void *data,
+		struct ext_image_copy_capture_session_v1 *session,
+		struct wl_array *device) {
+	// This space is intentionally left blank
+}
+
+static void session_handle_dmabuf_format(void *data,
+		struct ext_image_copy_capture_session_v1 *session, uint32_t format,
+		struct wl_array *modifiers) {
+	// This space is intentionally left blank
+}
+
+static void session_handle_done(void *data,
+		struct ext_image_copy_capture_session_v1 *session) {
+	// This space is intentionally left blank
+}
+
+static void session_handle_stopped(void *data,
+		struct ext_image_copy_capture_session_v1 *session) {
+	fprintf(stderr, "Capture session stopped\n");
+	abort();
+}
+
+static const struct ext_image_copy_capture_session_v1_listener session_listener = {
+	.buffer_size = session_handle_buffer_size,
+	.shm_format = session_handle_shm_format,
+	.dmabuf_device = session_handle_dmabuf_device,
+	.dmabuf_format = session_handle_dmabuf_format,
+	.done = session_handle_done,
+	.stopped = session_handle_stopped,
+};
+
+static void frame_handle_transform(void *data,
+		struct ext_image_copy_capture_frame_v1 *frame, uint32_t transform) {
+	// This space is intentionally left blank
+}
+
+static void frame_handle_damage(void *data,
+		struct ext_image_copy_capture_frame_v1 *frame, int32_t x, int32_t y,
+		int32_t width, int32_t height) {
+	// This space is intentionally left blank
+}
+
+static void frame_handle_presentation_time(void *data,
+		struct ext_image_copy_capture_frame_v1 *frame, uint32_t tv_sec_hi,
+		uint32_t tv_sec_lo, uint32_t tv_nsec) {
+	// This space is intentionally left blank
+}
+
+static void frame_handle_ready(void *data,
+		struct ext_image_copy_capture_frame_v1 *frame) {
+	struct bench_client *client = data;
+	client->frame_done = true;
+}
+
+static void frame_handle_failed(void *data,
+		struct ext_image_copy_capture_frame_v1 *frame, uint32_t reason) {
+	fprintf(stderr, "Failed to capture frame: %u\n", reason);
+	abort();
+}
+
+static const struct ext_image_copy_capture_frame_v1_listener frame_listener = {
+	.transform = frame_handle_transform,
+	.damage = frame_handle_damage,
+	.presentation_time = frame_handle_presentation_time,
+	.ready = frame_handle_ready,
+	.failed = frame_handle_failed,
+};
+
+static void client_create_buffer(struct bench_client *client) {
+	const struct bench_config *config = client->config;
+	uint32_t bpp = config->shm_format == WL_SHM_FORMAT_RGB565 ? 2 : 4;
+	uint32_t stride = client->width * bpp;
+
+	client->size = (size_t)stride * client->height;
+	int fd = memfd_create("bench-image-copy-capture", MFD_CLOEXEC);
+	assert(fd >= 0);
+	int ret = ftruncate(fd, client->size);
+	assert(ret == 0);
+	client->data = mmap(NULL, client->size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	assert(client->data != MAP_FAILED);
+
+	struct wl_shm_pool *pool = wl_shm_create_pool(client->shm, fd,
+		client->size);
+	client->buffer = wl_shm_pool_create_buffer(pool, 0, client->width,
+		client->height, stride, config->shm_format);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+}
+
+static void *client_run(void *data) {
+	struct bench_client *client = data;
+
+	client->display = wl_display_connect_to_fd(client->fd);
+	assert(client->display);
+
+	struct wl_registry *registry = wl_display_get_registry(client->display);
+	wl_registry_add_listener(registry, &registry_listener, client);
+	wl_display_roundtrip(client->display);
+	assert(client->shm && client->output && client->source_manager &&
+		client->copy_manager);
+
+	struct ext_image_capture_source_v1 *source =
+		ext_output_image_capture_source_manager_v1_create_source(
+			client->source_manager, client->output);
+	struct ext_image_copy_capture_session_v1 *session =
+		ext_image_copy_capture_manager_v1_create_session(client->copy_manager,
+			source, 0);
+	ext_image_copy_capture_session_v1_add_listener(session,
+		&session_listener, client);
+	// The compositor adjusts the constraints once the session is created
+	wl_display_roundtrip(client->display);
+	assert(client->has_format);
+
+	client_create_buffer(client);
+
+	for (int i = 0; i < N_FRAMES; i++) {
+		struct ext_image_copy_capture_frame_v1 *frame =
+			ext_image_copy_capture_session_v1_create_frame(session);
+		ext_image_copy_capture_frame_v1_add_listener(frame, &frame_listener,
+			client);
+		ext_image_copy_capture_frame_v1_attach_buffer(frame, client->buffer);
+		// The buffer holds the previous frame from then on
+		if (i == 0) {
+			ext_image_copy_capture_frame_v1_damage_buffer(frame, 0, 0,
+				client->width, client->height);
+		}
+		ext_image_copy_capture_frame_v1_capture(frame);
+
+		client->frame_done = false;
+		while (!client->frame_done) {
+			int ret = wl_display_dispatch(client->display);
+			assert(ret >= 0);
+		}
+		ext_image_copy_capture_frame_v1_destroy(frame);
+	}
+
+	wl_buffer_destroy(client->buffer);
+	munmap(client->data, client->size);
+	ext_image_copy_capture_session_v1_destroy(session);
+	ext_image_capture_source_v1_destroy(source);
+	ext_image_copy_capture_manager_v1_destroy(client->copy_manager);
+	ext_output_image_capture_source_manager_v1_destroy(client->source_manager);
+	wl_output_destroy(client->output);
+	wl_shm_destroy(client->shm);
+	wl_registry_destroy(registry);
+	wl_display_disconnect(client->display);
+
+	atomic_store(&client->done, true);
+	return NULL;
+}
+
+static void render_frame(struct wlr_output *output, int i) {
+	// Move the cursor along a diagonal, damaging its old and new position
+	int prev = i > 0 ? i - 1 : 0;
+	int x = (i * 16) % (OUTPUT_WIDTH - CURSOR_SIZE);
+	int y = (i * 9) % (OUTPUT_HEIGHT - CURSOR_SIZE);
+	int prev_x = (prev * 16) % (OUTPUT_WIDTH - CURSOR_SIZE);
+	int prev_y = (prev * 9) % (OUTPUT_HEIGHT - CURSOR_SIZE);
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+
+	pixman_region32_t damage;
+	pixman_region32_init_rect(&damage, x, y, CURSOR_SIZE, CURSOR_SIZE);
+	pixman_region32_union_rect(&damage, &damage, prev_x, prev_y,
+		CURSOR_SIZE, CURSOR_SIZE);
+	wlr_output_state_set_damage(&state, &damage);
+	pixman_region32_fini(&damage);
+
+	struct wlr_render_pass *pass =
+		wlr_output_begin_render_pass(output, &state, NULL);
+	assert(pass);
+	wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
+		.box = { .x = x, .y = y, .width = CURSOR_SIZE, .height = CURSOR_SIZE },
+		.color = { .r = 1, .g = 1, .b = 1, .a = 1 },
+	});
+	bool ok = wlr_render_pass_submit(pass);
+	assert(ok);
+
+	ok = wlr_output_commit_state(output, &state);
+	assert(ok);
+	wlr_output_state_finish(&state);
+}
+
+static const struct bench_config *current_config;
+
+static void handle_new_session(struct wl_listener *listener, void *data) {
+	struct wlr_ext_image_copy_capture_session_v1 *session = data;
+	const struct bench_config *config = current_config;
+
+	wlr_ext_image_copy_capture_session_v1_set_max_buffer_size(session,
+		config->max_width, config->max_height);
+	if (config->shm_format == WL_SHM_FORMAT_RGB565) {
+		uint32_t format = DRM_FORMAT_RGB565;
+		bool ok = wlr_ext_image_copy_capture_session_v1_set_shm_formats(session,
+			&format, 1);
+		assert(ok);
+	}
+}
+
+static void run(const struct bench_config *config) {
+	current_config = config;
+
+	struct wl_display *display = wl_display_create();
+	assert(display);
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+
+	struct wlr_backend *backend = wlr_headless_backend_create(loop);
+	assert(backend);
+	struct wlr_renderer *renderer = wlr_pixman_renderer_create();
+	assert(renderer);
+	struct wlr_allocator *allocator =
+		wlr_allocator_autocreate(backend, renderer);
+	assert(allocator);
+
+	wlr_shm_create_with_renderer(display, 1, renderer);
+	struct wlr_ext_image_copy_capture_manager_v1 *copy_manager =
+		wlr_ext_image_copy_capture_manager_v1_create(display, 1);
+	assert(copy_manager);
+	struct wlr_ext_output_image_capture_source_manager_v1 *source_manager =
+		wlr_ext_output_image_capture_source_manager_v1_create(display, 1);
+	assert(source_manager);
+
+	struct wl_listener new_session = { .notify = handle_new_session };
+	wl_signal_add(&copy_manager->events.new_session, &new_session);
+
+	struct wlr_output *output =
+		wlr_headless_add_output(backend, OUTPUT_WIDTH, OUTPUT_HEIGHT);
+	assert(output);
+	bool ok = wlr_backend_start(backend);
+	assert(ok);
+	ok = wlr_output_init_render(output, allocator, renderer);
+	assert(ok);
+	wlr_output_create_global(output, display);
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_enabled(&state, true);
+	ok = wlr_output_commit_state(output, &state);
+	assert(ok);
+	wlr_output_state_finish(&state);
+
+	int fds[2];
+	int ret = socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds);
+	assert(ret == 0);
+	struct wl_client *wl_client = wl_client_create(display, fds[0]);
+	assert(wl_client);
+
+	struct bench_client client = {
+		.fd = fds[1],
+		.config = config,
+	};
+	pthread_t thread;
+	ret = pthread_create(&thread, NULL, client_run, &client);
+	assert(ret == 0);
+
+	int commits = 0;
+	int64_t commit_ns = 0;
+	for (int i = 0; !atomic_load(&client.done); i++) {
+		wl_display_flush_clients(display);
+		ret = wl_event_loop_dispatch(loop, 1);
+		assert(ret >= 0);
+
+		int64_t start_ns = bench_get_time_ns();
+		render_frame(output, i);
+		commit_ns += bench_get_time_ns() - start_ns;
+		commits++;
+	}
+	wl_display_flush_clients(display);
+	pthread_join(thread, NULL);
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkImageCopyCapture/%s/%ux%u",
+		config->name, client.width, client.height);
+	// Commits which don't copy a frame are accounted for as well, they cost
+	// the same in all runs
+	bench_result_begin(name, N_FRAMES, (double)commit_ns / N_FRAMES);
+	bench_result_metric(client.size, "buffer-bytes");
+	bench_result_metric(commits, "commits");
+	bench_result_end();
+
+	wl_list_remove(&new_session.link);
+	wl_display_destroy_clients(display);
+	wlr_backend_destroy(backend);
+	wlr_allocator_destroy(allocator);
+	wlr_renderer_destroy(renderer);
+	wl_display_destroy(display);
+}
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	static const struct bench_config configs[] = {
+		{ "full/xrgb8888", 0, 0, WL_SHM_FORMAT_XRGB8888 },
+		{ "scaled/xrgb8888", 1920, 1080, WL_SHM_FORMAT_XRGB8888 },
+		{ "scaled/rgb565", 1920, 1080, WL_SHM_FORMAT_RGB565 },
+		{ "thumbnail/xrgb8888", 480, 270, WL_SHM_FORMAT_XRGB8888 },
+	};
+	for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+		run(&configs[i]);
+	}
+	return 0;
+}
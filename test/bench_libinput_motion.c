@@ -0,0 +1,206 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wayland-util.h>
+#include <wlr/interfaces/wlr_pointer.h>
+#include <wlr/types/wlr_scene.h>
+
+#include "backend/libinput.h"
+#include "bench.h"
+
+#define SCENE_WIDTH    3840
+#define SCENE_HEIGHT   2160
+#define SCENE_COLS     16
+#define SCENE_ROWS     16
+#define SYNTH_RATE_HZ  8000
+#define SYNTH_DURATION 2 // seconds
+#define TAU            6.283185307179586
+
+/**
+ * Replays a recorded relative motion stream through the libinput backend's
+ * motion coalescing, into a sink which does what a typical compositor does
+ * on motion: move the cursor and hit-test the scene.
+ *
+ * A recording can be passed as argument. Each line contains
+ * "<time_usec> <dx> <dy> <unaccel_dx> <unaccel_dy>", e.g. converted from the
+ * POINTER_MOTION events of a `libinput record` capture. Without argument, a
+ * synthetic 8 kHz stream is used.
+ */
+
+struct sink {
+	struct wlr_scene *scene;
+	struct wl_listener motion;
+	double x, y;
+	size_t motion_events;
+	size_t hits;
+};
+
+static const struct wlr_pointer_impl bench_pointer_impl = {
+	.name = "bench-pointer",
+};
+
+static void handle_motion(struct wl_listener *listener, void *data) {
+	struct sink *sink = wl_container_of(listener, sink, motion);
+	struct wlr_pointer_motion_event *event = data;
+
+	sink->x = fmin(fmax(sink->x + event->delta_x, 0), SCENE_WIDTH - 1);
+	sink->y = fmin(fmax(sink->y + event->delta_y, 0), SCENE_HEIGHT - 1);
+	sink->motion_events++;
+
+	double sx, sy;
+	if (wlr_scene_node_at(&sink->scene->tree.node, sink->x, sink->y,
+			&sx, &sy) != NULL) {
+		sink->hits++;
+	}
+}
+
+static void build_scene(struct wlr_scene *scene) {
+	float color[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	int width = SCENE_WIDTH / SCENE_COLS, height = SCENE_HEIGHT / SCENE_ROWS;
+	for (int row = 0; row < SCENE_ROWS; row++) {
+		for (int col = 0; col < SCENE_COLS; col++) {
+			struct wlr_scene_tree *tree = wlr_scene_tree_create(&scene->tree);
+			assert(tree);
+			wlr_scene_node_set_position(&tree->node, col * width, row * height);
+			// Leave gaps so that some lookups miss
+			struct wlr_scene_rect *rect = wlr_scene_rect_create(tree,
+				width - 8, height - 8, color);
+			assert(rect);
+		}
+	}
+}
+
+static bool load_recording(const char *path, struct wl_array *samples) {
+	FILE *f = fopen(path, "r");
+	if (f == NULL) {
+		perror("fopen");
+		return false;
+	}
+
+	struct wlr_pointer_motion_sample sample;
+	uint64_t time_usec;
+	while (fscanf(f, "%" SCNu64 " %lf %lf %lf %lf", &time_usec,
+			&sample.delta_x, &sample.delta_y,
+			&sample.unaccel_dx, &sample.unaccel_dy) == 5) {
+		sample.time_usec = time_usec;
+		struct wlr_pointer_motion_sample *slot =
+			wl_array_add(samples, sizeof(*slot));
+		assert(slot);
+		*slot = sample;
+	}
+
+	fclose(f);
+	return samples->size > 0;
+}
+
+static void synthesize_recording(struct wl_array *samples) {
+	// Circular sweeps, like a player looking around in a game
+	size_t n = SYNTH_RATE_HZ * SYNTH_DURATION;
+	for (size_t i = 0; i < n; i++) {
+		double angle = TAU * i / SYNTH_RATE_HZ;
+		struct wlr_pointer_motion_sample *slot =
+			wl_array_add(samples, sizeof(*slot));
+		assert(slot);
+		*slot = (struct wlr_pointer_motion_sample){
+			.time_usec = i * 1000000 / SYNTH_RATE_HZ,
+			.delta_x = 4 * cos(angle),
+			.delta_y = 4 * sin(angle),
+			.unaccel_dx = 2 * cos(angle),
+			.unaccel_dy = 2 * sin(angle),
+		};
+	}
+}
+
+static void replay(const struct wl_array *samples, int64_t dispatch_usec,
+		bool coalesce) {
+	struct sink sink = {
+		.scene = wlr_scene_create(),
+		.x = SCENE_WIDTH / 2,
+		.y = SCENE_HEIGHT / 2,
+	};
+	assert(sink.scene);
+	build_scene(sink.scene);
+
+	struct wlr_pointer pointer;
+	wlr_pointer_init(&pointer, &bench_pointer_impl, "bench-pointer");
+	sink.motion.notify = handle_motion;
+	wl_signal_add(&pointer.events.motion, &sink.motion);
+
+	struct wlr_libinput_motion_batch batch;
+	motion_batch_init(&batch);
+
+	const struct wlr_pointer_motion_sample *sample;
+	size_t n_samples = samples->size / sizeof(*sample);
+	uint64_t dispatch_end = 0;
+
+	int64_t start_ns = bench_get_time_ns();
+	wl_array_for_each(sample, samples) {
+		if (sample->time_usec >= dispatch_end) {
+			// All events up to here have been read in one libinput dispatch
+			motion_batch_flush(&batch);
+			dispatch_end = sample->time_usec + dispatch_usec;
+		}
+
+		if (coalesce) {
+			motion_batch_add(&batch, &pointer, sample);
+		} else {
+			struct wlr_pointer_motion_event event = {
+				.pointer = &pointer,
+				.time_msec = sample->time_usec / 1000,
+				.delta_x = sample->delta_x,
+				.delta_y = sample->delta_y,
+				.unaccel_dx = sample->unaccel_dx,
+				.unaccel_dy = sample->unaccel_dy,
+			};
+			wl_signal_emit_mutable(&pointer.events.motion, &event);
+			wl_signal_emit_mutable(&pointer.events.frame, &pointer);
+		}
+	}
+	motion_batch_flush(&batch);
+	int64_t elapsed_ns = bench_get_time_ns() - start_ns;
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkMotion/%s/dispatch%" PRId64 "us",
+		coalesce ? "coalesced" : "direct", dispatch_usec);
+	bench_result_begin(name, n_samples, (double)elapsed_ns / n_samples);
+	bench_result_metric(sink.motion_events, "events");
+	bench_result_metric(sink.x, "x");
+	bench_result_metric(sink.y, "y");
+	bench_result_end();
+
+	motion_batch_finish(&batch);
+	wl_list_remove(&sink.motion.link);
+	wlr_pointer_finish(&pointer);
+	wlr_scene_node_destroy(&sink.scene->tree.node);
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 2) {
+		fprintf(stderr, "Usage: %s [recording]\n", argv[0]);
+		return 1;
+	}
+
+	struct wl_array samples;
+	wl_array_init(&samples);
+	if (argc == 2) {
+		if (!load_recording(argv[1], &samples)) {
+			fprintf(stderr, "Failed to load recording\n");
+			return 1;
+		}
+	} else {
+		synthesize_recording(&samples);
+	}
+
+	static const int64_t dispatch_intervals[] = { 125, 1000, 4000, 16000 };
+	for (size_t i = 0; i < sizeof(dispatch_intervals) / sizeof(dispatch_intervals[0]); i++) {
+		replay(&samples, dispatch_intervals[i], false);
+		replay(&samples, dispatch_intervals[i], true);
+	}
+
+	wl_array_release(&samples);
+	return 0;
+}
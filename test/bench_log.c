@@ -0,0 +1,186 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "bench.h"
+
+#define N_MESSAGES 200000
+#define BURST_SIZE 1000
+#define N_CHECKED  100
+
+// Length of the "HH:MM:SS.mmm " timestamp in front of each line
+#define TIMESTAMP_LEN 13
+
+/**
+ * Logs messages shaped like the debug output of a busy compositor, in bursts
+ * as happens on each frame, and measures the time spent in the caller. The
+ * background thread writes the asynchronous logger's output to /dev/null.
+ */
+
+enum bench_logger {
+	LOGGER_STDERR,
+	LOGGER_ASYNC_TEXT,
+	LOGGER_ASYNC_BINARY,
+};
+
+static const char *logger_names[] = {
+	[LOGGER_STDERR] = "Stderr",
+	[LOGGER_ASYNC_TEXT] = "AsyncText",
+	[LOGGER_ASYNC_BINARY] = "AsyncBinary",
+};
+
+static void log_message(size_t i) {
+	static const char *outputs[] = { "DP-1", "HDMI-A-1", "eDP-1" };
+	switch (i % 4) {
+	case 0:
+		wlr_log(WLR_DEBUG, "Committing output %s with buffer %dx%d",
+			outputs[i % 3], 1920 + (int)(i % 7), 1080);
+		break;
+	case 1:
+		wlr_log(WLR_DEBUG, "Surface %p committed, seq %" PRIu32 " damage %.2f%%",
+			(void *)(uintptr_t)(0x1000 + 16 * i), (uint32_t)i,
+			(double)(i % 1000) / 10);
+		break;
+	case 2:
+		wlr_log(WLR_DEBUG, "Pointer motion to %.3f, %.3f on %.*s",
+			(double)i / 3, (double)i / 7, 4, outputs[i % 3]);
+		break;
+	case 3:
+		wlr_log(WLR_DEBUG, "Frame %zu scheduled %+ld ns late (%c)",
+			i, (long)(i % 5000) - 2500, 'a' + (int)(i % 26));
+		break;
+	}
+}
+
+static void run(enum bench_logger logger, int fd) {
+	switch (logger) {
+	case LOGGER_STDERR:
+		wlr_log_init(WLR_DEBUG, NULL);
+		break;
+	case LOGGER_ASYNC_TEXT:
+	case LOGGER_ASYNC_BINARY:;
+		bool ok = wlr_log_init_async(WLR_DEBUG, &(struct wlr_log_async_options){
+			.fd = fd,
+			.binary = logger == LOGGER_ASYNC_BINARY,
+		});
+		assert(ok);
+		break;
+	}
+
+	uint64_t dropped = wlr_log_get_dropped();
+	int64_t elapsed_ns = 0;
+	for (size_t i = 0; i < N_MESSAGES; i += BURST_SIZE) {
+		int64_t start_ns = bench_get_time_ns();
+		for (size_t j = i; j < i + BURST_SIZE; j++) {
+			log_message(j);
+		}
+		elapsed_ns += bench_get_time_ns() - start_ns;
+
+		// Leave time for the flush thread in between frames
+		nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+	}
+
+	wlr_log_finish_async();
+	dropped = wlr_log_get_dropped() - dropped;
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkLog/%s", logger_names[logger]);
+	bench_result_begin(name, N_MESSAGES, (double)elapsed_ns / N_MESSAGES);
+	bench_result_metric(dropped, "dropped");
+	bench_result_end();
+}
+
+static char *read_file(FILE *f) {
+	fflush(f);
+	long size = ftell(f);
+	assert(size >= 0);
+	char *data = calloc(1, size + 1);
+	assert(data);
+	rewind(f);
+	size_t n = fread(data, 1, size, f);
+	assert(n == (size_t)size);
+	return data;
+}
+
+// Checks that decoding the binary output yields the text output
+static void check_binary_decode(void) {
+	FILE *text = tmpfile(), *binary = tmpfile(), *decoded = tmpfile();
+	assert(text && binary && decoded);
+
+	for (int i = 0; i < 2; i++) {
+		bool ok = wlr_log_init_async(WLR_DEBUG, &(struct wlr_log_async_options){
+			.fd = fileno(i == 0 ? text : binary),
+			.binary = i == 1,
+		});
+		assert(ok);
+		for (size_t j = 0; j < N_CHECKED; j++) {
+			log_message(j);
+		}
+		wlr_log_finish_async();
+	}
+
+	fflush(binary);
+	lseek(fileno(binary), 0, SEEK_SET);
+	bool ok = wlr_log_decode_binary(fileno(binary), fileno(decoded));
+	assert(ok);
+	fseek(decoded, 0, SEEK_END);
+	fseek(text, 0, SEEK_END);
+
+	char *text_data = read_file(text);
+	char *decoded_data = read_file(decoded);
+	char *text_line = text_data, *decoded_line = decoded_data;
+	size_t lines = 0;
+	while (*text_line != '\0') {
+		char *text_end = strchr(text_line, '\n');
+		char *decoded_end = strchr(decoded_line, '\n');
+		assert(text_end && decoded_end);
+		// Timestamps differ
+		size_t len = text_end - text_line;
+		assert(len > TIMESTAMP_LEN);
+		assert((size_t)(decoded_end - decoded_line) == len);
+		assert(memcmp(text_line + TIMESTAMP_LEN, decoded_line + TIMESTAMP_LEN,
+			len - TIMESTAMP_LEN) == 0);
+		text_line = text_end + 1;
+		decoded_line = decoded_end + 1;
+		lines++;
+	}
+	assert(*decoded_line == '\0');
+	assert(lines == N_CHECKED);
+
+	free(text_data);
+	free(decoded_data);
+	fclose(text);
+	fclose(binary);
+	fclose(decoded);
+}
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	check_binary_decode();
+
+	int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+	assert(null_fd >= 0);
+
+	// The default logger writes to stderr
+	fflush(stderr);
+	int stderr_fd = dup(STDERR_FILENO);
+	assert(stderr_fd >= 0);
+	dup2(null_fd, STDERR_FILENO);
+
+	run(LOGGER_STDERR, null_fd);
+	run(LOGGER_ASYNC_TEXT, null_fd);
+	run(LOGGER_ASYNC_BINARY, null_fd);
+
+	dup2(stderr_fd, STDERR_FILENO);
+	close(stderr_fd);
+	close(null_fd);
+	return 0;
+}
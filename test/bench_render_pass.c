@@ -31,6 +31,7 @@
 #define MAX_ITER       10000
 #define MIN_ITER       10
 #define WARMUP_ITER    2
+#define FIRST_FRAME_ITER 5
 
 enum primitive_type {
 	RECT,
@@ -49,6 +50,13 @@ struct bench_case {
 	int count;
 };
 
+// Backing memory options of the shm and udmabuf allocators
+struct memory_config {
+	const char *name;
+	const char *hugepages;
+	bool prefault;
+};
+
 struct bench_result {
 	int iters;
 	int64_t cpu_ns;
@@ -150,6 +158,21 @@ static void bench_ctx_finish(struct bench_ctx *ctx) {
 	wl_event_loop_destroy(ctx->ev);
 }
 
+static void wait_render(struct bench_ctx *ctx, uint64_t point) {
+	if (!ctx->renderer->features.timeline) {
+		return;
+	}
+
+	struct render_wait wait = { 0 };
+	assert(wlr_drm_syncobj_timeline_waiter_init(&wait.waiter, ctx->timeline,
+			point, 0, ctx->ev, handle_render_ready));
+	while (!wait.ready) {
+		int ret = wl_event_loop_dispatch(ctx->ev, -1);
+		assert(ret >= 0);
+	}
+	wlr_drm_syncobj_timeline_waiter_finish(&wait.waiter);
+}
+
 static void run_one(struct bench_ctx *ctx, const struct bench_case *bc,
 		const pixman_region32_t *clip, int64_t *out_cpu_ns,
 		int64_t *out_gpu_ns) {
@@ -212,17 +235,7 @@ static void run_one(struct bench_ctx *ctx, const struct bench_case *bc,
 	clock_gettime(CLOCK_MONOTONIC, &end);
 	*out_cpu_ns = timespec_diff_ns(&start, &end);
 
-	if (ctx->renderer->features.timeline) {
-		struct render_wait wait = { 0 };
-		assert(wlr_drm_syncobj_timeline_waiter_init(&wait.waiter, ctx->timeline,
-				point, 0, ctx->ev, handle_render_ready));
-		while (!wait.ready) {
-			int ret = wl_event_loop_dispatch(ctx->ev, -1);
-			assert(ret >= 0);
-		}
-		wlr_drm_syncobj_timeline_waiter_finish(&wait.waiter);
-	}
-
+	wait_render(ctx, point);
 	wlr_buffer_unlock(buffer);
 
 	if (ctx->timer) {
@@ -315,11 +328,142 @@ static void print_result(const struct bench_case *bc,
 	fflush(stdout);
 }
 
+// Blends a translucent rect over a whole buffer of the swapchain. The time
+// spent includes allocating the buffer if the swapchain slot is empty.
+static int64_t run_blend(struct bench_ctx *ctx,
+		struct wlr_swapchain *swapchain) {
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	struct wlr_buffer *buffer = wlr_swapchain_acquire(swapchain);
+	assert(buffer);
+
+	uint64_t point = ctx->signal_point++;
+	struct wlr_render_pass *pass = wlr_renderer_begin_buffer_pass(
+			ctx->renderer, buffer, &(struct wlr_buffer_pass_options){
+		.color_transform = ctx->color_transform,
+		.signal_timeline = ctx->timeline,
+		.signal_point = point,
+	});
+	assert(pass);
+
+	wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
+		.box = { .width = swapchain->width, .height = swapchain->height },
+		.color = { .r = 0.5, .g = 0.25, .b = 0.05, .a = 0.5 },
+	});
+
+	bool ok = wlr_render_pass_submit(pass);
+	assert(ok);
+	wait_render(ctx, point);
+	wlr_buffer_unlock(buffer);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return timespec_diff_ns(&start, &end);
+}
+
+static void print_memory_result(const char *bench,
+		const struct memory_config *mc, int width, int height, int iters, int64_t ns) {
+	char name[64];
+	snprintf(name, sizeof(name), "Benchmark%s/%s/%dx%d",
+		bench, mc->name, width, height);
+	printf("%-40s %8d %12lld ns/op\n", name, iters, (long long)(ns / iters));
+	fflush(stdout);
+}
+
+// Measures the latency of the first frame drawn into a newly allocated buffer,
+// which takes the page faults, and the steady-state blend throughput. Returns
+// false if the allocator doesn't use shared memory or doesn't support the
+// output format.
+static bool run_memory_benchmark(struct bench_ctx *ctx,
+		const struct memory_config *mc, int width, int height) {
+	// Disable the buffer pool so that each swapchain gets new buffers
+	setenv("WLR_ALLOCATOR_NO_POOL", "1", true);
+	setenv("WLR_ALLOCATOR_HUGEPAGES", mc->hugepages, true);
+	setenv("WLR_ALLOCATOR_PREFAULT", mc->prefault ? "1" : "0", true);
+	struct wlr_allocator *allocator =
+		wlr_allocator_autocreate(ctx->backend, ctx->renderer);
+	assert(allocator);
+	unsetenv("WLR_ALLOCATOR_NO_POOL");
+	unsetenv("WLR_ALLOCATOR_HUGEPAGES");
+	unsetenv("WLR_ALLOCATOR_PREFAULT");
+
+	if (!(allocator->buffer_caps & WLR_BUFFER_CAP_SHM)) {
+		wlr_allocator_destroy(allocator);
+		return false;
+	}
+
+	const struct wlr_drm_format_set *formats =
+		wlr_renderer_get_texture_formats(ctx->renderer,
+			allocator->buffer_caps);
+	const struct wlr_drm_format *format =
+		wlr_drm_format_set_get(formats, OUTPUT_FORMAT);
+	if (format == NULL) {
+		wlr_allocator_destroy(allocator);
+		return false;
+	}
+
+	int64_t first_frame_ns = 0;
+	for (int i = 0; i < FIRST_FRAME_ITER; i++) {
+		struct wlr_swapchain *swapchain =
+			wlr_swapchain_create(allocator, width, height, format);
+		assert(swapchain);
+		first_frame_ns += run_blend(ctx, swapchain);
+		wlr_swapchain_destroy(swapchain);
+	}
+	print_memory_result("FirstFrame", mc, width, height, FIRST_FRAME_ITER,
+		first_frame_ns);
+
+	struct wlr_swapchain *swapchain =
+		wlr_swapchain_create(allocator, width, height, format);
+	assert(swapchain);
+	for (int i = 0; i < WARMUP_ITER; i++) {
+		run_blend(ctx, swapchain);
+	}
+	int iters = 0;
+	int64_t blend_ns = 0;
+	while ((blend_ns < TARGET_NS || iters < MIN_ITER) && iters < MAX_ITER) {
+		blend_ns += run_blend(ctx, swapchain);
+		iters++;
+	}
+	print_memory_result("Blend", mc, width, height, iters, blend_ns);
+	wlr_swapchain_destroy(swapchain);
+
+	wlr_allocator_destroy(allocator);
+	return true;
+}
+
+static void run_memory_benchmarks(struct bench_ctx *ctx, int reruns) {
+	static const struct memory_config configs[] = {
+		{ "default", "none", false },
+		{ "prefault", "none", true },
+		{ "thp", "transparent", false },
+		{ "thp-prefault", "transparent", true },
+		{ "hugetlb", "explicit", false },
+		{ "hugetlb-prefault", "explicit", true },
+	};
+	static const int sizes[][2] = { { 3840, 2160 }, { 7680, 4320 } };
+
+	for (size_t ci = 0; ci < sizeof(configs) / sizeof(configs[0]); ci++) {
+		for (size_t si = 0; si < sizeof(sizes) / sizeof(sizes[0]); si++) {
+			for (int ri = 0; ri < reruns; ri++) {
+				if (!run_memory_benchmark(ctx, &configs[ci],
+						sizes[si][0], sizes[si][1])) {
+					fprintf(stderr, "Skipping memory benchmarks, "
+						"the allocator doesn't use shared memory "
+						"or doesn't support the output format\n");
+					return;
+				}
+			}
+		}
+	}
+}
+
 int main(int argc, char *argv[]) {
 	int reruns = 1;
+	bool memory_only = false;
 
 	int opt;
-	while ((opt = getopt(argc, argv, "c:")) != -1) {
+	while ((opt = getopt(argc, argv, "c:m")) != -1) {
 		switch (opt) {
 		case 'c':
 			reruns = atoi(optarg);
@@ -328,20 +472,31 @@ int main(int argc, char *argv[]) {
 				return 1;
 			}
 			break;
+		case 'm':
+			memory_only = true;
+			break;
 		default:
-			fprintf(stderr, "Usage: %s [-c N]\n", argv[0]);
+			fprintf(stderr, "Usage: %s [-c N] [-m]\n", argv[0]);
 			return 1;
 		}
 	}
 
 	if (optind != argc) {
-		fprintf(stderr, "Usage: %s [-c N]\n", argv[0]);
+		fprintf(stderr, "Usage: %s [-c N] [-m]\n", argv[0]);
 		return 1;
 	}
 
 	struct bench_ctx ctx = {0};
 	bench_ctx_init(&ctx);
 
+	// The memory benchmarks allocate large buffers in each configuration,
+	// they only run on demand
+	if (memory_only) {
+		run_memory_benchmarks(&ctx, reruns);
+		bench_ctx_finish(&ctx);
+		return 0;
+	}
+
 	static const int primitives[] = { RECT, TEXTURE, -1 };
 	static const int layouts[] = { STACKED, GRID, -1 };
 	static const int clips[] = { 1, 200, -1 };
@@ -0,0 +1,347 @@
+#undef _POSIX_C_SOURCE
+#define _GNU_SOURCE // for memfd_create()
+#include <assert.h>
+#include <pixman.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/pass.h>
+#include <wlr/render/pixman.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_screencopy_v1.h>
+#include <wlr/types/wlr_shm.h>
+#include <wlr/util/log.h>
+#include "wlr-screencopy-unstable-v1-client-protocol.h"
+#include "bench.h"
+
+#define OUTPUT_WIDTH  3840
+#define OUTPUT_HEIGHT 2160
+#define CURSOR_SIZE   64
+#define N_FRAMES      100
+#define MAX_CLIENTS   3
+
+/**
+ * A remote desktop client captures a 4K output with wlr-screencopy, reusing
+ * a single shm buffer, while the compositor renders a moving cursor-sized
+ * region on each frame. The client runs on its own thread, the time spent
+ * in output commits which copy a frame is measured on the compositor side.
+ *
+ * With several clients, e.g. a recorder and a VNC server capturing the same
+ * output, the copies of each commit share the output buffer import.
+ */
+
+struct bench_client {
+	int fd;
+	bool with_damage;
+	atomic_bool done;
+
+	struct wl_display *display;
+	struct wl_shm *shm;
+	struct wl_output *output;
+	struct zwlr_screencopy_manager_v1 *manager;
+
+	struct wl_buffer *buffer;
+	void *data;
+	size_t size;
+	bool frame_done;
+};
+
+static void registry_handle_global(void *data, struct wl_registry *registry,
+		uint32_t name, const char *interface, uint32_t version) {
+	struct bench_client *client = data;
+	if (strcmp(interface, wl_shm_interface.name) == 0) {
+		client->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (strcmp(interface, wl_output_interface.name) == 0) {
+		client->output = wl_registry_bind(registry, name, &wl_output_interface, 1);
+	} else if (strcmp(interface,
+			zwlr_screencopy_manager_v1_interface.name) == 0) {
+		client->manager = wl_registry_bind(registry, name,
+			&zwlr_screencopy_manager_v1_interface, 3);
+	}
+}
+
+static void registry_handle_global_remove(void *data,
+		struct wl_registry *registry, uint32_t name) {
+	// This space is intentionally left blank
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_handle_global,
+	.global_remove = registry_handle_global_remove,
+};
+
+static void frame_handle_buffer(void *data,
+		struct zwlr_screencopy_frame_v1 *frame, uint32_t format,
+		uint32_t width, uint32_t height, uint32_t stride) {
+	struct bench_client *client = data;
+	if (client->buffer != NULL) {
+		return;
+	}
+
+	client->size = (size_t)stride * height;
+	int fd = memfd_create("bench-screencopy", MFD_CLOEXEC);
+	assert(fd >= 0);
+	int ret = ftruncate(fd, client->size);
+	assert(ret == 0);
+	client->data = mmap(NULL, client->size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	assert(client->data != MAP_FAILED);
+
+	struct wl_shm_pool *pool = wl_shm_create_pool(client->shm, fd,
+		client->size);
+	client->buffer = wl_shm_pool_create_buffer(pool, 0, width, height,
+		stride, format);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+}
+
+static void frame_handle_flags(void *data,
+		struct zwlr_screencopy_frame_v1 *frame, uint32_t flags) {
+	// This space is intentionally left blank
+}
+
+static void frame_handle_ready(void *data,
+		struct zwlr_screencopy_frame_v1 *frame, uint32_t tv_sec_hi,
+		uint32_t tv_sec_lo, uint32_t tv_nsec) {
+	struct bench_client *client = data;
+	client->frame_done = true;
+}
+
+static void frame_handle_failed(void *data,
+		struct zwlr_screencopy_frame_v1 *frame) {
+	fprintf(stderr, "Failed to capture frame\n");
+	abort();
+}
+
+static void frame_handle_damage(void *data,
+		struct zwlr_screencopy_frame_v1 *frame, uint32_t x, uint32_t y,
+		uint32_t width, uint32_t height) {
+	// This space is intentionally left blank
+}
+
+static void frame_handle_linux_dmabuf(void *data,
+		struct zwlr_screencopy_frame_v1 *frame, uint32_t format,
+		uint32_t width, uint32_t height) {
+	// This space is intentionally left blank
+}
+
+static void frame_handle_buffer_done(void *data,
+		struct zwlr_screencopy_frame_v1 *frame) {
+	struct bench_client *client = data;
+	if (client->with_damage) {
+		zwlr_screencopy_frame_v1_copy_with_damage(frame, client->buffer);
+	} else {
+		zwlr_screencopy_frame_v1_copy(frame, client->buffer);
+	}
+}
+
+static const struct zwlr_screencopy_frame_v1_listener frame_listener = {
+	.buffer = frame_handle_buffer,
+	.flags = frame_handle_flags,
+	.ready = frame_handle_ready,
+	.failed = frame_handle_failed,
+	.damage = frame_handle_damage,
+	.linux_dmabuf = frame_handle_linux_dmabuf,
+	.buffer_done = frame_handle_buffer_done,
+};
+
+static void *client_run(void *data) {
+	struct bench_client *client = data;
+
+	client->display = wl_display_connect_to_fd(client->fd);
+	assert(client->display);
+
+	struct wl_registry *registry = wl_display_get_registry(client->display);
+	wl_registry_add_listener(registry, &registry_listener, client);
+	wl_display_roundtrip(client->display);
+	assert(client->shm && client->output && client->manager);
+
+	for (int i = 0; i < N_FRAMES; i++) {
+		struct zwlr_screencopy_frame_v1 *frame =
+			zwlr_screencopy_manager_v1_capture_output(client->manager, 0,
+				client->output);
+		zwlr_screencopy_frame_v1_add_listener(frame, &frame_listener, client);
+
+		client->frame_done = false;
+		while (!client->frame_done) {
+			int ret = wl_display_dispatch(client->display);
+			assert(ret >= 0);
+		}
+		zwlr_screencopy_frame_v1_destroy(frame);
+	}
+
+	wl_buffer_destroy(client->buffer);
+	munmap(client->data, client->size);
+	zwlr_screencopy_manager_v1_destroy(client->manager);
+	wl_output_destroy(client->output);
+	wl_shm_destroy(client->shm);
+	wl_registry_destroy(registry);
+	wl_display_disconnect(client->display);
+
+	atomic_store(&client->done, true);
+	return NULL;
+}
+
+static bool clients_done(struct bench_client *clients, int n_clients) {
+	for (int i = 0; i < n_clients; i++) {
+		if (!atomic_load(&clients[i].done)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void render_frame(struct wlr_output *output, int i) {
+	// Move the cursor along a diagonal, damaging its old and new position
+	int prev = i > 0 ? i - 1 : 0;
+	int x = (i * 16) % (OUTPUT_WIDTH - CURSOR_SIZE);
+	int y = (i * 9) % (OUTPUT_HEIGHT - CURSOR_SIZE);
+	int prev_x = (prev * 16) % (OUTPUT_WIDTH - CURSOR_SIZE);
+	int prev_y = (prev * 9) % (OUTPUT_HEIGHT - CURSOR_SIZE);
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+
+	pixman_region32_t damage;
+	pixman_region32_init_rect(&damage, x, y, CURSOR_SIZE, CURSOR_SIZE);
+	pixman_region32_union_rect(&damage, &damage, prev_x, prev_y,
+		CURSOR_SIZE, CURSOR_SIZE);
+	wlr_output_state_set_damage(&state, &damage);
+	pixman_region32_fini(&damage);
+
+	struct wlr_render_pass *pass =
+		wlr_output_begin_render_pass(output, &state, NULL);
+	assert(pass);
+	wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
+		.box = { .x = x, .y = y, .width = CURSOR_SIZE, .height = CURSOR_SIZE },
+		.color = { .r = 1, .g = 1, .b = 1, .a = 1 },
+	});
+	bool ok = wlr_render_pass_submit(pass);
+	assert(ok);
+
+	ok = wlr_output_commit_state(output, &state);
+	assert(ok);
+	wlr_output_state_finish(&state);
+}
+
+static void run(bool with_damage, int n_clients) {
+	struct wl_display *display = wl_display_create();
+	assert(display);
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+
+	struct wlr_backend *backend = wlr_headless_backend_create(loop);
+	assert(backend);
+	struct wlr_renderer *renderer = wlr_pixman_renderer_create();
+	assert(renderer);
+	struct wlr_allocator *allocator =
+		wlr_allocator_autocreate(backend, renderer);
+	assert(allocator);
+
+	wlr_shm_create_with_renderer(display, 1, renderer);
+	struct wlr_screencopy_manager_v1 *manager =
+		wlr_screencopy_manager_v1_create(display);
+	assert(manager);
+	// The client doesn't touch its buffer between frames
+	wlr_screencopy_manager_v1_set_damage_only_copy(manager, true);
+
+	struct wlr_output *output =
+		wlr_headless_add_output(backend, OUTPUT_WIDTH, OUTPUT_HEIGHT);
+	assert(output);
+	bool ok = wlr_backend_start(backend);
+	assert(ok);
+	ok = wlr_output_init_render(output, allocator, renderer);
+	assert(ok);
+	wlr_output_create_global(output, display);
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_enabled(&state, true);
+	ok = wlr_output_commit_state(output, &state);
+	assert(ok);
+	wlr_output_state_finish(&state);
+
+	assert(n_clients <= MAX_CLIENTS);
+	struct bench_client clients[MAX_CLIENTS] = {0};
+	pthread_t threads[MAX_CLIENTS];
+	int ret;
+	for (int i = 0; i < n_clients; i++) {
+		int fds[2];
+		ret = socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds);
+		assert(ret == 0);
+		struct wl_client *wl_client = wl_client_create(display, fds[0]);
+		assert(wl_client);
+
+		clients[i].fd = fds[1];
+		clients[i].with_damage = with_damage;
+		ret = pthread_create(&threads[i], NULL, client_run, &clients[i]);
+		assert(ret == 0);
+	}
+
+	struct wlr_screencopy_v1_stats stats = {0};
+	int64_t copy_ns = 0;
+	for (int i = 0; !clients_done(clients, n_clients); i++) {
+		wl_display_flush_clients(display);
+		ret = wl_event_loop_dispatch(loop, 1);
+		assert(ret >= 0);
+
+		// Only account for commits which copy a frame
+		uint64_t copied = stats.shm_frames;
+		int64_t start_ns = bench_get_time_ns();
+		render_frame(output, i);
+		int64_t elapsed_ns = bench_get_time_ns() - start_ns;
+		wlr_screencopy_manager_v1_get_stats(manager, &stats);
+		if (stats.shm_frames != copied) {
+			copy_ns += elapsed_ns;
+		}
+	}
+	wl_display_flush_clients(display);
+	for (int i = 0; i < n_clients; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	assert(stats.shm_frames == (uint64_t)N_FRAMES * n_clients);
+
+	struct wlr_output_capture_stats capture_stats;
+	wlr_output_get_capture_stats(output, &capture_stats);
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkScreencopy/%s/%dclients/%dx%d",
+		with_damage ? "damage" : "full", n_clients,
+		OUTPUT_WIDTH, OUTPUT_HEIGHT);
+	// The first frame is always copied in full
+	bench_result_begin(name, stats.shm_frames,
+		(double)copy_ns / stats.shm_frames);
+	bench_result_metric((double)stats.shm_bytes / stats.shm_frames, "bytes/op");
+	bench_result_metric(stats.last_shm_bytes, "last-bytes");
+	bench_result_metric(stats.shm_damage_frames, "damage-frames");
+	bench_result_metric(capture_stats.imports_saved, "imports-saved");
+	bench_result_end();
+
+	wl_display_destroy_clients(display);
+	wlr_backend_destroy(backend);
+	wlr_allocator_destroy(allocator);
+	wlr_renderer_destroy(renderer);
+	wl_display_destroy(display);
+}
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	for (int n_clients = 1; n_clients <= MAX_CLIENTS; n_clients += 2) {
+		run(false, n_clients);
+		run(true, n_clients);
+	}
+	return 0;
+}
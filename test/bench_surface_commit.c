@@ -0,0 +1,201 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/util/log.h>
+#include "bench.h"
+
+#define N_COMMITS     100000
+#define N_SYNCED      3
+#define SYNCED_SIZE   128
+
+// Object IDs allocated by the fake client
+#define DISPLAY_ID    1
+#define REGISTRY_ID   2
+#define COMPOSITOR_ID 3
+#define SURFACE_ID    4
+
+// Request opcodes, see wayland.xml
+#define DISPLAY_GET_REGISTRY      1
+#define REGISTRY_BIND             0
+#define COMPOSITOR_CREATE_SURFACE 0
+#define SURFACE_DAMAGE            2
+#define SURFACE_COMMIT            6
+
+/**
+ * Drives wl_surface commits from a fake client speaking the wire protocol
+ * over a socket pair. The compositor holds a number of commits locked, as
+ * with synchronized subsurfaces or explicit sync, so that each commit goes
+ * through the cached state path.
+ */
+
+struct bench_synced {
+	struct wlr_surface_synced synced;
+	uint8_t pending[SYNCED_SIZE], current[SYNCED_SIZE];
+};
+
+struct bench_server {
+	struct wl_display *display;
+	struct wl_event_loop *loop;
+	struct wlr_compositor *compositor;
+	struct wl_listener new_surface;
+
+	struct wlr_surface *surface;
+	struct bench_synced synced[N_SYNCED];
+	struct wl_listener client_commit;
+
+	uint32_t locks[64];
+	size_t locks_len;
+};
+
+static const struct wlr_surface_synced_impl bench_synced_impl = {
+	.state_size = SYNCED_SIZE,
+};
+
+static void handle_client_commit(struct wl_listener *listener, void *data) {
+	struct bench_server *server =
+		wl_container_of(listener, server, client_commit);
+	assert(server->locks_len < sizeof(server->locks) / sizeof(server->locks[0]));
+	server->locks[server->locks_len++] =
+		wlr_surface_lock_pending(server->surface);
+}
+
+static void handle_new_surface(struct wl_listener *listener, void *data) {
+	struct bench_server *server = wl_container_of(listener, server, new_surface);
+	struct wlr_surface *surface = data;
+
+	server->surface = surface;
+	for (size_t i = 0; i < N_SYNCED; i++) {
+		struct bench_synced *synced = &server->synced[i];
+		bool ok = wlr_surface_synced_init(&synced->synced, surface,
+			&bench_synced_impl, synced->pending, synced->current);
+		assert(ok);
+	}
+
+	server->client_commit.notify = handle_client_commit;
+	wl_signal_add(&surface->events.client_commit, &server->client_commit);
+}
+
+static void write_request(int fd, uint32_t id, uint16_t opcode,
+		const uint32_t *args, size_t args_len) {
+	uint32_t msg[16];
+	assert(args_len + 2 <= sizeof(msg) / sizeof(msg[0]));
+	size_t size = (args_len + 2) * sizeof(uint32_t);
+	msg[0] = id;
+	msg[1] = (uint32_t)size << 16 | opcode;
+	memcpy(&msg[2], args, args_len * sizeof(uint32_t));
+	ssize_t n = write(fd, msg, size);
+	assert(n == (ssize_t)size);
+}
+
+static void drain_events(int fd) {
+	char buf[4096];
+	while (read(fd, buf, sizeof(buf)) > 0) {
+		// Discard
+	}
+}
+
+static void dispatch(struct bench_server *server, int client_fd) {
+	wl_event_loop_dispatch(server->loop, 0);
+	wl_display_flush_clients(server->display);
+	drain_events(client_fd);
+}
+
+static void client_init(struct bench_server *server, int fd,
+		struct wl_client *client) {
+	write_request(fd, DISPLAY_ID, DISPLAY_GET_REGISTRY,
+		(uint32_t[]){ REGISTRY_ID }, 1);
+
+	// new_id without interface: name, interface string, version, id
+	uint32_t bind[] = {
+		wl_global_get_name(server->compositor->global, client),
+		sizeof("wl_compositor"),
+		0, 0, 0, 0, // "wl_compositor\0", padded to 16 bytes
+		6,
+		COMPOSITOR_ID,
+	};
+	memcpy(&bind[2], "wl_compositor", sizeof("wl_compositor"));
+	write_request(fd, REGISTRY_ID, REGISTRY_BIND,
+		bind, sizeof(bind) / sizeof(bind[0]));
+
+	write_request(fd, COMPOSITOR_ID, COMPOSITOR_CREATE_SURFACE,
+		(uint32_t[]){ SURFACE_ID }, 1);
+
+	dispatch(server, fd);
+	assert(server->surface != NULL);
+}
+
+static void unlock_oldest(struct bench_server *server) {
+	uint32_t seq = server->locks[0];
+	server->locks_len--;
+	memmove(&server->locks[0], &server->locks[1],
+		server->locks_len * sizeof(server->locks[0]));
+	wlr_surface_unlock_cached(server->surface, seq);
+}
+
+static void run(struct bench_server *server, int client_fd, size_t depth) {
+	int64_t start_ns = bench_get_time_ns();
+	for (int i = 0; i < N_COMMITS; i++) {
+		uint32_t damage[] = { i % 64, i % 32, 16, 16 };
+		write_request(client_fd, SURFACE_ID, SURFACE_DAMAGE, damage, 4);
+		write_request(client_fd, SURFACE_ID, SURFACE_COMMIT, NULL, 0);
+		dispatch(server, client_fd);
+
+		// Keep up to depth commits in flight
+		while (server->locks_len > depth) {
+			unlock_oldest(server);
+		}
+	}
+	while (server->locks_len > 0) {
+		unlock_oldest(server);
+	}
+	int64_t elapsed_ns = bench_get_time_ns() - start_ns;
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkCachedCommit/depth%zu", depth);
+	bench_result(name, N_COMMITS, (double)elapsed_ns / N_COMMITS);
+}
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	struct bench_server server = {0};
+	server.display = wl_display_create();
+	assert(server.display);
+	server.loop = wl_display_get_event_loop(server.display);
+	server.compositor = wlr_compositor_create(server.display, 6, NULL);
+	assert(server.compositor);
+	server.new_surface.notify = handle_new_surface;
+	wl_signal_add(&server.compositor->events.new_surface, &server.new_surface);
+
+	int fds[2];
+	int ret = socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds);
+	assert(ret == 0);
+	fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+
+	struct wl_client *client = wl_client_create(server.display, fds[0]);
+	assert(client);
+	client_init(&server, fds[1], client);
+
+	static const size_t depths[] = { 0, 1, 2, 4, 16 };
+	for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+		run(&server, fds[1], depths[i]);
+	}
+
+	wl_list_remove(&server.client_commit.link);
+	for (size_t i = 0; i < N_SYNCED; i++) {
+		wlr_surface_synced_finish(&server.synced[i].synced);
+	}
+	wl_list_remove(&server.new_surface.link);
+	wl_client_destroy(client);
+	close(fds[1]);
+	wl_display_destroy(server.display);
+	return 0;
+}
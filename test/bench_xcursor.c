@@ -0,0 +1,252 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include <wlr/xcursor.h>
+#include "xcursor/xcursor.h"
+#include "bench.h"
+
+#define N_CURSORS  128
+// Every this many cursors is animated
+#define ANIMATED_EVERY 8
+#define N_FRAMES   12
+#define TARGET_NS  200000000
+#define MIN_ITER   5
+
+/**
+ * Loads a cursor theme like a compositor does at startup, then looks up the
+ * handful of cursors it actually shows. The theme is generated in a temporary
+ * directory, with cursor files holding the usual nominal sizes.
+ *
+ * Decoding all cursor files of the theme is also measured on its own, reading
+ * them with stdio and from memory mappings.
+ */
+
+static const uint32_t nominal_sizes[] = { 24, 32, 48, 64, 96 };
+
+static const char *shown_cursors[] = {
+	"default", "text", "pointer", "se-resize",
+};
+
+static char theme_dir[256];
+
+static void write_u32(FILE *f, uint32_t u) {
+	uint8_t bytes[4] = { u, u >> 8, u >> 16, u >> 24 };
+	size_t n = fwrite(bytes, 1, sizeof(bytes), f);
+	assert(n == sizeof(bytes));
+}
+
+static void write_cursor_file(const char *path, int n_frames) {
+	FILE *f = fopen(path, "w");
+	assert(f);
+
+	size_t n_sizes = sizeof(nominal_sizes) / sizeof(nominal_sizes[0]);
+	uint32_t ntoc = n_sizes * n_frames;
+	uint32_t header_len = 4 * 4;
+	uint32_t position = header_len + ntoc * 3 * 4;
+
+	write_u32(f, 0x72756358); // magic
+	write_u32(f, header_len);
+	write_u32(f, 0x10000); // version
+	write_u32(f, ntoc);
+	for (size_t i = 0; i < n_sizes; i++) {
+		uint32_t size = nominal_sizes[i];
+		for (int j = 0; j < n_frames; j++) {
+			write_u32(f, 0xfffd0002); // image type
+			write_u32(f, size);
+			write_u32(f, position);
+			position += 9 * 4 + size * size * 4;
+		}
+	}
+
+	for (size_t i = 0; i < n_sizes; i++) {
+		uint32_t size = nominal_sizes[i];
+		for (int j = 0; j < n_frames; j++) {
+			write_u32(f, 9 * 4); // chunk header length
+			write_u32(f, 0xfffd0002);
+			write_u32(f, size);
+			write_u32(f, 1); // version
+			write_u32(f, size); // width
+			write_u32(f, size); // height
+			write_u32(f, size / 4); // hotspot
+			write_u32(f, size / 4);
+			write_u32(f, 50); // delay
+			for (uint32_t p = 0; p < size * size; p++) {
+				write_u32(f, 0xFF000000 | (p * 2654435761u >> 8));
+			}
+		}
+	}
+
+	fclose(f);
+}
+
+static char cursor_names[N_CURSORS][32];
+
+static void init_cursor_names(void) {
+	size_t n_shown = sizeof(shown_cursors) / sizeof(shown_cursors[0]);
+	for (int i = 0; i < N_CURSORS; i++) {
+		if ((size_t)i < n_shown) {
+			snprintf(cursor_names[i], sizeof(cursor_names[i]), "%s",
+				shown_cursors[i]);
+		} else {
+			snprintf(cursor_names[i], sizeof(cursor_names[i]), "cursor-%03d", i);
+		}
+	}
+}
+
+static void theme_path(char *buf, size_t size, const char *name) {
+	int n = snprintf(buf, size, "%s/bench/cursors/%s", theme_dir, name);
+	assert(n > 0 && (size_t)n < size);
+}
+
+static void create_theme(void) {
+	snprintf(theme_dir, sizeof(theme_dir), "%s/wlr-bench-xcursor-XXXXXX",
+		getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+	char *ret = mkdtemp(theme_dir);
+	assert(ret);
+
+	char path[512];
+	snprintf(path, sizeof(path), "%s/bench", theme_dir);
+	int err = mkdir(path, 0700);
+	assert(err == 0);
+	snprintf(path, sizeof(path), "%s/bench/cursors", theme_dir);
+	err = mkdir(path, 0700);
+	assert(err == 0);
+
+	for (int i = 0; i < N_CURSORS; i++) {
+		theme_path(path, sizeof(path), cursor_names[i]);
+		write_cursor_file(path, i % ANIMATED_EVERY == 0 ? N_FRAMES : 1);
+	}
+
+	setenv("XCURSOR_PATH", theme_dir, 1);
+}
+
+static void remove_theme(void) {
+	char path[512];
+	for (int i = 0; i < N_CURSORS; i++) {
+		theme_path(path, sizeof(path), cursor_names[i]);
+		unlink(path);
+	}
+	snprintf(path, sizeof(path), "%s/bench/cursors", theme_dir);
+	rmdir(path);
+	snprintf(path, sizeof(path), "%s/bench", theme_dir);
+	rmdir(path);
+	rmdir(theme_dir);
+}
+
+static void run_load(bool lazy, int size) {
+	size_t n_shown = sizeof(shown_cursors) / sizeof(shown_cursors[0]);
+
+	struct bench_loop loop;
+	bench_loop_start(&loop, TARGET_NS, MIN_ITER);
+	do {
+		struct wlr_xcursor_theme *theme = lazy ?
+			wlr_xcursor_theme_load_lazy("bench", size) :
+			wlr_xcursor_theme_load("bench", size);
+		assert(theme);
+		for (size_t i = 0; i < n_shown; i++) {
+			struct wlr_xcursor *cursor =
+				wlr_xcursor_theme_get_cursor(theme, shown_cursors[i]);
+			assert(cursor && cursor->image_count > 0);
+		}
+		wlr_xcursor_theme_destroy(theme);
+	} while (bench_loop_next(&loop));
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkXcursorThemeLoad/%s/size%d",
+		lazy ? "lazy" : "eager", size);
+	bench_result(name, loop.iters, (double)loop.elapsed_ns / loop.iters);
+}
+
+struct decode_data {
+	bool mmap;
+	int size;
+	int images;
+};
+
+static void decode_file_callback(const char *name, const char *path,
+		void *data) {
+	struct decode_data *decode = data;
+	struct xcursor_images *images = decode->mmap ?
+		xcursor_load_file(path, name, decode->size) :
+		xcursor_load_file_stdio(path, name, decode->size);
+	assert(images);
+	decode->images += images->nimage;
+	xcursor_images_destroy(images);
+}
+
+static void run_decode(bool mmap, int size) {
+	struct bench_loop loop;
+	bench_loop_start(&loop, TARGET_NS, MIN_ITER);
+	do {
+		struct decode_data decode = { .mmap = mmap, .size = size };
+		xcursor_scan_theme("bench", decode_file_callback, &decode);
+		assert(decode.images >= N_CURSORS);
+	} while (bench_loop_next(&loop));
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkXcursorDecode/%s/size%d",
+		mmap ? "mmap" : "stdio", size);
+	bench_result(name, loop.iters, (double)loop.elapsed_ns / loop.iters);
+}
+
+static void run_get_cursor(bool lazy) {
+	struct wlr_xcursor_theme *theme = lazy ?
+		wlr_xcursor_theme_load_lazy("bench", 24) :
+		wlr_xcursor_theme_load("bench", 24);
+	assert(theme);
+
+	// Warm up lazily loaded cursors
+	for (int i = 0; i < N_CURSORS; i++) {
+		struct wlr_xcursor *cursor =
+			wlr_xcursor_theme_get_cursor(theme, cursor_names[i]);
+		assert(cursor);
+	}
+
+	size_t lookups = 0;
+	struct bench_loop loop;
+	bench_loop_start(&loop, TARGET_NS, 1);
+	do {
+		for (int i = 0; i < N_CURSORS; i++) {
+			int j = (i * 37) % N_CURSORS;
+			struct wlr_xcursor *cursor =
+				wlr_xcursor_theme_get_cursor(theme, cursor_names[j]);
+			assert(cursor);
+		}
+		lookups += N_CURSORS;
+	} while (bench_loop_next(&loop));
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkXcursorGetCursor/%s",
+		lazy ? "lazy" : "eager");
+	bench_result(name, lookups, (double)loop.elapsed_ns / lookups);
+
+	wlr_xcursor_theme_destroy(theme);
+}
+
+int main(void) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	init_cursor_names();
+	create_theme();
+
+	static const int sizes[] = { 24, 48 };
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		run_load(false, sizes[i]);
+		run_load(true, sizes[i]);
+	}
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		run_decode(false, sizes[i]);
+		run_decode(true, sizes[i]);
+	}
+	run_get_cursor(false);
+	run_get_cursor(true);
+
+	remove_theme();
+	return 0;
+}
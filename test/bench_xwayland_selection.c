@@ -0,0 +1,501 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_data_device.h>
+#include <wlr/types/wlr_seat.h>
+#include <wlr/util/log.h>
+#include <wlr/xwayland/xwayland.h>
+#include <xcb/xcb.h>
+#include "bench.h"
+
+#define PAYLOAD_SIZE (100 * 1024 * 1024)
+// Largest chunk written at once by the X11 client and the Wayland source
+#define PAYLOAD_CHUNK_SIZE (4 * 1024 * 1024)
+#define MIME_TYPE "text/plain;charset=utf-8"
+#define TIMEOUT_NS 60000000000
+
+/**
+ * Copies a 100 MB clipboard payload from an X11 client to the compositor,
+ * then from a Wayland data source to the X11 client. Both directions go
+ * through the INCR protocol. The X11 client writes chunks as large as the
+ * server accepts, like toolkits do.
+ */
+
+struct bench_server {
+	struct wl_display *display;
+	struct wl_event_loop *loop;
+	struct wlr_backend *backend;
+	struct wlr_renderer *renderer;
+	struct wlr_compositor *compositor;
+	struct wlr_seat *seat;
+	struct wlr_xwayland *xwayland;
+	atomic_bool ready;
+
+	struct wl_listener xwayland_ready;
+	struct wl_listener new_surface;
+	struct wl_listener request_set_selection;
+	struct wl_listener set_selection;
+
+	// X11 to Wayland, read by the compositor
+	int read_fd;
+	struct wl_event_source *read_source;
+	size_t received;
+	int64_t start_ns, x11_to_wayland_ns;
+	atomic_bool x11_to_wayland_done;
+
+	// Wayland to X11, read by the X11 client
+	struct wlr_data_source source;
+	pthread_t writer_thread;
+	int write_fd;
+	bool writer_started;
+	atomic_llong wayland_to_x11_ns;
+	atomic_bool wayland_to_x11_done;
+
+	pthread_t client_thread;
+	atomic_bool focused;
+};
+
+static char payload[PAYLOAD_CHUNK_SIZE];
+
+static xcb_atom_t intern_atom(xcb_connection_t *conn, const char *name) {
+	xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(conn,
+		xcb_intern_atom(conn, 0, strlen(name), name), NULL);
+	assert(reply);
+	xcb_atom_t atom = reply->atom;
+	free(reply);
+	return atom;
+}
+
+static xcb_generic_event_t *client_poll_event(xcb_connection_t *conn) {
+	xcb_generic_event_t *event = xcb_poll_for_event(conn);
+	if (event == NULL) {
+		struct pollfd pollfd = {
+			.fd = xcb_get_file_descriptor(conn),
+			.events = POLLIN,
+		};
+		poll(&pollfd, 1, 10);
+		event = xcb_poll_for_event(conn);
+	}
+	assert(!xcb_connection_has_error(conn));
+	return event;
+}
+
+static void client_send_selection_notify(xcb_connection_t *conn,
+		xcb_selection_request_event_t *req, xcb_atom_t property) {
+	xcb_selection_notify_event_t notify = {
+		.response_type = XCB_SELECTION_NOTIFY,
+		.time = req->time,
+		.requestor = req->requestor,
+		.selection = req->selection,
+		.target = req->target,
+		.property = property,
+	};
+	xcb_send_event(conn, 0, req->requestor, XCB_EVENT_MASK_NO_EVENT,
+		(const char *)&notify);
+	xcb_flush(conn);
+}
+
+/**
+ * Own the clipboard and send the payload to whoever asks for it, in
+ * increments.
+ */
+static void client_send_selection(struct bench_server *server,
+		xcb_connection_t *conn, xcb_window_t window) {
+	xcb_atom_t clipboard = intern_atom(conn, "CLIPBOARD");
+	xcb_atom_t targets = intern_atom(conn, "TARGETS");
+	xcb_atom_t utf8_string = intern_atom(conn, "UTF8_STRING");
+	xcb_atom_t incr = intern_atom(conn, "INCR");
+
+	size_t chunk_size = (size_t)xcb_get_maximum_request_length(conn) * 4 - 32;
+	if (chunk_size > PAYLOAD_CHUNK_SIZE) {
+		chunk_size = PAYLOAD_CHUNK_SIZE;
+	}
+
+	xcb_set_selection_owner(conn, window, clipboard, XCB_CURRENT_TIME);
+	xcb_flush(conn);
+
+	xcb_window_t requestor = XCB_WINDOW_NONE;
+	xcb_atom_t property = XCB_ATOM_NONE;
+	size_t sent = 0;
+	bool done = false;
+	while (!atomic_load(&server->x11_to_wayland_done)) {
+		xcb_generic_event_t *event = client_poll_event(conn);
+		if (event == NULL) {
+			continue;
+		}
+
+		switch (event->response_type & ~0x80) {
+		case XCB_SELECTION_REQUEST:;
+			xcb_selection_request_event_t *req =
+				(xcb_selection_request_event_t *)event;
+			if (req->target == targets) {
+				xcb_atom_t atoms[] = { targets, utf8_string };
+				xcb_change_property(conn, XCB_PROP_MODE_REPLACE,
+					req->requestor, req->property, XCB_ATOM_ATOM, 32,
+					2, atoms);
+				client_send_selection_notify(conn, req, req->property);
+			} else if (req->target == utf8_string && requestor == XCB_NONE) {
+				requestor = req->requestor;
+				property = req->property;
+				xcb_change_window_attributes(conn, requestor,
+					XCB_CW_EVENT_MASK,
+					(uint32_t[]){ XCB_EVENT_MASK_PROPERTY_CHANGE });
+				uint32_t size = PAYLOAD_SIZE;
+				xcb_change_property(conn, XCB_PROP_MODE_REPLACE, requestor,
+					property, incr, 32, 1, &size);
+				client_send_selection_notify(conn, req, property);
+			} else {
+				client_send_selection_notify(conn, req, XCB_ATOM_NONE);
+			}
+			break;
+		case XCB_PROPERTY_NOTIFY:;
+			xcb_property_notify_event_t *notify =
+				(xcb_property_notify_event_t *)event;
+			if (notify->window != requestor || notify->atom != property ||
+					notify->state != XCB_PROPERTY_DELETE || done) {
+				break;
+			}
+
+			// The requestor is ready for the next chunk, an empty one ends
+			// the transfer
+			size_t len = PAYLOAD_SIZE - sent;
+			if (len > chunk_size) {
+				len = chunk_size;
+			}
+			xcb_change_property(conn, XCB_PROP_MODE_REPLACE, requestor,
+				property, utf8_string, 8, len, payload);
+			xcb_flush(conn);
+			sent += len;
+			done = len == 0;
+			break;
+		}
+		free(event);
+	}
+}
+
+/**
+ * Wait for the compositor to take the clipboard over, then read it.
+ */
+static void client_receive_selection(struct bench_server *server,
+		xcb_connection_t *conn, xcb_window_t window) {
+	xcb_atom_t clipboard = intern_atom(conn, "CLIPBOARD");
+	xcb_atom_t utf8_string = intern_atom(conn, "UTF8_STRING");
+	xcb_atom_t incr = intern_atom(conn, "INCR");
+	xcb_atom_t property = intern_atom(conn, "WLR_BENCH_SELECTION");
+
+	while (true) {
+		xcb_get_selection_owner_reply_t *reply = xcb_get_selection_owner_reply(
+			conn, xcb_get_selection_owner(conn, clipboard), NULL);
+		assert(reply);
+		xcb_window_t owner = reply->owner;
+		free(reply);
+		if (owner != XCB_WINDOW_NONE && owner != window) {
+			break;
+		}
+		nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+	}
+
+	int64_t start_ns = bench_get_time_ns();
+	xcb_convert_selection(conn, window, clipboard, utf8_string, property,
+		XCB_CURRENT_TIME);
+	xcb_flush(conn);
+
+	size_t received = 0;
+	bool incr_started = false;
+	while (true) {
+		xcb_generic_event_t *event = client_poll_event(conn);
+		if (event == NULL) {
+			continue;
+		}
+
+		bool read = false;
+		switch (event->response_type & ~0x80) {
+		case XCB_SELECTION_NOTIFY:;
+			xcb_selection_notify_event_t *notify =
+				(xcb_selection_notify_event_t *)event;
+			assert(notify->property == property);
+			read = true;
+			break;
+		case XCB_PROPERTY_NOTIFY:;
+			xcb_property_notify_event_t *property_notify =
+				(xcb_property_notify_event_t *)event;
+			read = incr_started && property_notify->window == window &&
+				property_notify->atom == property &&
+				property_notify->state == XCB_PROPERTY_NEW_VALUE;
+			break;
+		}
+		free(event);
+		if (!read) {
+			continue;
+		}
+
+		// Deleting the property asks for the next chunk
+		xcb_get_property_reply_t *reply = xcb_get_property_reply(conn,
+			xcb_get_property(conn, 1, window, property,
+				XCB_GET_PROPERTY_TYPE_ANY, 0, UINT32_MAX / 4), NULL);
+		assert(reply);
+		assert(reply->bytes_after == 0);
+		int len = xcb_get_property_value_length(reply);
+		bool is_incr = reply->type == incr;
+		free(reply);
+
+		if (!incr_started && is_incr) {
+			incr_started = true;
+			continue;
+		}
+		received += len;
+		if (!incr_started || len == 0) {
+			break;
+		}
+	}
+
+	assert(received == PAYLOAD_SIZE);
+	atomic_store(&server->wayland_to_x11_ns, bench_get_time_ns() - start_ns);
+	atomic_store(&server->wayland_to_x11_done, true);
+}
+
+static void *client_run(void *data) {
+	struct bench_server *server = data;
+
+	xcb_connection_t *conn = xcb_connect(server->xwayland->display_name, NULL);
+	assert(!xcb_connection_has_error(conn));
+	xcb_screen_t *screen = xcb_setup_roots_iterator(xcb_get_setup(conn)).data;
+
+	xcb_window_t window = xcb_generate_id(conn);
+	xcb_create_window(conn, XCB_COPY_FROM_PARENT, window, screen->root,
+		0, 0, 100, 100, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+		XCB_CW_EVENT_MASK, (uint32_t[]){ XCB_EVENT_MASK_PROPERTY_CHANGE });
+	xcb_flush(conn);
+
+	// Clipboard access is only granted to focused clients
+	while (!atomic_load(&server->focused)) {
+		nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+	}
+
+	client_send_selection(server, conn, window);
+	client_receive_selection(server, conn, window);
+
+	xcb_destroy_window(conn, window);
+	xcb_disconnect(conn);
+	return NULL;
+}
+
+static int handle_read_fd(int fd, uint32_t mask, void *data) {
+	struct bench_server *server = data;
+
+	static char buf[PAYLOAD_CHUNK_SIZE];
+	ssize_t len = read(fd, buf, sizeof(buf));
+	assert(len >= 0);
+	server->received += len;
+	if (len > 0) {
+		return 0;
+	}
+
+	server->x11_to_wayland_ns = bench_get_time_ns() - server->start_ns;
+	assert(server->received == PAYLOAD_SIZE);
+	wl_event_source_remove(server->read_source);
+	server->read_source = NULL;
+	close(server->read_fd);
+	atomic_store(&server->x11_to_wayland_done, true);
+	return 0;
+}
+
+static void handle_set_selection(struct wl_listener *listener, void *data) {
+	struct bench_server *server =
+		wl_container_of(listener, server, set_selection);
+	struct wlr_data_source *source = server->seat->selection_source;
+	if (source == NULL || source == &server->source) {
+		return;
+	}
+
+	// The X11 client took the clipboard over
+	int fds[2];
+	int ret = pipe(fds);
+	assert(ret == 0);
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	server->read_fd = fds[0];
+	server->read_source = wl_event_loop_add_fd(server->loop, fds[0],
+		WL_EVENT_READABLE, handle_read_fd, server);
+	assert(server->read_source);
+
+	server->start_ns = bench_get_time_ns();
+	wlr_data_source_send(source, MIME_TYPE, fds[1]);
+}
+
+static void handle_request_set_selection(struct wl_listener *listener,
+		void *data) {
+	struct bench_server *server =
+		wl_container_of(listener, server, request_set_selection);
+	struct wlr_seat_request_set_selection_event *event = data;
+	wlr_seat_set_selection(server->seat, event->source, event->serial);
+}
+
+static void *writer_run(void *data) {
+	struct bench_server *server = data;
+
+	size_t written = 0;
+	while (written < PAYLOAD_SIZE) {
+		size_t len = PAYLOAD_SIZE - written;
+		if (len > sizeof(payload)) {
+			len = sizeof(payload);
+		}
+		ssize_t ret = write(server->write_fd, payload, len);
+		assert(ret > 0);
+		written += ret;
+	}
+
+	close(server->write_fd);
+	return NULL;
+}
+
+static void source_send(struct wlr_data_source *source, const char *mime_type,
+		int32_t fd) {
+	struct bench_server *server = wl_container_of(source, server, source);
+	assert(strcmp(mime_type, MIME_TYPE) == 0);
+	assert(!server->writer_started);
+
+	// Write from another thread, as a Wayland client would
+	fcntl(fd, F_SETFL, 0);
+	server->write_fd = fd;
+	int ret = pthread_create(&server->writer_thread, NULL, writer_run, server);
+	assert(ret == 0);
+	server->writer_started = true;
+}
+
+static void source_destroy(struct wlr_data_source *source) {
+	// Embedded in struct bench_server
+}
+
+static const struct wlr_data_source_impl source_impl = {
+	.send = source_send,
+	.destroy = source_destroy,
+};
+
+static void handle_new_surface(struct wl_listener *listener, void *data) {
+	struct bench_server *server = wl_container_of(listener, server, new_surface);
+	struct wlr_xwayland_surface *xsurface = data;
+	if (xsurface->override_redirect) {
+		return;
+	}
+
+	wlr_xwayland_surface_activate(xsurface, true);
+	atomic_store(&server->focused, true);
+}
+
+static void handle_xwayland_ready(struct wl_listener *listener, void *data) {
+	struct bench_server *server =
+		wl_container_of(listener, server, xwayland_ready);
+	wlr_xwayland_set_seat(server->xwayland, server->seat);
+	atomic_store(&server->ready, true);
+}
+
+static void dispatch_until(struct bench_server *server, atomic_bool *cond) {
+	int64_t start_ns = bench_get_time_ns();
+	while (!atomic_load(cond)) {
+		int ret = wl_event_loop_dispatch(server->loop, 10);
+		assert(ret >= 0);
+		wl_display_flush_clients(server->display);
+		assert(bench_get_time_ns() - start_ns < TIMEOUT_NS);
+	}
+}
+
+static void print_result(const char *direction, int64_t elapsed_ns) {
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkXwaylandSelection/%s", direction);
+	bench_result_begin(name, 1, elapsed_ns);
+	bench_result_metric(PAYLOAD_SIZE * 1e3 / elapsed_ns, "MB/s");
+	bench_result_end();
+}
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	// Set by the build to the Xwayland binary found at configure time
+	const char *xwayland_path = getenv("WLR_XWAYLAND");
+	if (xwayland_path == NULL || access(xwayland_path, X_OK) != 0) {
+		fprintf(stderr, "Xwayland not found, skipping\n");
+		return BENCH_EXIT_SKIP;
+	}
+
+	memset(payload, 'x', sizeof(payload));
+
+	struct bench_server server = {0};
+	server.display = wl_display_create();
+	assert(server.display);
+	server.loop = wl_display_get_event_loop(server.display);
+	server.backend = wlr_headless_backend_create(server.loop);
+	assert(server.backend);
+	server.renderer = wlr_renderer_autocreate(server.backend);
+	assert(server.renderer);
+	bool ok = wlr_renderer_init_wl_display(server.renderer, server.display);
+	assert(ok);
+	server.compositor = wlr_compositor_create(server.display, 6, server.renderer);
+	assert(server.compositor);
+	server.seat = wlr_seat_create(server.display, "seat0");
+	assert(server.seat);
+	server.request_set_selection.notify = handle_request_set_selection;
+	wl_signal_add(&server.seat->events.request_set_selection,
+		&server.request_set_selection);
+	server.set_selection.notify = handle_set_selection;
+	wl_signal_add(&server.seat->events.set_selection, &server.set_selection);
+	ok = wlr_backend_start(server.backend);
+	assert(ok);
+
+	server.xwayland = wlr_xwayland_create(server.display, server.compositor,
+		false);
+	assert(server.xwayland);
+	server.xwayland_ready.notify = handle_xwayland_ready;
+	wl_signal_add(&server.xwayland->events.ready, &server.xwayland_ready);
+	server.new_surface.notify = handle_new_surface;
+	wl_signal_add(&server.xwayland->events.new_surface, &server.new_surface);
+
+	dispatch_until(&server, &server.ready);
+
+	int ret = pthread_create(&server.client_thread, NULL, client_run, &server);
+	assert(ret == 0);
+
+	dispatch_until(&server, &server.x11_to_wayland_done);
+	print_result("x11-to-wayland", server.x11_to_wayland_ns);
+
+	wlr_data_source_init(&server.source, &source_impl);
+	char **mime_type_ptr =
+		wl_array_add(&server.source.mime_types, sizeof(*mime_type_ptr));
+	assert(mime_type_ptr);
+	*mime_type_ptr = strdup(MIME_TYPE);
+	wlr_seat_set_selection(server.seat, &server.source,
+		wl_display_next_serial(server.display));
+
+	dispatch_until(&server, &server.wayland_to_x11_done);
+	print_result("wayland-to-x11", atomic_load(&server.wayland_to_x11_ns));
+
+	pthread_join(server.client_thread, NULL);
+	if (server.writer_started) {
+		pthread_join(server.writer_thread, NULL);
+	}
+
+	wlr_seat_set_selection(server.seat, NULL, 0);
+	wl_list_remove(&server.xwayland_ready.link);
+	wl_list_remove(&server.new_surface.link);
+	wl_list_remove(&server.request_set_selection.link);
+	wl_list_remove(&server.set_selection.link);
+	wlr_xwayland_destroy(server.xwayland);
+	wl_display_destroy_clients(server.display);
+	wlr_backend_destroy(server.backend);
+	wlr_renderer_destroy(server.renderer);
+	wl_display_destroy(server.display);
+	return 0;
+}
@@ -0,0 +1,299 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/util/log.h>
+#include <wlr/xwayland/xwayland.h>
+#include <xcb/xcb.h>
+#include "bench.h"
+
+#define MAX_WINDOWS 4096
+#define N_EVENTS    20000
+#define N_RESTACKS  20000
+// Restacks done by the compositor per event loop iteration
+#define RESTACKS_PER_ITER 16
+#define TIMEOUT_NS  60000000000
+
+/**
+ * An X11 client creates many top-level windows, as pid-per-window apps and
+ * tooltips do, then floods the window manager with configure requests on
+ * windows picked at random. Each request is looked up by window ID before
+ * being handed to the compositor. Only the time spent dispatching X11
+ * events is measured.
+ *
+ * The compositor then raises windows picked at random, a few times per event
+ * loop iteration, which updates _NET_CLIENT_LIST_STACKING.
+ */
+
+struct bench_surface {
+	struct bench_server *server;
+	struct wlr_xwayland_surface *xsurface;
+	int index; // in bench_server.surfaces_by_index
+	struct wl_listener request_configure;
+	struct wl_listener destroy;
+};
+
+struct bench_server {
+	struct wl_display *display;
+	struct wl_event_loop *loop;
+	struct wlr_backend *backend;
+	struct wlr_renderer *renderer;
+	struct wlr_compositor *compositor;
+	struct wlr_xwayland *xwayland;
+	bool ready;
+
+	struct wl_listener xwayland_ready;
+	struct wl_listener new_surface;
+
+	int n_windows, n_configures;
+	atomic_int surfaces;
+	struct bench_surface *surfaces_by_index[MAX_WINDOWS];
+	int configures;
+	atomic_bool done;
+};
+
+static void *client_run(void *data) {
+	struct bench_server *server = data;
+
+	xcb_connection_t *conn = xcb_connect(server->xwayland->display_name, NULL);
+	assert(!xcb_connection_has_error(conn));
+	xcb_screen_t *screen = xcb_setup_roots_iterator(xcb_get_setup(conn)).data;
+
+	static xcb_window_t windows[MAX_WINDOWS];
+	for (int i = 0; i < server->n_windows; i++) {
+		windows[i] = xcb_generate_id(conn);
+		xcb_create_window(conn, XCB_COPY_FROM_PARENT, windows[i], screen->root,
+			0, 0, 100, 100, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
+			screen->root_visual, 0, NULL);
+	}
+	xcb_flush(conn);
+
+	// Wait for the window manager to pick up all windows
+	while (atomic_load(&server->surfaces) < server->n_windows) {
+		nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+	}
+
+	unsigned int seed = 1;
+	for (int i = 0; i < server->n_configures; i++) {
+		xcb_window_t window = windows[rand_r(&seed) % server->n_windows];
+		uint32_t x = i % 1000;
+		xcb_configure_window(conn, window, XCB_CONFIG_WINDOW_X, &x);
+	}
+	xcb_flush(conn);
+
+	while (!atomic_load(&server->done)) {
+		nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+	}
+
+	xcb_disconnect(conn);
+	return NULL;
+}
+
+static void surface_handle_request_configure(struct wl_listener *listener,
+		void *data) {
+	struct bench_surface *surface =
+		wl_container_of(listener, surface, request_configure);
+	surface->server->configures++;
+}
+
+static void surface_handle_destroy(struct wl_listener *listener, void *data) {
+	struct bench_surface *surface = wl_container_of(listener, surface, destroy);
+	struct bench_server *server = surface->server;
+
+	int last = atomic_fetch_sub(&server->surfaces, 1) - 1;
+	server->surfaces_by_index[surface->index] = server->surfaces_by_index[last];
+	server->surfaces_by_index[surface->index]->index = surface->index;
+	wl_list_remove(&surface->request_configure.link);
+	wl_list_remove(&surface->destroy.link);
+	free(surface);
+}
+
+static void handle_new_surface(struct wl_listener *listener, void *data) {
+	struct bench_server *server = wl_container_of(listener, server, new_surface);
+	struct wlr_xwayland_surface *xsurface = data;
+
+	struct bench_surface *surface = calloc(1, sizeof(*surface));
+	assert(surface);
+	surface->server = server;
+	surface->xsurface = xsurface;
+	surface->request_configure.notify = surface_handle_request_configure;
+	wl_signal_add(&xsurface->events.request_configure,
+		&surface->request_configure);
+	surface->destroy.notify = surface_handle_destroy;
+	wl_signal_add(&xsurface->events.destroy, &surface->destroy);
+
+	surface->index = atomic_load(&server->surfaces);
+	assert(surface->index < MAX_WINDOWS);
+	server->surfaces_by_index[surface->index] = surface;
+	atomic_fetch_add(&server->surfaces, 1);
+}
+
+static void handle_xwayland_ready(struct wl_listener *listener, void *data) {
+	struct bench_server *server =
+		wl_container_of(listener, server, xwayland_ready);
+	server->ready = true;
+}
+
+static void dispatch_until(struct bench_server *server, bool *cond) {
+	int64_t start_ns = bench_get_time_ns();
+	while (!*cond) {
+		int ret = wl_event_loop_dispatch(server->loop, 10);
+		assert(ret >= 0);
+		wl_display_flush_clients(server->display);
+		assert(bench_get_time_ns() - start_ns < TIMEOUT_NS);
+	}
+}
+
+static void client_start(struct bench_server *server, pthread_t *thread,
+		int n_windows, int n_configures) {
+	server->n_windows = n_windows;
+	server->n_configures = n_configures;
+	atomic_store(&server->done, false);
+
+	int ret = pthread_create(thread, NULL, client_run, server);
+	assert(ret == 0);
+
+	int64_t start_ns = bench_get_time_ns();
+	while (atomic_load(&server->surfaces) < n_windows) {
+		ret = wl_event_loop_dispatch(server->loop, 10);
+		assert(ret >= 0);
+		assert(bench_get_time_ns() - start_ns < TIMEOUT_NS);
+	}
+}
+
+static void client_stop(struct bench_server *server, pthread_t thread) {
+	atomic_store(&server->done, true);
+	pthread_join(thread, NULL);
+
+	// Wait for the window manager to destroy the client's windows
+	int64_t start_ns = bench_get_time_ns();
+	while (atomic_load(&server->surfaces) > 0) {
+		int ret = wl_event_loop_dispatch(server->loop, 10);
+		assert(ret >= 0);
+		assert(bench_get_time_ns() - start_ns < TIMEOUT_NS);
+	}
+}
+
+static void run_configure(struct bench_server *server, int n_windows) {
+	server->configures = 0;
+
+	pthread_t thread;
+	client_start(server, &thread, n_windows, N_EVENTS);
+
+	// Only count dispatches which handled configure requests, so that
+	// waiting for the client isn't included
+	int64_t dispatch_ns = 0;
+	int64_t start_ns = bench_get_time_ns();
+	while (server->configures < N_EVENTS) {
+		int configures = server->configures;
+		int64_t dispatch_start_ns = bench_get_time_ns();
+		int ret = wl_event_loop_dispatch(server->loop, 0);
+		assert(ret >= 0);
+		if (server->configures != configures) {
+			dispatch_ns += bench_get_time_ns() - dispatch_start_ns;
+		}
+		assert(bench_get_time_ns() - start_ns < TIMEOUT_NS);
+	}
+
+	client_stop(server, thread);
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkXwmConfigureRequest/windows%d",
+		n_windows);
+	bench_result(name, N_EVENTS, (double)dispatch_ns / N_EVENTS);
+}
+
+static void run_restack(struct bench_server *server, int n_windows) {
+	pthread_t thread;
+	client_start(server, &thread, n_windows, 0);
+
+	// Put all windows in the stack first
+	for (int i = 0; i < n_windows; i++) {
+		wlr_xwayland_surface_restack(server->surfaces_by_index[i]->xsurface,
+			NULL, XCB_STACK_MODE_BELOW);
+	}
+	int ret = wl_event_loop_dispatch(server->loop, 0);
+	assert(ret >= 0);
+
+	unsigned int seed = 1;
+	int64_t start_ns = bench_get_time_ns();
+	for (int i = 0; i < N_RESTACKS; i++) {
+		struct bench_surface *surface =
+			server->surfaces_by_index[rand_r(&seed) % n_windows];
+		wlr_xwayland_surface_restack(surface->xsurface, NULL,
+			XCB_STACK_MODE_ABOVE);
+		if (i % RESTACKS_PER_ITER == RESTACKS_PER_ITER - 1) {
+			ret = wl_event_loop_dispatch(server->loop, 0);
+			assert(ret >= 0);
+		}
+	}
+	int64_t elapsed_ns = bench_get_time_ns() - start_ns;
+
+	client_stop(server, thread);
+
+	char name[64];
+	snprintf(name, sizeof(name), "BenchmarkXwmRestack/windows%d", n_windows);
+	bench_result(name, N_RESTACKS, (double)elapsed_ns / N_RESTACKS);
+}
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	// Set by the build to the Xwayland binary found at configure time
+	const char *xwayland_path = getenv("WLR_XWAYLAND");
+	if (xwayland_path == NULL || access(xwayland_path, X_OK) != 0) {
+		fprintf(stderr, "Xwayland not found, skipping\n");
+		return BENCH_EXIT_SKIP;
+	}
+
+	struct bench_server server = {0};
+	server.display = wl_display_create();
+	assert(server.display);
+	server.loop = wl_display_get_event_loop(server.display);
+	server.backend = wlr_headless_backend_create(server.loop);
+	assert(server.backend);
+	server.renderer = wlr_renderer_autocreate(server.backend);
+	assert(server.renderer);
+	bool ok = wlr_renderer_init_wl_display(server.renderer, server.display);
+	assert(ok);
+	server.compositor = wlr_compositor_create(server.display, 6, server.renderer);
+	assert(server.compositor);
+	ok = wlr_backend_start(server.backend);
+	assert(ok);
+
+	server.xwayland = wlr_xwayland_create(server.display, server.compositor,
+		false);
+	assert(server.xwayland);
+	server.xwayland_ready.notify = handle_xwayland_ready;
+	wl_signal_add(&server.xwayland->events.ready, &server.xwayland_ready);
+	server.new_surface.notify = handle_new_surface;
+	wl_signal_add(&server.xwayland->events.new_surface, &server.new_surface);
+	dispatch_until(&server, &server.ready);
+
+	static const int sizes[] = { 16, 256, 1024, 4096 };
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		run_configure(&server, sizes[i]);
+	}
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		run_restack(&server, sizes[i]);
+	}
+
+	wl_list_remove(&server.xwayland_ready.link);
+	wl_list_remove(&server.new_surface.link);
+	wlr_xwayland_destroy(server.xwayland);
+	wl_display_destroy_clients(server.display);
+	wlr_backend_destroy(server.backend);
+	wlr_renderer_destroy(server.renderer);
+	wl_display_destroy(server.display);
+	return 0;
+}
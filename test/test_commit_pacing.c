@@ -0,0 +1,266 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/render/pass.h>
+#include <wlr/types/wlr_commit_timing_v1.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_fifo_v1.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+#include "test_server.h"
+
+// Object IDs allocated by the fake client
+#define DISPLAY_ID        1
+#define REGISTRY_ID       2
+#define COMPOSITOR_ID     3
+#define FIFO_MANAGER_ID   4
+#define TIMING_MANAGER_ID 5
+#define SURFACE_ID        6
+#define FIFO_ID           7
+#define TIMER_ID          8
+
+// Request opcodes, see the protocol XML files
+#define DISPLAY_GET_REGISTRY      1
+#define REGISTRY_BIND             0
+#define COMPOSITOR_CREATE_SURFACE 0
+#define SURFACE_COMMIT            6
+#define FIFO_MANAGER_GET_FIFO     1
+#define FIFO_SET_BARRIER          0
+#define FIFO_WAIT_BARRIER         1
+#define TIMING_MANAGER_GET_TIMER  1
+#define TIMER_SET_TIMESTAMP       0
+
+#define TIMESTAMP_DELAY_NSEC 50000000
+
+struct pacing_server {
+	struct test_server base;
+	struct wlr_fifo_manager_v1 *fifo_manager;
+	struct wlr_commit_timing_manager_v1 *timing_manager;
+
+	struct wlr_output *output;
+	struct wlr_surface *surface;
+	struct wl_listener new_surface;
+	struct wl_listener output_frame;
+	struct wl_listener output_present;
+	struct wl_listener surface_commit;
+
+	// Number of output frames and presented output commits when each commit
+	// was applied, by sequence number
+	size_t frames, presents;
+	size_t frames_at_commit[16];
+	size_t presents_at_commit[16];
+
+	struct wl_client *client;
+	int client_fd;
+};
+
+static void handle_output_frame(struct wl_listener *listener, void *data) {
+	struct pacing_server *server = wl_container_of(listener, server, output_frame);
+	server->frames++;
+
+	// Repaint, like a compositor would
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	struct wlr_render_pass *pass =
+		wlr_output_begin_render_pass(server->output, &state, NULL);
+	assert(pass != NULL);
+	bool ok = wlr_render_pass_submit(pass);
+	assert(ok);
+	ok = wlr_output_commit_state(server->output, &state);
+	assert(ok);
+	wlr_output_state_finish(&state);
+}
+
+static void handle_output_present(struct wl_listener *listener, void *data) {
+	struct pacing_server *server = wl_container_of(listener, server, output_present);
+	server->presents++;
+}
+
+static void handle_surface_commit(struct wl_listener *listener, void *data) {
+	struct pacing_server *server =
+		wl_container_of(listener, server, surface_commit);
+	uint32_t seq = server->surface->current.seq;
+	assert(seq < sizeof(server->frames_at_commit) / sizeof(server->frames_at_commit[0]));
+	server->frames_at_commit[seq] = server->frames;
+	server->presents_at_commit[seq] = server->presents;
+}
+
+static void handle_new_surface(struct wl_listener *listener, void *data) {
+	struct pacing_server *server = wl_container_of(listener, server, new_surface);
+	server->surface = data;
+	server->surface_commit.notify = handle_surface_commit;
+	wl_signal_add(&server->surface->events.commit, &server->surface_commit);
+}
+
+static void write_request(struct pacing_server *server, uint32_t id,
+		uint16_t opcode, const uint32_t *args, size_t args_len) {
+	uint32_t msg[16];
+	assert(args_len + 2 <= sizeof(msg) / sizeof(msg[0]));
+	size_t size = (args_len + 2) * sizeof(uint32_t);
+	msg[0] = id;
+	msg[1] = (uint32_t)size << 16 | opcode;
+	if (args_len > 0) {
+		memcpy(&msg[2], args, args_len * sizeof(uint32_t));
+	}
+	ssize_t n = write(server->client_fd, msg, size);
+	assert(n == (ssize_t)size);
+}
+
+static void bind_global(struct pacing_server *server, struct wl_global *global,
+		const char *interface, uint32_t version, uint32_t id) {
+	// new_id without interface: name, interface string, version, id
+	uint32_t args[12] = {0};
+	size_t len = strlen(interface) + 1;
+	size_t words = (len + 3) / 4;
+	assert(words <= 8);
+	args[0] = wl_global_get_name(global, server->client);
+	args[1] = len;
+	memcpy(&args[2], interface, len);
+	args[2 + words] = version;
+	args[3 + words] = id;
+	write_request(server, REGISTRY_ID, REGISTRY_BIND, args, 4 + words);
+}
+
+static void dispatch(struct pacing_server *server) {
+	wl_event_loop_dispatch(server->base.loop, 0);
+	wl_display_flush_clients(server->base.display);
+
+	char buf[4096];
+	while (read(server->client_fd, buf, sizeof(buf)) > 0) {
+		// Discard events
+	}
+}
+
+static void dispatch_until_applied(struct pacing_server *server, uint32_t seq) {
+	int64_t start_nsec = test_get_time_nsec();
+	while (server->surface->current.seq != seq) {
+		wl_event_loop_dispatch(server->base.loop, 10);
+		assert(test_get_time_nsec() - start_nsec < 1000000000);
+	}
+}
+
+static void server_init(struct pacing_server *server) {
+	test_server_init(&server->base);
+
+	server->fifo_manager =
+		wlr_fifo_manager_v1_create(server->base.display, 1);
+	server->timing_manager =
+		wlr_commit_timing_manager_v1_create(server->base.display, 1);
+	assert(server->fifo_manager && server->timing_manager);
+
+	server->new_surface.notify = handle_new_surface;
+	wl_signal_add(&server->base.compositor->events.new_surface, &server->new_surface);
+
+	server->output = test_server_add_output(&server->base, 640, 480);
+	server->output_frame.notify = handle_output_frame;
+	wl_signal_add(&server->output->events.frame, &server->output_frame);
+	server->output_present.notify = handle_output_present;
+	wl_signal_add(&server->output->events.present, &server->output_present);
+
+	int fds[2];
+	int ret = socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds);
+	assert(ret == 0);
+	fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+	server->client = wl_client_create(server->base.display, fds[0]);
+	assert(server->client);
+	server->client_fd = fds[1];
+
+	write_request(server, DISPLAY_ID, DISPLAY_GET_REGISTRY,
+		(uint32_t[]){ REGISTRY_ID }, 1);
+	bind_global(server, server->base.compositor->global, "wl_compositor", 6,
+		COMPOSITOR_ID);
+	bind_global(server, server->fifo_manager->global, "wp_fifo_manager_v1", 1,
+		FIFO_MANAGER_ID);
+	bind_global(server, server->timing_manager->global,
+		"wp_commit_timing_manager_v1", 1, TIMING_MANAGER_ID);
+	write_request(server, COMPOSITOR_ID, COMPOSITOR_CREATE_SURFACE,
+		(uint32_t[]){ SURFACE_ID }, 1);
+	write_request(server, FIFO_MANAGER_ID, FIFO_MANAGER_GET_FIFO,
+		(uint32_t[]){ FIFO_ID, SURFACE_ID }, 2);
+	write_request(server, TIMING_MANAGER_ID, TIMING_MANAGER_GET_TIMER,
+		(uint32_t[]){ TIMER_ID, SURFACE_ID }, 2);
+	dispatch(server);
+	assert(server->surface != NULL);
+
+	wlr_surface_send_enter(server->surface, server->output);
+}
+
+static void server_finish(struct pacing_server *server) {
+	wl_list_remove(&server->surface_commit.link);
+	wl_list_remove(&server->output_frame.link);
+	wl_list_remove(&server->output_present.link);
+	wl_client_destroy(server->client);
+	close(server->client_fd);
+	wl_list_remove(&server->new_surface.link);
+	test_server_finish(&server->base);
+}
+
+static void test_fifo_barrier(struct pacing_server *server) {
+	uint32_t first_seq = server->surface->pending.seq;
+	write_request(server, FIFO_ID, FIFO_SET_BARRIER, NULL, 0);
+	write_request(server, SURFACE_ID, SURFACE_COMMIT, NULL, 0);
+	write_request(server, FIFO_ID, FIFO_WAIT_BARRIER, NULL, 0);
+	write_request(server, SURFACE_ID, SURFACE_COMMIT, NULL, 0);
+	dispatch_until_applied(server, first_seq + 1);
+
+	// The first commit sets the barrier, the second one waits until an output
+	// commit made after the first one has been presented
+	assert(server->frames_at_commit[first_seq + 1] >
+		server->frames_at_commit[first_seq]);
+	assert(server->presents_at_commit[first_seq + 1] >
+		server->presents_at_commit[first_seq]);
+}
+
+static void test_fifo_no_barrier(struct pacing_server *server) {
+	// Waiting without a barrier set doesn't block
+	uint32_t seq = server->surface->pending.seq;
+	write_request(server, FIFO_ID, FIFO_WAIT_BARRIER, NULL, 0);
+	write_request(server, SURFACE_ID, SURFACE_COMMIT, NULL, 0);
+	dispatch(server);
+	assert(server->surface->current.seq == seq);
+}
+
+static void test_commit_timing(struct pacing_server *server) {
+	int64_t start_nsec = test_get_time_nsec();
+	int64_t target_nsec = start_nsec + TIMESTAMP_DELAY_NSEC;
+	uint64_t tv_sec = target_nsec / 1000000000;
+	uint32_t timestamp[] = {
+		tv_sec >> 32,
+		tv_sec & 0xFFFFFFFF,
+		target_nsec % 1000000000,
+	};
+	uint32_t seq = server->surface->pending.seq;
+	write_request(server, TIMER_ID, TIMER_SET_TIMESTAMP, timestamp, 3);
+	write_request(server, SURFACE_ID, SURFACE_COMMIT, NULL, 0);
+	dispatch(server);
+	assert(server->surface->current.seq != seq);
+
+	dispatch_until_applied(server, seq);
+
+	// Released for the refresh cycle covering the target time
+	int64_t refresh_nsec = 1000000000 / 60;
+	if (server->output->refresh > 0) {
+		refresh_nsec = (int64_t)1000000000000 / server->output->refresh;
+	}
+	assert(test_get_time_nsec() >= target_nsec - refresh_nsec);
+}
+
+int main(void) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	struct pacing_server server = {0};
+	server_init(&server);
+
+	test_fifo_barrier(&server);
+	test_fifo_no_barrier(&server);
+	test_commit_timing(&server);
+
+	server_finish(&server);
+	return 0;
+}
@@ -0,0 +1,381 @@
+#undef _POSIX_C_SOURCE
+#define _GNU_SOURCE // for memfd_create()
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_ext_foreign_toplevel_list_v1.h>
+#include <wlr/types/wlr_ext_image_capture_source_v1.h>
+#include <wlr/types/wlr_ext_image_copy_capture_v1.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_shm.h>
+#include <wlr/util/log.h>
+#include "ext-foreign-toplevel-list-v1-client-protocol.h"
+#include "ext-image-capture-source-v1-client-protocol.h"
+#include "ext-image-copy-capture-v1-client-protocol.h"
+
+#define NODE_SIZE   256
+#define BUFFER_SIZE 64
+
+/**
+ * A client captures a scene node, as it would capture a toplevel, into a shm
+ * buffer smaller than the node. Scene node sources aren't tied to an output:
+ * the scaled copy must not depend on one. The renderer is picked as usual, so
+ * running with WLR_RENDERER=gles2 or vulkan covers renderers which can't
+ * render to shared memory.
+ */
+
+struct test_client {
+	int fd;
+	atomic_bool done;
+
+	struct wl_display *display;
+	struct wl_shm *shm;
+	struct ext_foreign_toplevel_list_v1 *toplevel_list;
+	struct ext_foreign_toplevel_image_capture_source_manager_v1 *source_manager;
+	struct ext_image_copy_capture_manager_v1 *copy_manager;
+	struct ext_foreign_toplevel_handle_v1 *toplevel;
+
+	uint32_t width, height;
+	bool has_format;
+	bool frame_done;
+	uint32_t pixel;
+};
+
+static void toplevel_list_handle_toplevel(void *data,
+		struct ext_foreign_toplevel_list_v1 *list,
+		struct ext_foreign_toplevel_handle_v1 *toplevel) {
+	struct test_client *client = data;
+	client->toplevel = toplevel;
+}
+
+static void toplevel_list_handle_finished(void *data,
+		struct ext_foreign_toplevel_list_v1 *list) {
+	// This space is intentionally left blank
+}
+
+static const struct ext_foreign_toplevel_list_v1_listener toplevel_list_listener = {
+	.toplevel = toplevel_list_handle_toplevel,
+	.finished = toplevel_list_handle_finished,
+};
+
+static void registry_handle_global(void *data, struct wl_registry *registry,
+		uint32_t name, const char *interface, uint32_t version) {
+	struct test_client *client = data;
+	if (strcmp(interface, wl_shm_interface.name) == 0) {
+		client->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (strcmp(interface,
+			ext_foreign_toplevel_list_v1_interface.name) == 0) {
+		client->toplevel_list = wl_registry_bind(registry, name,
+			&ext_foreign_toplevel_list_v1_interface, 1);
+		ext_foreign_toplevel_list_v1_add_listener(client->toplevel_list,
+			&toplevel_list_listener, client);
+	} else if (strcmp(interface,
+			ext_foreign_toplevel_image_capture_source_manager_v1_interface.name) == 0) {
+		client->source_manager = wl_registry_bind(registry, name,
+			&ext_foreign_toplevel_image_capture_source_manager_v1_interface, 1);
+	} else if (strcmp(interface,
+			ext_image_copy_capture_manager_v1_interface.name) == 0) {
+		client->copy_manager = wl_registry_bind(registry, name,
+			&ext_image_copy_capture_manager_v1_interface, 1);
+	}
+}
+
+static void registry_handle_global_remove(void *data,
+		struct wl_registry *registry, uint32_t name) {
+	// This space is intentionally left blank
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_handle_global,
+	.global_remove = registry_handle_global_remove,
+};
+
+static void session_handle_buffer_size(void *data,
+		struct ext_image_copy_capture_session_v1 *session,
+		uint32_t width, uint32_t height) {
+	struct test_client *client = data;
+	client->width = width;
+	client->height = height;
+	client->has_format = false;
+}
+
+static void session_handle_shm_format(void *data,
+		struct ext_image_copy_capture_session_v1 *session, uint32_t format) {
+	struct test_client *client = data;
+	if (format == WL_SHM_FORMAT_XRGB8888) {
+		client->has_format = true;
+	}
+}
+
+static void session_handle_dmabuf_device(void *data,
+		struct ext_image_copy_capture_session_v1 *session,
+		struct wl_array *device) {
+	// This space is intentionally left blank
+}
+
+static void session_handle_dmabuf_format(void *data,
+		struct ext_image_copy_capture_session_v1 *session, uint32_t format,
+		struct wl_array *modifiers) {
+	// This space is intentionally left blank
+}
+
+static void session_handle_done(void *data,
+		struct ext_image_copy_capture_session_v1 *session) {
+	// This space is intentionally left blank
+}
+
+static void session_handle_stopped(void *data,
+		struct ext_image_copy_capture_session_v1 *session) {
+	fprintf(stderr, "Capture session stopped\n");
+	abort();
+}
+
+static const struct ext_image_copy_capture_session_v1_listener session_listener = {
+	.buffer_size = session_handle_buffer_size,
+	.shm_format = session_handle_shm_format,
+	.dmabuf_device = session_handle_dmabuf_device,
+	.dmabuf_format = session_handle_dmabuf_format,
+	.done = session_handle_done,
+	.stopped = session_handle_stopped,
+};
+
+static void frame_handle_transform(void *data,
+		struct ext_image_copy_capture_frame_v1 *frame, uint32_t transform) {
+	// This space is intentionally left blank
+}
+
+static void frame_handle_damage(void *data,
+		struct ext_image_copy_capture_frame_v1 *frame, int32_t x, int32_t y,
+		int32_t width, int32_t height) {
+	// This space is intentionally left blank
+}
+
+static void frame_handle_presentation_time(void *data,
+		struct ext_image_copy_capture_frame_v1 *frame, uint32_t tv_sec_hi,
+		uint32_t tv_sec_lo, uint32_t tv_nsec) {
+	// This space is intentionally left blank
+}
+
+static void frame_handle_ready(void *data,
+		struct ext_image_copy_capture_frame_v1 *frame) {
+	struct test_client *client = data;
+	client->frame_done = true;
+}
+
+static void frame_handle_failed(void *data,
+		struct ext_image_copy_capture_frame_v1 *frame, uint32_t reason) {
+	fprintf(stderr, "Failed to capture frame: %u\n", reason);
+	abort();
+}
+
+static const struct ext_image_copy_capture_frame_v1_listener frame_listener = {
+	.transform = frame_handle_transform,
+	.damage = frame_handle_damage,
+	.presentation_time = frame_handle_presentation_time,
+	.ready = frame_handle_ready,
+	.failed = frame_handle_failed,
+};
+
+static void *client_run(void *data) {
+	struct test_client *client = data;
+
+	client->display = wl_display_connect_to_fd(client->fd);
+	assert(client->display);
+
+	struct wl_registry *registry = wl_display_get_registry(client->display);
+	wl_registry_add_listener(registry, &registry_listener, client);
+	wl_display_roundtrip(client->display);
+	assert(client->shm && client->toplevel_list && client->source_manager &&
+		client->copy_manager);
+
+	// The toplevels are announced when the list is bound
+	wl_display_roundtrip(client->display);
+	assert(client->toplevel);
+
+	struct ext_image_capture_source_v1 *source =
+		ext_foreign_toplevel_image_capture_source_manager_v1_create_source(
+			client->source_manager, client->toplevel);
+	struct ext_image_copy_capture_session_v1 *session =
+		ext_image_copy_capture_manager_v1_create_session(client->copy_manager,
+			source, 0);
+	ext_image_copy_capture_session_v1_add_listener(session,
+		&session_listener, client);
+	// The compositor adjusts the constraints once the session is created
+	wl_display_roundtrip(client->display);
+	assert(client->has_format);
+	assert(client->width == BUFFER_SIZE && client->height == BUFFER_SIZE);
+
+	uint32_t stride = client->width * 4;
+	size_t size = (size_t)stride * client->height;
+	int fd = memfd_create("test-image-copy-capture", MFD_CLOEXEC);
+	assert(fd >= 0);
+	int ret = ftruncate(fd, size);
+	assert(ret == 0);
+	uint32_t *pixels = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	assert(pixels != MAP_FAILED);
+
+	struct wl_shm_pool *pool = wl_shm_create_pool(client->shm, fd, size);
+	struct wl_buffer *buffer = wl_shm_pool_create_buffer(pool, 0,
+		client->width, client->height, stride, WL_SHM_FORMAT_XRGB8888);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+
+	struct ext_image_copy_capture_frame_v1 *frame =
+		ext_image_copy_capture_session_v1_create_frame(session);
+	ext_image_copy_capture_frame_v1_add_listener(frame, &frame_listener,
+		client);
+	ext_image_copy_capture_frame_v1_attach_buffer(frame, buffer);
+	ext_image_copy_capture_frame_v1_damage_buffer(frame, 0, 0,
+		client->width, client->height);
+	ext_image_copy_capture_frame_v1_capture(frame);
+
+	while (!client->frame_done) {
+		ret = wl_display_dispatch(client->display);
+		assert(ret >= 0);
+	}
+	client->pixel = pixels[(client->height / 2) * client->width +
+		client->width / 2];
+	ext_image_copy_capture_frame_v1_destroy(frame);
+
+	wl_buffer_destroy(buffer);
+	munmap(pixels, size);
+	ext_image_copy_capture_session_v1_destroy(session);
+	ext_image_capture_source_v1_destroy(source);
+	ext_foreign_toplevel_handle_v1_destroy(client->toplevel);
+	ext_image_copy_capture_manager_v1_destroy(client->copy_manager);
+	ext_foreign_toplevel_image_capture_source_manager_v1_destroy(
+		client->source_manager);
+	ext_foreign_toplevel_list_v1_destroy(client->toplevel_list);
+	wl_shm_destroy(client->shm);
+	wl_registry_destroy(registry);
+	wl_display_disconnect(client->display);
+
+	atomic_store(&client->done, true);
+	return NULL;
+}
+
+struct test_server {
+	struct wl_event_loop *loop;
+	struct wlr_allocator *allocator;
+	struct wlr_renderer *renderer;
+	struct wlr_ext_image_capture_source_v1 *source;
+};
+
+static struct test_server server = {0};
+
+static void handle_capture_request(struct wl_listener *listener, void *data) {
+	struct wlr_ext_foreign_toplevel_image_capture_source_manager_v1_request_event *request =
+		data;
+	bool ok = wlr_ext_foreign_toplevel_image_capture_source_manager_v1_request_accept(
+		request, server.source);
+	assert(ok);
+}
+
+static void handle_new_session(struct wl_listener *listener, void *data) {
+	struct wlr_ext_image_copy_capture_session_v1 *session = data;
+	wlr_ext_image_copy_capture_session_v1_set_max_buffer_size(session,
+		BUFFER_SIZE, BUFFER_SIZE);
+}
+
+int main(void) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	struct wl_display *display = wl_display_create();
+	assert(display);
+	server.loop = wl_display_get_event_loop(display);
+
+	struct wlr_backend *backend = wlr_headless_backend_create(server.loop);
+	assert(backend);
+	server.renderer = wlr_renderer_autocreate(backend);
+	assert(server.renderer);
+	server.allocator = wlr_allocator_autocreate(backend, server.renderer);
+	assert(server.allocator);
+
+	wlr_shm_create_with_renderer(display, 1, server.renderer);
+	struct wlr_ext_foreign_toplevel_list_v1 *toplevel_list =
+		wlr_ext_foreign_toplevel_list_v1_create(display, 1);
+	assert(toplevel_list);
+	struct wlr_ext_foreign_toplevel_handle_v1 *toplevel =
+		wlr_ext_foreign_toplevel_handle_v1_create(toplevel_list,
+			&(struct wlr_ext_foreign_toplevel_handle_v1_state){
+				.title = "test",
+				.app_id = "test",
+			});
+	assert(toplevel);
+	struct wlr_ext_foreign_toplevel_image_capture_source_manager_v1 *source_manager =
+		wlr_ext_foreign_toplevel_image_capture_source_manager_v1_create(display, 1);
+	assert(source_manager);
+	struct wlr_ext_image_copy_capture_manager_v1 *copy_manager =
+		wlr_ext_image_copy_capture_manager_v1_create(display, 1);
+	assert(copy_manager);
+
+	struct wl_listener capture_request = { .notify = handle_capture_request };
+	wl_signal_add(&source_manager->events.capture_request, &capture_request);
+	struct wl_listener new_session = { .notify = handle_new_session };
+	wl_signal_add(&copy_manager->events.new_session, &new_session);
+
+	struct wlr_scene *scene = wlr_scene_create();
+	assert(scene);
+	struct wlr_scene_rect *rect = wlr_scene_rect_create(&scene->tree,
+		NODE_SIZE, NODE_SIZE, (float[4]){ 1, 0, 0, 1 });
+	assert(rect);
+	server.source = wlr_ext_image_capture_source_v1_create_with_scene_node(
+		&rect->node, server.loop, server.allocator, server.renderer);
+	assert(server.source);
+
+	int fds[2];
+	int ret = socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds);
+	assert(ret == 0);
+	struct wl_client *wl_client = wl_client_create(display, fds[0]);
+	assert(wl_client);
+
+	struct test_client client = { .fd = fds[1] };
+	pthread_t thread;
+	ret = pthread_create(&thread, NULL, client_run, &client);
+	assert(ret == 0);
+
+	for (int i = 0; !atomic_load(&client.done); i++) {
+		wl_display_flush_clients(display);
+		ret = wl_event_loop_dispatch(server.loop, 1);
+		assert(ret >= 0);
+
+		// Scene node sources only produce frames on damage. Moving the node
+		// doesn't change its contents: the source follows its extents.
+		wlr_scene_node_set_position(&rect->node, i % 2, 0);
+	}
+	wl_display_flush_clients(display);
+	pthread_join(thread, NULL);
+
+	if ((client.pixel & 0x00FFFFFF) != 0x00FF0000) {
+		fprintf(stderr, "Unexpected pixel 0x%08X in the scaled copy\n",
+			client.pixel);
+		return 1;
+	}
+
+	wl_list_remove(&capture_request.link);
+	wl_list_remove(&new_session.link);
+	wl_display_destroy_clients(display);
+	// Destroys the source as well
+	wlr_scene_node_destroy(&scene->tree.node);
+	wlr_ext_foreign_toplevel_handle_v1_destroy(toplevel);
+	wlr_backend_destroy(backend);
+	wlr_allocator_destroy(server.allocator);
+	wlr_renderer_destroy(server.renderer);
+	wl_display_destroy(display);
+	return 0;
+}
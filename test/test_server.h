@@ -0,0 +1,96 @@
+#ifndef TEST_TEST_SERVER_H
+#define TEST_TEST_SERVER_H
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_output.h>
+
+/*
+ * Fixture shared by tests which need a compositor: a display with a headless
+ * backend, a renderer, an allocator and a wl_compositor global.
+ */
+
+// Meson's exit code for skipped tests
+#define TEST_EXIT_SKIP 77
+
+struct test_server {
+	struct wl_display *display;
+	struct wl_event_loop *loop;
+	struct wlr_backend *backend;
+	struct wlr_renderer *renderer;
+	struct wlr_allocator *allocator;
+	struct wlr_compositor *compositor;
+};
+
+static inline int64_t test_get_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * Create the fixture and start the backend. Listeners for backend or
+ * compositor events can be added once this returns, there are no outputs or
+ * clients yet.
+ */
+static inline void test_server_init(struct test_server *server) {
+	server->display = wl_display_create();
+	assert(server->display);
+	server->loop = wl_display_get_event_loop(server->display);
+
+	server->backend = wlr_headless_backend_create(server->loop);
+	assert(server->backend);
+	server->renderer = wlr_renderer_autocreate(server->backend);
+	assert(server->renderer);
+	bool ok = wlr_renderer_init_wl_display(server->renderer, server->display);
+	assert(ok);
+	server->allocator = wlr_allocator_autocreate(server->backend, server->renderer);
+	assert(server->allocator);
+
+	server->compositor = wlr_compositor_create(server->display, 6, server->renderer);
+	assert(server->compositor);
+
+	ok = wlr_backend_start(server->backend);
+	assert(ok);
+}
+
+/**
+ * Add an enabled headless output which can be rendered to.
+ */
+static inline struct wlr_output *test_server_add_output(
+		struct test_server *server, int width, int height) {
+	struct wlr_output *output =
+		wlr_headless_add_output(server->backend, width, height);
+	assert(output);
+	bool ok = wlr_output_init_render(output, server->allocator, server->renderer);
+	assert(ok);
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_enabled(&state, true);
+	ok = wlr_output_commit_state(output, &state);
+	assert(ok);
+	wlr_output_state_finish(&state);
+	return output;
+}
+
+/**
+ * Destroy the remaining clients, then the fixture.
+ */
+static inline void test_server_finish(struct test_server *server) {
+	wl_display_destroy_clients(server->display);
+	wlr_backend_destroy(server->backend);
+	wlr_allocator_destroy(server->allocator);
+	wlr_renderer_destroy(server->renderer);
+	wl_display_destroy(server->display);
+}
+
+#endif
@@ -0,0 +1,205 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_seat.h>
+#include <wlr/util/log.h>
+#include <wlr/xwayland/xwayland.h>
+#include <xcb/xcb.h>
+#include "test_server.h"
+
+// The window manager indexes surfaces by window ID, the index grows once
+// there are more than 32 surfaces
+#define N_WINDOWS_FIRST 24
+#define N_WINDOWS 48
+// Unmapped while another window is mapped, after the first batch
+#define UNMAPPED_WINDOW 4
+#define TIMEOUT_NSEC 20000000000
+
+/**
+ * An X11 client maps windows one at a time and checks that _NET_CLIENT_LIST
+ * lists them in map order. It then unmaps a window and maps a new one at the
+ * same time, so that the window manager has to write the whole list again,
+ * and maps enough windows to grow the surface index of the window manager.
+ * Destroying the window manager with all of them mapped must not touch freed
+ * memory.
+ */
+
+struct client_list_server {
+	struct test_server base;
+	struct wlr_seat *seat;
+	struct wlr_xwayland *xwayland;
+
+	struct wl_listener xwayland_ready;
+
+	pthread_t client_thread;
+	bool client_started;
+	atomic_bool listed;
+	atomic_bool done;
+};
+
+static xcb_atom_t intern_atom(xcb_connection_t *conn, const char *name) {
+	xcb_intern_atom_cookie_t cookie =
+		xcb_intern_atom(conn, 0, strlen(name), name);
+	xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(conn, cookie, NULL);
+	assert(reply);
+	xcb_atom_t atom = reply->atom;
+	free(reply);
+	return atom;
+}
+
+static xcb_window_t map_window(xcb_connection_t *conn, xcb_screen_t *screen) {
+	xcb_window_t window = xcb_generate_id(conn);
+	// Xwayland only commits a buffer for windows with contents
+	uint32_t values[] = { screen->white_pixel };
+	xcb_create_window(conn, XCB_COPY_FROM_PARENT, window, screen->root,
+		0, 0, 10, 10, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
+		screen->root_visual, XCB_CW_BACK_PIXEL, values);
+	xcb_map_window(conn, window);
+	return window;
+}
+
+static bool client_list_equals(xcb_connection_t *conn, xcb_window_t root,
+		xcb_atom_t net_client_list, const xcb_window_t *expected, int n) {
+	xcb_get_property_cookie_t cookie = xcb_get_property(conn, 0, root,
+		net_client_list, XCB_ATOM_WINDOW, 0, 1024);
+	xcb_get_property_reply_t *reply =
+		xcb_get_property_reply(conn, cookie, NULL);
+	if (reply == NULL) {
+		return false;
+	}
+
+	const xcb_window_t *listed = xcb_get_property_value(reply);
+	int len = xcb_get_property_value_length(reply) / sizeof(*listed);
+	bool equal = len == n &&
+		memcmp(listed, expected, n * sizeof(*expected)) == 0;
+	free(reply);
+	return equal;
+}
+
+static void wait_client_list(xcb_connection_t *conn, xcb_window_t root,
+		xcb_atom_t net_client_list, const xcb_window_t *expected, int n) {
+	int64_t start_nsec = test_get_time_nsec();
+	while (!client_list_equals(conn, root, net_client_list, expected, n)) {
+		assert(test_get_time_nsec() - start_nsec < TIMEOUT_NSEC);
+		nanosleep(&(struct timespec){ .tv_nsec = 10000000 }, NULL);
+	}
+}
+
+static void *client_run(void *data) {
+	struct client_list_server *server = data;
+
+	xcb_connection_t *conn = xcb_connect(server->xwayland->display_name, NULL);
+	assert(!xcb_connection_has_error(conn));
+	xcb_screen_t *screen = xcb_setup_roots_iterator(xcb_get_setup(conn)).data;
+	xcb_window_t root = screen->root;
+	xcb_atom_t net_client_list = intern_atom(conn, "_NET_CLIENT_LIST");
+
+	// Windows are mapped one at a time, the order in which Xwayland
+	// associates them with their surfaces isn't defined otherwise
+	xcb_window_t windows[N_WINDOWS];
+	int n = 0;
+	while (n < N_WINDOWS_FIRST) {
+		windows[n] = map_window(conn, screen);
+		xcb_flush(conn);
+		n++;
+		wait_client_list(conn, root, net_client_list, windows, n);
+	}
+
+	// Mapping a window right after an unmap, before the window manager has
+	// written the whole list again: the new window must still come last
+	xcb_unmap_window(conn, windows[UNMAPPED_WINDOW]);
+	memmove(&windows[UNMAPPED_WINDOW], &windows[UNMAPPED_WINDOW + 1],
+		(n - UNMAPPED_WINDOW - 1) * sizeof(*windows));
+	windows[n - 1] = map_window(conn, screen);
+	xcb_flush(conn);
+	wait_client_list(conn, root, net_client_list, windows, n);
+
+	while (n < N_WINDOWS) {
+		windows[n] = map_window(conn, screen);
+		xcb_flush(conn);
+		n++;
+		wait_client_list(conn, root, net_client_list, windows, n);
+	}
+
+	// Keep the windows mapped until the window manager is destroyed
+	atomic_store(&server->listed, true);
+	while (!atomic_load(&server->done)) {
+		nanosleep(&(struct timespec){ .tv_nsec = 10000000 }, NULL);
+	}
+
+	xcb_disconnect(conn);
+	return NULL;
+}
+
+static void handle_xwayland_ready(struct wl_listener *listener, void *data) {
+	struct client_list_server *server =
+		wl_container_of(listener, server, xwayland_ready);
+	wlr_xwayland_set_seat(server->xwayland, server->seat);
+
+	int ret = pthread_create(&server->client_thread, NULL, client_run, server);
+	assert(ret == 0);
+	server->client_started = true;
+}
+
+static void server_init(struct client_list_server *server) {
+	test_server_init(&server->base);
+
+	server->seat = wlr_seat_create(server->base.display, "seat0");
+	assert(server->seat);
+	struct wlr_output *output =
+		test_server_add_output(&server->base, 640, 480);
+	wlr_output_create_global(output, server->base.display);
+
+	server->xwayland = wlr_xwayland_create(server->base.display,
+		server->base.compositor, false);
+	assert(server->xwayland);
+	server->xwayland_ready.notify = handle_xwayland_ready;
+	wl_signal_add(&server->xwayland->events.ready, &server->xwayland_ready);
+}
+
+static void server_finish(struct client_list_server *server) {
+	wl_list_remove(&server->xwayland_ready.link);
+	// Destroys the window manager while the windows are mapped
+	wlr_xwayland_destroy(server->xwayland);
+
+	atomic_store(&server->done, true);
+	if (server->client_started) {
+		pthread_join(server->client_thread, NULL);
+	}
+
+	test_server_finish(&server->base);
+}
+
+int main(void) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	// Set by the build to the Xwayland binary found at configure time
+	const char *xwayland_path = getenv("WLR_XWAYLAND");
+	if (xwayland_path == NULL || access(xwayland_path, X_OK) != 0) {
+		fprintf(stderr, "Xwayland not found, skipping\n");
+		return TEST_EXIT_SKIP;
+	}
+
+	struct client_list_server server = {0};
+	server_init(&server);
+
+	int64_t start_nsec = test_get_time_nsec();
+	while (!atomic_load(&server.listed)) {
+		wl_display_flush_clients(server.base.display);
+		int ret = wl_event_loop_dispatch(server.base.loop, 100);
+		assert(ret >= 0);
+		assert(test_get_time_nsec() - start_nsec < TIMEOUT_NSEC);
+	}
+
+	server_finish(&server);
+	return 0;
+}
@@ -0,0 +1,197 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_seat.h>
+#include <wlr/util/log.h>
+#include <wlr/xwayland/xwayland.h>
+#include <xcb/xcb.h>
+#include "test_server.h"
+
+#define N_TITLES 10000
+#define FINAL_TITLE "final"
+#define WM_CLASS "test\0Test"
+#define TIMEOUT_NSEC 20000000000
+
+/**
+ * An X11 client changes its title as fast as it can, then maps its window.
+ * The window manager must not fall behind: the last title is reported, and
+ * the properties of the window have been read by the time it's associated
+ * with its Wayland surface.
+ */
+
+struct properties_server {
+	struct test_server base;
+	struct wlr_seat *seat;
+	struct wlr_xwayland *xwayland;
+
+	struct wlr_xwayland_surface *xsurface;
+	bool has_final_title;
+	bool associated;
+
+	struct wl_listener xwayland_ready;
+	struct wl_listener new_surface;
+	struct wl_listener surface_set_title;
+	struct wl_listener surface_associate;
+	struct wl_listener surface_destroy;
+
+	pthread_t client_thread;
+	bool client_started;
+	atomic_bool done;
+};
+
+static void set_title(xcb_connection_t *conn, xcb_window_t window,
+		const char *title) {
+	xcb_change_property(conn, XCB_PROP_MODE_REPLACE, window,
+		XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8, strlen(title), title);
+}
+
+static void *client_run(void *data) {
+	struct properties_server *server = data;
+
+	xcb_connection_t *conn = xcb_connect(server->xwayland->display_name, NULL);
+	assert(!xcb_connection_has_error(conn));
+	xcb_screen_t *screen = xcb_setup_roots_iterator(xcb_get_setup(conn)).data;
+
+	xcb_window_t window = xcb_generate_id(conn);
+	xcb_create_window(conn, XCB_COPY_FROM_PARENT, window, screen->root,
+		0, 0, 100, 100, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+		0, NULL);
+	xcb_change_property(conn, XCB_PROP_MODE_REPLACE, window,
+		XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 8, sizeof(WM_CLASS), WM_CLASS);
+
+	for (int i = 0; i < N_TITLES; i++) {
+		char title[32];
+		snprintf(title, sizeof(title), "title %d", i);
+		set_title(conn, window, title);
+	}
+	set_title(conn, window, FINAL_TITLE);
+	xcb_map_window(conn, window);
+	xcb_flush(conn);
+
+	// The window manager may not have selected property events on the
+	// window before the first changes, repeat the last one until it's seen
+	while (!atomic_load(&server->done)) {
+		nanosleep(&(struct timespec){ .tv_nsec = 50000000 }, NULL);
+		set_title(conn, window, FINAL_TITLE);
+		xcb_flush(conn);
+	}
+
+	xcb_destroy_window(conn, window);
+	xcb_disconnect(conn);
+	return NULL;
+}
+
+static void handle_surface_set_title(struct wl_listener *listener, void *data) {
+	struct properties_server *server =
+		wl_container_of(listener, server, surface_set_title);
+	server->has_final_title = server->xsurface->title != NULL &&
+		strcmp(server->xsurface->title, FINAL_TITLE) == 0;
+}
+
+static void handle_surface_associate(struct wl_listener *listener, void *data) {
+	struct properties_server *server =
+		wl_container_of(listener, server, surface_associate);
+	struct wlr_xwayland_surface *xsurface = server->xsurface;
+
+	// Properties are read before the associate event
+	assert(xsurface->surface != NULL);
+	assert(xsurface->class != NULL && strcmp(xsurface->class, "Test") == 0);
+	assert(xsurface->title != NULL);
+	server->associated = true;
+}
+
+static void handle_surface_destroy(struct wl_listener *listener, void *data) {
+	struct properties_server *server =
+		wl_container_of(listener, server, surface_destroy);
+	wl_list_remove(&server->surface_set_title.link);
+	wl_list_remove(&server->surface_associate.link);
+	wl_list_remove(&server->surface_destroy.link);
+	server->xsurface = NULL;
+}
+
+static void handle_new_surface(struct wl_listener *listener, void *data) {
+	struct properties_server *server =
+		wl_container_of(listener, server, new_surface);
+	struct wlr_xwayland_surface *xsurface = data;
+	assert(server->xsurface == NULL);
+
+	server->xsurface = xsurface;
+	server->surface_set_title.notify = handle_surface_set_title;
+	wl_signal_add(&xsurface->events.set_title, &server->surface_set_title);
+	server->surface_associate.notify = handle_surface_associate;
+	wl_signal_add(&xsurface->events.associate, &server->surface_associate);
+	server->surface_destroy.notify = handle_surface_destroy;
+	wl_signal_add(&xsurface->events.destroy, &server->surface_destroy);
+}
+
+static void handle_xwayland_ready(struct wl_listener *listener, void *data) {
+	struct properties_server *server =
+		wl_container_of(listener, server, xwayland_ready);
+	wlr_xwayland_set_seat(server->xwayland, server->seat);
+
+	int ret = pthread_create(&server->client_thread, NULL, client_run, server);
+	assert(ret == 0);
+	server->client_started = true;
+}
+
+static void server_init(struct properties_server *server) {
+	test_server_init(&server->base);
+
+	server->seat = wlr_seat_create(server->base.display, "seat0");
+	assert(server->seat);
+	struct wlr_output *output = test_server_add_output(&server->base, 640, 480);
+	wlr_output_create_global(output, server->base.display);
+
+	server->xwayland = wlr_xwayland_create(server->base.display,
+		server->base.compositor, false);
+	assert(server->xwayland);
+	server->xwayland_ready.notify = handle_xwayland_ready;
+	wl_signal_add(&server->xwayland->events.ready, &server->xwayland_ready);
+	server->new_surface.notify = handle_new_surface;
+	wl_signal_add(&server->xwayland->events.new_surface, &server->new_surface);
+}
+
+static void server_finish(struct properties_server *server) {
+	atomic_store(&server->done, true);
+	if (server->client_started) {
+		pthread_join(server->client_thread, NULL);
+	}
+
+	wl_list_remove(&server->xwayland_ready.link);
+	wl_list_remove(&server->new_surface.link);
+	wlr_xwayland_destroy(server->xwayland);
+	test_server_finish(&server->base);
+}
+
+int main(void) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	// Set by the build to the Xwayland binary found at configure time
+	const char *xwayland_path = getenv("WLR_XWAYLAND");
+	if (xwayland_path == NULL || access(xwayland_path, X_OK) != 0) {
+		fprintf(stderr, "Xwayland not found, skipping\n");
+		return TEST_EXIT_SKIP;
+	}
+
+	struct properties_server server = {0};
+	server_init(&server);
+
+	int64_t start_nsec = test_get_time_nsec();
+	while (!server.has_final_title || !server.associated) {
+		wl_display_flush_clients(server.base.display);
+		int ret = wl_event_loop_dispatch(server.base.loop, 100);
+		assert(ret >= 0);
+		assert(test_get_time_nsec() - start_nsec < TIMEOUT_NSEC);
+	}
+
+	server_finish(&server);
+	return 0;
+}
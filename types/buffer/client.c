@@ -5,6 +5,9 @@
 #include <wlr/util/log.h>
 #include "types/wlr_buffer.h"
 
+// Upper bound on how long a deferred upload keeps the client's buffer locked
+#define CLIENT_BUFFER_UPLOAD_TIMEOUT_MS 50
+
 static const struct wlr_buffer_impl client_buffer_impl;
 
 struct wlr_client_buffer *wlr_client_buffer_get(struct wlr_buffer *wlr_buffer) {
@@ -22,58 +25,90 @@ static struct wlr_client_buffer *client_buffer_from_buffer(
 	return client_buffer;
 }
 
+static void client_buffer_release_upload(struct wlr_client_buffer *client_buffer) {
+	if (client_buffer->upload_buffer == NULL) {
+		return;
+	}
+
+	wlr_buffer_unlock(client_buffer->upload_buffer);
+	client_buffer->upload_buffer = NULL;
+	pixman_region32_clear(&client_buffer->upload_damage);
+	if (client_buffer->upload_timer != NULL) {
+		wl_event_source_timer_update(client_buffer->upload_timer, 0);
+	}
+}
+
 static void client_buffer_destroy(struct wlr_buffer *buffer) {
 	struct wlr_client_buffer *client_buffer = client_buffer_from_buffer(buffer);
 
 	wlr_buffer_finish(buffer);
 
+	client_buffer_release_upload(client_buffer);
+	if (client_buffer->upload_timer != NULL) {
+		wl_event_source_remove(client_buffer->upload_timer);
+	}
+	pixman_region32_fini(&client_buffer->upload_damage);
+
 	wl_list_remove(&client_buffer->source_destroy.link);
 	wl_list_remove(&client_buffer->renderer_destroy.link);
 	wlr_texture_destroy(client_buffer->texture);
 	free(client_buffer);
 }
 
+// Returns the buffer holding the most recent contents
+static struct wlr_buffer *client_buffer_get_contents(
+		struct wlr_client_buffer *client_buffer) {
+	if (client_buffer->upload_buffer != NULL) {
+		return client_buffer->upload_buffer;
+	}
+	return client_buffer->source;
+}
+
 static bool client_buffer_get_dmabuf(struct wlr_buffer *buffer,
 		struct wlr_dmabuf_attributes *attribs) {
 	struct wlr_client_buffer *client_buffer = client_buffer_from_buffer(buffer);
+	struct wlr_buffer *contents = client_buffer_get_contents(client_buffer);
 
-	if (client_buffer->source == NULL) {
+	if (contents == NULL) {
 		return false;
 	}
 
-	return wlr_buffer_get_dmabuf(client_buffer->source, attribs);
+	return wlr_buffer_get_dmabuf(contents, attribs);
 }
 
 static bool client_buffer_get_shm(struct wlr_buffer *buffer,
 		struct wlr_shm_attributes *attribs) {
 	struct wlr_client_buffer *client_buffer = client_buffer_from_buffer(buffer);
+	struct wlr_buffer *contents = client_buffer_get_contents(client_buffer);
 
-	if (client_buffer->source == NULL) {
+	if (contents == NULL) {
 		return false;
 	}
 
-	return wlr_buffer_get_shm(client_buffer->source, attribs);
+	return wlr_buffer_get_shm(contents, attribs);
 }
 
 static bool client_buffer_begin_data_ptr_access(struct wlr_buffer *buffer, uint32_t flags,
 		void **data, uint32_t *format, size_t *stride) {
 	struct wlr_client_buffer *client_buffer = client_buffer_from_buffer(buffer);
+	struct wlr_buffer *contents = client_buffer_get_contents(client_buffer);
 
-	if (client_buffer->source == NULL) {
+	if (contents == NULL) {
 		return false;
 	}
 
-	return wlr_buffer_begin_data_ptr_access(client_buffer->source, flags, data, format, stride);
+	return wlr_buffer_begin_data_ptr_access(contents, flags, data, format, stride);
 }
 
 static void client_buffer_end_data_ptr_access(struct wlr_buffer *buffer) {
 	struct wlr_client_buffer *client_buffer = client_buffer_from_buffer(buffer);
+	struct wlr_buffer *contents = client_buffer_get_contents(client_buffer);
 
-	if (client_buffer->source == NULL) {
+	if (contents == NULL) {
 		return;
 	}
 
-	wlr_buffer_end_data_ptr_access(client_buffer->source);
+	wlr_buffer_end_data_ptr_access(contents);
 }
 
 static const struct wlr_buffer_impl client_buffer_impl = {
@@ -100,30 +135,27 @@ static void client_buffer_handle_renderer_destroy(struct wl_listener *listener,
 	wl_list_remove(&client_buffer->renderer_destroy.link);
 	wl_list_init(&client_buffer->renderer_destroy.link);
 	client_buffer->texture = NULL;
+	client_buffer->renderer = NULL;
+	client_buffer_release_upload(client_buffer);
 }
 
-struct wlr_client_buffer *wlr_client_buffer_create(struct wlr_buffer *buffer,
-		struct wlr_renderer *renderer) {
-	struct wlr_texture *texture = wlr_texture_from_buffer(renderer, buffer);
-	if (texture == NULL) {
-		wlr_log(WLR_ERROR, "Failed to create texture");
-		return NULL;
-	}
-
+static struct wlr_client_buffer *client_buffer_create(struct wlr_buffer *buffer,
+		struct wlr_renderer *renderer, struct wlr_texture *texture) {
 	struct wlr_client_buffer *client_buffer = calloc(1, sizeof(*client_buffer));
 	if (client_buffer == NULL) {
-		wlr_texture_destroy(texture);
 		return NULL;
 	}
 	wlr_buffer_init(&client_buffer->base, &client_buffer_impl,
-		texture->width, texture->height);
+		buffer->width, buffer->height);
 	client_buffer->source = buffer;
 	client_buffer->texture = texture;
+	client_buffer->renderer = renderer;
+	pixman_region32_init(&client_buffer->upload_damage);
 
 	wl_signal_add(&buffer->events.destroy, &client_buffer->source_destroy);
 	client_buffer->source_destroy.notify = client_buffer_handle_source_destroy;
 
-	wl_signal_add(&texture->renderer->events.destroy, &client_buffer->renderer_destroy);
+	wl_signal_add(&renderer->events.destroy, &client_buffer->renderer_destroy);
 	client_buffer->renderer_destroy.notify = client_buffer_handle_renderer_destroy;
 
 	// Ensure the buffer will be released before being destroyed
@@ -133,13 +165,120 @@ struct wlr_client_buffer *wlr_client_buffer_create(struct wlr_buffer *buffer,
 	return client_buffer;
 }
 
+struct wlr_client_buffer *wlr_client_buffer_create(struct wlr_buffer *buffer,
+		struct wlr_renderer *renderer) {
+	struct wlr_texture *texture = wlr_texture_from_buffer(renderer, buffer);
+	if (texture == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create texture");
+		return NULL;
+	}
+
+	struct wlr_client_buffer *client_buffer =
+		client_buffer_create(buffer, texture->renderer, texture);
+	if (client_buffer == NULL) {
+		wlr_texture_destroy(texture);
+		return NULL;
+	}
+	return client_buffer;
+}
+
+static int client_buffer_handle_upload_timer(void *data) {
+	struct wlr_client_buffer *client_buffer = data;
+	// Nobody sampled the texture in time, don't keep the client waiting for
+	// its buffer to be released
+	wlr_client_buffer_get_texture(client_buffer);
+	return 0;
+}
+
+static void client_buffer_defer_upload(struct wlr_client_buffer *client_buffer,
+		struct wlr_buffer *next) {
+	wlr_buffer_lock(next);
+	if (client_buffer->upload_buffer != NULL) {
+		wlr_buffer_unlock(client_buffer->upload_buffer);
+	} else if (client_buffer->upload_timer != NULL) {
+		wl_event_source_timer_update(client_buffer->upload_timer,
+			CLIENT_BUFFER_UPLOAD_TIMEOUT_MS);
+	}
+	client_buffer->upload_buffer = next;
+}
+
+struct wlr_client_buffer *client_buffer_create_deferred(struct wlr_buffer *buffer,
+		struct wlr_renderer *renderer, struct wl_event_loop *loop) {
+	struct wlr_client_buffer *client_buffer =
+		client_buffer_create(buffer, renderer, NULL);
+	if (client_buffer == NULL) {
+		return NULL;
+	}
+
+	client_buffer->upload_timer = wl_event_loop_add_timer(loop,
+		client_buffer_handle_upload_timer, client_buffer);
+	if (client_buffer->upload_timer == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create upload timer");
+		wlr_buffer_unlock(&client_buffer->base);
+		return NULL;
+	}
+
+	client_buffer_defer_upload(client_buffer, buffer);
+	pixman_region32_union_rect(&client_buffer->upload_damage,
+		&client_buffer->upload_damage, 0, 0, buffer->width, buffer->height);
+
+	return client_buffer;
+}
+
+bool client_buffer_defer_damage(struct wlr_client_buffer *client_buffer,
+		struct wlr_buffer *next, const pixman_region32_t *damage) {
+	if (client_buffer->base.n_locks - client_buffer->n_ignore_locks > 1) {
+		// Someone else still has a reference to the buffer
+		return false;
+	}
+	if (client_buffer->renderer == NULL || client_buffer->upload_timer == NULL) {
+		return false;
+	}
+	if (client_buffer->texture == NULL && client_buffer->upload_buffer == NULL) {
+		// A previous upload failed
+		return false;
+	}
+	if (next->width != client_buffer->base.width ||
+			next->height != client_buffer->base.height) {
+		return false;
+	}
+
+	client_buffer_defer_upload(client_buffer, next);
+	pixman_region32_union(&client_buffer->upload_damage,
+		&client_buffer->upload_damage, damage);
+	return true;
+}
+
+struct wlr_texture *wlr_client_buffer_get_texture(
+		struct wlr_client_buffer *client_buffer) {
+	if (client_buffer->upload_buffer == NULL) {
+		return client_buffer->texture;
+	}
+
+	struct wlr_buffer *buffer = client_buffer->upload_buffer;
+	if (client_buffer->texture == NULL || !wlr_texture_update_from_buffer(
+			client_buffer->texture, buffer, &client_buffer->upload_damage)) {
+		struct wlr_texture *texture =
+			wlr_texture_from_buffer(client_buffer->renderer, buffer);
+		if (texture != NULL) {
+			wlr_texture_destroy(client_buffer->texture);
+			client_buffer->texture = texture;
+		} else {
+			wlr_log(WLR_ERROR, "Failed to create texture");
+		}
+	}
+
+	client_buffer_release_upload(client_buffer);
+	return client_buffer->texture;
+}
+
 bool wlr_client_buffer_apply_damage(struct wlr_client_buffer *client_buffer,
 		struct wlr_buffer *next, const pixman_region32_t *damage) {
 	if (client_buffer->base.n_locks - client_buffer->n_ignore_locks > 1) {
 		// Someone else still has a reference to the buffer
 		return false;
 	}
-	if (client_buffer->texture == NULL) {
+	if (wlr_client_buffer_get_texture(client_buffer) == NULL) {
 		return false;
 	}
 
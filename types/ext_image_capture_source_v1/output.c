@@ -8,6 +8,7 @@
 #include <wlr/types/wlr_output.h>
 #include <wlr/util/addon.h>
 #include "ext-image-capture-source-v1-protocol.h"
+#include "types/wlr_ext_image_copy_capture_v1.h"
 
 #define OUTPUT_IMAGE_SOURCE_MANAGER_V1_VERSION 1
 
@@ -85,11 +86,8 @@ static void output_source_copy_frame(struct wlr_ext_image_capture_source_v1 *bas
 	struct wlr_ext_output_image_capture_source_v1_frame_event *event =
 		wl_container_of(base_event, event, base);
 
-	if (wlr_ext_image_copy_capture_frame_v1_copy_buffer(frame,
-			event->buffer, source->output->renderer)) {
-		wlr_ext_image_copy_capture_frame_v1_ready(frame,
-			source->output->transform, &event->when);
-	}
+	image_copy_capture_frame_copy_output_and_ready(frame, source->output,
+		event->buffer, &event->when);
 }
 
 static struct wlr_ext_image_capture_source_v1_cursor *output_source_get_pointer_cursor(
@@ -286,16 +284,12 @@ static void output_cursor_source_copy_frame(struct wlr_ext_image_capture_source_
 		return;
 	}
 
-	if (!wlr_ext_image_copy_capture_frame_v1_copy_buffer(frame,
-			src_buffer, cursor_source->output->renderer)) {
-		return;
-	}
-
 	struct timespec now;
 	clock_gettime(CLOCK_MONOTONIC, &now);
 
-	wlr_ext_image_copy_capture_frame_v1_ready(frame,
-			cursor_source->output->transform, &now);
+	wlr_ext_image_copy_capture_frame_v1_copy_and_ready(frame, src_buffer,
+		cursor_source->output->renderer, cursor_source->output->transform,
+		&now);
 }
 
 static const struct wlr_ext_image_capture_source_v1_interface output_cursor_source_impl = {
@@ -148,11 +148,8 @@ static void source_copy_frame(struct wlr_ext_image_capture_source_v1 *base,
 	struct scene_node_source *source = wl_container_of(base, source, base);
 	struct scene_node_source_frame_event *event = wl_container_of(base_event, event, base);
 
-	if (wlr_ext_image_copy_capture_frame_v1_copy_buffer(frame,
-			event->buffer, source->output.renderer)) {
-		wlr_ext_image_copy_capture_frame_v1_ready(frame,
-			source->output.transform, &event->when);
-	}
+	wlr_ext_image_copy_capture_frame_v1_copy_and_ready(frame, event->buffer,
+		source->output.renderer, source->output.transform, &event->when);
 }
 
 static const struct wlr_ext_image_capture_source_v1_interface source_impl = {
@@ -0,0 +1,258 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <wlr/render/interface.h>
+#include <wlr/render/wlr_texture.h>
+#include <wlr/util/log.h>
+#include "types/wlr_output.h"
+
+/**
+ * A read-back of the buffer being committed, shared by the capture clients
+ * asking for the same region and format. Each client gets its own
+ * struct output_capture_readback_ref.
+ */
+struct output_capture_readback {
+	struct wlr_texture_readback *readback;
+	// wlr_output.capture.readbacks, empty once the commit event is over
+	struct wl_list link;
+	struct wl_list refs; // output_capture_readback_ref.link
+	size_t n_refs;
+};
+
+struct output_capture_readback_ref {
+	struct wlr_texture_readback base;
+	struct output_capture_readback *shared;
+	struct wl_list link; // output_capture_readback.refs
+};
+
+static const struct wlr_texture_readback_impl readback_ref_impl;
+
+void output_capture_end(struct wlr_output *output) {
+	// Read-backs in flight stay alive until all of their clients are done
+	struct output_capture_readback *shared, *tmp;
+	wl_list_for_each_safe(shared, tmp, &output->capture.readbacks, link) {
+		wl_list_remove(&shared->link);
+		wl_list_init(&shared->link);
+	}
+
+	wlr_texture_destroy(output->capture.texture);
+	output->capture.texture = NULL;
+	output->capture.buffer = NULL;
+}
+
+void output_capture_begin(struct wlr_output *output,
+		const struct wlr_output_state *state) {
+	// Commits from commit event listeners start over
+	output_capture_end(output);
+	if (state->committed & WLR_OUTPUT_STATE_BUFFER) {
+		output->capture.buffer = state->buffer;
+	}
+}
+
+struct wlr_texture *output_capture_acquire_texture(struct wlr_output *output,
+		struct wlr_buffer *buffer) {
+	struct wlr_output_capture_stats *stats = &output->capture.stats;
+	if (buffer != output->capture.buffer) {
+		struct wlr_texture *texture =
+			wlr_texture_from_buffer(output->renderer, buffer);
+		if (texture != NULL) {
+			stats->imports++;
+		}
+		return texture;
+	}
+
+	if (output->capture.texture != NULL) {
+		stats->imports_saved++;
+		return output->capture.texture;
+	}
+
+	output->capture.texture = wlr_texture_from_buffer(output->renderer, buffer);
+	if (output->capture.texture != NULL) {
+		stats->imports++;
+	}
+	return output->capture.texture;
+}
+
+void output_capture_release_texture(struct wlr_output *output,
+		struct wlr_texture *texture) {
+	if (texture != output->capture.texture) {
+		wlr_texture_destroy(texture);
+	}
+}
+
+static void readback_unref(struct output_capture_readback *shared) {
+	assert(shared->n_refs > 0);
+	shared->n_refs--;
+	if (shared->n_refs > 0) {
+		return;
+	}
+
+	wl_list_remove(&shared->link);
+	wlr_texture_readback_destroy(shared->readback);
+	free(shared);
+}
+
+static void readback_handle_ready(struct wlr_texture_readback *readback) {
+	// References are notified through their own copy of the fence, unless
+	// the renderer is going away
+	if (!readback->cancelled) {
+		return;
+	}
+
+	// Keep the shared read-back alive until all references are cancelled,
+	// then destroy it as required
+	struct output_capture_readback *shared = readback->data;
+	shared->n_refs++;
+	struct output_capture_readback_ref *ref, *tmp;
+	wl_list_for_each_safe(ref, tmp, &shared->refs, link) {
+		wlr_texture_readback_cancel(&ref->base);
+	}
+	readback_unref(shared);
+}
+
+static struct output_capture_readback *readback_find(struct wlr_output *output,
+		const struct wlr_texture_read_pixels_options *options,
+		const struct wlr_box *src_box) {
+	if (options->wait_timeline != NULL) {
+		return NULL;
+	}
+
+	struct output_capture_readback *shared;
+	wl_list_for_each(shared, &output->capture.readbacks, link) {
+		if (shared->readback->format == options->format &&
+				wlr_box_equal(&shared->readback->src_box, src_box)) {
+			return shared;
+		}
+	}
+	return NULL;
+}
+
+static struct output_capture_readback *readback_create(
+		struct wlr_output *output, struct wlr_buffer *buffer,
+		const struct wlr_texture_read_pixels_options *options) {
+	struct output_capture_readback *shared = calloc(1, sizeof(*shared));
+	if (shared == NULL) {
+		return NULL;
+	}
+	wl_list_init(&shared->refs);
+
+	struct wlr_texture *texture = output_capture_acquire_texture(output, buffer);
+	if (texture == NULL) {
+		free(shared);
+		return NULL;
+	}
+	shared->readback = wlr_texture_read_pixels_async(texture, options,
+		output->event_loop, readback_handle_ready, shared);
+	output_capture_release_texture(output, texture);
+	if (shared->readback == NULL) {
+		free(shared);
+		return NULL;
+	}
+
+	output->capture.stats.readbacks++;
+
+	if (buffer == output->capture.buffer && options->wait_timeline == NULL) {
+		wl_list_insert(&output->capture.readbacks, &shared->link);
+	} else {
+		wl_list_init(&shared->link);
+	}
+	return shared;
+}
+
+struct wlr_texture_readback *output_capture_read_pixels_async(
+		struct wlr_output *output, struct wlr_buffer *buffer,
+		const struct wlr_texture_read_pixels_options *options,
+		wlr_texture_readback_ready_callback callback, void *data) {
+	struct wlr_box src_box = options->src_box;
+	if (wlr_box_empty(&src_box)) {
+		src_box = (struct wlr_box){
+			.width = buffer->width,
+			.height = buffer->height,
+		};
+	}
+
+	struct output_capture_readback_ref *ref = calloc(1, sizeof(*ref));
+	if (ref == NULL) {
+		return NULL;
+	}
+
+	struct output_capture_readback *shared = NULL;
+	if (buffer == output->capture.buffer) {
+		shared = readback_find(output, options, &src_box);
+	}
+	if (shared != NULL) {
+		output->capture.stats.readbacks_saved++;
+	} else {
+		shared = readback_create(output, buffer, options);
+		if (shared == NULL) {
+			free(ref);
+			return NULL;
+		}
+	}
+
+	wlr_texture_readback_init(&ref->base, &readback_ref_impl,
+		shared->readback->format, &shared->readback->src_box);
+	ref->shared = shared;
+	shared->n_refs++;
+	wl_list_insert(&shared->refs, &ref->link);
+
+	// Each client waits on its own copy of the fence, so that its callback
+	// may destroy its reference without affecting the others
+	int fence_fd = -1;
+	if (shared->readback->fence_fd >= 0) {
+		fence_fd = fcntl(shared->readback->fence_fd, F_DUPFD_CLOEXEC, 0);
+		if (fence_fd < 0) {
+			wlr_log_errno(WLR_ERROR, "Failed to duplicate read-back fence FD");
+			wlr_texture_readback_destroy(&ref->base);
+			return NULL;
+		}
+	}
+	if (!wlr_texture_readback_start(&ref->base, fence_fd, output->event_loop,
+			callback, data)) {
+		return NULL;
+	}
+	return &ref->base;
+}
+
+static struct output_capture_readback_ref *readback_ref_from_readback(
+		struct wlr_texture_readback *readback) {
+	assert(readback->impl == &readback_ref_impl);
+	struct output_capture_readback_ref *ref = wl_container_of(readback, ref, base);
+	return ref;
+}
+
+static bool readback_ref_begin_data_ptr_access(
+		struct wlr_texture_readback *readback, const void **data,
+		uint32_t *stride) {
+	struct output_capture_readback_ref *ref =
+		readback_ref_from_readback(readback);
+	struct wlr_texture_readback *shared = ref->shared->readback;
+	return shared->impl->begin_data_ptr_access(shared, data, stride);
+}
+
+static void readback_ref_end_data_ptr_access(
+		struct wlr_texture_readback *readback) {
+	struct output_capture_readback_ref *ref =
+		readback_ref_from_readback(readback);
+	struct wlr_texture_readback *shared = ref->shared->readback;
+	shared->impl->end_data_ptr_access(shared);
+}
+
+static void readback_ref_destroy(struct wlr_texture_readback *readback) {
+	struct output_capture_readback_ref *ref =
+		readback_ref_from_readback(readback);
+	wl_list_remove(&ref->link);
+	readback_unref(ref->shared);
+	free(ref);
+}
+
+static const struct wlr_texture_readback_impl readback_ref_impl = {
+	.begin_data_ptr_access = readback_ref_begin_data_ptr_access,
+	.end_data_ptr_access = readback_ref_end_data_ptr_access,
+	.destroy = readback_ref_destroy,
+};
+
+void wlr_output_get_capture_stats(struct wlr_output *output,
+		struct wlr_output_capture_stats *stats) {
+	*stats = output->capture.stats;
+}
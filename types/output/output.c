@@ -366,6 +366,7 @@ void wlr_output_init(struct wlr_output *output, struct wlr_backend *backend,
 	wl_list_init(&output->cursors);
 	wl_list_init(&output->layers);
 	wl_list_init(&output->resources);
+	wl_list_init(&output->capture.readbacks);
 
 	wl_signal_init(&output->events.frame);
 	wl_signal_init(&output->events.damage);
@@ -801,7 +802,9 @@ void output_send_commit_event(struct wlr_output *output, const struct wlr_output
 		.when = now,
 		.state = state,
 	};
+	output_capture_begin(output, state);
 	wl_signal_emit_mutable(&output->events.commit, &event);
+	output_capture_end(output);
 }
 
 bool wlr_output_commit_state(struct wlr_output *output,
@@ -1013,6 +1016,14 @@ const struct wlr_drm_format_set *wlr_output_get_primary_formats(
 	return formats;
 }
 
+bool wlr_output_import_buffer(struct wlr_output *output,
+		struct wlr_buffer *buffer) {
+	if (!output->impl->import_buffer) {
+		return true;
+	}
+	return output->impl->import_buffer(output, buffer);
+}
+
 bool wlr_output_is_direct_scanout_allowed(struct wlr_output *output) {
 	if (output->attach_render_locks > 0) {
 		wlr_log(WLR_DEBUG, "Direct scan-out disabled by lock");
@@ -113,6 +113,13 @@ void wlr_scene_node_destroy(struct wlr_scene_node *node) {
 	if (node->type == WLR_SCENE_NODE_BUFFER) {
 		struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
 
+		struct wlr_scene_output *scene_output;
+		wl_list_for_each(scene_output, &scene->outputs, link) {
+			if (scene_output->scanout_candidate == scene_buffer) {
+				scene_output->scanout_candidate = NULL;
+			}
+		}
+
 		scene_buffer_set_buffer(scene_buffer, NULL);
 		scene_buffer_set_texture(scene_buffer, NULL);
 		pixman_region32_fini(&scene_buffer->opaque_region);
@@ -864,6 +871,31 @@ struct wlr_scene_buffer *wlr_scene_buffer_create(struct wlr_scene_tree *parent,
 	return scene_buffer;
 }
 
+/**
+ * If the buffer was picked for direct scan-out on an output in the last frame,
+ * let the backend import the new buffer now rather than in the middle of the
+ * next output commit.
+ */
+static void scene_buffer_import_for_scanout(struct wlr_scene_buffer *scene_buffer) {
+	struct wlr_scene *scene = scene_node_get_root(&scene_buffer->node);
+	if (scene_buffer->buffer == NULL || !scene->direct_scanout) {
+		return;
+	}
+
+	struct wlr_buffer *buffer = scene_buffer->buffer;
+	struct wlr_client_buffer *client_buffer = wlr_client_buffer_get(buffer);
+	if (client_buffer != NULL && client_buffer->source != NULL && client_buffer->source->n_locks > 0) {
+		buffer = client_buffer->source;
+	}
+
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		if (scene_output->scanout_candidate == scene_buffer) {
+			wlr_output_import_buffer(scene_output->output, buffer);
+		}
+	}
+}
+
 void wlr_scene_buffer_set_buffer_with_options(struct wlr_scene_buffer *scene_buffer,
 		struct wlr_buffer *buffer, const struct wlr_scene_buffer_set_buffer_options *options) {
 	const struct wlr_scene_buffer_set_buffer_options default_options = {0};
@@ -893,10 +925,12 @@ void wlr_scene_buffer_set_buffer_with_options(struct wlr_scene_buffer *scene_buf
 			scene_buffer->buffer_height != buffer->height;
 	}
 
+	bool buffer_changed = buffer != scene_buffer->buffer;
+
 	// If this is a buffer change, check if it's a single pixel buffer.
 	// Cache that so we can still apply rendering optimisations even when
 	// the original buffer has been freed after texture upload.
-	if (buffer != scene_buffer->buffer) {
+	if (buffer_changed) {
 		scene_buffer->is_single_pixel_buffer = false;
 		struct wlr_client_buffer *client_buffer = NULL;
 		if (buffer != NULL) {
@@ -920,6 +954,10 @@ void wlr_scene_buffer_set_buffer_with_options(struct wlr_scene_buffer *scene_buf
 	scene_buffer_set_wait_timeline(scene_buffer,
 		options->wait_timeline, options->wait_point);
 
+	if (buffer_changed) {
+		scene_buffer_import_for_scanout(scene_buffer);
+	}
+
 	if (update) {
 		scene_node_update(&scene_buffer->node, NULL);
 		// updating the node will already damage the whole node for us. Return
@@ -1165,7 +1203,7 @@ static struct wlr_texture *scene_buffer_get_texture(
 	struct wlr_client_buffer *client_buffer =
 		wlr_client_buffer_get(scene_buffer->buffer);
 	if (client_buffer != NULL) {
-		return client_buffer->texture;
+		return wlr_client_buffer_get_texture(client_buffer);
 	}
 
 	struct wlr_texture *texture =
@@ -2432,6 +2470,9 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 		scene_output->dmabuf_feedback_debounce++;
 	}
 
+	scene_output->scanout_candidate = scanout_result == SCANOUT_INELIGIBLE ?
+		NULL : wlr_scene_buffer_from_node(list_data[0].node);
+
 	bool scanout = scanout_result == SCANOUT_SUCCESS;
 	if (scene_output->prev_scanout != scanout) {
 		scene_output->prev_scanout = scanout;
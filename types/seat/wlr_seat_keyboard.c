@@ -122,10 +122,11 @@ void wlr_seat_set_keyboard(struct wlr_seat *seat,
 		return;
 	}
 
-	// send the keymap only if it has changed
+	// send the keymap only if it has changed. Keyboards with identical
+	// keymaps share the same keymap string and fd.
 	bool needs_keymap_update =
 		!seat->keyboard_state.keyboard || !keyboard ||
-		seat->keyboard_state.keyboard->keymap != keyboard->keymap;
+		seat->keyboard_state.keyboard->keymap_string != keyboard->keymap_string;
 
 	if (seat->keyboard_state.keyboard) {
 		wl_list_remove(&seat->keyboard_state.keyboard_destroy.link);
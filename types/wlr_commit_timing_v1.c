@@ -0,0 +1,305 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wlr/types/wlr_commit_timing_v1.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/addon.h>
+#include "commit-timing-v1-protocol.h"
+#include "types/wlr_compositor.h"
+#include "util/array.h"
+#include "util/time.h"
+
+#define COMMIT_TIMING_MANAGER_VERSION 1
+
+// Assumed refresh period when the output doesn't advertise one
+#define DEFAULT_REFRESH_NSEC (NSEC_PER_SEC / 60)
+
+struct wlr_commit_timer_v1_state {
+	bool has_timestamp;
+	int64_t timestamp_nsec;
+};
+
+struct wlr_commit_timer_v1_commit {
+	uint32_t seq;
+	int64_t timestamp_nsec;
+};
+
+struct wlr_commit_timer_v1 {
+	struct wl_resource *resource;
+	struct wlr_surface *surface;
+	struct wlr_addon addon;
+	struct wlr_surface_synced synced;
+	struct wlr_commit_timer_v1_state pending, current;
+
+	// Cached commits waiting for their target time, oldest first
+	struct wl_array waiting; // struct wlr_commit_timer_v1_commit
+
+	struct surface_frame_waiter frame_waiter;
+	struct wl_listener client_commit;
+};
+
+static const struct wp_commit_timer_v1_interface timer_impl;
+
+// Returns NULL if the wl_surface was destroyed
+static struct wlr_commit_timer_v1 *timer_from_resource(struct wl_resource *resource) {
+	assert(wl_resource_instance_of(resource, &wp_commit_timer_v1_interface,
+		&timer_impl));
+	return wl_resource_get_user_data(resource);
+}
+
+static int64_t get_current_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_to_nsec(&now);
+}
+
+static void timer_destroy(struct wlr_commit_timer_v1 *timer, bool release) {
+	if (timer == NULL) {
+		return;
+	}
+
+	wl_list_remove(&timer->client_commit.link);
+	surface_frame_waiter_finish(&timer->frame_waiter);
+	wlr_surface_synced_finish(&timer->synced);
+	wlr_addon_finish(&timer->addon);
+	wl_resource_set_user_data(timer->resource, NULL);
+
+	if (release) {
+		struct wlr_commit_timer_v1_commit *commit;
+		wl_array_for_each(commit, &timer->waiting) {
+			wlr_surface_unlock_cached(timer->surface, commit->seq);
+		}
+	}
+	wl_array_release(&timer->waiting);
+	free(timer);
+}
+
+static void timer_handle_resource_destroy(struct wl_resource *resource) {
+	struct wlr_commit_timer_v1 *timer = timer_from_resource(resource);
+	timer_destroy(timer, true);
+}
+
+static void timer_handle_destroy(struct wl_client *client,
+		struct wl_resource *resource) {
+	wl_resource_destroy(resource);
+}
+
+static void timer_handle_set_timestamp(struct wl_client *client,
+		struct wl_resource *resource, uint32_t tv_sec_hi, uint32_t tv_sec_lo,
+		uint32_t tv_nsec) {
+	struct wlr_commit_timer_v1 *timer = timer_from_resource(resource);
+	if (timer == NULL) {
+		wl_resource_post_error(resource,
+			WP_COMMIT_TIMER_V1_ERROR_SURFACE_DESTROYED,
+			"The wl_surface object has been destroyed");
+		return;
+	}
+
+	if (timer->pending.has_timestamp) {
+		wl_resource_post_error(resource,
+			WP_COMMIT_TIMER_V1_ERROR_TIMESTAMP_EXISTS,
+			"A timestamp has already been set for this commit");
+		return;
+	}
+	if (tv_nsec >= NSEC_PER_SEC) {
+		wl_resource_post_error(resource,
+			WP_COMMIT_TIMER_V1_ERROR_INVALID_TIMESTAMP,
+			"Invalid tv_nsec value: %" PRIu32, tv_nsec);
+		return;
+	}
+
+	uint64_t tv_sec = (uint64_t)tv_sec_hi << 32 | tv_sec_lo;
+	int64_t timestamp_nsec = INT64_MAX;
+	if (tv_sec < (uint64_t)(INT64_MAX / NSEC_PER_SEC)) {
+		timestamp_nsec = (int64_t)tv_sec * NSEC_PER_SEC + tv_nsec;
+	}
+
+	timer->pending.has_timestamp = true;
+	timer->pending.timestamp_nsec = timestamp_nsec;
+}
+
+static const struct wp_commit_timer_v1_interface timer_impl = {
+	.set_timestamp = timer_handle_set_timestamp,
+	.destroy = timer_handle_destroy,
+};
+
+static void timer_handle_frame(struct surface_frame_waiter *waiter,
+		struct wlr_output *output) {
+	struct wlr_commit_timer_v1 *timer =
+		wl_container_of(waiter, timer, frame_waiter);
+
+	// Content released now will be displayed at the next refresh. Without
+	// an output, there is no refresh to line up with.
+	int64_t deadline_nsec = get_current_time_nsec();
+	if (output != NULL) {
+		deadline_nsec += output->refresh > 0 ?
+			(int64_t)1000000000000 / output->refresh : DEFAULT_REFRESH_NSEC;
+	}
+
+	while (timer->waiting.size > 0) {
+		struct wlr_commit_timer_v1_commit *commit = timer->waiting.data;
+		if (commit->timestamp_nsec > deadline_nsec) {
+			break;
+		}
+		uint32_t seq = commit->seq;
+		array_remove_at(&timer->waiting, 0, sizeof(*commit));
+		wlr_surface_unlock_cached(timer->surface, seq);
+	}
+
+	if (timer->waiting.size > 0) {
+		surface_frame_waiter_arm(&timer->frame_waiter);
+	}
+}
+
+static void timer_handle_client_commit(struct wl_listener *listener, void *data) {
+	struct wlr_commit_timer_v1 *timer =
+		wl_container_of(listener, timer, client_commit);
+
+	if (!timer->pending.has_timestamp ||
+			timer->pending.timestamp_nsec <= get_current_time_nsec()) {
+		return;
+	}
+
+	struct wlr_commit_timer_v1_commit *commit =
+		wl_array_add(&timer->waiting, sizeof(*commit));
+	if (commit == NULL) {
+		wl_resource_post_no_memory(timer->resource);
+		return;
+	}
+	*commit = (struct wlr_commit_timer_v1_commit){
+		.seq = wlr_surface_lock_pending(timer->surface),
+		.timestamp_nsec = timer->pending.timestamp_nsec,
+	};
+
+	surface_frame_waiter_arm(&timer->frame_waiter);
+}
+
+static void surface_synced_move_state(void *_dst, void *_src) {
+	struct wlr_commit_timer_v1_state *dst = _dst, *src = _src;
+	*dst = *src;
+	*src = (struct wlr_commit_timer_v1_state){0};
+}
+
+static const struct wlr_surface_synced_impl surface_synced_impl = {
+	.state_size = sizeof(struct wlr_commit_timer_v1_state),
+	.move_state = surface_synced_move_state,
+};
+
+static void surface_addon_destroy(struct wlr_addon *addon) {
+	struct wlr_commit_timer_v1 *timer = wl_container_of(addon, timer, addon);
+	timer_destroy(timer, false);
+}
+
+static const struct wlr_addon_interface surface_addon_impl = {
+	.name = "wp_commit_timer_v1",
+	.destroy = surface_addon_destroy,
+};
+
+static void manager_handle_destroy(struct wl_client *client,
+		struct wl_resource *resource) {
+	wl_resource_destroy(resource);
+}
+
+static void manager_handle_get_timer(struct wl_client *client,
+		struct wl_resource *manager_resource, uint32_t id,
+		struct wl_resource *surface_resource) {
+	struct wlr_surface *surface = wlr_surface_from_resource(surface_resource);
+
+	if (wlr_addon_find(&surface->addons, NULL, &surface_addon_impl) != NULL) {
+		wl_resource_post_error(manager_resource,
+			WP_COMMIT_TIMING_MANAGER_V1_ERROR_COMMIT_TIMER_EXISTS,
+			"The wl_surface object already has a wp_commit_timer_v1 object");
+		return;
+	}
+
+	struct wlr_commit_timer_v1 *timer = calloc(1, sizeof(*timer));
+	if (timer == NULL) {
+		wl_resource_post_no_memory(manager_resource);
+		return;
+	}
+
+	if (!surface_frame_waiter_init(&timer->frame_waiter, surface,
+			timer_handle_frame)) {
+		goto error_timer;
+	}
+
+	if (!wlr_surface_synced_init(&timer->synced, surface,
+			&surface_synced_impl, &timer->pending, &timer->current)) {
+		goto error_frame_waiter;
+	}
+
+	uint32_t version = wl_resource_get_version(manager_resource);
+	timer->resource = wl_resource_create(client,
+		&wp_commit_timer_v1_interface, version, id);
+	if (timer->resource == NULL) {
+		goto error_synced;
+	}
+	wl_resource_set_implementation(timer->resource, &timer_impl,
+		timer, timer_handle_resource_destroy);
+
+	timer->surface = surface;
+	wl_array_init(&timer->waiting);
+
+	timer->client_commit.notify = timer_handle_client_commit;
+	wl_signal_add(&surface->events.client_commit, &timer->client_commit);
+
+	wlr_addon_init(&timer->addon, &surface->addons, NULL, &surface_addon_impl);
+	return;
+
+error_synced:
+	wlr_surface_synced_finish(&timer->synced);
+error_frame_waiter:
+	surface_frame_waiter_finish(&timer->frame_waiter);
+error_timer:
+	free(timer);
+	wl_resource_post_no_memory(manager_resource);
+}
+
+static const struct wp_commit_timing_manager_v1_interface manager_impl = {
+	.destroy = manager_handle_destroy,
+	.get_timer = manager_handle_get_timer,
+};
+
+static void manager_bind(struct wl_client *client, void *data,
+		uint32_t version, uint32_t id) {
+	struct wl_resource *resource = wl_resource_create(client,
+		&wp_commit_timing_manager_v1_interface, version, id);
+	if (resource == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(resource, &manager_impl, NULL, NULL);
+}
+
+static void handle_display_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_commit_timing_manager_v1 *manager =
+		wl_container_of(listener, manager, display_destroy);
+	wl_list_remove(&manager->display_destroy.link);
+	wl_global_destroy(manager->global);
+	free(manager);
+}
+
+struct wlr_commit_timing_manager_v1 *wlr_commit_timing_manager_v1_create(
+		struct wl_display *display, uint32_t version) {
+	assert(version <= COMMIT_TIMING_MANAGER_VERSION);
+
+	struct wlr_commit_timing_manager_v1 *manager = calloc(1, sizeof(*manager));
+	if (manager == NULL) {
+		return NULL;
+	}
+
+	manager->global = wl_global_create(display,
+		&wp_commit_timing_manager_v1_interface, version, NULL, manager_bind);
+	if (manager->global == NULL) {
+		free(manager);
+		return NULL;
+	}
+
+	manager->display_destroy.notify = handle_display_destroy;
+	wl_display_add_destroy_listener(display, &manager->display_destroy);
+
+	return manager;
+}
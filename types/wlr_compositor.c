@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wayland-server-core.h>
 #include <wlr/render/interface.h>
 #include <wlr/types/wlr_buffer.h>
@@ -11,6 +12,7 @@
 #include <wlr/util/region.h>
 #include <wlr/util/transform.h>
 #include "types/wlr_buffer.h"
+#include "types/wlr_compositor.h"
 #include "types/wlr_region.h"
 #include "types/wlr_subcompositor.h"
 #include "util/array.h"
@@ -19,6 +21,9 @@
 #define COMPOSITOR_VERSION 6
 #define CALLBACK_VERSION 1
 
+// Maximum number of released cached states kept per surface for reuse
+#define SURFACE_CACHED_POOL_SIZE 4
+
 static int min(int fst, int snd) {
 	if (fst < snd) {
 		return fst;
@@ -404,6 +409,16 @@ static void surface_state_move(struct wlr_surface_state *state,
 	next->cached_state_locks = 0;
 }
 
+static bool surface_can_defer_upload(struct wlr_surface *surface) {
+	if (!surface->compositor->deferred_upload ||
+			surface->compositor->renderer == NULL) {
+		return false;
+	}
+	// Only shared memory buffers need to be copied on upload
+	struct wlr_shm_attributes shm;
+	return wlr_buffer_get_shm(surface->current.buffer, &shm);
+}
+
 static void surface_apply_damage(struct wlr_surface *surface) {
 	if (surface->current.buffer == NULL) {
 		// NULL commit
@@ -417,9 +432,17 @@ static void surface_apply_damage(struct wlr_surface *surface) {
 
 	surface->opaque = wlr_buffer_is_opaque(surface->current.buffer);
 
+	bool defer = surface_can_defer_upload(surface);
 	if (surface->buffer != NULL) {
-		if (wlr_client_buffer_apply_damage(surface->buffer,
-				surface->current.buffer, &surface->buffer_damage)) {
+		bool applied;
+		if (defer) {
+			applied = client_buffer_defer_damage(surface->buffer,
+				surface->current.buffer, &surface->buffer_damage);
+		} else {
+			applied = wlr_client_buffer_apply_damage(surface->buffer,
+				surface->current.buffer, &surface->buffer_damage);
+		}
+		if (applied) {
 			wlr_buffer_unlock(surface->current.buffer);
 			surface->current.buffer = NULL;
 			return;
@@ -430,8 +453,17 @@ static void surface_apply_damage(struct wlr_surface *surface) {
 		return;
 	}
 
-	struct wlr_client_buffer *buffer = wlr_client_buffer_create(
-			surface->current.buffer, surface->compositor->renderer);
+	struct wlr_client_buffer *buffer;
+	if (defer) {
+		struct wl_client *client = wl_resource_get_client(surface->resource);
+		struct wl_event_loop *loop =
+			wl_display_get_event_loop(wl_client_get_display(client));
+		buffer = client_buffer_create_deferred(surface->current.buffer,
+			surface->compositor->renderer, loop);
+	} else {
+		buffer = wlr_client_buffer_create(surface->current.buffer,
+			surface->compositor->renderer);
+	}
 
 	if (buffer == NULL) {
 		wlr_log(WLR_ERROR, "Failed to upload buffer");
@@ -471,9 +503,16 @@ static void surface_update_input_region(struct wlr_surface *surface) {
 static bool surface_state_init(struct wlr_surface_state *state,
 	struct wlr_surface *surface);
 static void surface_state_finish(struct wlr_surface_state *state);
+static struct wlr_surface_state *surface_cached_pool_get(
+	struct wlr_surface *surface);
 
 static void surface_cache_pending(struct wlr_surface *surface) {
-	struct wlr_surface_state *cached = calloc(1, sizeof(*cached));
+	struct wlr_surface_state *cached = surface_cached_pool_get(surface);
+	if (cached != NULL) {
+		goto move;
+	}
+
+	cached = calloc(1, sizeof(*cached));
 	if (!cached) {
 		goto error;
 	}
@@ -492,6 +531,7 @@ static void surface_cache_pending(struct wlr_surface *surface) {
 		cached_synced[synced->index] = synced_state;
 	}
 
+move:
 	surface_state_move(cached, &surface->pending, surface);
 
 	wl_list_insert(surface->cached.prev, &cached->cached_state_link);
@@ -666,11 +706,15 @@ struct wlr_surface *wlr_surface_from_resource(struct wl_resource *resource) {
 	return wl_resource_get_user_data(resource);
 }
 
-static bool surface_state_init(struct wlr_surface_state *state,
-		struct wlr_surface *surface) {
+/**
+ * Initialize everything but the synced state array.
+ */
+static void surface_state_init_fields(struct wlr_surface_state *state,
+		struct wl_array *synced) {
 	*state = (struct wlr_surface_state){
 		.scale = 1,
 		.transform = WL_OUTPUT_TRANSFORM_NORMAL,
+		.synced = *synced,
 	};
 
 	wl_list_init(&state->subsurfaces_above);
@@ -683,13 +727,22 @@ static bool surface_state_init(struct wlr_surface_state *state,
 	pixman_region32_init(&state->opaque);
 	pixman_region32_init_rect(&state->input,
 		INT32_MIN, INT32_MIN, UINT32_MAX, UINT32_MAX);
+}
+
+static bool surface_state_init(struct wlr_surface_state *state,
+		struct wlr_surface *surface) {
+	struct wl_array synced;
+	wl_array_init(&synced);
+	surface_state_init_fields(state, &synced);
 
-	wl_array_init(&state->synced);
 	void *ptr = wl_array_add(&state->synced, surface->synced_len * sizeof(void *));
 	return ptr != NULL;
 }
 
-static void surface_state_finish(struct wlr_surface_state *state) {
+/**
+ * Finish everything but the synced state array.
+ */
+static void surface_state_finish_fields(struct wlr_surface_state *state) {
 	wlr_buffer_unlock(state->buffer);
 
 	struct wl_resource *resource, *tmp;
@@ -701,12 +754,89 @@ static void surface_state_finish(struct wlr_surface_state *state) {
 	pixman_region32_fini(&state->buffer_damage);
 	pixman_region32_fini(&state->opaque);
 	pixman_region32_fini(&state->input);
+}
 
+static void surface_state_finish(struct wlr_surface_state *state) {
+	surface_state_finish_fields(state);
 	wl_array_release(&state->synced);
 }
 
+/**
+ * Free a pooled cached state. Its synced states have already been finished.
+ */
+static void surface_cached_pool_free(struct wlr_surface_state *state) {
+	void **synced_state;
+	wl_array_for_each(synced_state, &state->synced) {
+		free(*synced_state);
+	}
+	wl_array_release(&state->synced);
+	wl_list_remove(&state->cached_state_link);
+	free(state);
+}
+
+/**
+ * Empty the cached state pool. Must be called whenever the set of synced
+ * objects changes, since pooled states have one synced state block per object.
+ */
+static void surface_cached_pool_drain(struct wlr_surface *surface) {
+	struct wlr_surface_state *state, *tmp;
+	wl_list_for_each_safe(state, tmp, &surface->cached_pool, cached_state_link) {
+		surface_cached_pool_free(state);
+	}
+	surface->cached_pool_len = 0;
+}
+
+/**
+ * Get a cached state from the pool, reusing its allocations. The synced
+ * states are re-initialized.
+ */
+static struct wlr_surface_state *surface_cached_pool_get(
+		struct wlr_surface *surface) {
+	if (wl_list_empty(&surface->cached_pool)) {
+		return NULL;
+	}
+
+	struct wlr_surface_state *state =
+		wl_container_of(surface->cached_pool.next, state, cached_state_link);
+	wl_list_remove(&state->cached_state_link);
+	surface->cached_pool_len--;
+
+	struct wl_array synced_states = state->synced;
+	surface_state_init_fields(state, &synced_states);
+
+	void **synced_data = state->synced.data;
+	struct wlr_surface_synced *synced;
+	wl_list_for_each(synced, &surface->synced, link) {
+		void *synced_state = synced_data[synced->index];
+		memset(synced_state, 0, synced->impl->state_size);
+		if (synced->impl->init_state) {
+			synced->impl->init_state(synced_state);
+		}
+	}
+
+	return state;
+}
+
 static void surface_state_destroy_cached(struct wlr_surface_state *state,
 		struct wlr_surface *surface) {
+	wl_list_remove(&state->cached_state_link);
+
+	if (surface->cached_pool_len < SURFACE_CACHED_POOL_SIZE) {
+		// Keep the allocations around for the next cached commit
+		void **synced_states = state->synced.data;
+		struct wlr_surface_synced *synced;
+		wl_list_for_each(synced, &surface->synced, link) {
+			if (synced->impl->finish_state) {
+				synced->impl->finish_state(synced_states[synced->index]);
+			}
+		}
+
+		surface_state_finish_fields(state);
+		wl_list_insert(&surface->cached_pool, &state->cached_state_link);
+		surface->cached_pool_len++;
+		return;
+	}
+
 	void **synced_states = state->synced.data;
 	struct wlr_surface_synced *synced;
 	wl_list_for_each(synced, &surface->synced, link) {
@@ -714,7 +844,6 @@ static void surface_state_destroy_cached(struct wlr_surface_state *state,
 	}
 
 	surface_state_finish(state);
-	wl_list_remove(&state->cached_state_link);
 	free(state);
 }
 
@@ -742,6 +871,7 @@ static void surface_handle_resource_destroy(struct wl_resource *resource) {
 	wl_list_for_each_safe(cached, cached_tmp, &surface->cached, cached_state_link) {
 		surface_state_destroy_cached(cached, surface);
 	}
+	surface_cached_pool_drain(surface);
 
 	wl_list_remove(&surface->role_resource_destroy.link);
 
@@ -799,6 +929,7 @@ static struct wlr_surface *surface_create(struct wl_client *client,
 
 	wl_list_init(&surface->current_outputs);
 	wl_list_init(&surface->cached);
+	wl_list_init(&surface->cached_pool);
 	pixman_region32_init(&surface->buffer_damage);
 	pixman_region32_init(&surface->opaque_region);
 	pixman_region32_init(&surface->input_region);
@@ -817,7 +948,7 @@ struct wlr_texture *wlr_surface_get_texture(struct wlr_surface *surface) {
 	if (surface->buffer == NULL) {
 		return NULL;
 	}
-	return surface->buffer->texture;
+	return wlr_client_buffer_get_texture(surface->buffer);
 }
 
 bool wlr_surface_has_buffer(struct wlr_surface *surface) {
@@ -1407,6 +1538,11 @@ void wlr_compositor_set_renderer(struct wlr_compositor *compositor,
 	}
 }
 
+void wlr_compositor_set_deferred_upload(struct wlr_compositor *compositor,
+		bool enabled) {
+	compositor->deferred_upload = enabled;
+}
+
 static bool surface_state_add_synced(struct wlr_surface_state *state, void *value) {
 	void **ptr = wl_array_add(&state->synced, sizeof(void *));
 	if (ptr == NULL) {
@@ -1440,6 +1576,8 @@ bool wlr_surface_synced_init(struct wlr_surface_synced *synced,
 		assert(synced != other);
 	}
 
+	surface_cached_pool_drain(surface);
+
 	memset(pending, 0, impl->state_size);
 	memset(current, 0, impl->state_size);
 	if (impl->init_state) {
@@ -1507,6 +1645,8 @@ void wlr_surface_synced_finish(struct wlr_surface_synced *synced) {
 	}
 	assert(found);
 
+	surface_cached_pool_drain(surface);
+
 	struct wlr_surface_state *cached;
 	wl_list_for_each(cached, &surface->cached, cached_state_link) {
 		surface_state_remove_and_destroy_synced(cached, synced);
@@ -1528,3 +1668,189 @@ void *wlr_surface_synced_get_state(struct wlr_surface_synced *synced,
 	void **synced_states = state->synced.data;
 	return synced_states[synced->index];
 }
+
+// Pace surfaces which aren't displayed on any output at roughly 60Hz
+#define SURFACE_FRAME_WAITER_FALLBACK_MS 16
+
+struct surface_frame_waiter_output {
+	struct surface_frame_waiter *waiter;
+	struct wl_list link; // surface_frame_waiter.outputs
+
+	// Only used when waiting for presentation
+	bool committed; // a buffer has been committed since arming
+	uint32_t commit_seq; // of that commit
+	bool idle_frame; // a frame event went by without a commit
+
+	struct wl_listener frame;
+	struct wl_listener commit;
+	struct wl_listener present;
+	struct wl_listener destroy;
+};
+
+static void surface_frame_waiter_output_destroy(
+		struct surface_frame_waiter_output *waiter_output) {
+	wl_list_remove(&waiter_output->frame.link);
+	wl_list_remove(&waiter_output->commit.link);
+	wl_list_remove(&waiter_output->present.link);
+	wl_list_remove(&waiter_output->destroy.link);
+	wl_list_remove(&waiter_output->link);
+	free(waiter_output);
+}
+
+static void surface_frame_waiter_fire(struct surface_frame_waiter *waiter,
+		struct wlr_output *output) {
+	surface_frame_waiter_disarm(waiter);
+	waiter->callback(waiter, output);
+}
+
+static void surface_frame_waiter_handle_output_frame(struct wl_listener *listener,
+		void *data) {
+	struct surface_frame_waiter_output *waiter_output =
+		wl_container_of(listener, waiter_output, frame);
+	struct wlr_output *output = data;
+	struct surface_frame_waiter *waiter = waiter_output->waiter;
+
+	if (!waiter->wait_present) {
+		surface_frame_waiter_fire(waiter, output);
+		return;
+	}
+
+	if (waiter_output->committed) {
+		return;
+	}
+	if (waiter_output->idle_frame) {
+		// Nothing was repainted for a whole refresh cycle, the surface state
+		// is already on screen
+		surface_frame_waiter_fire(waiter, output);
+		return;
+	}
+	waiter_output->idle_frame = true;
+	wlr_output_schedule_frame(output);
+}
+
+static void surface_frame_waiter_handle_output_commit(struct wl_listener *listener,
+		void *data) {
+	struct surface_frame_waiter_output *waiter_output =
+		wl_container_of(listener, waiter_output, commit);
+	const struct wlr_output_event_commit *event = data;
+	if (waiter_output->committed ||
+			!(event->state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		return;
+	}
+	waiter_output->committed = true;
+	waiter_output->commit_seq = event->output->commit_seq;
+}
+
+static void surface_frame_waiter_handle_output_present(struct wl_listener *listener,
+		void *data) {
+	struct surface_frame_waiter_output *waiter_output =
+		wl_container_of(listener, waiter_output, present);
+	const struct wlr_output_event_present *event = data;
+	// Ignore commits which were in flight when the waiter was armed
+	if (!waiter_output->committed ||
+			(int32_t)(event->commit_seq - waiter_output->commit_seq) < 0) {
+		return;
+	}
+	surface_frame_waiter_fire(waiter_output->waiter, event->output);
+}
+
+static void surface_frame_waiter_handle_output_destroy(struct wl_listener *listener,
+		void *data) {
+	struct surface_frame_waiter_output *waiter_output =
+		wl_container_of(listener, waiter_output, destroy);
+	struct surface_frame_waiter *waiter = waiter_output->waiter;
+	surface_frame_waiter_output_destroy(waiter_output);
+	if (wl_list_empty(&waiter->outputs)) {
+		wl_event_source_timer_update(waiter->timer,
+			SURFACE_FRAME_WAITER_FALLBACK_MS);
+	}
+}
+
+static int surface_frame_waiter_handle_timer(void *data) {
+	struct surface_frame_waiter *waiter = data;
+	surface_frame_waiter_fire(waiter, NULL);
+	return 0;
+}
+
+bool surface_frame_waiter_init(struct surface_frame_waiter *waiter,
+		struct wlr_surface *surface, surface_frame_waiter_func_t callback) {
+	struct wl_client *client = wl_resource_get_client(surface->resource);
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(wl_client_get_display(client));
+
+	*waiter = (struct surface_frame_waiter){
+		.surface = surface,
+		.callback = callback,
+	};
+	wl_list_init(&waiter->outputs);
+
+	waiter->timer = wl_event_loop_add_timer(loop,
+		surface_frame_waiter_handle_timer, waiter);
+	return waiter->timer != NULL;
+}
+
+void surface_frame_waiter_finish(struct surface_frame_waiter *waiter) {
+	surface_frame_waiter_disarm(waiter);
+	if (waiter->timer != NULL) {
+		wl_event_source_remove(waiter->timer);
+	}
+}
+
+static void surface_frame_waiter_arm_with_mode(struct surface_frame_waiter *waiter,
+		bool wait_present) {
+	if (waiter->armed) {
+		return;
+	}
+	waiter->armed = true;
+	waiter->wait_present = wait_present;
+
+	struct wlr_surface_output *surface_output;
+	wl_list_for_each(surface_output, &waiter->surface->current_outputs, link) {
+		struct surface_frame_waiter_output *waiter_output =
+			calloc(1, sizeof(*waiter_output));
+		if (waiter_output == NULL) {
+			continue;
+		}
+		waiter_output->waiter = waiter;
+		waiter_output->frame.notify = surface_frame_waiter_handle_output_frame;
+		wl_signal_add(&surface_output->output->events.frame, &waiter_output->frame);
+		if (wait_present) {
+			waiter_output->commit.notify = surface_frame_waiter_handle_output_commit;
+			wl_signal_add(&surface_output->output->events.commit, &waiter_output->commit);
+			waiter_output->present.notify = surface_frame_waiter_handle_output_present;
+			wl_signal_add(&surface_output->output->events.present, &waiter_output->present);
+		} else {
+			wl_list_init(&waiter_output->commit.link);
+			wl_list_init(&waiter_output->present.link);
+		}
+		waiter_output->destroy.notify = surface_frame_waiter_handle_output_destroy;
+		wl_signal_add(&surface_output->output->events.destroy, &waiter_output->destroy);
+		wl_list_insert(&waiter->outputs, &waiter_output->link);
+
+		wlr_output_schedule_frame(surface_output->output);
+	}
+
+	if (wl_list_empty(&waiter->outputs)) {
+		wl_event_source_timer_update(waiter->timer,
+			SURFACE_FRAME_WAITER_FALLBACK_MS);
+	}
+}
+
+void surface_frame_waiter_arm(struct surface_frame_waiter *waiter) {
+	surface_frame_waiter_arm_with_mode(waiter, false);
+}
+
+void surface_frame_waiter_arm_present(struct surface_frame_waiter *waiter) {
+	surface_frame_waiter_arm_with_mode(waiter, true);
+}
+
+void surface_frame_waiter_disarm(struct surface_frame_waiter *waiter) {
+	struct surface_frame_waiter_output *waiter_output, *tmp;
+	wl_list_for_each_safe(waiter_output, tmp, &waiter->outputs, link) {
+		surface_frame_waiter_output_destroy(waiter_output);
+	}
+	if (waiter->armed) {
+		wl_event_source_timer_update(waiter->timer, 0);
+	}
+	waiter->armed = false;
+}
@@ -1,13 +1,23 @@
 #include <assert.h>
+#include <drm_fourcc.h>
+#include <math.h>
 #include <pixman.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/interfaces/wlr_ext_image_capture_source_v1.h>
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_ext_image_copy_capture_v1.h>
 #include <wlr/types/wlr_seat.h>
+#include <wlr/render/swapchain.h>
 #include <wlr/render/wlr_renderer.h>
+#include <wlr/render/wlr_texture.h>
+#include <wlr/util/region.h>
 #include "ext-image-copy-capture-v1-protocol.h"
+#include "render/allocator/allocator.h"
 #include "render/pixel_format.h"
+#include "render/wlr_renderer.h"
+#include "types/wlr_ext_image_copy_capture_v1.h"
+#include "types/wlr_output.h"
 
 #define IMAGE_COPY_CAPTURE_MANAGER_V1_VERSION 1
 
@@ -62,12 +72,70 @@ static struct wlr_ext_image_copy_capture_cursor_session_v1 *cursor_session_from_
 	return wl_resource_get_user_data(resource);
 }
 
+/**
+ * Get the size of the buffers the client allocates, see
+ * wlr_ext_image_copy_capture_session_v1_set_max_buffer_size().
+ */
+static void session_get_buffer_size(struct wlr_ext_image_copy_capture_session_v1 *session,
+		int *width, int *height) {
+	struct wlr_ext_image_capture_source_v1 *source = session->source;
+	double scale = 1;
+	if (session->max_buffer_width > 0 &&
+			(int)source->width > session->max_buffer_width) {
+		scale = (double)session->max_buffer_width / source->width;
+	}
+	if (session->max_buffer_height > 0 &&
+			source->height * scale > session->max_buffer_height) {
+		scale = (double)session->max_buffer_height / source->height;
+	}
+
+	*width = source->width;
+	*height = source->height;
+	if (scale < 1) {
+		*width = round(source->width * scale);
+		*height = round(source->height * scale);
+		if (*width < 1) {
+			*width = 1;
+		}
+		if (*height < 1) {
+			*height = 1;
+		}
+	}
+}
+
+/**
+ * Get the damage accumulated by the session, in buffer coordinates.
+ */
+static void session_get_buffer_damage(struct wlr_ext_image_copy_capture_session_v1 *session,
+		pixman_region32_t *damage) {
+	struct wlr_ext_image_capture_source_v1 *source = session->source;
+	int width, height;
+	session_get_buffer_size(session, &width, &height);
+
+	pixman_region32_init(damage);
+	if (width == (int)source->width && height == (int)source->height) {
+		pixman_region32_copy(damage, &session->damage);
+		return;
+	}
+
+	wlr_region_scale_xy(damage, &session->damage,
+		(float)width / source->width, (float)height / source->height);
+	// Filtering blends neighbouring pixels together
+	wlr_region_expand(damage, damage, 1);
+	pixman_region32_intersect_rect(damage, damage, 0, 0, width, height);
+}
+
+static size_t session_get_shm_formats_len(struct wlr_ext_image_copy_capture_session_v1 *session) {
+	return session->source->shm_formats_len + session->shm_formats_len;
+}
+
 static void frame_destroy(struct wlr_ext_image_copy_capture_frame_v1 *frame) {
 	if (frame == NULL) {
 		return;
 	}
 	wl_signal_emit_mutable(&frame->events.destroy, NULL);
 	assert(wl_list_empty(&frame->events.destroy.listener_list));
+	wlr_texture_readback_destroy(frame->readback);
 	wl_resource_set_user_data(frame->resource, NULL);
 	wlr_buffer_unlock(frame->buffer);
 	pixman_region32_fini(&frame->buffer_damage);
@@ -81,22 +149,25 @@ static void frame_handle_resource_destroy(struct wl_resource *resource) {
 	frame_destroy(wl_resource_get_user_data(resource));
 }
 
-void wlr_ext_image_copy_capture_frame_v1_ready(struct wlr_ext_image_copy_capture_frame_v1 *frame,
-		enum wl_output_transform transform,
-		const struct timespec *presentation_time) {
-	assert(frame->capturing);
+static void frame_send_damage(struct wlr_ext_image_copy_capture_frame_v1 *frame) {
+	pixman_region32_t damage;
+	session_get_buffer_damage(frame->session, &damage);
 
 	int rects_len = 0;
-	const pixman_box32_t *rects =
-		pixman_region32_rectangles(&frame->session->damage, &rects_len);
+	const pixman_box32_t *rects = pixman_region32_rectangles(&damage, &rects_len);
 	for (int i = 0; i < rects_len; i++) {
 		const pixman_box32_t *rect = &rects[i];
 		ext_image_copy_capture_frame_v1_send_damage(frame->resource,
 			rect->x1, rect->y1, rect->x2 - rect->x1, rect->y2 - rect->y1);
 	}
 
+	pixman_region32_fini(&damage);
 	pixman_region32_clear(&frame->session->damage);
+}
 
+static void frame_send_ready(struct wlr_ext_image_copy_capture_frame_v1 *frame,
+		enum wl_output_transform transform,
+		const struct timespec *presentation_time) {
 	uint64_t pres_time_sec = (uint64_t)presentation_time->tv_sec;
 	ext_image_copy_capture_frame_v1_send_transform(frame->resource, transform);
 	ext_image_copy_capture_frame_v1_send_presentation_time(frame->resource,
@@ -105,10 +176,43 @@ void wlr_ext_image_copy_capture_frame_v1_ready(struct wlr_ext_image_copy_capture
 	frame_destroy(frame);
 }
 
-static bool copy_dmabuf(struct wlr_buffer *dst,
+void wlr_ext_image_copy_capture_frame_v1_ready(struct wlr_ext_image_copy_capture_frame_v1 *frame,
+		enum wl_output_transform transform,
+		const struct timespec *presentation_time) {
+	assert(frame->capturing);
+
+	frame_send_damage(frame);
+	frame_send_ready(frame, transform, presentation_time);
+}
+
+/**
+ * Import a source buffer. If the buffer is being committed on an output, the
+ * import is shared with the output's other capture clients.
+ */
+static struct wlr_texture *acquire_texture(struct wlr_output *output,
+		struct wlr_buffer *src, struct wlr_renderer *renderer) {
+	if (output != NULL) {
+		return output_capture_acquire_texture(output, src);
+	}
+	return wlr_texture_from_buffer(renderer, src);
+}
+
+static void release_texture(struct wlr_output *output,
+		struct wlr_texture *texture) {
+	if (output != NULL) {
+		output_capture_release_texture(output, texture);
+	} else {
+		wlr_texture_destroy(texture);
+	}
+}
+
+/**
+ * Render a source buffer into a buffer, scaling it to the buffer size.
+ */
+static bool copy_render(struct wlr_buffer *dst, struct wlr_output *output,
 		struct wlr_buffer *src, struct wlr_renderer *renderer,
 		const pixman_region32_t *clip) {
-	struct wlr_texture *texture = wlr_texture_from_buffer(renderer, src);
+	struct wlr_texture *texture = acquire_texture(output, src, renderer);
 	if (texture == NULL) {
 		return false;
 	}
@@ -121,21 +225,24 @@ static bool copy_dmabuf(struct wlr_buffer *dst,
 
 	wlr_render_pass_add_texture(pass, &(struct wlr_render_texture_options) {
 		.texture = texture,
+		.dst_box = { .width = dst->width, .height = dst->height },
 		.clip = clip,
+		.filter_mode = WLR_SCALE_FILTER_BILINEAR,
 		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
 	});
 
 	ok = wlr_render_pass_submit(pass);
 
 out:
-	wlr_texture_destroy(texture);
+	release_texture(output, texture);
 	return ok;
 }
 
 static bool copy_shm(void *data, uint32_t format, size_t stride,
-		struct wlr_buffer *src, struct wlr_renderer *renderer) {
+		struct wlr_output *output, struct wlr_buffer *src,
+		struct wlr_renderer *renderer) {
 	// TODO: bypass renderer if source buffer supports data ptr access
-	struct wlr_texture *texture = wlr_texture_from_buffer(renderer, src);
+	struct wlr_texture *texture = acquire_texture(output, src, renderer);
 	if (!texture) {
 		return false;
 	}
@@ -147,20 +254,103 @@ static bool copy_shm(void *data, uint32_t format, size_t stride,
 		.stride = stride,
 	});
 
-	wlr_texture_destroy(texture);
+	release_texture(output, texture);
 
 	return ok;
 }
 
-bool wlr_ext_image_copy_capture_frame_v1_copy_buffer(struct wlr_ext_image_copy_capture_frame_v1 *frame,
-		struct wlr_buffer *src, struct wlr_renderer *renderer) {
+static struct wlr_buffer *session_acquire_staging_buffer(
+		struct wlr_ext_image_copy_capture_session_v1 *session,
+		struct wlr_renderer *renderer, int width, int height) {
+	if (session->staging_allocator == NULL ||
+			session->staging_renderer != renderer) {
+		wlr_swapchain_destroy(session->staging);
+		session->staging = NULL;
+		wlr_allocator_destroy(session->staging_allocator);
+		session->staging_renderer = NULL;
+
+		// The staging buffer is only used by the renderer
+		session->staging_allocator = allocator_autocreate_with_drm_fd(
+			renderer->render_buffer_caps, renderer,
+			wlr_renderer_get_drm_fd(renderer));
+		if (session->staging_allocator == NULL) {
+			return NULL;
+		}
+		session->staging_renderer = renderer;
+	}
+
+	struct wlr_swapchain *staging = session->staging;
+	if (staging == NULL || staging->width != width ||
+			staging->height != height) {
+		const struct wlr_drm_format *format = wlr_drm_format_set_get(
+			wlr_renderer_get_render_formats(renderer), DRM_FORMAT_ARGB8888);
+		if (format == NULL) {
+			return NULL;
+		}
+
+		wlr_swapchain_destroy(session->staging);
+		session->staging = wlr_swapchain_create(session->staging_allocator,
+			width, height, format);
+		if (session->staging == NULL) {
+			return NULL;
+		}
+	}
+
+	return wlr_swapchain_acquire(session->staging);
+}
+
+/**
+ * Scale a source buffer into a shared memory buffer. Renderers which can't
+ * render to shared memory draw into a staging buffer which is read back, it
+ * is allocated for the renderer since sources aren't always tied to an
+ * output.
+ */
+static bool copy_shm_scaled(struct wlr_ext_image_copy_capture_frame_v1 *frame,
+		struct wlr_output *output, struct wlr_buffer *src,
+		struct wlr_renderer *renderer) {
+	struct wlr_buffer *dst = frame->buffer;
+	if (renderer->render_buffer_caps & WLR_BUFFER_CAP_DATA_PTR) {
+		return copy_render(dst, output, src, renderer, &frame->buffer_damage);
+	}
+
+	struct wlr_buffer *staging = session_acquire_staging_buffer(frame->session,
+		renderer, dst->width, dst->height);
+	if (staging == NULL) {
+		return false;
+	}
+
+	// Staging buffers don't hold the previous frame, draw everything
+	bool ok = copy_render(staging, output, src, renderer, NULL);
+
+	void *data;
+	uint32_t format;
+	size_t stride;
+	if (ok && wlr_buffer_begin_data_ptr_access(dst,
+			WLR_BUFFER_DATA_PTR_ACCESS_WRITE, &data, &format, &stride)) {
+		ok = copy_shm(data, format, stride, NULL, staging, renderer);
+		wlr_buffer_end_data_ptr_access(dst);
+	} else {
+		ok = false;
+	}
+
+	wlr_buffer_unlock(staging);
+	return ok;
+}
+
+static bool frame_copy_buffer(struct wlr_ext_image_copy_capture_frame_v1 *frame,
+		struct wlr_output *output, struct wlr_buffer *src,
+		struct wlr_renderer *renderer) {
+	struct wlr_ext_image_copy_capture_session_v1 *session = frame->session;
 	struct wlr_buffer *dst = frame->buffer;
 
-	if (src->width != dst->width || src->height != dst->height) {
+	int width, height;
+	session_get_buffer_size(session, &width, &height);
+	if (dst->width != width || dst->height != height) {
 		wlr_ext_image_copy_capture_frame_v1_fail(frame,
 			EXT_IMAGE_COPY_CAPTURE_FRAME_V1_FAILURE_REASON_BUFFER_CONSTRAINTS);
 		return false;
 	}
+	bool scaled = src->width != dst->width || src->height != dst->height;
 
 	bool ok = false;
 	enum ext_image_copy_capture_frame_v1_failure_reason failure_reason =
@@ -170,20 +360,20 @@ bool wlr_ext_image_copy_capture_frame_v1_copy_buffer(struct wlr_ext_image_copy_c
 	uint32_t format;
 	size_t stride;
 	if (wlr_buffer_get_dmabuf(dst, &dmabuf)) {
-		if (frame->session->source->dmabuf_formats.len == 0) {
+		if (session->source->dmabuf_formats.len == 0) {
 			ok = false;
 			failure_reason = EXT_IMAGE_COPY_CAPTURE_FRAME_V1_FAILURE_REASON_BUFFER_CONSTRAINTS;
 		} else {
-			ok = copy_dmabuf(dst, src, renderer, &frame->buffer_damage);
+			ok = copy_render(dst, output, src, renderer, &frame->buffer_damage);
 		}
+	} else if (session_get_shm_formats_len(session) == 0) {
+		ok = false;
+		failure_reason = EXT_IMAGE_COPY_CAPTURE_FRAME_V1_FAILURE_REASON_BUFFER_CONSTRAINTS;
+	} else if (scaled) {
+		ok = copy_shm_scaled(frame, output, src, renderer);
 	} else if (wlr_buffer_begin_data_ptr_access(dst,
 			WLR_BUFFER_DATA_PTR_ACCESS_WRITE, &data, &format, &stride)) {
-		if (frame->session->source->shm_formats_len == 0) {
-			ok = false;
-			failure_reason = EXT_IMAGE_COPY_CAPTURE_FRAME_V1_FAILURE_REASON_BUFFER_CONSTRAINTS;
-		} else {
-			ok = copy_shm(data, format, stride, src, renderer);
-		}
+		ok = copy_shm(data, format, stride, output, src, renderer);
 		wlr_buffer_end_data_ptr_access(dst);
 	}
 	if (!ok) {
@@ -194,6 +384,129 @@ bool wlr_ext_image_copy_capture_frame_v1_copy_buffer(struct wlr_ext_image_copy_c
 	return true;
 }
 
+bool wlr_ext_image_copy_capture_frame_v1_copy_buffer(struct wlr_ext_image_copy_capture_frame_v1 *frame,
+		struct wlr_buffer *src, struct wlr_renderer *renderer) {
+	return frame_copy_buffer(frame, NULL, src, renderer);
+}
+
+static void frame_handle_readback_ready(struct wlr_texture_readback *readback) {
+	struct wlr_ext_image_copy_capture_frame_v1 *frame = readback->data;
+	frame->readback = NULL;
+
+	bool ok = false;
+	void *data;
+	uint32_t format;
+	size_t stride;
+	if (wlr_buffer_begin_data_ptr_access(frame->buffer,
+			WLR_BUFFER_DATA_PTR_ACCESS_WRITE, &data, &format, &stride)) {
+		ok = wlr_texture_readback_copy(readback, &(struct wlr_texture_read_pixels_options){
+			.data = data,
+			.format = format,
+			.stride = stride,
+		});
+		wlr_buffer_end_data_ptr_access(frame->buffer);
+	}
+	wlr_texture_readback_destroy(readback);
+
+	if (!ok) {
+		wlr_ext_image_copy_capture_frame_v1_fail(frame,
+			EXT_IMAGE_COPY_CAPTURE_FRAME_V1_FAILURE_REASON_UNKNOWN);
+		return;
+	}
+
+	frame_send_ready(frame, frame->transform, &frame->presentation_time);
+}
+
+/**
+ * Start reading back a shared memory copy without waiting for the GPU.
+ * Returns false if that isn't possible, in which case nothing has been done.
+ */
+static bool frame_copy_shm_async(struct wlr_ext_image_copy_capture_frame_v1 *frame,
+		struct wlr_output *output, struct wlr_buffer *src,
+		struct wlr_renderer *renderer,
+		enum wl_output_transform transform,
+		const struct timespec *presentation_time) {
+	struct wlr_buffer *dst = frame->buffer;
+	// Errors are reported by the synchronous path
+	if (src->width != dst->width || src->height != dst->height ||
+			session_get_shm_formats_len(frame->session) == 0) {
+		return false;
+	}
+
+	struct wlr_dmabuf_attributes dmabuf;
+	void *data;
+	uint32_t format;
+	size_t stride;
+	if (wlr_buffer_get_dmabuf(dst, &dmabuf) ||
+			!wlr_buffer_begin_data_ptr_access(dst,
+				WLR_BUFFER_DATA_PTR_ACCESS_WRITE, &data, &format, &stride)) {
+		return false;
+	}
+	wlr_buffer_end_data_ptr_access(dst);
+
+	const struct wlr_texture_read_pixels_options options = {
+		.format = format,
+	};
+	if (output != NULL) {
+		frame->readback = output_capture_read_pixels_async(output, src,
+			&options, frame_handle_readback_ready, frame);
+	} else {
+		struct wlr_texture *texture = wlr_texture_from_buffer(renderer, src);
+		if (texture == NULL) {
+			return false;
+		}
+
+		struct wl_event_loop *loop = wl_display_get_event_loop(
+			wl_client_get_display(wl_resource_get_client(frame->resource)));
+		frame->readback = wlr_texture_read_pixels_async(texture, &options,
+			loop, frame_handle_readback_ready, frame);
+		wlr_texture_destroy(texture);
+	}
+	if (frame->readback == NULL) {
+		return false;
+	}
+
+	// Damage received from now on belongs to the next frame
+	frame_send_damage(frame);
+	frame->transform = transform;
+	frame->presentation_time = *presentation_time;
+	return true;
+}
+
+static void frame_copy_and_ready(struct wlr_ext_image_copy_capture_frame_v1 *frame,
+		struct wlr_output *output, struct wlr_buffer *src,
+		struct wlr_renderer *renderer, enum wl_output_transform transform,
+		const struct timespec *presentation_time) {
+	assert(frame->capturing && frame->readback == NULL);
+
+	if (frame_copy_shm_async(frame, output, src, renderer, transform,
+			presentation_time)) {
+		return;
+	}
+
+	if (frame_copy_buffer(frame, output, src, renderer)) {
+		wlr_ext_image_copy_capture_frame_v1_ready(frame, transform,
+			presentation_time);
+	}
+}
+
+void wlr_ext_image_copy_capture_frame_v1_copy_and_ready(
+		struct wlr_ext_image_copy_capture_frame_v1 *frame,
+		struct wlr_buffer *src, struct wlr_renderer *renderer,
+		enum wl_output_transform transform,
+		const struct timespec *presentation_time) {
+	frame_copy_and_ready(frame, NULL, src, renderer, transform,
+		presentation_time);
+}
+
+void image_copy_capture_frame_copy_output_and_ready(
+		struct wlr_ext_image_copy_capture_frame_v1 *frame,
+		struct wlr_output *output, struct wlr_buffer *src,
+		const struct timespec *presentation_time) {
+	frame_copy_and_ready(frame, output, src, output->renderer,
+		output->transform, presentation_time);
+}
+
 void wlr_ext_image_copy_capture_frame_v1_fail(struct wlr_ext_image_copy_capture_frame_v1 *frame,
 		enum ext_image_copy_capture_frame_v1_failure_reason reason) {
 	ext_image_copy_capture_frame_v1_send_failed(frame->resource, reason);
@@ -348,13 +661,28 @@ static const struct ext_image_copy_capture_session_v1_interface session_impl = {
 static void session_send_constraints(struct wlr_ext_image_copy_capture_session_v1 *session) {
 	struct wlr_ext_image_capture_source_v1 *source = session->source;
 
+	int width, height;
+	session_get_buffer_size(session, &width, &height);
 	ext_image_copy_capture_session_v1_send_buffer_size(session->resource,
-		source->width, source->height);
+		width, height);
 
 	for (size_t i = 0; i < source->shm_formats_len; i++) {
 		ext_image_copy_capture_session_v1_send_shm_format(session->resource,
 			convert_drm_format_to_wl_shm(source->shm_formats[i]));
 	}
+	for (size_t i = 0; i < session->shm_formats_len; i++) {
+		bool duplicate = false;
+		for (size_t j = 0; j < source->shm_formats_len; j++) {
+			if (source->shm_formats[j] == session->shm_formats[i]) {
+				duplicate = true;
+				break;
+			}
+		}
+		if (!duplicate) {
+			ext_image_copy_capture_session_v1_send_shm_format(session->resource,
+				convert_drm_format_to_wl_shm(session->shm_formats[i]));
+		}
+	}
 
 	if (source->dmabuf_formats.len > 0) {
 		struct wl_array dev_id_array = {
@@ -397,6 +725,9 @@ static void session_destroy(struct wlr_ext_image_copy_capture_session_v1 *sessio
 	wl_resource_set_user_data(session->resource, NULL);
 
 	pixman_region32_fini(&session->damage);
+	free(session->shm_formats);
+	wlr_swapchain_destroy(session->staging);
+	wlr_allocator_destroy(session->staging_allocator);
 	wl_list_remove(&session->source_destroy.link);
 	wl_list_remove(&session->source_constraints_update.link);
 	wl_list_remove(&session->source_frame.link);
@@ -424,11 +755,15 @@ static void session_handle_source_frame(struct wl_listener *listener, void *data
 
 	pixman_region32_union(&session->damage, &session->damage, event->damage);
 
+	// Frames waiting for a read-back are already copied
 	struct wlr_ext_image_copy_capture_frame_v1 *frame = session->frame;
-	if (frame != NULL && frame->capturing &&
+	if (frame != NULL && frame->capturing && frame->readback == NULL &&
 			!pixman_region32_empty(&session->damage)) {
+		pixman_region32_t damage;
+		session_get_buffer_damage(session, &damage);
 		pixman_region32_union(&frame->buffer_damage,
-			&frame->buffer_damage, &session->damage);
+			&frame->buffer_damage, &damage);
+		pixman_region32_fini(&damage);
 
 		struct wlr_ext_image_capture_source_v1 *source = frame->session->source;
 		source->impl->copy_frame(source, frame, event);
@@ -676,6 +1011,38 @@ static void manager_handle_display_destroy(struct wl_listener *listener, void *d
 	free(manager);
 }
 
+void wlr_ext_image_copy_capture_session_v1_set_max_buffer_size(
+		struct wlr_ext_image_copy_capture_session_v1 *session,
+		int width, int height) {
+	assert(width >= 0 && height >= 0);
+	if (session->max_buffer_width == width &&
+			session->max_buffer_height == height) {
+		return;
+	}
+	session->max_buffer_width = width;
+	session->max_buffer_height = height;
+	session_send_constraints(session);
+}
+
+bool wlr_ext_image_copy_capture_session_v1_set_shm_formats(
+		struct wlr_ext_image_copy_capture_session_v1 *session,
+		const uint32_t *formats, size_t formats_len) {
+	uint32_t *shm_formats = NULL;
+	if (formats_len > 0) {
+		shm_formats = calloc(formats_len, sizeof(shm_formats[0]));
+		if (shm_formats == NULL) {
+			return false;
+		}
+		memcpy(shm_formats, formats, formats_len * sizeof(shm_formats[0]));
+	}
+
+	free(session->shm_formats);
+	session->shm_formats = shm_formats;
+	session->shm_formats_len = formats_len;
+	session_send_constraints(session);
+	return true;
+}
+
 struct wlr_ext_image_copy_capture_manager_v1 *wlr_ext_image_copy_capture_manager_v1_create(
 		struct wl_display *display, uint32_t version) {
 	assert(version <= IMAGE_COPY_CAPTURE_MANAGER_V1_VERSION);
@@ -0,0 +1,288 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_fifo_v1.h>
+#include <wlr/util/addon.h>
+#include "fifo-v1-protocol.h"
+#include "types/wlr_compositor.h"
+#include "util/array.h"
+
+#define FIFO_MANAGER_VERSION 1
+
+struct wlr_fifo_v1_surface_state {
+	bool set_barrier, wait_barrier;
+};
+
+struct wlr_fifo_v1_surface {
+	struct wl_resource *resource;
+	struct wlr_surface *surface;
+	struct wlr_addon addon;
+	struct wlr_surface_synced synced;
+	struct wlr_fifo_v1_surface_state pending, current;
+
+	// Whether a barrier has been applied and not latched by an output yet
+	bool barrier;
+	// Number of commits setting a barrier which haven't been applied yet
+	size_t unapplied_barriers;
+	// Cached commit sequence numbers waiting on the barrier, oldest first
+	struct wl_array waiting; // uint32_t
+
+	struct surface_frame_waiter frame_waiter;
+	struct wl_listener client_commit;
+};
+
+static const struct wp_fifo_v1_interface fifo_impl;
+
+// Returns NULL if the wl_surface was destroyed
+static struct wlr_fifo_v1_surface *fifo_from_resource(struct wl_resource *resource) {
+	assert(wl_resource_instance_of(resource, &wp_fifo_v1_interface, &fifo_impl));
+	return wl_resource_get_user_data(resource);
+}
+
+static void fifo_destroy(struct wlr_fifo_v1_surface *fifo, bool release) {
+	if (fifo == NULL) {
+		return;
+	}
+
+	wl_list_remove(&fifo->client_commit.link);
+	surface_frame_waiter_finish(&fifo->frame_waiter);
+	wlr_surface_synced_finish(&fifo->synced);
+	wlr_addon_finish(&fifo->addon);
+	wl_resource_set_user_data(fifo->resource, NULL);
+
+	if (release) {
+		// Don't leave the surface stuck behind a barrier nobody will clear
+		uint32_t *seq;
+		wl_array_for_each(seq, &fifo->waiting) {
+			wlr_surface_unlock_cached(fifo->surface, *seq);
+		}
+	}
+	wl_array_release(&fifo->waiting);
+	free(fifo);
+}
+
+static void fifo_handle_resource_destroy(struct wl_resource *resource) {
+	struct wlr_fifo_v1_surface *fifo = fifo_from_resource(resource);
+	fifo_destroy(fifo, true);
+}
+
+static void fifo_handle_destroy(struct wl_client *client,
+		struct wl_resource *resource) {
+	wl_resource_destroy(resource);
+}
+
+static void fifo_handle_set_barrier(struct wl_client *client,
+		struct wl_resource *resource) {
+	struct wlr_fifo_v1_surface *fifo = fifo_from_resource(resource);
+	if (fifo == NULL) {
+		wl_resource_post_error(resource, WP_FIFO_V1_ERROR_SURFACE_DESTROYED,
+			"The wl_surface object has been destroyed");
+		return;
+	}
+	fifo->pending.set_barrier = true;
+}
+
+static void fifo_handle_wait_barrier(struct wl_client *client,
+		struct wl_resource *resource) {
+	struct wlr_fifo_v1_surface *fifo = fifo_from_resource(resource);
+	if (fifo == NULL) {
+		wl_resource_post_error(resource, WP_FIFO_V1_ERROR_SURFACE_DESTROYED,
+			"The wl_surface object has been destroyed");
+		return;
+	}
+	fifo->pending.wait_barrier = true;
+}
+
+static const struct wp_fifo_v1_interface fifo_impl = {
+	.set_barrier = fifo_handle_set_barrier,
+	.wait_barrier = fifo_handle_wait_barrier,
+	.destroy = fifo_handle_destroy,
+};
+
+static void fifo_release_waiting(struct wlr_fifo_v1_surface *fifo) {
+	while (!fifo->barrier && fifo->waiting.size > 0) {
+		uint32_t *waiting = fifo->waiting.data;
+		uint32_t seq = waiting[0];
+		array_remove_at(&fifo->waiting, 0, sizeof(seq));
+
+		// May apply the commit, and set the barrier again
+		wlr_surface_unlock_cached(fifo->surface, seq);
+
+		if (fifo->surface->current.seq != seq) {
+			// Still blocked by another lock, which may be holding back a
+			// barrier: try again on the next refresh
+			surface_frame_waiter_arm_present(&fifo->frame_waiter);
+			break;
+		}
+	}
+}
+
+static void fifo_handle_frame(struct surface_frame_waiter *waiter,
+		struct wlr_output *output) {
+	struct wlr_fifo_v1_surface *fifo =
+		wl_container_of(waiter, fifo, frame_waiter);
+	// The output commit containing the barrier state has been presented
+	fifo->barrier = false;
+	fifo_release_waiting(fifo);
+}
+
+static void fifo_handle_client_commit(struct wl_listener *listener, void *data) {
+	struct wlr_fifo_v1_surface *fifo =
+		wl_container_of(listener, fifo, client_commit);
+
+	if (fifo->pending.wait_barrier && (fifo->barrier ||
+			fifo->unapplied_barriers > 0 || fifo->waiting.size > 0)) {
+		uint32_t *seq = wl_array_add(&fifo->waiting, sizeof(*seq));
+		if (seq == NULL) {
+			wl_resource_post_no_memory(fifo->resource);
+			return;
+		}
+		*seq = wlr_surface_lock_pending(fifo->surface);
+	}
+
+	if (fifo->pending.set_barrier) {
+		fifo->unapplied_barriers++;
+	}
+}
+
+static void surface_synced_move_state(void *_dst, void *_src) {
+	struct wlr_fifo_v1_surface_state *dst = _dst, *src = _src;
+	*dst = *src;
+	*src = (struct wlr_fifo_v1_surface_state){0};
+}
+
+static void surface_synced_commit(struct wlr_surface_synced *synced) {
+	struct wlr_fifo_v1_surface *fifo = wl_container_of(synced, fifo, synced);
+	if (!fifo->current.set_barrier) {
+		return;
+	}
+
+	assert(fifo->unapplied_barriers > 0);
+	fifo->unapplied_barriers--;
+	fifo->barrier = true;
+	// Start over if already waiting, output commits seen so far don't
+	// contain the barrier state
+	surface_frame_waiter_disarm(&fifo->frame_waiter);
+	surface_frame_waiter_arm_present(&fifo->frame_waiter);
+}
+
+static const struct wlr_surface_synced_impl surface_synced_impl = {
+	.state_size = sizeof(struct wlr_fifo_v1_surface_state),
+	.move_state = surface_synced_move_state,
+	.commit = surface_synced_commit,
+};
+
+static void surface_addon_destroy(struct wlr_addon *addon) {
+	struct wlr_fifo_v1_surface *fifo = wl_container_of(addon, fifo, addon);
+	fifo_destroy(fifo, false);
+}
+
+static const struct wlr_addon_interface surface_addon_impl = {
+	.name = "wp_fifo_v1",
+	.destroy = surface_addon_destroy,
+};
+
+static void manager_handle_destroy(struct wl_client *client,
+		struct wl_resource *resource) {
+	wl_resource_destroy(resource);
+}
+
+static void manager_handle_get_fifo(struct wl_client *client,
+		struct wl_resource *manager_resource, uint32_t id,
+		struct wl_resource *surface_resource) {
+	struct wlr_surface *surface = wlr_surface_from_resource(surface_resource);
+
+	if (wlr_addon_find(&surface->addons, NULL, &surface_addon_impl) != NULL) {
+		wl_resource_post_error(manager_resource,
+			WP_FIFO_MANAGER_V1_ERROR_ALREADY_EXISTS,
+			"The wl_surface object already has a wp_fifo_v1 object");
+		return;
+	}
+
+	struct wlr_fifo_v1_surface *fifo = calloc(1, sizeof(*fifo));
+	if (fifo == NULL) {
+		wl_resource_post_no_memory(manager_resource);
+		return;
+	}
+
+	if (!surface_frame_waiter_init(&fifo->frame_waiter, surface,
+			fifo_handle_frame)) {
+		goto error_fifo;
+	}
+
+	if (!wlr_surface_synced_init(&fifo->synced, surface,
+			&surface_synced_impl, &fifo->pending, &fifo->current)) {
+		goto error_frame_waiter;
+	}
+
+	uint32_t version = wl_resource_get_version(manager_resource);
+	fifo->resource = wl_resource_create(client, &wp_fifo_v1_interface, version, id);
+	if (fifo->resource == NULL) {
+		goto error_synced;
+	}
+	wl_resource_set_implementation(fifo->resource, &fifo_impl,
+		fifo, fifo_handle_resource_destroy);
+
+	fifo->surface = surface;
+	wl_array_init(&fifo->waiting);
+
+	fifo->client_commit.notify = fifo_handle_client_commit;
+	wl_signal_add(&surface->events.client_commit, &fifo->client_commit);
+
+	wlr_addon_init(&fifo->addon, &surface->addons, NULL, &surface_addon_impl);
+	return;
+
+error_synced:
+	wlr_surface_synced_finish(&fifo->synced);
+error_frame_waiter:
+	surface_frame_waiter_finish(&fifo->frame_waiter);
+error_fifo:
+	free(fifo);
+	wl_resource_post_no_memory(manager_resource);
+}
+
+static const struct wp_fifo_manager_v1_interface manager_impl = {
+	.destroy = manager_handle_destroy,
+	.get_fifo = manager_handle_get_fifo,
+};
+
+static void manager_bind(struct wl_client *client, void *data,
+		uint32_t version, uint32_t id) {
+	struct wl_resource *resource = wl_resource_create(client,
+		&wp_fifo_manager_v1_interface, version, id);
+	if (resource == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(resource, &manager_impl, NULL, NULL);
+}
+
+static void handle_display_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_fifo_manager_v1 *manager =
+		wl_container_of(listener, manager, display_destroy);
+	wl_list_remove(&manager->display_destroy.link);
+	wl_global_destroy(manager->global);
+	free(manager);
+}
+
+struct wlr_fifo_manager_v1 *wlr_fifo_manager_v1_create(struct wl_display *display,
+		uint32_t version) {
+	assert(version <= FIFO_MANAGER_VERSION);
+
+	struct wlr_fifo_manager_v1 *manager = calloc(1, sizeof(*manager));
+	if (manager == NULL) {
+		return NULL;
+	}
+
+	manager->global = wl_global_create(display, &wp_fifo_manager_v1_interface,
+		version, NULL, manager_bind);
+	if (manager->global == NULL) {
+		free(manager);
+		return NULL;
+	}
+
+	manager->display_destroy.notify = handle_display_destroy;
+	wl_display_add_destroy_listener(display, &manager->display_destroy);
+
+	return manager;
+}
@@ -148,17 +148,164 @@ void wlr_keyboard_init(struct wlr_keyboard *kb,
 	wl_signal_init(&kb->events.repeat_info);
 }
 
+/**
+ * A serialized keymap, shared by all keyboards with the same keymap contents.
+ */
+struct wlr_keyboard_shared_keymap {
+	// The first keymap object serialized to this string, used to skip
+	// serializing it again
+	struct xkb_keymap *keymap;
+	char *string;
+	size_t size; // including the NUL terminator
+	int fd; // read-only
+	uint64_t hash;
+
+	size_t n_refs;
+	struct wl_list link; // shared_keymaps_by_hash
+	struct wl_list keymap_link; // shared_keymaps_by_keymap
+};
+
+#define SHARED_KEYMAPS_BUCKETS 64
+
+// Process-wide hash tables of struct wlr_keyboard_shared_keymap, indexed by
+// the hash of the keymap string and by keymap object. Buckets are initialized
+// on first use.
+static struct wl_list shared_keymaps_by_hash[SHARED_KEYMAPS_BUCKETS];
+static struct wl_list shared_keymaps_by_keymap[SHARED_KEYMAPS_BUCKETS];
+
+static uint64_t hash_keymap_string(const char *str) {
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325;
+	for (const char *c = str; *c != '\0'; c++) {
+		hash ^= (unsigned char)*c;
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+static struct wl_list *shared_keymaps_bucket(struct wl_list *buckets,
+		uint64_t hash) {
+	struct wl_list *bucket = &buckets[hash % SHARED_KEYMAPS_BUCKETS];
+	if (bucket->next == NULL) {
+		wl_list_init(bucket);
+	}
+	return bucket;
+}
+
+static struct wl_list *shared_keymaps_bucket_by_keymap(
+		struct xkb_keymap *keymap) {
+	// Drop the low bits, which are always zero due to alignment
+	uint64_t hash = (uintptr_t)keymap >> 4;
+	return shared_keymaps_bucket(shared_keymaps_by_keymap, hash);
+}
+
+static struct wlr_keyboard_shared_keymap *shared_keymap_find_by_keymap(
+		struct xkb_keymap *keymap) {
+	struct wl_list *bucket = shared_keymaps_bucket_by_keymap(keymap);
+	struct wlr_keyboard_shared_keymap *shared;
+	wl_list_for_each(shared, bucket, keymap_link) {
+		if (shared->keymap == keymap) {
+			return shared;
+		}
+	}
+	return NULL;
+}
+
+static struct wlr_keyboard_shared_keymap *shared_keymap_acquire(
+		struct xkb_keymap *keymap) {
+	// Fast path: this keymap has already been serialized, e.g. when copying
+	// the keymap of a keyboard to a keyboard group
+	struct wlr_keyboard_shared_keymap *shared = shared_keymap_find_by_keymap(keymap);
+	if (shared != NULL) {
+		shared->n_refs++;
+		return shared;
+	}
+
+	char *keymap_str = xkb_keymap_get_as_string(keymap, XKB_KEYMAP_FORMAT_TEXT_V1);
+	if (keymap_str == NULL) {
+		wlr_log(WLR_ERROR, "Failed to get string version of keymap");
+		return NULL;
+	}
+	size_t keymap_size = strlen(keymap_str) + 1;
+	uint64_t hash = hash_keymap_string(keymap_str);
+
+	struct wl_list *bucket = shared_keymaps_bucket(shared_keymaps_by_hash, hash);
+	wl_list_for_each(shared, bucket, link) {
+		if (shared->hash == hash && shared->size == keymap_size &&
+				memcmp(shared->string, keymap_str, keymap_size) == 0) {
+			free(keymap_str);
+			shared->n_refs++;
+			return shared;
+		}
+	}
+
+	shared = calloc(1, sizeof(*shared));
+	if (shared == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		goto error_keymap_str;
+	}
+
+	int rw_fd = -1, ro_fd = -1;
+	if (!allocate_shm_file_pair(keymap_size, &rw_fd, &ro_fd)) {
+		wlr_log(WLR_ERROR, "Failed to allocate shm file for keymap");
+		goto error_shared;
+	}
+
+	void *dst = mmap(NULL, keymap_size, PROT_READ | PROT_WRITE, MAP_SHARED, rw_fd, 0);
+	close(rw_fd);
+	if (dst == MAP_FAILED) {
+		wlr_log_errno(WLR_ERROR, "mmap failed");
+		close(ro_fd);
+		goto error_shared;
+	}
+
+	memcpy(dst, keymap_str, keymap_size);
+	munmap(dst, keymap_size);
+
+	shared->keymap = xkb_keymap_ref(keymap);
+	shared->string = keymap_str;
+	shared->size = keymap_size;
+	shared->fd = ro_fd;
+	shared->hash = hash;
+	shared->n_refs = 1;
+	wl_list_insert(bucket, &shared->link);
+	wl_list_insert(shared_keymaps_bucket_by_keymap(keymap), &shared->keymap_link);
+	return shared;
+
+error_shared:
+	free(shared);
+error_keymap_str:
+	free(keymap_str);
+	return NULL;
+}
+
+static void shared_keymap_release(struct wlr_keyboard_shared_keymap *shared) {
+	if (shared == NULL) {
+		return;
+	}
+	assert(shared->n_refs > 0);
+	shared->n_refs--;
+	if (shared->n_refs > 0) {
+		return;
+	}
+
+	wl_list_remove(&shared->link);
+	wl_list_remove(&shared->keymap_link);
+	xkb_keymap_unref(shared->keymap);
+	free(shared->string);
+	close(shared->fd);
+	free(shared);
+}
+
 static void keyboard_unset_keymap(struct wlr_keyboard *kb) {
 	xkb_keymap_unref(kb->keymap);
 	kb->keymap = NULL;
 	xkb_state_unref(kb->xkb_state);
 	kb->xkb_state = NULL;
-	free(kb->keymap_string);
+	shared_keymap_release(kb->shared_keymap);
+	kb->shared_keymap = NULL;
 	kb->keymap_string = NULL;
 	kb->keymap_size = 0;
-	if (kb->keymap_fd >= 0) {
-		close(kb->keymap_fd);
-	}
 	kb->keymap_fd = -1;
 }
 
@@ -204,42 +351,25 @@ bool wlr_keyboard_set_keymap(struct wlr_keyboard *kb, struct xkb_keymap *keymap)
 		return true;
 	}
 
+	struct wlr_keyboard_shared_keymap *shared = shared_keymap_acquire(keymap);
+	if (shared == NULL) {
+		return false;
+	}
+
 	struct xkb_state *xkb_state = xkb_state_new(keymap);
 	if (xkb_state == NULL) {
 		wlr_log(WLR_ERROR, "Failed to create XKB state");
+		shared_keymap_release(shared);
 		return false;
 	}
 
-	char *keymap_str = xkb_keymap_get_as_string(keymap, XKB_KEYMAP_FORMAT_TEXT_V1);
-	if (keymap_str == NULL) {
-		wlr_log(WLR_ERROR, "Failed to get string version of keymap");
-		goto error_xkb_state;
-	}
-	size_t keymap_size = strlen(keymap_str) + 1;
-
-	int rw_fd = -1, ro_fd = -1;
-	if (!allocate_shm_file_pair(keymap_size, &rw_fd, &ro_fd)) {
-		wlr_log(WLR_ERROR, "Failed to allocate shm file for keymap");
-		goto error_keymap_str;
-	}
-
-	void *dst = mmap(NULL, keymap_size, PROT_READ | PROT_WRITE, MAP_SHARED, rw_fd, 0);
-	close(rw_fd);
-	if (dst == MAP_FAILED) {
-		wlr_log_errno(WLR_ERROR, "mmap failed");
-		close(ro_fd);
-		goto error_keymap_str;
-	}
-
-	memcpy(dst, keymap_str, keymap_size);
-	munmap(dst, keymap_size);
-
 	keyboard_unset_keymap(kb);
 	kb->keymap = xkb_keymap_ref(keymap);
 	kb->xkb_state = xkb_state;
-	kb->keymap_string = keymap_str;
-	kb->keymap_size = keymap_size;
-	kb->keymap_fd = ro_fd;
+	kb->shared_keymap = shared;
+	kb->keymap_string = shared->string;
+	kb->keymap_size = shared->size;
+	kb->keymap_fd = shared->fd;
 
 	const char *led_names[WLR_LED_COUNT] = {
 		XKB_LED_NAME_NUM,
@@ -277,12 +407,6 @@ bool wlr_keyboard_set_keymap(struct wlr_keyboard *kb, struct xkb_keymap *keymap)
 	wl_signal_emit_mutable(&kb->events.keymap, kb);
 
 	return true;
-
-error_keymap_str:
-	free(keymap_str);
-error_xkb_state:
-	xkb_state_unref(xkb_state);
-	return false;
 }
 
 void wlr_keyboard_set_repeat_info(struct wlr_keyboard *kb, int32_t rate,
@@ -315,6 +439,18 @@ bool wlr_keyboard_keymaps_match(struct xkb_keymap *km1,
 	if (!km1 || !km2) {
 		return false;
 	}
+	if (km1 == km2) {
+		return true;
+	}
+
+	// Keymaps which have been serialized already can be compared without
+	// serializing them again
+	struct wlr_keyboard_shared_keymap *shared1 = shared_keymap_find_by_keymap(km1);
+	struct wlr_keyboard_shared_keymap *shared2 = shared_keymap_find_by_keymap(km2);
+	if (shared1 != NULL && shared2 != NULL) {
+		return shared1 == shared2;
+	}
+
 	char *km1_str = xkb_keymap_get_as_string(km1, XKB_KEYMAP_FORMAT_TEXT_V1);
 	char *km2_str = xkb_keymap_get_as_string(km2, XKB_KEYMAP_FORMAT_TEXT_V1);
 	bool result = strcmp(km1_str, km2_str) == 0;
@@ -36,10 +36,19 @@ struct wlr_linux_dmabuf_feedback_v1_compiled_tranche {
 	struct wl_array indices; // uint16_t
 };
 
+/**
+ * A compiled feedback, shared by the default feedback and all surfaces with
+ * the same feedback contents.
+ */
 struct wlr_linux_dmabuf_feedback_v1_compiled {
+	struct wl_list link; // wlr_linux_dmabuf_v1.compiled_feedbacks
+	size_t n_refs;
+	uint64_t hash;
+
 	dev_t main_device;
-	int table_fd;
+	int table_fd; // read-only
 	size_t table_size;
+	const struct wlr_linux_dmabuf_feedback_v1_table_entry *table;
 
 	size_t tranches_len;
 	struct wlr_linux_dmabuf_feedback_v1_compiled_tranche tranches[];
@@ -563,19 +572,20 @@ static struct wlr_linux_dmabuf_feedback_v1_compiled *feedback_compile(
 	}
 	assert(n == table_len);
 
-	munmap(table, table_size);
-
 	struct wlr_linux_dmabuf_feedback_v1_compiled *compiled = calloc(1, sizeof(*compiled) +
 		tranches_len * sizeof(struct wlr_linux_dmabuf_feedback_v1_compiled_tranche));
 	if (compiled == NULL) {
+		munmap(table, table_size);
 		close(ro_fd);
 		goto err_all_formats;
 	}
 
+	// Keep the table mapped to compare against other feedbacks
 	compiled->main_device = feedback->main_device;
 	compiled->tranches_len = tranches_len;
 	compiled->table_fd = ro_fd;
 	compiled->table_size = table_size;
+	compiled->table = table;
 
 	// Build the indices lists for all tranches
 	for (size_t i = 0; i < tranches_len; i++) {
@@ -618,6 +628,10 @@ static struct wlr_linux_dmabuf_feedback_v1_compiled *feedback_compile(
 	return compiled;
 
 error_compiled:
+	for (size_t i = 0; i < tranches_len; i++) {
+		wl_array_release(&compiled->tranches[i].indices);
+	}
+	munmap(table, table_size);
 	close(compiled->table_fd);
 	free(compiled);
 err_all_formats:
@@ -625,14 +639,119 @@ err_all_formats:
 	return NULL;
 }
 
-static void compiled_feedback_destroy(
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+	// FNV-1a
+	const unsigned char *bytes = data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+static uint64_t feedback_hash(const struct wlr_linux_dmabuf_feedback_v1 *feedback) {
+	uint64_t hash = 0xcbf29ce484222325;
+	hash = hash_bytes(hash, &feedback->main_device, sizeof(feedback->main_device));
+
+	const struct wlr_linux_dmabuf_feedback_v1_tranche *tranche;
+	wl_array_for_each(tranche, &feedback->tranches) {
+		hash = hash_bytes(hash, &tranche->target_device, sizeof(tranche->target_device));
+		hash = hash_bytes(hash, &tranche->flags, sizeof(tranche->flags));
+		for (size_t i = 0; i < tranche->formats.len; i++) {
+			const struct wlr_drm_format *fmt = &tranche->formats.formats[i];
+			hash = hash_bytes(hash, &fmt->format, sizeof(fmt->format));
+			hash = hash_bytes(hash, fmt->modifiers, fmt->len * sizeof(fmt->modifiers[0]));
+		}
+	}
+	return hash;
+}
+
+static bool compiled_feedback_equal(
+		const struct wlr_linux_dmabuf_feedback_v1_compiled *compiled,
+		const struct wlr_linux_dmabuf_feedback_v1 *feedback) {
+	const struct wlr_linux_dmabuf_feedback_v1_tranche *tranches = feedback->tranches.data;
+	size_t tranches_len = feedback->tranches.size / sizeof(struct wlr_linux_dmabuf_feedback_v1_tranche);
+	if (compiled->main_device != feedback->main_device ||
+			compiled->tranches_len != tranches_len) {
+		return false;
+	}
+
+	// The format table is derived from the tranches, so comparing the
+	// format + modifier pairs of each tranche is enough
+	for (size_t i = 0; i < tranches_len; i++) {
+		const struct wlr_linux_dmabuf_feedback_v1_tranche *tranche = &tranches[i];
+		const struct wlr_linux_dmabuf_feedback_v1_compiled_tranche *compiled_tranche =
+			&compiled->tranches[i];
+		if (compiled_tranche->target_device != tranche->target_device ||
+				compiled_tranche->flags != tranche->flags) {
+			return false;
+		}
+
+		const uint16_t *indices = compiled_tranche->indices.data;
+		size_t indices_len = compiled_tranche->indices.size / sizeof(uint16_t);
+		size_t n = 0;
+		for (size_t j = 0; j < tranche->formats.len; j++) {
+			const struct wlr_drm_format *fmt = &tranche->formats.formats[j];
+			for (size_t k = 0; k < fmt->len; k++) {
+				if (n == indices_len) {
+					return false;
+				}
+				const struct wlr_linux_dmabuf_feedback_v1_table_entry *entry =
+					&compiled->table[indices[n]];
+				if (entry->format != fmt->format || entry->modifier != fmt->modifiers[k]) {
+					return false;
+				}
+				n++;
+			}
+		}
+		if (n != indices_len) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static struct wlr_linux_dmabuf_feedback_v1_compiled *compiled_feedback_acquire(
+		struct wlr_linux_dmabuf_v1 *linux_dmabuf,
+		const struct wlr_linux_dmabuf_feedback_v1 *feedback) {
+	uint64_t hash = feedback_hash(feedback);
+
+	struct wlr_linux_dmabuf_feedback_v1_compiled *compiled;
+	wl_list_for_each(compiled, &linux_dmabuf->compiled_feedbacks, link) {
+		if (compiled->hash == hash && compiled_feedback_equal(compiled, feedback)) {
+			compiled->n_refs++;
+			return compiled;
+		}
+	}
+
+	compiled = feedback_compile(feedback);
+	if (compiled == NULL) {
+		return NULL;
+	}
+
+	compiled->hash = hash;
+	compiled->n_refs = 1;
+	wl_list_insert(&linux_dmabuf->compiled_feedbacks, &compiled->link);
+	return compiled;
+}
+
+static void compiled_feedback_release(
 		struct wlr_linux_dmabuf_feedback_v1_compiled *feedback) {
 	if (feedback == NULL) {
 		return;
 	}
+	assert(feedback->n_refs > 0);
+	feedback->n_refs--;
+	if (feedback->n_refs > 0) {
+		return;
+	}
+
+	wl_list_remove(&feedback->link);
 	for (size_t i = 0; i < feedback->tranches_len; i++) {
 		wl_array_release(&feedback->tranches[i].indices);
 	}
+	munmap((void *)feedback->table, feedback->table_size);
 	close(feedback->table_fd);
 	free(feedback);
 }
@@ -695,7 +814,7 @@ static void surface_destroy(struct wlr_linux_dmabuf_v1_surface *surface) {
 		wl_list_init(link);
 	}
 
-	compiled_feedback_destroy(surface->feedback);
+	compiled_feedback_release(surface->feedback);
 
 	wlr_addon_finish(&surface->addon);
 	wl_list_remove(&surface->link);
@@ -866,7 +985,8 @@ static void linux_dmabuf_v1_destroy(struct wlr_linux_dmabuf_v1 *linux_dmabuf) {
 		surface_destroy(surface);
 	}
 
-	compiled_feedback_destroy(linux_dmabuf->default_feedback);
+	compiled_feedback_release(linux_dmabuf->default_feedback);
+	assert(wl_list_empty(&linux_dmabuf->compiled_feedbacks));
 	wlr_drm_format_set_finish(&linux_dmabuf->default_formats);
 	if (linux_dmabuf->main_device_fd >= 0) {
 		close(linux_dmabuf->main_device_fd);
@@ -886,7 +1006,8 @@ static void handle_display_destroy(struct wl_listener *listener, void *data) {
 
 static bool set_default_feedback(struct wlr_linux_dmabuf_v1 *linux_dmabuf,
 		const struct wlr_linux_dmabuf_feedback_v1 *feedback) {
-	struct wlr_linux_dmabuf_feedback_v1_compiled *compiled = feedback_compile(feedback);
+	struct wlr_linux_dmabuf_feedback_v1_compiled *compiled =
+		compiled_feedback_acquire(linux_dmabuf, feedback);
 	if (compiled == NULL) {
 		return false;
 	}
@@ -928,7 +1049,7 @@ static bool set_default_feedback(struct wlr_linux_dmabuf_v1 *linux_dmabuf,
 		}
 	}
 
-	compiled_feedback_destroy(linux_dmabuf->default_feedback);
+	compiled_feedback_release(linux_dmabuf->default_feedback);
 	linux_dmabuf->default_feedback = compiled;
 
 	if (linux_dmabuf->main_device_fd >= 0) {
@@ -947,7 +1068,7 @@ error_formats:
 		close(main_device_fd);
 	}
 error_compiled:
-	compiled_feedback_destroy(compiled);
+	compiled_feedback_release(compiled);
 	return false;
 }
 
@@ -963,6 +1084,7 @@ struct wlr_linux_dmabuf_v1 *wlr_linux_dmabuf_v1_create(struct wl_display *displa
 	linux_dmabuf->main_device_fd = -1;
 
 	wl_list_init(&linux_dmabuf->surfaces);
+	wl_list_init(&linux_dmabuf->compiled_feedbacks);
 
 	wl_signal_init(&linux_dmabuf->events.destroy);
 
@@ -1028,15 +1150,24 @@ bool wlr_linux_dmabuf_v1_set_surface_feedback(
 
 	struct wlr_linux_dmabuf_feedback_v1_compiled *compiled = NULL;
 	if (feedback != NULL) {
-		compiled = feedback_compile(feedback);
+		compiled = compiled_feedback_acquire(linux_dmabuf, feedback);
 		if (compiled == NULL) {
 			return false;
 		}
 	}
 
-	compiled_feedback_destroy(surface->feedback);
+	// Compiled feedbacks are shared, so an unchanged feedback is the same
+	// object and doesn't need to be sent again
+	bool changed = surface_get_feedback(surface) !=
+		(compiled != NULL ? compiled : linux_dmabuf->default_feedback);
+
+	compiled_feedback_release(surface->feedback);
 	surface->feedback = compiled;
 
+	if (!changed) {
+		return true;
+	}
+
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &surface->feedback_resources) {
 		feedback_send(surface_get_feedback(surface), resource);
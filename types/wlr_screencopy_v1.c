@@ -13,19 +13,59 @@
 #include "wlr-screencopy-unstable-v1-protocol.h"
 #include "render/pixel_format.h"
 #include "render/wlr_renderer.h"
+#include "types/wlr_output.h"
 
 #define SCREENCOPY_MANAGER_VERSION 3
+// Client buffers whose damage is tracked, per client and output
+#define MAX_BUFFER_DAMAGES 4
+// Above this, copy the damage extents at once instead of each rect
+#define MAX_COPY_RECTS 16
 
 struct screencopy_damage {
 	struct wl_list link;
 	struct wlr_output *output;
 	struct pixman_region32 damage;
+	struct wl_list buffers; // screencopy_buffer_damage.link, most recent first
 	struct wl_listener output_precommit;
 	struct wl_listener output_destroy;
 };
 
+/**
+ * Output damage accumulated since a frame was last copied into a client
+ * buffer. Only this damage needs to be copied when the client reuses the
+ * buffer for the same region, format and cursor mode.
+ */
+struct screencopy_buffer_damage {
+	struct wl_list link;
+	struct wlr_buffer *buffer;
+	struct wlr_box box;
+	uint32_t format;
+	bool overlay_cursor;
+	struct pixman_region32 damage;
+	struct wl_listener buffer_destroy;
+};
+
+/**
+ * A shared memory copy waiting for the pixels to be read back from the GPU.
+ */
+struct screencopy_readback {
+	struct wlr_texture_readback *readback;
+	struct pixman_region32 region; // to copy into the client buffer
+	struct timespec when;
+	bool damage_valid;
+};
+
 static const struct zwlr_screencopy_frame_v1_interface frame_impl;
 
+static void screencopy_readback_destroy(struct screencopy_readback *pending) {
+	if (pending == NULL) {
+		return;
+	}
+	wlr_texture_readback_destroy(pending->readback);
+	pixman_region32_fini(&pending->region);
+	free(pending);
+}
+
 static struct screencopy_damage *screencopy_damage_find(
 		struct wlr_screencopy_v1_client *client,
 		struct wlr_output *output) {
@@ -40,11 +80,8 @@ static struct screencopy_damage *screencopy_damage_find(
 	return NULL;
 }
 
-static void screencopy_damage_accumulate(struct screencopy_damage *damage,
-		const struct wlr_output_state *state) {
-	struct pixman_region32 *region = &damage->damage;
-	struct wlr_output *output = damage->output;
-
+static void accumulate_output_damage(struct pixman_region32 *region,
+		struct wlr_output *output, const struct wlr_output_state *state) {
 	if (state->committed & WLR_OUTPUT_STATE_DAMAGE) {
 		// If the compositor submitted damage, copy it over
 		pixman_region32_union(region, region, &state->damage);
@@ -58,6 +95,67 @@ static void screencopy_damage_accumulate(struct screencopy_damage *damage,
 	}
 }
 
+static void screencopy_buffer_damage_destroy(
+		struct screencopy_buffer_damage *buffer_damage) {
+	wl_list_remove(&buffer_damage->buffer_destroy.link);
+	wl_list_remove(&buffer_damage->link);
+	pixman_region32_fini(&buffer_damage->damage);
+	free(buffer_damage);
+}
+
+static void screencopy_buffer_damage_handle_buffer_destroy(
+		struct wl_listener *listener, void *data) {
+	struct screencopy_buffer_damage *buffer_damage =
+		wl_container_of(listener, buffer_damage, buffer_destroy);
+	screencopy_buffer_damage_destroy(buffer_damage);
+}
+
+static struct screencopy_buffer_damage *screencopy_buffer_damage_find(
+		struct screencopy_damage *damage, struct wlr_buffer *buffer) {
+	struct screencopy_buffer_damage *buffer_damage;
+	wl_list_for_each(buffer_damage, &damage->buffers, link) {
+		if (buffer_damage->buffer == buffer) {
+			return buffer_damage;
+		}
+	}
+	return NULL;
+}
+
+static struct screencopy_buffer_damage *screencopy_buffer_damage_create(
+		struct screencopy_damage *damage, struct wlr_buffer *buffer) {
+	if (wl_list_length(&damage->buffers) >= MAX_BUFFER_DAMAGES) {
+		struct screencopy_buffer_damage *oldest =
+			wl_container_of(damage->buffers.prev, oldest, link);
+		screencopy_buffer_damage_destroy(oldest);
+	}
+
+	struct screencopy_buffer_damage *buffer_damage =
+		calloc(1, sizeof(*buffer_damage));
+	if (buffer_damage == NULL) {
+		return NULL;
+	}
+
+	buffer_damage->buffer = buffer;
+	pixman_region32_init(&buffer_damage->damage);
+	wl_list_insert(&damage->buffers, &buffer_damage->link);
+
+	buffer_damage->buffer_destroy.notify =
+		screencopy_buffer_damage_handle_buffer_destroy;
+	wl_signal_add(&buffer->events.destroy, &buffer_damage->buffer_destroy);
+
+	return buffer_damage;
+}
+
+static void screencopy_damage_accumulate(struct screencopy_damage *damage,
+		const struct wlr_output_state *state) {
+	accumulate_output_damage(&damage->damage, damage->output, state);
+
+	struct screencopy_buffer_damage *buffer_damage;
+	wl_list_for_each(buffer_damage, &damage->buffers, link) {
+		accumulate_output_damage(&buffer_damage->damage, damage->output, state);
+	}
+}
+
 static void screencopy_damage_handle_output_precommit(
 		struct wl_listener *listener, void *data) {
 	struct screencopy_damage *damage =
@@ -67,6 +165,10 @@ static void screencopy_damage_handle_output_precommit(
 }
 
 static void screencopy_damage_destroy(struct screencopy_damage *damage) {
+	struct screencopy_buffer_damage *buffer_damage, *tmp;
+	wl_list_for_each_safe(buffer_damage, tmp, &damage->buffers, link) {
+		screencopy_buffer_damage_destroy(buffer_damage);
+	}
 	wl_list_remove(&damage->output_destroy.link);
 	wl_list_remove(&damage->output_precommit.link);
 	wl_list_remove(&damage->link);
@@ -92,6 +194,7 @@ static struct screencopy_damage *screencopy_damage_create(
 	damage->output = output;
 	pixman_region32_init_rect(&damage->damage, 0, 0, output->width,
 		output->height);
+	wl_list_init(&damage->buffers);
 	wl_list_insert(&client->damages, &damage->link);
 
 	wl_signal_add(&output->events.precommit, &damage->output_precommit);
@@ -143,6 +246,7 @@ static void frame_destroy(struct wlr_screencopy_frame_v1 *frame) {
 			wlr_output_lock_software_cursors(frame->output, false);
 		}
 	}
+	screencopy_readback_destroy(frame->readback);
 	wl_list_remove(&frame->link);
 	wl_list_remove(&frame->output_commit.link);
 	wl_list_remove(&frame->output_destroy.link);
@@ -190,47 +294,283 @@ static void frame_send_ready(struct wlr_screencopy_frame_v1 *frame,
 		tv_sec_hi, tv_sec_lo, when->tv_nsec);
 }
 
+static struct screencopy_buffer_damage *frame_get_buffer_damage(
+		struct wlr_screencopy_frame_v1 *frame, bool *valid) {
+	*valid = false;
+	if (!frame->with_damage || !frame->client->manager->damage_only_copy) {
+		return NULL;
+	}
+
+	struct screencopy_damage *damage =
+		screencopy_damage_get_or_create(frame->client, frame->output);
+	if (damage == NULL) {
+		return NULL;
+	}
+
+	struct screencopy_buffer_damage *buffer_damage =
+		screencopy_buffer_damage_find(damage, frame->buffer);
+	if (buffer_damage != NULL) {
+		*valid = wlr_box_equal(&buffer_damage->box, &frame->box) &&
+			buffer_damage->format == frame->shm_format &&
+			buffer_damage->overlay_cursor == frame->overlay_cursor;
+		wl_list_remove(&buffer_damage->link);
+		wl_list_insert(&damage->buffers, &buffer_damage->link);
+		return buffer_damage;
+	}
+
+	return screencopy_buffer_damage_create(damage, frame->buffer);
+}
+
+static struct screencopy_buffer_damage *frame_get_copy_region(
+		struct wlr_screencopy_frame_v1 *frame, struct pixman_region32 *region,
+		bool *damage_valid) {
+	// The client buffer holds the previous frame if it was copied into it
+	// before, only copy what has changed since
+	struct screencopy_buffer_damage *buffer_damage =
+		frame_get_buffer_damage(frame, damage_valid);
+
+	pixman_region32_init_rect(region, frame->box.x, frame->box.y,
+		frame->box.width, frame->box.height);
+	if (*damage_valid) {
+		pixman_region32_intersect(region, region, &buffer_damage->damage);
+	}
+	return buffer_damage;
+}
+
+static const pixman_box32_t *copy_region_rects(
+		const struct pixman_region32 *region, int *n_rects) {
+	const pixman_box32_t *rects = pixman_region32_rectangles(region, n_rects);
+	if (*n_rects > MAX_COPY_RECTS) {
+		rects = pixman_region32_extents(region);
+		*n_rects = 1;
+	}
+	return rects;
+}
+
+static void buffer_damage_reset(struct screencopy_buffer_damage *buffer_damage,
+		struct wlr_screencopy_frame_v1 *frame) {
+	buffer_damage->box = frame->box;
+	buffer_damage->format = frame->shm_format;
+	buffer_damage->overlay_cursor = frame->overlay_cursor;
+	pixman_region32_clear(&buffer_damage->damage);
+}
+
+static void frame_discard_buffer_damage(struct wlr_screencopy_frame_v1 *frame) {
+	struct screencopy_damage *damage =
+		screencopy_damage_find(frame->client, frame->output);
+	if (damage == NULL) {
+		return;
+	}
+	struct screencopy_buffer_damage *buffer_damage =
+		screencopy_buffer_damage_find(damage, frame->buffer);
+	if (buffer_damage != NULL) {
+		screencopy_buffer_damage_destroy(buffer_damage);
+	}
+}
+
+static void frame_update_shm_stats(struct wlr_screencopy_frame_v1 *frame,
+		bool damage_valid, uint64_t bytes) {
+	struct wlr_screencopy_v1_stats *stats = &frame->client->manager->stats;
+	stats->shm_frames++;
+	if (damage_valid) {
+		stats->shm_damage_frames++;
+	}
+	stats->shm_bytes += bytes;
+	stats->last_shm_bytes = bytes;
+}
+
 static bool frame_shm_copy(struct wlr_screencopy_frame_v1 *frame,
 		struct wlr_buffer *src_buffer) {
 	struct wlr_output *output = frame->output;
-	struct wlr_renderer *renderer = output->renderer;
-	assert(renderer);
+	assert(output->renderer);
+
+	const struct wlr_pixel_format_info *info =
+		drm_get_pixel_format_info(frame->shm_format);
+	assert(info);
+
+	bool damage_valid;
+	struct pixman_region32 region;
+	struct screencopy_buffer_damage *buffer_damage =
+		frame_get_copy_region(frame, &region, &damage_valid);
+
+	int n_rects;
+	const pixman_box32_t *rects = copy_region_rects(&region, &n_rects);
 
 	void *data;
 	uint32_t format;
 	size_t stride;
 	if (!wlr_buffer_begin_data_ptr_access(frame->buffer,
 			WLR_BUFFER_DATA_PTR_ACCESS_WRITE, &data, &format, &stride)) {
+		pixman_region32_fini(&region);
 		return false;
 	}
 
 	bool ok = false;
+	uint64_t bytes = 0;
 
-	struct wlr_texture *texture = wlr_texture_from_buffer(renderer, src_buffer);
+	struct wlr_texture *texture = output_capture_acquire_texture(output, src_buffer);
 	if (!texture) {
 		wlr_log(WLR_DEBUG, "Failed to grab a texture from a buffer during shm screencopy");
 		goto out;
 	}
 
-	ok = wlr_texture_read_pixels(texture, &(struct wlr_texture_read_pixels_options) {
-		.data = data,
-		.format = format,
-		.stride = stride,
-		.src_box = frame->box,
-	});
+	ok = true;
+	for (int i = 0; i < n_rects && ok; i++) {
+		const pixman_box32_t *rect = &rects[i];
+		struct wlr_box src_box = {
+			.x = rect->x1,
+			.y = rect->y1,
+			.width = rect->x2 - rect->x1,
+			.height = rect->y2 - rect->y1,
+		};
+		ok = wlr_texture_read_pixels(texture, &(struct wlr_texture_read_pixels_options) {
+			.data = data,
+			.format = format,
+			.stride = stride,
+			.dst_x = src_box.x - frame->box.x,
+			.dst_y = src_box.y - frame->box.y,
+			.src_box = src_box,
+		});
+		bytes += (uint64_t)pixel_format_info_min_stride(info, src_box.width) *
+			src_box.height;
+	}
 
-	wlr_texture_destroy(texture);
+	output_capture_release_texture(output, texture);
 
 out:
 	wlr_buffer_end_data_ptr_access(frame->buffer);
+	pixman_region32_fini(&region);
 
 	if (!ok) {
 		wlr_log(WLR_DEBUG, "Failed to copy to destination during shm screencopy");
+		if (buffer_damage != NULL) {
+			screencopy_buffer_damage_destroy(buffer_damage);
+		}
+		return false;
+	}
+
+	if (buffer_damage != NULL) {
+		buffer_damage_reset(buffer_damage, frame);
+	}
+	frame_update_shm_stats(frame, damage_valid, bytes);
+	return true;
+}
+
+static bool frame_copy_readback(struct wlr_screencopy_frame_v1 *frame,
+		struct screencopy_readback *pending, uint64_t *bytes) {
+	const struct wlr_pixel_format_info *info =
+		drm_get_pixel_format_info(frame->shm_format);
+	assert(info);
+
+	void *data;
+	uint32_t format;
+	size_t stride;
+	if (!wlr_buffer_begin_data_ptr_access(frame->buffer,
+			WLR_BUFFER_DATA_PTR_ACCESS_WRITE, &data, &format, &stride)) {
+		return false;
+	}
+
+	int n_rects;
+	const pixman_box32_t *rects = copy_region_rects(&pending->region, &n_rects);
+
+	bool ok = true;
+	for (int i = 0; i < n_rects && ok; i++) {
+		const pixman_box32_t *rect = &rects[i];
+		struct wlr_box src_box = {
+			.x = rect->x1,
+			.y = rect->y1,
+			.width = rect->x2 - rect->x1,
+			.height = rect->y2 - rect->y1,
+		};
+		ok = wlr_texture_readback_copy(pending->readback,
+			&(struct wlr_texture_read_pixels_options) {
+				.data = data,
+				.format = format,
+				.stride = stride,
+				.dst_x = src_box.x - frame->box.x,
+				.dst_y = src_box.y - frame->box.y,
+				.src_box = src_box,
+			});
+		*bytes += (uint64_t)pixel_format_info_min_stride(info, src_box.width) *
+			src_box.height;
 	}
 
+	wlr_buffer_end_data_ptr_access(frame->buffer);
 	return ok;
 }
 
+static void frame_handle_readback_ready(struct wlr_texture_readback *readback) {
+	struct wlr_screencopy_frame_v1 *frame = readback->data;
+	struct screencopy_readback *pending = frame->readback;
+	frame->readback = NULL;
+
+	uint64_t bytes = 0;
+	if (frame_copy_readback(frame, pending, &bytes)) {
+		frame_update_shm_stats(frame, pending->damage_valid, bytes);
+		frame_send_ready(frame, &pending->when);
+	} else {
+		wlr_log(WLR_DEBUG, "Failed to copy to destination during shm screencopy");
+		frame_discard_buffer_damage(frame);
+		zwlr_screencopy_frame_v1_send_failed(frame->resource);
+	}
+
+	screencopy_readback_destroy(pending);
+	frame_destroy(frame);
+}
+
+/**
+ * Start reading back the region to copy without waiting for the GPU. Returns
+ * false if the renderer can't, in which case nothing has been done.
+ */
+static bool frame_shm_copy_async(struct wlr_screencopy_frame_v1 *frame,
+		struct wlr_buffer *src_buffer, const struct timespec *when) {
+	assert(frame->output->renderer);
+
+	struct screencopy_readback *pending = calloc(1, sizeof(*pending));
+	if (pending == NULL) {
+		return false;
+	}
+	pending->when = *when;
+
+	struct screencopy_buffer_damage *buffer_damage =
+		frame_get_copy_region(frame, &pending->region, &pending->damage_valid);
+	if (pixman_region32_empty(&pending->region)) {
+		// Nothing to read back
+		screencopy_readback_destroy(pending);
+		return false;
+	}
+
+	// Read back the extents of the region, only its rects are copied into
+	// the client buffer
+	const pixman_box32_t *extents = pixman_region32_extents(&pending->region);
+	struct wlr_box src_box = {
+		.x = extents->x1,
+		.y = extents->y1,
+		.width = extents->x2 - extents->x1,
+		.height = extents->y2 - extents->y1,
+	};
+
+	// Other clients capturing the same region share the read-back
+	pending->readback = output_capture_read_pixels_async(frame->output,
+		src_buffer, &(struct wlr_texture_read_pixels_options) {
+			.format = frame->shm_format,
+			.src_box = src_box,
+		}, frame_handle_readback_ready, frame);
+	if (pending->readback == NULL) {
+		screencopy_readback_destroy(pending);
+		return false;
+	}
+
+	// The damage tracked for the buffer is copied by this frame, later
+	// output damage accumulates for the next one
+	if (buffer_damage != NULL) {
+		buffer_damage_reset(buffer_damage, frame);
+	}
+
+	frame->readback = pending;
+	return true;
+}
+
 static bool frame_dma_copy(struct wlr_screencopy_frame_v1 *frame,
 		struct wlr_buffer *src_buffer) {
 	struct wlr_buffer *dst_buffer = frame->buffer;
@@ -239,7 +579,7 @@ static bool frame_dma_copy(struct wlr_screencopy_frame_v1 *frame,
 	assert(renderer);
 
 	struct wlr_texture *src_tex =
-		wlr_texture_from_buffer(renderer, src_buffer);
+		output_capture_acquire_texture(output, src_buffer);
 	if (src_tex == NULL) {
 		wlr_log(WLR_DEBUG, "Failed to grab a texture from a buffer during dma screencopy");
 		return false;
@@ -271,7 +611,7 @@ static bool frame_dma_copy(struct wlr_screencopy_frame_v1 *frame,
 	ok = wlr_render_pass_submit(pass);
 
 out:
-	wlr_texture_destroy(src_tex);
+	output_capture_release_texture(output, src_tex);
 
 	if (!ok) {
 		wlr_log(WLR_DEBUG, "Failed to render to destination during dma screencopy");
@@ -324,6 +664,13 @@ static void frame_handle_output_commit(struct wl_listener *listener,
 		}
 		break;
 	case WLR_BUFFER_CAP_DATA_PTR:
+		if (frame_shm_copy_async(frame, src_buffer, &event->when)) {
+			// Ready is sent once the pixels land, see
+			// frame_handle_readback_ready()
+			zwlr_screencopy_frame_v1_send_flags(frame->resource, 0);
+			frame_send_damage(frame);
+			return;
+		}
 		if (!frame_shm_copy(frame, src_buffer)) {
 			goto err;
 		}
@@ -726,3 +1073,14 @@ struct wlr_screencopy_manager_v1 *wlr_screencopy_manager_v1_create(
 
 	return manager;
 }
+
+void wlr_screencopy_manager_v1_set_damage_only_copy(
+		struct wlr_screencopy_manager_v1 *manager, bool enabled) {
+	manager->damage_only_copy = enabled;
+}
+
+void wlr_screencopy_manager_v1_get_stats(
+		struct wlr_screencopy_manager_v1 *manager,
+		struct wlr_screencopy_v1_stats *stats) {
+	*stats = manager->stats;
+}
@@ -1,10 +1,74 @@
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wayland-server-core.h>
 #include <wlr/util/addon.h>
 #include <wlr/util/log.h>
 
+// Sets with more than this many addons get an index. The index is dropped
+// once the set shrinks to half of that, to avoid rebuilding it repeatedly.
+#define ADDON_INDEX_THRESHOLD 8
+
+static size_t addon_hash(const void *owner, const struct wlr_addon_interface *impl) {
+	uint64_t hash = (uint64_t)(uintptr_t)owner * 0x9E3779B97F4A7C15;
+	hash ^= (uint64_t)(uintptr_t)impl * 0xC2B2AE3D27D4EB4F;
+	return hash ^ (hash >> 32);
+}
+
+static void index_insert(struct wlr_addon_set *set, struct wlr_addon *addon) {
+	size_t mask = set->index_cap - 1;
+	size_t i = addon_hash(addon->owner, addon->impl) & mask;
+	while (set->index[i] != NULL) {
+		i = (i + 1) & mask;
+	}
+	set->index[i] = addon;
+}
+
+static void index_remove(struct wlr_addon_set *set, struct wlr_addon *addon) {
+	size_t mask = set->index_cap - 1;
+	size_t i = addon_hash(addon->owner, addon->impl) & mask;
+	while (set->index[i] != addon) {
+		assert(set->index[i] != NULL);
+		i = (i + 1) & mask;
+	}
+
+	// Shift back the following entries of the probe sequence, so that
+	// lookups don't stop early at the hole
+	size_t j = i;
+	while (true) {
+		j = (j + 1) & mask;
+		struct wlr_addon *next = set->index[j];
+		if (next == NULL) {
+			break;
+		}
+		size_t k = addon_hash(next->owner, next->impl) & mask;
+		bool in_place = i < j ? (i < k && k <= j) : (i < k || k <= j);
+		if (in_place) {
+			continue;
+		}
+		set->index[i] = next;
+		i = j;
+	}
+	set->index[i] = NULL;
+}
+
+static void index_rebuild(struct wlr_addon_set *set, size_t cap) {
+	free(set->index);
+	set->index = calloc(cap, sizeof(*set->index));
+	if (set->index == NULL) {
+		// Fall back to searching the list
+		set->index_cap = 0;
+		return;
+	}
+	set->index_cap = cap;
+
+	struct wlr_addon *addon;
+	wl_list_for_each(addon, &set->addons, link) {
+		index_insert(set, addon);
+	}
+}
+
 void wlr_addon_set_init(struct wlr_addon_set *set) {
 	*set = (struct wlr_addon_set){0};
 	wl_list_init(&set->addons);
@@ -21,30 +85,69 @@ void wlr_addon_set_finish(struct wlr_addon_set *set) {
 			abort();
 		}
 	}
+
+	free(set->index);
+	set->index = NULL;
+	set->index_cap = 0;
 }
 
 void wlr_addon_init(struct wlr_addon *addon, struct wlr_addon_set *set,
 		const void *owner, const struct wlr_addon_interface *impl) {
 	assert(impl);
+	assert(wlr_addon_find(set, owner, impl) == NULL &&
+		"Can't have two addons of the same type with the same owner");
 	*addon = (struct wlr_addon){
 		.impl = impl,
 		.owner = owner,
+		.set = set,
 	};
-	struct wlr_addon *iter;
-	wl_list_for_each(iter, &set->addons, link) {
-		if (iter->owner == addon->owner && iter->impl == addon->impl) {
-			assert(0 && "Can't have two addons of the same type with the same owner");
-		}
-	}
 	wl_list_insert(&set->addons, &addon->link);
+	set->len++;
+
+	if (set->index_cap == 0 && set->len <= ADDON_INDEX_THRESHOLD) {
+		return;
+	}
+	// Keep the load factor at most 1/2
+	if (set->len * 2 > set->index_cap) {
+		size_t cap = set->index_cap > 0 ? set->index_cap * 2 : 4 * ADDON_INDEX_THRESHOLD;
+		index_rebuild(set, cap);
+	} else {
+		index_insert(set, addon);
+	}
 }
 
 void wlr_addon_finish(struct wlr_addon *addon) {
+	struct wlr_addon_set *set = addon->set;
 	wl_list_remove(&addon->link);
+	set->len--;
+
+	if (set->index_cap == 0) {
+		return;
+	}
+	if (set->len <= ADDON_INDEX_THRESHOLD / 2) {
+		free(set->index);
+		set->index = NULL;
+		set->index_cap = 0;
+	} else {
+		index_remove(set, addon);
+	}
 }
 
 struct wlr_addon *wlr_addon_find(struct wlr_addon_set *set, const void *owner,
 		const struct wlr_addon_interface *impl) {
+	if (set->index_cap > 0) {
+		size_t mask = set->index_cap - 1;
+		size_t i = addon_hash(owner, impl) & mask;
+		while (set->index[i] != NULL) {
+			struct wlr_addon *addon = set->index[i];
+			if (addon->owner == owner && addon->impl == impl) {
+				return addon;
+			}
+			i = (i + 1) & mask;
+		}
+		return NULL;
+	}
+
 	struct wlr_addon *addon;
 	wl_list_for_each(addon, &set->addons, link) {
 		if (addon->owner == owner && addon->impl == impl) {
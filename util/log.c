@@ -7,9 +7,11 @@
 #include <unistd.h>
 #include <wayland-server-core.h>
 #include <wlr/util/log.h>
+#include "util/log.h"
 #include "util/time.h"
 
 static bool colored = true;
+static bool stderr_is_tty = false;
 static enum wlr_log_importance log_importance = WLR_ERROR;
 static struct timespec start_time = {-1};
 
@@ -32,54 +34,77 @@ static void init_start_time(void) {
 		return;
 	}
 	clock_gettime(CLOCK_MONOTONIC, &start_time);
+	// Checked once instead of for each message, see wlr_log_init()
+	stderr_is_tty = isatty(STDERR_FILENO);
 }
 
-static void log_stderr(enum wlr_log_importance verbosity, const char *fmt,
-		va_list args) {
+int64_t log_get_elapsed_nsec(void) {
 	init_start_time();
 
-	if (verbosity > log_importance) {
-		return;
-	}
-
 	struct timespec ts = {0};
 	clock_gettime(CLOCK_MONOTONIC, &ts);
-	timespec_sub(&ts, &ts, &start_time);
+	return timespec_to_nsec(&ts) - timespec_to_nsec(&start_time);
+}
 
-	fprintf(stderr, "%02d:%02d:%02d.%03ld ", (int)(ts.tv_sec / 60 / 60),
-		(int)(ts.tv_sec / 60 % 60), (int)(ts.tv_sec % 60),
-		ts.tv_nsec / 1000000);
+int log_format_prefix(char *buf, size_t size, int64_t elapsed_nsec,
+		enum wlr_log_importance verbosity, bool colored) {
+	struct timespec ts;
+	timespec_from_nsec(&ts, elapsed_nsec);
 
 	unsigned c = (verbosity < WLR_LOG_IMPORTANCE_LAST) ? verbosity : WLR_LOG_IMPORTANCE_LAST - 1;
 
-	if (colored && isatty(STDERR_FILENO)) {
-		fprintf(stderr, "%s", verbosity_colors[c]);
-	} else {
-		fprintf(stderr, "%s ", verbosity_headers[c]);
+	return snprintf(buf, size, "%02d:%02d:%02d.%03ld %s%s",
+		(int)(ts.tv_sec / 60 / 60), (int)(ts.tv_sec / 60 % 60),
+		(int)(ts.tv_sec % 60), ts.tv_nsec / 1000000,
+		colored ? verbosity_colors[c] : verbosity_headers[c],
+		colored ? "" : " ");
+}
+
+void log_stderr(enum wlr_log_importance verbosity, const char *fmt,
+		va_list args) {
+	init_start_time();
+
+	if (verbosity > log_importance) {
+		return;
 	}
 
+	bool use_colors = colored && stderr_is_tty;
+
+	char prefix[64];
+	log_format_prefix(prefix, sizeof(prefix), log_get_elapsed_nsec(),
+		verbosity, use_colors);
+	fputs(prefix, stderr);
+
 	vfprintf(stderr, fmt, args);
 
-	if (colored && isatty(STDERR_FILENO)) {
-		fprintf(stderr, "\x1B[0m");
+	if (use_colors) {
+		fputs(LOG_COLOR_RESET, stderr);
 	}
-	fprintf(stderr, "\n");
+	fputc('\n', stderr);
 }
 
 static wlr_log_func_t log_callback = log_stderr;
 
 static void log_wl(const char *fmt, va_list args) {
-	static char wlr_fmt[1024];
-	int n = snprintf(wlr_fmt, sizeof(wlr_fmt), "[wayland] %s", fmt);
-	size_t len = strlen(wlr_fmt);
-	if (n > 0 && wlr_fmt[len - 1] == '\n') {
-		wlr_fmt[len - 1] = '\0';
+	if (WLR_INFO > log_importance) {
+		return;
+	}
+
+	// libwayland messages end with a newline, which needs to be stripped
+	char msg[1024];
+	if (vsnprintf(msg, sizeof(msg), fmt, args) < 0) {
+		return;
+	}
+	size_t len = strlen(msg);
+	if (len > 0 && msg[len - 1] == '\n') {
+		msg[len - 1] = '\0';
 	}
-	_wlr_vlog(WLR_INFO, wlr_fmt, args);
+	_wlr_log(WLR_INFO, "[wayland] %s", msg);
 }
 
 void wlr_log_init(enum wlr_log_importance verbosity, wlr_log_func_t callback) {
 	init_start_time();
+	stderr_is_tty = isatty(STDERR_FILENO);
 
 	if (verbosity < WLR_LOG_IMPORTANCE_LAST) {
 		log_importance = verbosity;
@@ -0,0 +1,991 @@
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "util/log.h"
+
+#ifdef __STDC_NO_ATOMICS__
+#error "C11 atomics are required"
+#endif
+
+#define DEFAULT_BUFFER_SIZE (1 << 20)
+#define MIN_BUFFER_SIZE 4096
+#define MAX_BUFFER_SIZE (1 << 30)
+// Longer messages are truncated
+#define MAX_MESSAGE_SIZE 1024
+#define OUT_BUFFER_SIZE 65536
+#define FLUSH_INTERVAL_NSEC 10000000
+
+/**
+ * The ring buffer is a byte array holding variable-sized records. Producers
+ * reserve space by advancing the head, then write their record and publish
+ * it by storing its size last. The flush thread consumes published records in
+ * order, zeroes them and advances the tail. Unused space is always zeroed, so
+ * a zero size means that the record at the tail isn't published yet.
+ *
+ * Records never wrap around the end of the buffer: a padding record fills the
+ * remaining space instead.
+ */
+
+enum log_record_type {
+	LOG_RECORD_PADDING,
+	LOG_RECORD_TEXT, // NUL-terminated line
+	LOG_RECORD_BINARY, // struct log_binary_message followed by arguments
+	LOG_RECORD_FORMAT, // format address followed by a NUL-terminated string
+};
+
+struct log_ring_record {
+	// Size including this header, a multiple of 8. Zero until published.
+	_Atomic uint32_t size;
+	uint32_t type;
+};
+
+/**
+ * Binary output is a magic string followed by records laid out like in the
+ * ring buffer. Format strings are written once before the first message
+ * using them.
+ */
+static const char binary_magic[8] = "WLRLOG1\n";
+
+struct log_stream_record {
+	uint32_t size;
+	uint32_t type;
+};
+
+struct log_binary_message {
+	int64_t elapsed_nsec;
+	uint64_t format; // address of the format string
+	uint32_t verbosity;
+	uint32_t padding;
+	// Followed by one 8-byte slot per argument, strings are stored as a
+	// length slot followed by the padded characters
+};
+
+struct log_format_entry {
+	uint64_t address; // zero if unused
+	char *str; // only set when decoding
+};
+
+struct log_format_table {
+	struct log_format_entry *entries;
+	size_t len, cap;
+};
+
+struct log_async {
+	uint8_t *data;
+	size_t size; // a power of two
+	atomic_size_t head, tail;
+	atomic_bool stop;
+
+	int fd;
+	bool binary, colored;
+	pthread_t thread;
+
+	// Only accessed by the flush thread
+	size_t dropped_reported;
+	struct log_format_table formats;
+	uint8_t out[OUT_BUFFER_SIZE];
+	size_t out_len;
+};
+
+static struct log_async *log_async = NULL;
+static atomic_size_t log_dropped = 0;
+
+static size_t align8(size_t size) {
+	return (size + 7) & ~(size_t)7;
+}
+
+static struct log_format_entry *format_table_find(
+		struct log_format_table *table, uint64_t address) {
+	if (table->cap == 0) {
+		return NULL;
+	}
+	size_t mask = table->cap - 1;
+	for (size_t i = (address * 0x9E3779B97F4A7C15) >> 32 & mask;; i = (i + 1) & mask) {
+		struct log_format_entry *entry = &table->entries[i];
+		if (entry->address == address || entry->address == 0) {
+			return entry;
+		}
+	}
+}
+
+static struct log_format_entry *format_table_add(
+		struct log_format_table *table, uint64_t address) {
+	if (2 * (table->len + 1) > table->cap) {
+		size_t cap = table->cap == 0 ? 64 : 2 * table->cap;
+		struct log_format_table grown = {
+			.entries = calloc(cap, sizeof(grown.entries[0])),
+			.len = table->len,
+			.cap = cap,
+		};
+		if (grown.entries == NULL) {
+			return NULL;
+		}
+		for (size_t i = 0; i < table->cap; i++) {
+			if (table->entries[i].address != 0) {
+				*format_table_find(&grown, table->entries[i].address) =
+					table->entries[i];
+			}
+		}
+		free(table->entries);
+		*table = grown;
+	}
+
+	struct log_format_entry *entry = format_table_find(table, address);
+	if (entry->address == 0) {
+		entry->address = address;
+		table->len++;
+	}
+	return entry;
+}
+
+static void format_table_finish(struct log_format_table *table) {
+	for (size_t i = 0; i < table->cap; i++) {
+		free(table->entries[i].str);
+	}
+	free(table->entries);
+}
+
+enum log_arg_type {
+	LOG_ARG_NONE, // "%%"
+	LOG_ARG_INT,
+	LOG_ARG_UINT,
+	LOG_ARG_CHAR,
+	LOG_ARG_DOUBLE,
+	LOG_ARG_STRING,
+	LOG_ARG_POINTER,
+};
+
+enum log_arg_length {
+	LOG_LENGTH_DEFAULT,
+	LOG_LENGTH_HH,
+	LOG_LENGTH_H,
+	LOG_LENGTH_L,
+	LOG_LENGTH_LL,
+	LOG_LENGTH_J,
+	LOG_LENGTH_Z,
+	LOG_LENGTH_T,
+	LOG_LENGTH_LONG_DOUBLE,
+};
+
+struct log_conversion {
+	size_t len; // length of the whole conversion specification
+	size_t prefix_len; // length of '%', flags, width and precision
+	int n_stars; // number of '*' width and precision arguments
+	bool star_precision;
+	int precision; // -1 if unset or passed as an argument
+	enum log_arg_length length;
+	enum log_arg_type type;
+	char conversion;
+};
+
+/**
+ * Parse the printf conversion specification starting at p, which points to
+ * a '%'. Positional arguments, "%n" and wide characters are unsupported.
+ */
+static bool parse_conversion(const char *p, struct log_conversion *conv) {
+	const char *start = p;
+	assert(*p == '%');
+	p++;
+	*conv = (struct log_conversion){ .precision = -1 };
+
+	p += strspn(p, "-+ #0'");
+	if (*p == '*') {
+		conv->n_stars++;
+		p++;
+	} else {
+		p += strspn(p, "0123456789");
+	}
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			conv->n_stars++;
+			conv->star_precision = true;
+			p++;
+		} else {
+			conv->precision = 0;
+			while (*p >= '0' && *p <= '9' && conv->precision < MAX_MESSAGE_SIZE) {
+				conv->precision = conv->precision * 10 + (*p - '0');
+				p++;
+			}
+			p += strspn(p, "0123456789");
+		}
+	}
+	conv->prefix_len = p - start;
+
+	switch (*p) {
+	case 'h':
+		conv->length = p[1] == 'h' ? LOG_LENGTH_HH : LOG_LENGTH_H;
+		break;
+	case 'l':
+		conv->length = p[1] == 'l' ? LOG_LENGTH_LL : LOG_LENGTH_L;
+		break;
+	case 'q':
+		conv->length = LOG_LENGTH_LL;
+		break;
+	case 'j':
+		conv->length = LOG_LENGTH_J;
+		break;
+	case 'z':
+		conv->length = LOG_LENGTH_Z;
+		break;
+	case 't':
+		conv->length = LOG_LENGTH_T;
+		break;
+	case 'L':
+		conv->length = LOG_LENGTH_LONG_DOUBLE;
+		break;
+	}
+	if (conv->length == LOG_LENGTH_HH || (conv->length == LOG_LENGTH_LL && *p == 'l')) {
+		p += 2;
+	} else if (conv->length != LOG_LENGTH_DEFAULT) {
+		p++;
+	}
+
+	conv->conversion = *p;
+	switch (*p) {
+	case '%':
+		conv->type = LOG_ARG_NONE;
+		break;
+	case 'd':
+	case 'i':
+		conv->type = LOG_ARG_INT;
+		break;
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+		conv->type = LOG_ARG_UINT;
+		break;
+	case 'c':
+		conv->type = LOG_ARG_CHAR;
+		break;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		conv->type = LOG_ARG_DOUBLE;
+		break;
+	case 's':
+		conv->type = LOG_ARG_STRING;
+		break;
+	case 'p':
+		conv->type = LOG_ARG_POINTER;
+		break;
+	default:
+		return false;
+	}
+	p++;
+	conv->len = p - start;
+
+	bool double_length = conv->length == LOG_LENGTH_DEFAULT ||
+		conv->length == LOG_LENGTH_L || conv->length == LOG_LENGTH_LONG_DOUBLE;
+	switch (conv->type) {
+	case LOG_ARG_INT:
+	case LOG_ARG_UINT:
+		return conv->length != LOG_LENGTH_LONG_DOUBLE;
+	case LOG_ARG_DOUBLE:
+		return double_length;
+	case LOG_ARG_NONE:
+	case LOG_ARG_CHAR:
+	case LOG_ARG_STRING:
+	case LOG_ARG_POINTER:
+		return conv->length == LOG_LENGTH_DEFAULT;
+	}
+	abort(); // unreachable
+}
+
+struct log_encoder {
+	uint8_t *data;
+	size_t len, cap;
+};
+
+static bool encode_u64(struct log_encoder *enc, uint64_t value) {
+	if (enc->cap - enc->len < sizeof(value)) {
+		return false;
+	}
+	memcpy(&enc->data[enc->len], &value, sizeof(value));
+	enc->len += sizeof(value);
+	return true;
+}
+
+static int64_t read_int_arg(enum log_arg_length length, va_list *args) {
+	switch (length) {
+	case LOG_LENGTH_HH:
+		return (signed char)va_arg(*args, int);
+	case LOG_LENGTH_H:
+		return (short)va_arg(*args, int);
+	case LOG_LENGTH_L:
+		return va_arg(*args, long);
+	case LOG_LENGTH_LL:
+		return va_arg(*args, long long);
+	case LOG_LENGTH_J:
+		return va_arg(*args, intmax_t);
+	case LOG_LENGTH_Z:
+		return va_arg(*args, ssize_t);
+	case LOG_LENGTH_T:
+		return va_arg(*args, ptrdiff_t);
+	default:
+		return va_arg(*args, int);
+	}
+}
+
+static uint64_t read_uint_arg(enum log_arg_length length, va_list *args) {
+	switch (length) {
+	case LOG_LENGTH_HH:
+		return (unsigned char)va_arg(*args, unsigned int);
+	case LOG_LENGTH_H:
+		return (unsigned short)va_arg(*args, unsigned int);
+	case LOG_LENGTH_L:
+		return va_arg(*args, unsigned long);
+	case LOG_LENGTH_LL:
+		return va_arg(*args, unsigned long long);
+	case LOG_LENGTH_J:
+		return va_arg(*args, uintmax_t);
+	case LOG_LENGTH_Z:
+		return va_arg(*args, size_t);
+	case LOG_LENGTH_T:
+		return (size_t)va_arg(*args, ptrdiff_t);
+	default:
+		return va_arg(*args, unsigned int);
+	}
+}
+
+/**
+ * Store the arguments referenced by fmt. Returns false if a conversion is
+ * unsupported or if the arguments don't fit.
+ */
+static bool encode_args(struct log_encoder *enc, const char *fmt,
+		va_list *args) {
+	for (const char *p = strchr(fmt, '%'); p != NULL; p = strchr(p, '%')) {
+		struct log_conversion conv;
+		if (!parse_conversion(p, &conv)) {
+			return false;
+		}
+		p += conv.len;
+
+		int precision = conv.precision;
+		for (int i = 0; i < conv.n_stars; i++) {
+			int value = va_arg(*args, int);
+			if (conv.star_precision && i == conv.n_stars - 1) {
+				precision = value;
+			}
+			if (!encode_u64(enc, (uint64_t)(int64_t)value)) {
+				return false;
+			}
+		}
+
+		uint64_t value = 0;
+		switch (conv.type) {
+		case LOG_ARG_NONE:
+			continue;
+		case LOG_ARG_INT:
+			value = (uint64_t)read_int_arg(conv.length, args);
+			break;
+		case LOG_ARG_UINT:
+			value = read_uint_arg(conv.length, args);
+			break;
+		case LOG_ARG_CHAR:
+			value = (uint64_t)(int64_t)va_arg(*args, int);
+			break;
+		case LOG_ARG_DOUBLE:;
+			double d = conv.length == LOG_LENGTH_LONG_DOUBLE ?
+				(double)va_arg(*args, long double) : va_arg(*args, double);
+			memcpy(&value, &d, sizeof(value));
+			break;
+		case LOG_ARG_POINTER:
+			value = (uintptr_t)va_arg(*args, void *);
+			break;
+		case LOG_ARG_STRING:;
+			const char *str = va_arg(*args, const char *);
+			if (str == NULL) {
+				str = "(null)";
+			}
+			size_t len = precision >= 0 ? strnlen(str, precision) : strlen(str);
+			if (!encode_u64(enc, len) || enc->cap - enc->len < align8(len)) {
+				return false;
+			}
+			memcpy(&enc->data[enc->len], str, len);
+			memset(&enc->data[enc->len + len], 0, align8(len) - len);
+			enc->len += align8(len);
+			continue;
+		}
+		if (!encode_u64(enc, value)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Store the formatted message as the only argument of a "%s" format, for
+ * messages which can't be encoded.
+ */
+static void encode_formatted(struct log_encoder *enc,
+		const char *fmt, va_list args) {
+	static const char formatted_fmt[] = "%s";
+	struct log_binary_message msg;
+	memcpy(&msg, enc->data, sizeof(msg));
+	msg.format = (uintptr_t)formatted_fmt;
+	memcpy(enc->data, &msg, sizeof(msg));
+	enc->len = sizeof(msg);
+
+	char text[MAX_MESSAGE_SIZE / 2];
+	int n = vsnprintf(text, sizeof(text), fmt, args);
+	size_t len = n < 0 ? 0 : (size_t)n < sizeof(text) ? (size_t)n : sizeof(text) - 1;
+	encode_u64(enc, len);
+	memcpy(&enc->data[enc->len], text, len);
+	memset(&enc->data[enc->len + len], 0, align8(len) - len);
+	enc->len += align8(len);
+}
+
+static size_t encode_binary_message(uint8_t *buf, size_t size,
+		enum wlr_log_importance verbosity, int64_t elapsed_nsec,
+		const char *fmt, va_list args) {
+	struct log_binary_message msg = {
+		.elapsed_nsec = elapsed_nsec,
+		.format = (uintptr_t)fmt,
+		.verbosity = verbosity,
+	};
+	assert(size >= sizeof(msg) + MAX_MESSAGE_SIZE / 2 + sizeof(uint64_t));
+	memcpy(buf, &msg, sizeof(msg));
+
+	struct log_encoder enc = {
+		.data = buf,
+		.len = sizeof(msg),
+		.cap = size,
+	};
+	va_list encoded_args;
+	va_copy(encoded_args, args);
+	bool ok = encode_args(&enc, fmt, &encoded_args);
+	va_end(encoded_args);
+	if (!ok) {
+		encode_formatted(&enc, fmt, args);
+	}
+	return enc.len;
+}
+
+static size_t encode_text_message(uint8_t *buf, size_t size, bool colored,
+		enum wlr_log_importance verbosity, int64_t elapsed_nsec,
+		const char *fmt, va_list args) {
+	char *str = (char *)buf;
+	// Leave room for the color reset, the newline and the NUL terminator
+	size_t avail = size - sizeof(LOG_COLOR_RESET) - 1;
+
+	int n = log_format_prefix(str, avail, elapsed_nsec, verbosity, colored);
+	size_t len = n < 0 ? 0 : (size_t)n < avail ? (size_t)n : avail - 1;
+	n = vsnprintf(&str[len], avail - len, fmt, args);
+	len += n < 0 ? 0 : (size_t)n < avail - len ? (size_t)n : avail - len - 1;
+
+	if (colored) {
+		memcpy(&str[len], LOG_COLOR_RESET, strlen(LOG_COLOR_RESET));
+		len += strlen(LOG_COLOR_RESET);
+	}
+	str[len++] = '\n';
+	str[len++] = '\0';
+	return len;
+}
+
+static size_t encode_message(struct log_async *async, uint8_t *buf,
+		size_t size, enum wlr_log_importance verbosity, const char *fmt,
+		va_list args) {
+	int64_t elapsed_nsec = log_get_elapsed_nsec();
+	if (async->binary) {
+		return encode_binary_message(buf, size, verbosity, elapsed_nsec,
+			fmt, args);
+	} else {
+		return encode_text_message(buf, size, async->colored, verbosity,
+			elapsed_nsec, fmt, args);
+	}
+}
+
+static void ring_push(struct log_async *async, enum log_record_type type,
+		const void *payload, size_t payload_len) {
+	size_t record_size = align8(sizeof(struct log_ring_record) + payload_len);
+	assert(record_size <= async->size / 2);
+
+	size_t head = atomic_load_explicit(&async->head, memory_order_relaxed);
+	size_t offset, pad;
+	do {
+		offset = head & (async->size - 1);
+		pad = offset + record_size > async->size ? async->size - offset : 0;
+		size_t tail = atomic_load_explicit(&async->tail, memory_order_acquire);
+		if (head + pad + record_size - tail > async->size) {
+			atomic_fetch_add_explicit(&log_dropped, 1, memory_order_relaxed);
+			return;
+		}
+	} while (!atomic_compare_exchange_weak_explicit(&async->head, &head,
+		head + pad + record_size, memory_order_relaxed, memory_order_relaxed));
+
+	if (pad > 0) {
+		struct log_ring_record *padding = (void *)&async->data[offset];
+		padding->type = LOG_RECORD_PADDING;
+		atomic_store_explicit(&padding->size, pad, memory_order_release);
+		offset = 0;
+	}
+
+	struct log_ring_record *record = (void *)&async->data[offset];
+	record->type = type;
+	memcpy(record + 1, payload, payload_len);
+	atomic_store_explicit(&record->size, record_size, memory_order_release);
+}
+
+static void log_async_write(enum wlr_log_importance verbosity,
+		const char *fmt, va_list args) {
+	if (verbosity > wlr_log_get_verbosity()) {
+		return;
+	}
+
+	struct log_async *async = log_async;
+	_Alignas(uint64_t) uint8_t buf[MAX_MESSAGE_SIZE];
+	size_t len = encode_message(async, buf, sizeof(buf), verbosity, fmt, args);
+	ring_push(async, async->binary ? LOG_RECORD_BINARY : LOG_RECORD_TEXT,
+		buf, len);
+}
+
+static void write_all(int fd, const uint8_t *data, size_t len) {
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		} else if (n <= 0) {
+			// Nowhere to report the error
+			return;
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+static void out_flush(struct log_async *async) {
+	write_all(async->fd, async->out, async->out_len);
+	async->out_len = 0;
+}
+
+static void out_append(struct log_async *async, const void *data, size_t len) {
+	if (async->out_len + len > sizeof(async->out)) {
+		out_flush(async);
+	}
+	if (len > sizeof(async->out)) {
+		write_all(async->fd, data, len);
+		return;
+	}
+	memcpy(&async->out[async->out_len], data, len);
+	async->out_len += len;
+}
+
+static void out_append_record(struct log_async *async,
+		enum log_record_type type, const void *payload, size_t payload_len) {
+	struct log_stream_record record = {
+		.size = align8(sizeof(record) + payload_len),
+		.type = type,
+	};
+	static const uint8_t zeroes[8] = {0};
+	out_append(async, &record, sizeof(record));
+	out_append(async, payload, payload_len);
+	out_append(async, zeroes, record.size - sizeof(record) - payload_len);
+}
+
+static void consume_record(struct log_async *async, enum log_record_type type,
+		const uint8_t *payload, size_t payload_len) {
+	switch (type) {
+	case LOG_RECORD_PADDING:
+	case LOG_RECORD_FORMAT:
+		break;
+	case LOG_RECORD_TEXT:
+		out_append(async, payload, strnlen((const char *)payload, payload_len));
+		break;
+	case LOG_RECORD_BINARY:;
+		struct log_binary_message msg;
+		memcpy(&msg, payload, sizeof(msg));
+		struct log_format_entry *entry =
+			format_table_find(&async->formats, msg.format);
+		if (entry == NULL || entry->address == 0) {
+			if (format_table_add(&async->formats, msg.format) == NULL) {
+				atomic_fetch_add_explicit(&log_dropped, 1, memory_order_relaxed);
+				break;
+			}
+			const char *fmt = (const char *)(uintptr_t)msg.format;
+			size_t fmt_size = strlen(fmt) + 1;
+			struct log_stream_record record = {
+				.size = align8(sizeof(record) + sizeof(msg.format) + fmt_size),
+				.type = LOG_RECORD_FORMAT,
+			};
+			static const uint8_t zeroes[8] = {0};
+			out_append(async, &record, sizeof(record));
+			out_append(async, &msg.format, sizeof(msg.format));
+			out_append(async, fmt, fmt_size);
+			out_append(async, zeroes,
+				record.size - sizeof(record) - sizeof(msg.format) - fmt_size);
+		}
+		out_append_record(async, LOG_RECORD_BINARY, payload, payload_len);
+		break;
+	}
+}
+
+static void report_dropped(struct log_async *async, const char *fmt, ...) {
+	_Alignas(uint64_t) uint8_t buf[MAX_MESSAGE_SIZE];
+	va_list args;
+	va_start(args, fmt);
+	size_t len = encode_message(async, buf, sizeof(buf), WLR_ERROR, fmt, args);
+	va_end(args);
+	consume_record(async, async->binary ? LOG_RECORD_BINARY : LOG_RECORD_TEXT,
+		buf, len);
+}
+
+static void log_async_flush(struct log_async *async) {
+	size_t tail = atomic_load_explicit(&async->tail, memory_order_relaxed);
+	while (true) {
+		struct log_ring_record *record =
+			(void *)&async->data[tail & (async->size - 1)];
+		uint32_t size = atomic_load_explicit(&record->size, memory_order_acquire);
+		if (size == 0) {
+			break;
+		}
+
+		consume_record(async, record->type, (const uint8_t *)(record + 1),
+			size - sizeof(*record));
+
+		// Unused space must be zero, see ring_push()
+		memset(record + 1, 0, size - sizeof(*record));
+		record->type = 0;
+		atomic_store_explicit(&record->size, 0, memory_order_relaxed);
+		tail += size;
+		atomic_store_explicit(&async->tail, tail, memory_order_release);
+	}
+
+	size_t dropped = atomic_load_explicit(&log_dropped, memory_order_relaxed);
+	if (dropped != async->dropped_reported) {
+		report_dropped(async, "Dropped %zu log messages",
+			dropped - async->dropped_reported);
+		async->dropped_reported = dropped;
+	}
+
+	out_flush(async);
+}
+
+static void *flush_thread(void *data) {
+	struct log_async *async = data;
+	const struct timespec interval = { .tv_nsec = FLUSH_INTERVAL_NSEC };
+	while (true) {
+		bool stop = atomic_load_explicit(&async->stop, memory_order_acquire);
+		log_async_flush(async);
+		if (stop) {
+			break;
+		}
+		nanosleep(&interval, NULL);
+	}
+	return NULL;
+}
+
+static void log_async_destroy(struct log_async *async) {
+	format_table_finish(&async->formats);
+	free(async->data);
+	free(async);
+}
+
+bool wlr_log_init_async(enum wlr_log_importance verbosity,
+		const struct wlr_log_async_options *options) {
+	if (log_async != NULL) {
+		wlr_log(WLR_ERROR, "Asynchronous logger already started");
+		return false;
+	}
+
+	static const struct wlr_log_async_options default_options = {
+		.fd = -1,
+	};
+	if (options == NULL) {
+		options = &default_options;
+	}
+
+	size_t size = DEFAULT_BUFFER_SIZE;
+	if (options->buffer_size != 0) {
+		size = MIN_BUFFER_SIZE;
+		while (size < options->buffer_size && size < MAX_BUFFER_SIZE) {
+			size *= 2;
+		}
+	}
+
+	struct log_async *async = calloc(1, sizeof(*async));
+	if (async == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+	async->size = size;
+	async->fd = options->fd >= 0 ? options->fd : STDERR_FILENO;
+	async->binary = options->binary;
+	async->colored = !async->binary && isatty(async->fd);
+
+	// Fault in the whole buffer now rather than while logging
+	async->data = malloc(size);
+	if (async->data == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		free(async);
+		return false;
+	}
+	memset(async->data, 0, size);
+
+	if (async->binary) {
+		out_append(async, binary_magic, sizeof(binary_magic));
+	}
+
+	// Signals must be delivered to the compositor's threads, which may rely
+	// on a signalfd
+	sigset_t mask, old_mask;
+	sigfillset(&mask);
+	pthread_sigmask(SIG_SETMASK, &mask, &old_mask);
+	int ret = pthread_create(&async->thread, NULL, flush_thread, async);
+	pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+	if (ret != 0) {
+		wlr_log(WLR_ERROR, "Failed to start logging thread: %s", strerror(ret));
+		log_async_destroy(async);
+		return false;
+	}
+
+	log_async = async;
+	wlr_log_init(verbosity, log_async_write);
+	return true;
+}
+
+void wlr_log_finish_async(void) {
+	struct log_async *async = log_async;
+	if (async == NULL) {
+		return;
+	}
+
+	wlr_log_init(wlr_log_get_verbosity(), log_stderr);
+	log_async = NULL;
+
+	atomic_store_explicit(&async->stop, true, memory_order_release);
+	pthread_join(async->thread, NULL);
+	log_async_destroy(async);
+}
+
+uint64_t wlr_log_get_dropped(void) {
+	return atomic_load_explicit(&log_dropped, memory_order_relaxed);
+}
+
+struct log_decoder {
+	const uint8_t *data;
+	size_t len, pos;
+};
+
+static bool decode_u64(struct log_decoder *dec, uint64_t *value) {
+	if (dec->len - dec->pos < sizeof(*value)) {
+		return false;
+	}
+	memcpy(value, &dec->data[dec->pos], sizeof(*value));
+	dec->pos += sizeof(*value);
+	return true;
+}
+
+#define PRINT_CONVERSION(out, spec, n_stars, stars, value) \
+	((n_stars) == 0 ? fprintf(out, spec, value) : \
+	(n_stars) == 1 ? fprintf(out, spec, stars[0], value) : \
+	fprintf(out, spec, stars[0], stars[1], value))
+
+static bool decode_args(FILE *out, const char *fmt, struct log_decoder *dec) {
+	const char *p = fmt;
+	while (true) {
+		const char *next = strchr(p, '%');
+		if (next == NULL) {
+			fputs(p, out);
+			return true;
+		}
+		fwrite(p, 1, next - p, out);
+		p = next;
+
+		struct log_conversion conv;
+		if (!parse_conversion(p, &conv)) {
+			return false;
+		}
+
+		int stars[2] = {0};
+		for (int i = 0; i < conv.n_stars; i++) {
+			uint64_t value;
+			if (!decode_u64(dec, &value)) {
+				return false;
+			}
+			stars[i] = (int)(int64_t)value;
+		}
+
+		// Arguments were widened when encoding
+		char spec[64];
+		if (conv.prefix_len > sizeof(spec) - 4) {
+			return false;
+		}
+		memcpy(spec, p, conv.prefix_len);
+		size_t spec_len = conv.prefix_len;
+		if (conv.type == LOG_ARG_INT || conv.type == LOG_ARG_UINT) {
+			spec[spec_len++] = 'l';
+			spec[spec_len++] = 'l';
+		}
+		spec[spec_len++] = conv.conversion;
+		spec[spec_len] = '\0';
+		p += conv.len;
+
+		uint64_t value;
+		if (conv.type != LOG_ARG_NONE && !decode_u64(dec, &value)) {
+			return false;
+		}
+		switch (conv.type) {
+		case LOG_ARG_NONE:
+			fputc('%', out);
+			break;
+		case LOG_ARG_INT:
+			PRINT_CONVERSION(out, spec, conv.n_stars, stars, (long long)(int64_t)value);
+			break;
+		case LOG_ARG_UINT:
+			PRINT_CONVERSION(out, spec, conv.n_stars, stars, (unsigned long long)value);
+			break;
+		case LOG_ARG_CHAR:
+			PRINT_CONVERSION(out, spec, conv.n_stars, stars, (int)(int64_t)value);
+			break;
+		case LOG_ARG_DOUBLE:;
+			double d;
+			memcpy(&d, &value, sizeof(d));
+			PRINT_CONVERSION(out, spec, conv.n_stars, stars, d);
+			break;
+		case LOG_ARG_POINTER:
+			PRINT_CONVERSION(out, spec, conv.n_stars, stars, (void *)(uintptr_t)value);
+			break;
+		case LOG_ARG_STRING:
+			if (value >= MAX_MESSAGE_SIZE || dec->len - dec->pos < align8(value)) {
+				return false;
+			}
+			char str[MAX_MESSAGE_SIZE];
+			memcpy(str, &dec->data[dec->pos], value);
+			str[value] = '\0';
+			dec->pos += align8(value);
+			PRINT_CONVERSION(out, spec, conv.n_stars, stars, str);
+			break;
+		}
+	}
+}
+
+static bool decode_record(FILE *out, struct log_format_table *formats,
+		const struct log_stream_record *record, const uint8_t *payload,
+		size_t payload_len) {
+	struct log_decoder dec = {
+		.data = payload,
+		.len = payload_len,
+	};
+
+	switch (record->type) {
+	case LOG_RECORD_FORMAT:;
+		uint64_t address;
+		if (!decode_u64(&dec, &address) || address == 0) {
+			return false;
+		}
+		const char *str = (const char *)&payload[dec.pos];
+		size_t str_len = strnlen(str, payload_len - dec.pos);
+		if (str_len == payload_len - dec.pos) {
+			return false;
+		}
+		struct log_format_entry *entry = format_table_add(formats, address);
+		if (entry == NULL) {
+			return false;
+		}
+		free(entry->str);
+		entry->str = strdup(str);
+		return entry->str != NULL;
+	case LOG_RECORD_BINARY:;
+		struct log_binary_message msg;
+		if (payload_len < sizeof(msg)) {
+			return false;
+		}
+		memcpy(&msg, payload, sizeof(msg));
+		dec.pos = sizeof(msg);
+		entry = format_table_find(formats, msg.format);
+		if (entry == NULL || entry->address == 0) {
+			return false;
+		}
+
+		char prefix[64];
+		log_format_prefix(prefix, sizeof(prefix), msg.elapsed_nsec,
+			msg.verbosity, false);
+		fputs(prefix, out);
+		bool ok = decode_args(out, entry->str, &dec);
+		fputc('\n', out);
+		return ok;
+	default:
+		return false;
+	}
+}
+
+bool wlr_log_decode_binary(int in_fd, int out_fd) {
+	uint8_t *data = NULL;
+	size_t len = 0, cap = 0;
+	while (true) {
+		if (len == cap) {
+			cap = cap == 0 ? OUT_BUFFER_SIZE : 2 * cap;
+			uint8_t *grown = realloc(data, cap);
+			if (grown == NULL) {
+				free(data);
+				return false;
+			}
+			data = grown;
+		}
+		ssize_t n = read(in_fd, &data[len], cap - len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		} else if (n < 0) {
+			free(data);
+			return false;
+		} else if (n == 0) {
+			break;
+		}
+		len += n;
+	}
+
+	int out_fd_dup = dup(out_fd);
+	FILE *out = out_fd_dup >= 0 ? fdopen(out_fd_dup, "w") : NULL;
+	if (out == NULL) {
+		if (out_fd_dup >= 0) {
+			close(out_fd_dup);
+		}
+		free(data);
+		return false;
+	}
+
+	struct log_format_table formats = {0};
+	bool ok = len >= sizeof(binary_magic) &&
+		memcmp(data, binary_magic, sizeof(binary_magic)) == 0;
+	size_t pos = sizeof(binary_magic);
+	while (ok && pos < len) {
+		struct log_stream_record record;
+		if (len - pos < sizeof(record)) {
+			ok = false;
+			break;
+		}
+		memcpy(&record, &data[pos], sizeof(record));
+		if (record.size < sizeof(record) || record.size > len - pos) {
+			ok = false;
+			break;
+		}
+		ok = decode_record(out, &formats, &record, &data[pos + sizeof(record)],
+			record.size - sizeof(record));
+		pos += record.size;
+	}
+
+	format_table_finish(&formats);
+	if (fclose(out) != 0) {
+		ok = false;
+	}
+	free(data);
+	return ok;
+}
@@ -1,3 +1,5 @@
+#undef _POSIX_C_SOURCE
+#define _GNU_SOURCE // for memfd_create() and MFD_HUGETLB
 #include <errno.h>
 #include <fcntl.h>
 #include <string.h>
@@ -95,3 +97,56 @@ bool allocate_shm_file_pair(size_t size, int *rw_fd_ptr, int *ro_fd_ptr) {
 	*ro_fd_ptr = ro_fd;
 	return true;
 }
+
+int allocate_hugetlb_file(size_t *size, unsigned int flags) {
+#ifdef MFD_HUGETLB
+	int fd = memfd_create("wlroots", MFD_CLOEXEC | MFD_HUGETLB | flags);
+	if (fd < 0) {
+		return -1;
+	}
+
+	// hugetlbfs reports the huge page size as the block size
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_blksize <= 0) {
+		close(fd);
+		return -1;
+	}
+	size_t huge_page_size = st.st_blksize;
+	size_t aligned_size = (*size + huge_page_size - 1) / huge_page_size *
+		huge_page_size;
+
+	int ret;
+	do {
+		ret = ftruncate(fd, aligned_size);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0) {
+		close(fd);
+		return -1;
+	}
+
+	*size = aligned_size;
+	return fd;
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+size_t get_huge_page_size(void) {
+#ifdef MFD_HUGETLB
+	int fd = memfd_create("wlroots", MFD_CLOEXEC | MFD_HUGETLB);
+	if (fd < 0) {
+		return 0;
+	}
+
+	struct stat st;
+	int ret = fstat(fd, &st);
+	close(fd);
+	if (ret != 0 || st.st_blksize <= 0) {
+		return 0;
+	}
+	return st.st_blksize;
+#else
+	return 0;
+#endif
+}
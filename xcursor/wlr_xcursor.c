@@ -47,8 +47,113 @@ static void xcursor_destroy(struct wlr_xcursor *cursor) {
 	free(cursor);
 }
 
-static struct wlr_xcursor_image *xcursor_image_create(uint32_t width, uint32_t height,
-		uint32_t hotspot_x, uint32_t hotspot_y, uint32_t delay, const void *buffer) {
+/**
+ * A cursor of a theme. Cursors of lazily loaded themes are decoded from their
+ * file on first use.
+ */
+struct wlr_xcursor_theme_entry {
+	char *name; // NULL if the slot is free
+	// Files to decode the cursor from, in order of precedence, NULL once
+	// decoded
+	char **paths;
+	size_t paths_len;
+	struct wlr_xcursor *cursor;
+};
+
+static void theme_entry_release_paths(struct wlr_xcursor_theme_entry *entry) {
+	for (size_t i = 0; i < entry->paths_len; i++) {
+		free(entry->paths[i]);
+	}
+	free(entry->paths);
+	entry->paths = NULL;
+	entry->paths_len = 0;
+}
+
+static size_t cursor_name_hash(const char *name) {
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325;
+	for (const char *c = name; *c != '\0'; c++) {
+		hash ^= (unsigned char)*c;
+		hash *= 0x100000001b3;
+	}
+	return hash ^ (hash >> 32);
+}
+
+static struct wlr_xcursor_theme_entry *theme_index_find(
+		struct wlr_xcursor_theme *theme, const char *name) {
+	if (theme->index_cap == 0) {
+		return NULL;
+	}
+
+	size_t mask = theme->index_cap - 1;
+	size_t i = cursor_name_hash(name) & mask;
+	while (theme->index[i].name != NULL) {
+		if (strcmp(theme->index[i].name, name) == 0) {
+			return &theme->index[i];
+		}
+		i = (i + 1) & mask;
+	}
+	return NULL;
+}
+
+static void theme_index_insert(struct wlr_xcursor_theme_entry *index,
+		size_t cap, const struct wlr_xcursor_theme_entry *entry) {
+	size_t mask = cap - 1;
+	size_t i = cursor_name_hash(entry->name) & mask;
+	while (index[i].name != NULL) {
+		i = (i + 1) & mask;
+	}
+	index[i] = *entry;
+}
+
+/**
+ * Add a cursor to the index of a theme. The entry takes ownership of the
+ * name and the paths.
+ */
+static bool theme_index_add(struct wlr_xcursor_theme *theme,
+		const struct wlr_xcursor_theme_entry *entry) {
+	// Keep the load factor at most 1/2
+	if ((theme->index_len + 1) * 2 > theme->index_cap) {
+		size_t cap = theme->index_cap > 0 ? theme->index_cap * 2 : 64;
+		struct wlr_xcursor_theme_entry *index = calloc(cap, sizeof(*index));
+		if (index == NULL) {
+			return false;
+		}
+		for (size_t i = 0; i < theme->index_cap; i++) {
+			if (theme->index[i].name != NULL) {
+				theme_index_insert(index, cap, &theme->index[i]);
+			}
+		}
+		free(theme->index);
+		theme->index = index;
+		theme->index_cap = cap;
+	}
+
+	theme_index_insert(theme->index, theme->index_cap, entry);
+	theme->index_len++;
+	return true;
+}
+
+static bool theme_add_cursor(struct wlr_xcursor_theme *theme,
+		struct wlr_xcursor *cursor) {
+	struct wlr_xcursor **cursors = realloc(theme->cursors,
+		(theme->cursor_count + 1) * sizeof(theme->cursors[0]));
+	if (cursors == NULL) {
+		return false;
+	}
+	theme->cursors = cursors;
+	theme->cursors[theme->cursor_count] = cursor;
+	theme->cursor_count++;
+	return true;
+}
+
+/**
+ * Create an image from pixels allocated with malloc(). The image takes
+ * ownership of them on success.
+ */
+static struct wlr_xcursor_image *xcursor_image_create_with_buffer(uint32_t width,
+		uint32_t height, uint32_t hotspot_x, uint32_t hotspot_y, uint32_t delay,
+		uint8_t *buffer) {
 	struct wlr_xcursor_image *image = calloc(1, sizeof(*image));
 	if (image == NULL) {
 		return NULL;
@@ -59,29 +164,34 @@ static struct wlr_xcursor_image *xcursor_image_create(uint32_t width, uint32_t h
 	image->hotspot_x = hotspot_x;
 	image->hotspot_y = hotspot_y;
 	image->delay = delay;
+	image->buffer = buffer;
 
 	size_t stride = width * sizeof(uint32_t);
-	size_t size = stride * height;
-	image->buffer = malloc(size);
-	if (image->buffer == NULL) {
-		goto err_image;
-	}
-
-	memcpy(image->buffer, buffer, size);
-
 	image->readonly_buffer = readonly_data_buffer_create(DRM_FORMAT_ARGB8888,
 		stride, width, height, image->buffer);
 	if (image->readonly_buffer == NULL) {
-		goto err_buffer;
+		free(image);
+		return NULL;
 	}
 
 	return image;
+}
 
-err_buffer:
-	free(image->buffer);
-err_image:
-	free(image);
-	return NULL;
+static struct wlr_xcursor_image *xcursor_image_create(uint32_t width, uint32_t height,
+		uint32_t hotspot_x, uint32_t hotspot_y, uint32_t delay, const void *buffer) {
+	size_t size = width * sizeof(uint32_t) * height;
+	uint8_t *copy = malloc(size);
+	if (copy == NULL) {
+		return NULL;
+	}
+	memcpy(copy, buffer, size);
+
+	struct wlr_xcursor_image *image = xcursor_image_create_with_buffer(width,
+		height, hotspot_x, hotspot_y, delay, copy);
+	if (image == NULL) {
+		free(copy);
+	}
+	return image;
 }
 
 static struct wlr_xcursor *xcursor_create_from_data(
@@ -131,11 +241,21 @@ static void load_default_theme(struct wlr_xcursor_theme *theme) {
 	}
 
 	for (uint32_t i = 0; i < cursor_count; ++i) {
-		theme->cursors[i] = xcursor_create_from_data(&cursor_metadata[i], theme);
-		if (theme->cursors[i] == NULL) {
+		struct wlr_xcursor *cursor =
+			xcursor_create_from_data(&cursor_metadata[i], theme);
+		if (cursor == NULL) {
 			break;
 		}
+		theme->cursors[i] = cursor;
 		++theme->cursor_count;
+
+		struct wlr_xcursor_theme_entry entry = {
+			.name = strdup(cursor->name),
+			.cursor = cursor,
+		};
+		if (entry.name == NULL || !theme_index_add(theme, &entry)) {
+			free(entry.name);
+		}
 	}
 }
 
@@ -156,12 +276,16 @@ static struct wlr_xcursor *xcursor_create_from_xcursor_images(
 	cursor->total_delay = 0;
 
 	for (int i = 0; i < images->nimage; i++) {
-		const struct xcursor_image *data = images->images[i];
-		struct wlr_xcursor_image *image = xcursor_image_create(data->width, data->height,
-			data->xhot, data->yhot, data->delay, data->pixels);
+		// The pixels are already decoded in the host byte order, take them
+		// over instead of copying them again
+		struct xcursor_image *data = images->images[i];
+		struct wlr_xcursor_image *image = xcursor_image_create_with_buffer(
+			data->width, data->height, data->xhot, data->yhot, data->delay,
+			(uint8_t *)data->pixels);
 		if (image == NULL) {
 			break;
 		}
+		data->pixels = NULL;
 
 		cursor->total_delay += image->delay;
 		cursor->images[i] = image;
@@ -178,35 +302,72 @@ static struct wlr_xcursor *xcursor_create_from_xcursor_images(
 	return cursor;
 }
 
-static struct wlr_xcursor *xcursor_theme_get_cursor(struct wlr_xcursor_theme *theme,
-	const char *name);
-
 static void load_callback(struct xcursor_images *images, void *data) {
 	struct wlr_xcursor_theme *theme = data;
 
-	if (xcursor_theme_get_cursor(theme, images->name)) {
+	if (theme_index_find(theme, images->name)) {
 		xcursor_images_destroy(images);
 		return;
 	}
 
 	struct wlr_xcursor *cursor = xcursor_create_from_xcursor_images(images, theme);
-	if (cursor) {
-		theme->cursor_count++;
-		struct wlr_xcursor **cursors = realloc(theme->cursors,
-			theme->cursor_count * sizeof(theme->cursors[0]));
-		if (cursors == NULL) {
-			theme->cursor_count--;
-			xcursor_destroy(cursor);
-		} else {
-			theme->cursors = cursors;
-			theme->cursors[theme->cursor_count - 1] = cursor;
-		}
+	xcursor_images_destroy(images);
+	if (cursor == NULL) {
+		return;
 	}
 
-	xcursor_images_destroy(images);
+	struct wlr_xcursor_theme_entry entry = {
+		.name = strdup(cursor->name),
+		.cursor = cursor,
+	};
+	if (entry.name == NULL || !theme_add_cursor(theme, cursor)) {
+		free(entry.name);
+		xcursor_destroy(cursor);
+		return;
+	}
+	if (!theme_index_add(theme, &entry)) {
+		free(entry.name);
+	}
 }
 
-struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
+static bool theme_entry_add_path(struct wlr_xcursor_theme_entry *entry,
+		const char *path) {
+	char **paths = realloc(entry->paths,
+		(entry->paths_len + 1) * sizeof(entry->paths[0]));
+	if (paths == NULL) {
+		return false;
+	}
+	entry->paths = paths;
+	entry->paths[entry->paths_len] = strdup(path);
+	if (entry->paths[entry->paths_len] == NULL) {
+		return false;
+	}
+	entry->paths_len++;
+	return true;
+}
+
+static void scan_callback(const char *name, const char *path, void *data) {
+	struct wlr_xcursor_theme *theme = data;
+
+	// Later files are only used if the previous ones can't be decoded
+	struct wlr_xcursor_theme_entry *existing = theme_index_find(theme, name);
+	if (existing != NULL) {
+		theme_entry_add_path(existing, path);
+		return;
+	}
+
+	struct wlr_xcursor_theme_entry entry = {
+		.name = strdup(name),
+	};
+	if (entry.name == NULL || !theme_entry_add_path(&entry, path) ||
+			!theme_index_add(theme, &entry)) {
+		free(entry.name);
+		theme_entry_release_paths(&entry);
+	}
+}
+
+static struct wlr_xcursor_theme *xcursor_theme_create(const char *name,
+		int size) {
 	struct wlr_xcursor_theme *theme = calloc(1, sizeof(*theme));
 	if (!theme) {
 		return NULL;
@@ -218,13 +379,23 @@ struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
 
 	theme->name = strdup(name);
 	if (!theme->name) {
-		goto out_error_name;
+		free(theme);
+		return NULL;
 	}
 	theme->size = size;
 	theme->cursor_count = 0;
 	theme->cursors = NULL;
 
-	xcursor_load_theme(name, size, load_callback, theme);
+	return theme;
+}
+
+struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
+	struct wlr_xcursor_theme *theme = xcursor_theme_create(name, size);
+	if (!theme) {
+		return NULL;
+	}
+
+	xcursor_load_theme(theme->name, size, load_callback, theme);
 
 	if (theme->cursor_count == 0) {
 		load_default_theme(theme);
@@ -234,10 +405,25 @@ struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
 			theme->name, size, theme->cursor_count);
 
 	return theme;
+}
 
-out_error_name:
-	free(theme);
-	return NULL;
+struct wlr_xcursor_theme *wlr_xcursor_theme_load_lazy(const char *name,
+		int size) {
+	struct wlr_xcursor_theme *theme = xcursor_theme_create(name, size);
+	if (!theme) {
+		return NULL;
+	}
+
+	xcursor_scan_theme(theme->name, scan_callback, theme);
+
+	if (theme->index_len == 0) {
+		load_default_theme(theme);
+	}
+
+	wlr_log(WLR_DEBUG, "Indexed cursor theme '%s' at size %d (%zu available cursors)",
+			theme->name, size, theme->index_len);
+
+	return theme;
 }
 
 void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *theme) {
@@ -249,22 +435,75 @@ void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *theme) {
 		xcursor_destroy(theme->cursors[i]);
 	}
 
+	for (size_t i = 0; i < theme->index_cap; i++) {
+		free(theme->index[i].name);
+		theme_entry_release_paths(&theme->index[i]);
+	}
+
+	free(theme->index);
 	free(theme->name);
 	free(theme->cursors);
 	free(theme);
 }
 
-static struct wlr_xcursor *xcursor_theme_get_cursor(struct wlr_xcursor_theme *theme,
-		const char *name) {
-	for (unsigned int i = 0; i < theme->cursor_count; i++) {
-		if (strcmp(name, theme->cursors[i]->name) == 0) {
-			return theme->cursors[i];
+static struct wlr_xcursor *xcursor_theme_decode_cursor(
+		struct wlr_xcursor_theme *theme,
+		const struct wlr_xcursor_theme_entry *entry) {
+	for (size_t i = 0; i < entry->paths_len; i++) {
+		struct xcursor_images *images =
+			xcursor_load_file(entry->paths[i], entry->name, theme->size);
+		if (images == NULL) {
+			wlr_log(WLR_DEBUG, "Failed to load cursor file '%s'",
+				entry->paths[i]);
+			continue;
+		}
+
+		struct wlr_xcursor *cursor =
+			xcursor_create_from_xcursor_images(images, theme);
+		xcursor_images_destroy(images);
+		if (cursor != NULL) {
+			return cursor;
 		}
 	}
 
+	// Like the default theme loaded when no cursor file can be decoded
+	size_t cursor_count = sizeof(cursor_metadata) / sizeof(cursor_metadata[0]);
+	for (size_t i = 0; i < cursor_count; i++) {
+		if (strcmp(cursor_metadata[i].name, entry->name) == 0) {
+			return xcursor_create_from_data(&cursor_metadata[i], theme);
+		}
+	}
 	return NULL;
 }
 
+static struct wlr_xcursor *xcursor_theme_get_cursor(struct wlr_xcursor_theme *theme,
+		const char *name) {
+	struct wlr_xcursor_theme_entry *entry = theme_index_find(theme, name);
+	if (entry == NULL) {
+		return NULL;
+	}
+	if (entry->paths == NULL) {
+		return entry->cursor;
+	}
+
+	// First use of a cursor of a lazily loaded theme. Only try once, even if
+	// none of the files can be decoded.
+	struct wlr_xcursor *cursor = xcursor_theme_decode_cursor(theme, entry);
+	theme_entry_release_paths(entry);
+	if (cursor == NULL) {
+		wlr_log(WLR_ERROR, "Failed to load cursor '%s' from theme '%s'",
+			name, theme->name);
+		return NULL;
+	}
+	if (!theme_add_cursor(theme, cursor)) {
+		xcursor_destroy(cursor);
+		return NULL;
+	}
+
+	entry->cursor = cursor;
+	return cursor;
+}
+
 struct wlr_xcursor *wlr_xcursor_theme_get_cursor(struct wlr_xcursor_theme *theme,
 		const char *name) {
 	struct wlr_xcursor *xcursor = xcursor_theme_get_cursor(theme, name);
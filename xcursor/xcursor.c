@@ -30,6 +30,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "config.h"
 #include "xcursor/xcursor.h"
 
@@ -150,12 +154,16 @@ xcursor_image_create(int width, int height)
 	if (width > XCURSOR_IMAGE_MAX_SIZE || height > XCURSOR_IMAGE_MAX_SIZE)
 		return NULL;
 
-	image = malloc(sizeof(*image) +
-		       width * height * sizeof(uint32_t));
+	image = malloc(sizeof(*image));
 	if (!image)
 		return NULL;
+	/* Allocated on their own, so that they can be taken over */
+	image->pixels = malloc(width * height * sizeof(uint32_t));
+	if (!image->pixels && width * height > 0) {
+		free(image);
+		return NULL;
+	}
 	image->version = XCURSOR_IMAGE_VERSION;
-	image->pixels = (uint32_t *) (image + 1);
 	image->size = width > height ? width : height;
 	image->width = width;
 	image->height = height;
@@ -166,6 +174,7 @@ xcursor_image_create(int width, int height)
 static void
 xcursor_image_destroy(struct xcursor_image *image)
 {
+	free(image->pixels);
 	free(image);
 }
 
@@ -481,6 +490,200 @@ xcursor_xc_file_load_images(FILE *file, int size)
 	return images;
 }
 
+/*
+ * Decoding from a read-only mapping of the file.  The table of contents is
+ * bounds-checked once when reading the header, image chunks are then checked
+ * against the size of the file and their pixels are copied out.  The file is
+ * unmapped once its images are decoded.
+ */
+
+struct xcursor_file_map {
+	const uint8_t *data;
+	size_t size;
+};
+
+static bool
+xcursor_file_map_open(struct xcursor_file_map *map, const char *path)
+{
+	struct stat st;
+	void *data;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	map->data = data;
+	map->size = st.st_size;
+	return true;
+}
+
+static void
+xcursor_file_map_close(struct xcursor_file_map *map)
+{
+	munmap((void *) map->data, map->size);
+}
+
+static uint32_t
+xcursor_map_uint(const uint8_t *bytes)
+{
+	return ((uint32_t)(bytes[0]) << 0) |
+		((uint32_t)(bytes[1]) << 8) |
+		((uint32_t)(bytes[2]) << 16) |
+		((uint32_t)(bytes[3]) << 24);
+}
+
+static struct xcursor_file_header *
+xcursor_map_read_file_header(const struct xcursor_file_map *map)
+{
+	struct xcursor_file_header head, *file_header;
+	const uint8_t *p;
+	unsigned int n;
+
+	if (map->size < XCURSOR_FILE_HEADER_LEN)
+		return NULL;
+	head.magic = xcursor_map_uint(map->data);
+	if (head.magic != XCURSOR_MAGIC)
+		return NULL;
+	head.header = xcursor_map_uint(map->data + 4);
+	head.version = xcursor_map_uint(map->data + 8);
+	head.ntoc = xcursor_map_uint(map->data + 12);
+	if (head.header < XCURSOR_FILE_HEADER_LEN || head.header > map->size)
+		return NULL;
+	if (head.ntoc > (map->size - head.header) / XCURSOR_FILE_TOC_LEN)
+		return NULL;
+	file_header = xcursor_file_header_create(head.ntoc);
+	if (!file_header)
+		return NULL;
+	file_header->magic = head.magic;
+	file_header->header = head.header;
+	file_header->version = head.version;
+	file_header->ntoc = head.ntoc;
+	p = map->data + head.header;
+	for (n = 0; n < file_header->ntoc; n++) {
+		file_header->tocs[n].type = xcursor_map_uint(p);
+		file_header->tocs[n].subtype = xcursor_map_uint(p + 4);
+		file_header->tocs[n].position = xcursor_map_uint(p + 8);
+		p += XCURSOR_FILE_TOC_LEN;
+	}
+	return file_header;
+}
+
+static struct xcursor_image *
+xcursor_map_read_image(const struct xcursor_file_map *map,
+		       struct xcursor_file_header *file_header,
+		       int toc)
+{
+	struct xcursor_chunk_header chunk_header;
+	struct xcursor_image head;
+	struct xcursor_image *image;
+	uint32_t position = file_header->tocs[toc].position;
+	const uint8_t *p = map->data + position;
+	const uint8_t *pixels;
+	size_t n;
+
+	if (position > map->size ||
+	    map->size - position < XCURSOR_IMAGE_HEADER_LEN)
+		return NULL;
+	chunk_header.header = xcursor_map_uint(p);
+	chunk_header.type = xcursor_map_uint(p + 4);
+	chunk_header.subtype = xcursor_map_uint(p + 8);
+	chunk_header.version = xcursor_map_uint(p + 12);
+	/* sanity check */
+	if (chunk_header.type != file_header->tocs[toc].type ||
+	    chunk_header.subtype != file_header->tocs[toc].subtype)
+		return NULL;
+	p += XCURSOR_CHUNK_HEADER_LEN;
+	head.width = xcursor_map_uint(p);
+	head.height = xcursor_map_uint(p + 4);
+	head.xhot = xcursor_map_uint(p + 8);
+	head.yhot = xcursor_map_uint(p + 12);
+	head.delay = xcursor_map_uint(p + 16);
+	/* sanity check data */
+	if (head.width > XCURSOR_IMAGE_MAX_SIZE ||
+	    head.height > XCURSOR_IMAGE_MAX_SIZE)
+		return NULL;
+	if (head.width == 0 || head.height == 0)
+		return NULL;
+	if (head.xhot > head.width || head.yhot > head.height)
+		return NULL;
+	n = (size_t)head.width * head.height;
+	if (n > (map->size - position - XCURSOR_IMAGE_HEADER_LEN) / 4)
+		return NULL;
+	pixels = map->data + position + XCURSOR_IMAGE_HEADER_LEN;
+
+	/* Create the image and initialize it */
+	image = xcursor_image_create(head.width, head.height);
+	if (image == NULL)
+		return NULL;
+#if WLR_LITTLE_ENDIAN
+	/* The file stores pixels in little-endian order */
+	memcpy(image->pixels, pixels, n * sizeof(uint32_t));
+#else
+	for (size_t i = 0; i < n; i++)
+		image->pixels[i] = xcursor_map_uint(pixels + 4 * i);
+#endif
+	if (chunk_header.version < image->version)
+		image->version = chunk_header.version;
+	image->size = chunk_header.subtype;
+	image->xhot = head.xhot;
+	image->yhot = head.yhot;
+	image->delay = head.delay;
+	return image;
+}
+
+static struct xcursor_images *
+xcursor_map_load_images(const struct xcursor_file_map *map, int size)
+{
+	struct xcursor_file_header *file_header;
+	uint32_t best_size;
+	int nsize;
+	struct xcursor_images *images;
+	int n;
+	int toc;
+
+	if (size < 0)
+		return NULL;
+	file_header = xcursor_map_read_file_header(map);
+	if (!file_header)
+		return NULL;
+	best_size = xcursor_file_best_size(file_header, (uint32_t) size, &nsize);
+	if (!best_size) {
+		xcursor_file_header_destroy(file_header);
+		return NULL;
+	}
+	images = xcursor_images_create(nsize);
+	if (!images) {
+		xcursor_file_header_destroy(file_header);
+		return NULL;
+	}
+	for (n = 0; n < nsize; n++) {
+		toc = xcursor_find_image_toc(file_header, best_size, n);
+		if (toc < 0)
+			break;
+		images->images[images->nimage] = xcursor_map_read_image(map,
+									file_header,
+									toc);
+		if (!images->images[images->nimage])
+			break;
+		images->nimage++;
+	}
+	xcursor_file_header_destroy(file_header);
+	if (images->nimage != nsize) {
+		xcursor_images_destroy(images);
+		images = NULL;
+	}
+	return images;
+}
+
 /*
  * From libXcursor/src/library.c
  */
@@ -678,15 +881,13 @@ xcursor_theme_inherits(const char *full)
 }
 
 static void
-load_all_cursors_from_dir(const char *path, int size,
-			  void (*load_callback)(struct xcursor_images *, void *),
+scan_all_cursors_from_dir(const char *path,
+			  void (*file_callback)(const char *, const char *, void *),
 			  void *user_data)
 {
-	FILE *f;
 	DIR *dir = opendir(path);
 	struct dirent *ent;
 	char *full;
-	struct xcursor_images *images;
 
 	if (!dir)
 		return;
@@ -703,20 +904,7 @@ load_all_cursors_from_dir(const char *path, int size,
 		if (!full)
 			continue;
 
-		f = fopen(full, "r");
-		if (!f) {
-			free(full);
-			continue;
-		}
-
-		images = xcursor_xc_file_load_images(f, size);
-
-		if (images) {
-			images->name = strdup(ent->d_name);
-			load_callback(images, user_data);
-		}
-
-		fclose(f);
+		file_callback(ent->d_name, full, user_data);
 		free(full);
 	}
 
@@ -740,9 +928,8 @@ nodelist_contains(struct xcursor_nodelist *nodelist, const char *s, size_t ss) {
 }
 
 static void
-xcursor_load_theme_protected(const char *theme,
-			     int size,
-			     void (*load_callback)(struct xcursor_images *, void *),
+xcursor_scan_theme_protected(const char *theme,
+			     void (*file_callback)(const char *, const char *, void *),
 			     void *user_data,
 			     struct xcursor_nodelist *visited_nodes)
 {
@@ -771,7 +958,7 @@ xcursor_load_theme_protected(const char *theme,
 
 		full = xcursor_build_fullname(dir, "cursors", "");
 		if (full) {
-			load_all_cursors_from_dir(full, size, load_callback,
+			scan_all_cursors_from_dir(full, file_callback,
 						  user_data);
 			free(full);
 		}
@@ -789,13 +976,103 @@ xcursor_load_theme_protected(const char *theme,
 		si = strlen(i);
 		if (nodelist_contains(visited_nodes, i, si))
 			continue;
-		xcursor_load_theme_protected(i, size, load_callback, user_data, visited_nodes);
+		xcursor_scan_theme_protected(i, file_callback, user_data, visited_nodes);
 	}
 
 	free(inherits);
 	free(xcursor_path);
 }
 
+/** Find all the cursor files of a theme
+ *
+ * This function walks the directories of a given theme and its inherited
+ * themes without reading the cursor files. The file callback is called with
+ * the cursor name and the path of each file, in the order in which
+ * xcursor_load_theme() would load them: if a cursor appears more than once,
+ * the first file takes precedence.
+ *
+ * \param theme The name of theme that should be scanned
+ * \param file_callback A callback function that will be called for each
+ * cursor file found. The first parameter is the name of the cursor, the
+ * second is the path of the file and the third is a pointer to data
+ * provided by the user.
+ * \param user_data The data that should be passed to the file callback
+ */
+void
+xcursor_scan_theme(const char *theme,
+		   void (*file_callback)(const char *, const char *, void *),
+		   void *user_data)
+{
+	xcursor_scan_theme_protected(theme, file_callback, user_data, NULL);
+}
+
+static struct xcursor_images *
+xcursor_images_set_name(struct xcursor_images *images, const char *name)
+{
+	if (!images)
+		return NULL;
+
+	images->name = strdup(name);
+	if (!images->name) {
+		xcursor_images_destroy(images);
+		return NULL;
+	}
+	return images;
+}
+
+struct xcursor_images *
+xcursor_load_file_stdio(const char *path, const char *name, int size)
+{
+	FILE *f;
+	struct xcursor_images *images;
+
+	f = fopen(path, "r");
+	if (!f)
+		return NULL;
+
+	images = xcursor_xc_file_load_images(f, size);
+	fclose(f);
+	return xcursor_images_set_name(images, name);
+}
+
+/** Load the cursor images of a cursor file
+ *
+ * Only the images with the size closest to the desired size are loaded.
+ * Returns NULL if the file can't be read. The images should be destroyed
+ * with xcursor_images_destroy().
+ */
+struct xcursor_images *
+xcursor_load_file(const char *path, const char *name, int size)
+{
+	struct xcursor_file_map map;
+	struct xcursor_images *images;
+
+	/* Fall back to stdio for files which can't be mapped */
+	if (!xcursor_file_map_open(&map, path))
+		return xcursor_load_file_stdio(path, name, size);
+
+	images = xcursor_map_load_images(&map, size);
+	xcursor_file_map_close(&map);
+	return xcursor_images_set_name(images, name);
+}
+
+struct xcursor_load_data {
+	int size;
+	void (*load_callback)(struct xcursor_images *, void *);
+	void *user_data;
+};
+
+static void
+load_file_callback(const char *name, const char *path, void *data)
+{
+	struct xcursor_load_data *load_data = data;
+	struct xcursor_images *images;
+
+	images = xcursor_load_file(path, name, load_data->size);
+	if (images)
+		load_data->load_callback(images, load_data->user_data);
+}
+
 /** Load all the cursor of a theme
  *
  * This function loads all the cursor images of a given theme and its
@@ -819,5 +1096,10 @@ void
 xcursor_load_theme(const char *theme, int size,
 		   void (*load_callback)(struct xcursor_images *, void *),
 		   void *user_data) {
-	return xcursor_load_theme_protected(theme, size, load_callback, user_data, NULL);
+	struct xcursor_load_data load_data = {
+		.size = size,
+		.load_callback = load_callback,
+		.user_data = user_data,
+	};
+	xcursor_scan_theme(theme, load_file_callback, &load_data);
 }
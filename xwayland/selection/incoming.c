@@ -6,6 +6,7 @@
 #include <wlr/types/wlr_data_device.h>
 #include <wlr/types/wlr_primary_selection.h>
 #include <wlr/util/log.h>
+#include <xcb/xcbext.h>
 #include <xcb/xfixes.h>
 #include "xwayland/selection.h"
 #include "xwayland/xwm.h"
@@ -55,30 +56,28 @@ xwm_selection_find_incoming_transfer_by_window(
 	return NULL;
 }
 
-static bool xwm_selection_transfer_get_incoming_selection_property(
-		struct wlr_xwm_selection_transfer *transfer, bool delete) {
+/**
+ * Request the next slice of the selection property. Slices grow as the
+ * transfer goes on, and the property is only deleted once its last slice has
+ * been read. INCR chunks are deleted once written to the Wayland client
+ * instead, to ask the X11 client for the next one.
+ */
+static void xwm_selection_transfer_request_property(
+		struct wlr_xwm_selection_transfer *transfer) {
 	struct wlr_xwm *xwm = transfer->selection->xwm;
+	assert(!transfer->property_requested);
 
-	xcb_get_property_cookie_t cookie = xcb_get_property(
+	transfer->property_cookie = xcb_get_property(
 		xwm->xcb_conn,
-		delete,
+		!transfer->incr, // delete
 		transfer->incoming_window,
 		xwm->atoms[WL_SELECTION],
 		XCB_GET_PROPERTY_TYPE_ANY,
-		0, // offset
-		0x1fffffff // length
+		transfer->property_offset,
+		transfer->chunk_size / 4 // length
 	);
-
-	transfer->property_start = 0;
-	transfer->property_reply =
-		xcb_get_property_reply(xwm->xcb_conn, cookie, NULL);
-
-	if (!transfer->property_reply) {
-		wlr_log(WLR_ERROR, "cannot get selection property");
-		return false;
-	}
-
-	return true;
+	transfer->property_requested = true;
+	xwm_schedule_flush(xwm);
 }
 
 static void xwm_notify_ready_for_next_incr_chunk(
@@ -95,6 +94,26 @@ static void xwm_notify_ready_for_next_incr_chunk(
 	xwm_selection_transfer_destroy_property_reply(transfer);
 }
 
+/**
+ * Move on once the current slice of the property has been written to the
+ * Wayland client.
+ */
+static void xwm_selection_transfer_finish_slice(
+		struct wlr_xwm_selection_transfer *transfer) {
+	xwm_selection_transfer_remove_event_source(transfer);
+	xwm_selection_transfer_destroy_property_reply(transfer);
+
+	if (transfer->property_requested) {
+		// The next slice may have arrived while writing this one
+		xwm_selection_transfer_read_property_reply(transfer);
+	} else if (transfer->incr) {
+		xwm_notify_ready_for_next_incr_chunk(transfer);
+	} else {
+		wlr_log(WLR_DEBUG, "transfer complete");
+		xwm_selection_transfer_destroy(transfer);
+	}
+}
+
 /**
  * Write the X11 selection to a Wayland client. Returns a nonzero value if the
  * Wayland client might become writeable again in the future.
@@ -122,13 +141,9 @@ static int write_selection_property_to_wl_client(int fd, uint32_t mask,
 	if (len < remainder) {
 		transfer->property_start += len;
 		return 1;
-	} else if (transfer->incr) {
-		xwm_notify_ready_for_next_incr_chunk(transfer);
-	} else {
-		wlr_log(WLR_DEBUG, "transfer complete");
-		xwm_selection_transfer_destroy(transfer);
 	}
 
+	xwm_selection_transfer_finish_slice(transfer);
 	return 0;
 }
 
@@ -137,7 +152,7 @@ static void xwm_write_selection_property_to_wl_client(
 	if (transfer->incr && transfer->wl_client_fd < 0) {
 		// Wayland client closed its pipe prematurely before the X11 client finished
 		// its incremental transfer. Continue draining the X11 client.
-		xwm_notify_ready_for_next_incr_chunk(transfer);
+		xwm_selection_transfer_finish_slice(transfer);
 		return;
 	}
 
@@ -155,42 +170,115 @@ static void xwm_write_selection_property_to_wl_client(
 	}
 }
 
-void xwm_get_incr_chunk(struct wlr_xwm_selection_transfer *transfer) {
-	wlr_log(WLR_DEBUG, "xwm_get_incr_chunk");
+static void xwm_selection_transfer_handle_property_reply(
+		struct wlr_xwm_selection_transfer *transfer,
+		xcb_get_property_reply_t *reply) {
+	struct wlr_xwm *xwm = transfer->selection->xwm;
 
-	if (transfer->property_reply) {
-		wlr_log(WLR_ERROR, "X11 client offered a new property before we deleted");
+	if (reply == NULL) {
+		wlr_log(WLR_ERROR, "cannot get selection property");
+		xwm_selection_transfer_destroy(transfer);
 		return;
 	}
 
-	if (!xwm_selection_transfer_get_incoming_selection_property(transfer, false)) {
+	bool first_slice = transfer->property_offset == 0;
+	if (first_slice && !transfer->incr && reply->type == xwm->atoms[INCR]) {
+		// Reading the property deleted it, which starts the transfer
+		transfer->incr = true;
+		free(reply);
 		return;
 	}
 
-	if (xcb_get_property_value_length(transfer->property_reply) > 0) {
-		xwm_write_selection_property_to_wl_client(transfer);
-	} else {
+	int len = xcb_get_property_value_length(reply);
+	if (first_slice && transfer->incr && len == 0) {
 		wlr_log(WLR_DEBUG, "incremental transfer complete");
+		free(reply);
 		xwm_selection_transfer_destroy(transfer);
+		return;
+	}
+
+	// Ask for the rest of the property before writing this slice, so that
+	// the X server sends it in the meantime
+	xwm_selection_transfer_grow_chunk(transfer);
+	if (reply->bytes_after > 0) {
+		transfer->property_offset += len / 4;
+		xwm_selection_transfer_request_property(transfer);
+	} else {
+		transfer->property_offset = 0;
 	}
+
+	// Reply's ownership is transferred to wm, which is responsible for freeing
+	// it.
+	transfer->property_start = 0;
+	transfer->property_reply = reply;
+	xwm_write_selection_property_to_wl_client(transfer);
 }
 
-static void xwm_selection_transfer_get_data(
+/**
+ * Handle the reply to the last property request, if it has arrived. Returns
+ * true if it has.
+ */
+bool xwm_selection_transfer_read_property_reply(
 		struct wlr_xwm_selection_transfer *transfer) {
 	struct wlr_xwm *xwm = transfer->selection->xwm;
+	assert(transfer->property_requested);
+	assert(transfer->property_reply == NULL);
 
-	if (!xwm_selection_transfer_get_incoming_selection_property(transfer, true)) {
+	xcb_get_property_reply_t *reply = NULL;
+	xcb_generic_error_t *error = NULL;
+	if (!xcb_poll_for_reply(xwm->xcb_conn, transfer->property_cookie.sequence,
+			(void **)&reply, &error)) {
+		return false;
+	}
+	free(error);
+
+	transfer->property_requested = false;
+	xwm_selection_transfer_handle_property_reply(transfer, reply);
+	return true;
+}
+
+int xwm_read_selection_replies(struct wlr_xwm *xwm) {
+	struct wlr_xwm_selection *selections[] = {
+		&xwm->clipboard_selection,
+		&xwm->primary_selection,
+		&xwm->dnd_selection,
+	};
+
+	int count = 0;
+	for (size_t i = 0; i < sizeof(selections)/sizeof(selections[0]); ++i) {
+		struct wlr_xwm_selection_transfer *transfer, *tmp;
+		wl_list_for_each_safe(transfer, tmp, &selections[i]->incoming, link) {
+			// Slices are handled once the previous one has been written
+			if (transfer->property_requested &&
+					transfer->property_reply == NULL &&
+					xwm_selection_transfer_read_property_reply(transfer)) {
+				count++;
+			}
+		}
+	}
+
+	return count;
+}
+
+void xwm_get_incr_chunk(struct wlr_xwm_selection_transfer *transfer) {
+	wlr_log(WLR_DEBUG, "xwm_get_incr_chunk");
+
+	if (transfer->property_reply || transfer->property_requested) {
+		wlr_log(WLR_ERROR, "X11 client offered a new property before we deleted");
 		return;
 	}
 
-	if (transfer->property_reply->type == xwm->atoms[INCR]) {
-		transfer->incr = true;
-		xwm_selection_transfer_destroy_property_reply(transfer);
-	} else {
-		// Reply's ownership is transferred to wm, which is responsible for freeing
-		// it.
-		xwm_write_selection_property_to_wl_client(transfer);
+	xwm_selection_transfer_request_property(transfer);
+}
+
+static void xwm_selection_transfer_get_data(
+		struct wlr_xwm_selection_transfer *transfer) {
+	if (transfer->property_requested) {
+		wlr_log(WLR_ERROR, "selection property is already being read");
+		return;
 	}
+
+	xwm_selection_transfer_request_property(transfer);
 }
 
 static void source_send(struct wlr_xwm_selection *selection,
@@ -334,6 +422,7 @@ static bool source_get_targets(struct wlr_xwm_selection *selection,
 
 	xcb_get_property_reply_t *reply =
 		xcb_get_property_reply(xwm->xcb_conn, cookie, NULL);
+	xwm_schedule_read(xwm);
 	if (reply == NULL) {
 		return false;
 	}
@@ -358,6 +447,7 @@ static bool source_get_targets(struct wlr_xwm_selection *selection,
 				xcb_get_atom_name(xwm->xcb_conn, atoms[i]);
 			xcb_get_atom_name_reply_t *name_reply =
 				xcb_get_atom_name_reply(xwm->xcb_conn, name_cookie, NULL);
+			xwm_schedule_read(xwm);
 			if (name_reply == NULL) {
 				continue;
 			}
@@ -50,6 +50,9 @@ static int xwm_selection_flush_source_data(
 	transfer->property_set = true;
 	size_t length = transfer->source_data.size;
 	transfer->source_data.size = 0;
+	if (transfer->incr) {
+		xwm_selection_transfer_grow_chunk(transfer);
+	}
 	return length;
 }
 
@@ -71,19 +74,17 @@ static int xwm_data_source_read(int fd, uint32_t mask, void *data) {
 	struct wlr_xwm_selection_transfer *transfer = data;
 	struct wlr_xwm *xwm = transfer->selection->xwm;
 
-	void *p;
+	// Read straight into the buffer handed to xcb, up to the current chunk
+	// size. The event source is removed once a chunk is full.
 	size_t current = transfer->source_data.size;
-	if (transfer->source_data.size < INCR_CHUNK_SIZE) {
-		p = wl_array_add(&transfer->source_data, INCR_CHUNK_SIZE);
-		if (p == NULL) {
-			wlr_log(WLR_ERROR, "Could not allocate selection source_data");
-			goto error_out;
-		}
-	} else {
-		p = (char *)transfer->source_data.data + transfer->source_data.size;
+	assert(current < transfer->chunk_size);
+	size_t available = transfer->chunk_size - current;
+	void *p = wl_array_add(&transfer->source_data, available);
+	if (p == NULL) {
+		wlr_log(WLR_ERROR, "Could not allocate selection source_data");
+		goto error_out;
 	}
 
-	size_t available = transfer->source_data.alloc - current;
 	ssize_t len = read(fd, p, available);
 	if (len == -1) {
 		wlr_log_errno(WLR_ERROR, "read error from data source");
@@ -94,25 +95,26 @@ static int xwm_data_source_read(int fd, uint32_t mask, void *data) {
 		available, mask);
 
 	transfer->source_data.size = current + len;
-	if (transfer->source_data.size >= INCR_CHUNK_SIZE) {
-		if (!transfer->incr) {
-			wlr_log(WLR_DEBUG, "got %zu bytes, starting incr",
-				transfer->source_data.size);
+	if (!transfer->incr && transfer->source_data.size >= INCR_CHUNK_SIZE) {
+		wlr_log(WLR_DEBUG, "got %zu bytes, starting incr",
+			transfer->source_data.size);
 
-			size_t incr_chunk_size = INCR_CHUNK_SIZE;
-			xcb_change_property(xwm->xcb_conn,
-				XCB_PROP_MODE_REPLACE,
-				transfer->request.requestor,
-				transfer->request.property,
-				xwm->atoms[INCR],
-				32, /* format */
-				1, &incr_chunk_size);
-			transfer->incr = true;
-			transfer->property_set = true;
-			transfer->flush_property_on_delete = true;
-			xwm_selection_transfer_remove_event_source(transfer);
-			xwm_selection_send_notify(xwm, &transfer->request, true);
-		} else if (transfer->property_set) {
+		size_t incr_chunk_size = INCR_CHUNK_SIZE;
+		xcb_change_property(xwm->xcb_conn,
+			XCB_PROP_MODE_REPLACE,
+			transfer->request.requestor,
+			transfer->request.property,
+			xwm->atoms[INCR],
+			32, /* format */
+			1, &incr_chunk_size);
+		transfer->incr = true;
+		transfer->property_set = true;
+		transfer->flush_property_on_delete = true;
+		xwm_selection_transfer_remove_event_source(transfer);
+		xwm_selection_send_notify(xwm, &transfer->request, true);
+	} else if (transfer->incr &&
+			transfer->source_data.size >= transfer->chunk_size) {
+		if (transfer->property_set) {
 			wlr_log(WLR_DEBUG, "got %zu bytes, waiting for property delete",
 				transfer->source_data.size);
 
@@ -36,9 +36,39 @@ void xwm_selection_transfer_init(struct wlr_xwm_selection_transfer *transfer,
 	*transfer = (struct wlr_xwm_selection_transfer){
 		.selection = selection,
 		.wl_client_fd = -1,
+		.chunk_size = INCR_CHUNK_SIZE,
 	};
 }
 
+static size_t xwm_selection_chunk_size_max(struct wlr_xwm *xwm) {
+	// Leave room for the ChangeProperty header, with the BIG-REQUESTS length
+	size_t header_size = 32;
+	size_t max = (size_t)xcb_get_maximum_request_length(xwm->xcb_conn) * 4;
+	if (max < INCR_CHUNK_SIZE + header_size) {
+		return INCR_CHUNK_SIZE;
+	}
+	max -= header_size;
+	if (max > SELECTION_CHUNK_SIZE_MAX) {
+		max = SELECTION_CHUNK_SIZE_MAX;
+	}
+	return max & ~(size_t)3;
+}
+
+/**
+ * Double the chunk size, up to what fits in a single request. Large
+ * transfers then need few round-trips, and small ones don't allocate more
+ * than they need.
+ */
+void xwm_selection_transfer_grow_chunk(
+		struct wlr_xwm_selection_transfer *transfer) {
+	size_t max = xwm_selection_chunk_size_max(transfer->selection->xwm);
+	if (transfer->chunk_size < max / 2) {
+		transfer->chunk_size *= 2;
+	} else {
+		transfer->chunk_size = max;
+	}
+}
+
 void xwm_selection_transfer_destroy(
 		struct wlr_xwm_selection_transfer *transfer) {
 	if (!transfer) {
@@ -49,6 +79,11 @@ void xwm_selection_transfer_destroy(
 	xwm_selection_transfer_remove_event_source(transfer);
 	xwm_selection_transfer_close_wl_client_fd(transfer);
 
+	if (transfer->property_requested) {
+		xcb_discard_reply(transfer->selection->xwm->xcb_conn,
+			transfer->property_cookie.sequence);
+	}
+
 	if (transfer->incoming_window) {
 		struct wlr_xwm *xwm = transfer->selection->xwm;
 		xcb_destroy_window(xwm->xcb_conn, transfer->incoming_window);
@@ -70,6 +105,7 @@ xcb_atom_t xwm_mime_type_to_atom(struct wlr_xwm *xwm, char *mime_type) {
 		xcb_intern_atom(xwm->xcb_conn, 0, strlen(mime_type), mime_type);
 	xcb_intern_atom_reply_t *reply =
 		xcb_intern_atom_reply(xwm->xcb_conn, cookie, NULL);
+	xwm_schedule_read(xwm);
 	if (reply == NULL) {
 		return XCB_ATOM_NONE;
 	}
@@ -103,6 +139,11 @@ struct wlr_xwm_selection *xwm_get_selection(struct wlr_xwm *xwm,
 
 static int xwm_handle_selection_property_notify(struct wlr_xwm *xwm,
 		xcb_property_notify_event_t *event) {
+	// Events are queued separately from replies. Replies to requests sent
+	// before the event was generated (e.g. the read of an INCR property)
+	// need to be handled first.
+	xwm_read_selection_replies(xwm);
+
 	struct wlr_xwm_selection *selections[] = {
 		&xwm->clipboard_selection,
 		&xwm->primary_selection,
@@ -183,6 +224,9 @@ void xwm_selection_init(struct wlr_xwm_selection *selection,
 	wl_list_init(&selection->incoming);
 	wl_list_init(&selection->outgoing);
 
+	// Used to size transfer chunks
+	xcb_prefetch_maximum_request_length(xwm->xcb_conn);
+
 	if (atom == xwm->atoms[DND_SELECTION]) {
 		xcb_create_window(
 			xwm->xcb_conn,
@@ -2,6 +2,7 @@
 #include <drm_fourcc.h>
 #include <poll.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_compositor.h>
@@ -15,6 +16,7 @@
 #include <xcb/composite.h>
 #include <xcb/render.h>
 #include <xcb/res.h>
+#include <xcb/xcbext.h>
 #include <xcb/xfixes.h>
 #include "xwayland/xwm.h"
 
@@ -114,6 +116,23 @@ struct pending_startup_id {
 	struct wl_list link;
 };
 
+/**
+ * A GetProperty request whose reply hasn't been read yet. Replies are handled
+ * from read_x11_events() in request order, so that X11 clients changing their
+ * properties don't make the compositor wait for Xwayland. They are read before
+ * the next event for the window, or after all pending events.
+ */
+struct xwm_property_request {
+	struct wlr_xwayland_surface *xsurface;
+	xcb_atom_t atom;
+	xcb_get_property_cookie_t cookie;
+	// Part of the batch sent by xwayland_surface_associate()
+	bool associate;
+	// The property changed again after the request was sent
+	bool stale;
+	struct wl_list link; // wlr_xwm.property_requests
+};
+
 static const struct wlr_addon_interface surface_addon_impl;
 
 struct wlr_xwayland_surface *wlr_xwayland_surface_try_from_wlr_surface(
@@ -126,9 +145,127 @@ struct wlr_xwayland_surface *wlr_xwayland_surface_try_from_wlr_surface(
 	return xsurface;
 }
 
-// TODO: replace this with hash table?
+// The index is kept at a load factor of at most 1/2
+#define SURFACE_INDEX_MIN_CAP 64
+
+static size_t window_hash(xcb_window_t window_id) {
+	uint32_t hash = window_id * 0x9E3779B1;
+	return hash ^ (hash >> 16);
+}
+
+static void surface_index_insert(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *xsurface) {
+	size_t mask = xwm->surface_index_cap - 1;
+	size_t i = window_hash(xsurface->window_id) & mask;
+	while (xwm->surface_index[i] != NULL) {
+		if (xwm->surface_index[i]->window_id == xsurface->window_id) {
+			// The most recently created surface wins, like in the list
+			xwm->surface_index_shadowed++;
+			break;
+		}
+		i = (i + 1) & mask;
+	}
+	xwm->surface_index[i] = xsurface;
+}
+
+static void surface_index_rebuild(struct wlr_xwm *xwm, size_t cap) {
+	free(xwm->surface_index);
+	xwm->surface_index = calloc(cap, sizeof(*xwm->surface_index));
+	if (xwm->surface_index == NULL) {
+		// Fall back to searching the list
+		xwm->surface_index_cap = 0;
+		return;
+	}
+	xwm->surface_index_cap = cap;
+	xwm->surface_index_shadowed = 0;
+
+	// Oldest first, newer surfaces replace older ones with the same window
+	struct wlr_xwayland_surface *xsurface;
+	wl_list_for_each_reverse(xsurface, &xwm->surfaces, link) {
+		surface_index_insert(xwm, xsurface);
+	}
+}
+
+static void surface_index_add(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *xsurface) {
+	xwm->surface_index_len++;
+	if (xwm->surface_index_len * 2 > xwm->surface_index_cap) {
+		size_t cap = xwm->surface_index_cap * 2;
+		if (cap < SURFACE_INDEX_MIN_CAP) {
+			cap = SURFACE_INDEX_MIN_CAP;
+		}
+		surface_index_rebuild(xwm, cap);
+	} else {
+		surface_index_insert(xwm, xsurface);
+	}
+}
+
+static void surface_index_remove(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *xsurface) {
+	xwm->surface_index_len--;
+	if (xwm->surface_index_cap == 0) {
+		return;
+	}
+
+	size_t mask = xwm->surface_index_cap - 1;
+	size_t i = window_hash(xsurface->window_id) & mask;
+	while (xwm->surface_index[i] != xsurface) {
+		if (xwm->surface_index[i] == NULL) {
+			// Replaced by a newer surface with the same window
+			xwm->surface_index_shadowed--;
+			return;
+		}
+		i = (i + 1) & mask;
+	}
+
+	// Shift back the following entries of the probe sequence, so that
+	// lookups don't stop early at the hole
+	size_t j = i;
+	while (true) {
+		j = (j + 1) & mask;
+		struct wlr_xwayland_surface *next = xwm->surface_index[j];
+		if (next == NULL) {
+			break;
+		}
+		size_t k = window_hash(next->window_id) & mask;
+		bool in_place = i < j ? (i < k && k <= j) : (i < k || k <= j);
+		if (in_place) {
+			continue;
+		}
+		xwm->surface_index[i] = next;
+		i = j;
+	}
+	xwm->surface_index[i] = NULL;
+
+	if (xwm->surface_index_shadowed == 0) {
+		return;
+	}
+	// Put back the next most recent surface with the same window, if this
+	// one replaced it
+	struct wlr_xwayland_surface *other;
+	wl_list_for_each(other, &xwm->surfaces, link) {
+		if (other != xsurface && other->window_id == xsurface->window_id) {
+			xwm->surface_index_shadowed--;
+			surface_index_insert(xwm, other);
+			return;
+		}
+	}
+}
+
 static struct wlr_xwayland_surface *lookup_surface(struct wlr_xwm *xwm,
 		xcb_window_t window_id) {
+	if (xwm->surface_index_cap > 0) {
+		size_t mask = xwm->surface_index_cap - 1;
+		size_t i = window_hash(window_id) & mask;
+		while (xwm->surface_index[i] != NULL) {
+			if (xwm->surface_index[i]->window_id == window_id) {
+				return xwm->surface_index[i];
+			}
+			i = (i + 1) & mask;
+		}
+		return NULL;
+	}
+
 	struct wlr_xwayland_surface *surface;
 	wl_list_for_each(surface, &xwm->surfaces, link) {
 		if (surface->window_id == window_id) {
@@ -254,6 +391,7 @@ static struct wlr_xwayland_surface *xwayland_surface_create(
 
 	xcb_get_geometry_reply_t *geometry_reply =
 		xcb_get_geometry_reply(xwm->xcb_conn, geometry_cookie, NULL);
+	xwm_schedule_read(xwm);
 	if (geometry_reply != NULL) {
 		surface->has_alpha = geometry_reply->depth == 32;
 	}
@@ -270,6 +408,7 @@ static struct wlr_xwayland_surface *xwayland_surface_create(
 	}
 
 	wl_list_insert(&xwm->surfaces, &surface->link);
+	surface_index_add(xwm, surface);
 
 	if (xwm->xres) {
 		read_surface_client_id(xwm, surface, client_id_cookie);
@@ -327,41 +466,14 @@ static void xwm_send_wm_message(struct wlr_xwayland_surface *surface,
 	xwm_schedule_flush(xwm);
 }
 
-static void xwm_set_net_client_list(struct wlr_xwm *xwm) {
-	// FIXME: _NET_CLIENT_LIST is expected to be ordered by map time, but the
-	// order of surfaces in `xwm->surfaces` is by creation time. The order of
-	// windows _NET_CLIENT_LIST exposed by wlroots is wrong.
-
-	size_t mapped_surfaces = 0;
-	struct wlr_xwayland_surface *surface;
-	wl_list_for_each(surface, &xwm->surfaces, link) {
-		if (surface->surface != NULL && surface->surface->mapped) {
-			mapped_surfaces++;
-		}
-	}
-
-	xcb_window_t *windows = NULL;
-	if (mapped_surfaces > 0) {
-		windows = malloc(sizeof(*windows) * mapped_surfaces);
-		if (!windows) {
-			return;
-		}
-
-		size_t index = 0;
-		wl_list_for_each(surface, &xwm->surfaces, link) {
-			if (surface->surface != NULL && surface->surface->mapped) {
-				windows[index++] = surface->window_id;
-			}
-		}
-	}
-
+static void xwm_write_net_client_list(struct wlr_xwm *xwm) {
 	xcb_change_property(xwm->xcb_conn, XCB_PROP_MODE_REPLACE,
 			xwm->screen->root, xwm->atoms[NET_CLIENT_LIST],
-			XCB_ATOM_WINDOW, 32, mapped_surfaces, windows);
-	free(windows);
+			XCB_ATOM_WINDOW, 32, xwm->net_client_list.size / sizeof(xcb_window_t),
+			xwm->net_client_list.data);
 }
 
-static void xwm_set_net_client_list_stacking(struct wlr_xwm *xwm) {
+static void xwm_write_net_client_list_stacking(struct wlr_xwm *xwm) {
 	size_t num_surfaces = wl_list_length(&xwm->surfaces_in_stack_order);
 	xcb_window_t *windows = malloc(sizeof(xcb_window_t) * num_surfaces);
 	if (!windows) {
@@ -380,6 +492,75 @@ static void xwm_set_net_client_list_stacking(struct wlr_xwm *xwm) {
 	free(windows);
 }
 
+static void xwm_handle_net_client_list_idle(void *data) {
+	struct wlr_xwm *xwm = data;
+	xwm->net_client_list_idle = NULL;
+
+	if (xwm->net_client_list_dirty) {
+		xwm_write_net_client_list(xwm);
+		xwm->net_client_list_dirty = false;
+	}
+	if (xwm->net_client_list_stacking_dirty) {
+		xwm_write_net_client_list_stacking(xwm);
+		xwm->net_client_list_stacking_dirty = false;
+	}
+	xwm_schedule_flush(xwm);
+}
+
+static void xwm_schedule_net_client_list_update(struct wlr_xwm *xwm) {
+	if (xwm->net_client_list_idle != NULL) {
+		return;
+	}
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(xwm->xwayland->wl_display);
+	xwm->net_client_list_idle = wl_event_loop_add_idle(loop,
+		xwm_handle_net_client_list_idle, xwm);
+	if (xwm->net_client_list_idle == NULL) {
+		wlr_log(WLR_ERROR, "Failed to add idle event source");
+	}
+}
+
+// _NET_CLIENT_LIST is ordered by map time: mapped windows are appended to the
+// root property, the whole list is only written again after unmaps
+static void xwm_net_client_list_add(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *xsurface) {
+	xcb_window_t *window = wl_array_add(&xwm->net_client_list, sizeof(*window));
+	if (window == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return;
+	}
+	*window = xsurface->window_id;
+
+	if (!xwm->net_client_list_dirty) {
+		xcb_change_property(xwm->xcb_conn, XCB_PROP_MODE_APPEND,
+			xwm->screen->root, xwm->atoms[NET_CLIENT_LIST],
+			XCB_ATOM_WINDOW, 32, 1, window);
+	}
+}
+
+static void xwm_net_client_list_remove(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *xsurface) {
+	xcb_window_t *windows = xwm->net_client_list.data;
+	size_t len = xwm->net_client_list.size / sizeof(*windows);
+	for (size_t i = 0; i < len; i++) {
+		if (windows[i] == xsurface->window_id) {
+			memmove(&windows[i], &windows[i + 1],
+				(len - i - 1) * sizeof(*windows));
+			xwm->net_client_list.size -= sizeof(*windows);
+			xwm->net_client_list_dirty = true;
+			xwm_schedule_net_client_list_update(xwm);
+			return;
+		}
+	}
+}
+
+// Restacks are batched, _NET_CLIENT_LIST_STACKING is written at most once per
+// event loop iteration
+static void xwm_set_net_client_list_stacking(struct wlr_xwm *xwm) {
+	xwm->net_client_list_stacking_dirty = true;
+	xwm_schedule_net_client_list_update(xwm);
+}
+
 static void xsurface_set_net_wm_state(struct wlr_xwayland_surface *xsurface);
 
 // Gives input (keyboard) focus to a window.
@@ -548,10 +729,35 @@ static void xsurface_set_net_wm_state(struct wlr_xwayland_surface *xsurface) {
 		i, property);
 }
 
+static void xwayland_surface_discard_property_requests(
+		struct wlr_xwayland_surface *xsurface) {
+	struct wlr_xwm *xwm = xsurface->xwm;
+	struct xwm_property_request *req, *tmp;
+	wl_list_for_each_safe(req, tmp, &xwm->property_requests, link) {
+		if (req->xsurface == xsurface) {
+			xcb_discard_reply(xwm->xcb_conn, req->cookie.sequence);
+			wl_list_remove(&req->link);
+			free(req);
+		}
+	}
+	xsurface->property_requests = 0;
+}
+
 static void xwayland_surface_dissociate(struct wlr_xwayland_surface *xsurface) {
 	if (xsurface->surface != NULL) {
-		wlr_surface_unmap(xsurface->surface);
-		wl_signal_emit_mutable(&xsurface->events.dissociate, NULL);
+		if (xsurface->associate_requests > 0) {
+			// The associate event hasn't been emitted yet
+			struct xwm_property_request *req;
+			wl_list_for_each(req, &xsurface->xwm->property_requests, link) {
+				if (req->xsurface == xsurface) {
+					req->associate = false;
+				}
+			}
+			xsurface->associate_requests = 0;
+		} else {
+			wlr_surface_unmap(xsurface->surface);
+			wl_signal_emit_mutable(&xsurface->events.dissociate, NULL);
+		}
 
 		wl_list_remove(&xsurface->surface_commit.link);
 		wl_list_remove(&xsurface->surface_map.link);
@@ -575,6 +781,7 @@ static void xwayland_surface_dissociate(struct wlr_xwayland_surface *xsurface) {
 
 static void xwayland_surface_destroy(struct wlr_xwayland_surface *xsurface) {
 	xwayland_surface_dissociate(xsurface);
+	xwayland_surface_discard_property_requests(xsurface);
 
 	wl_signal_emit_mutable(&xsurface->events.destroy, NULL);
 
@@ -622,6 +829,7 @@ static void xwayland_surface_destroy(struct wlr_xwayland_surface *xsurface) {
 		xsurface->xwm->offered_focus = NULL;
 	}
 
+	surface_index_remove(xsurface->xwm, xsurface);
 	wl_list_remove(&xsurface->link);
 	wl_list_remove(&xsurface->parent_link);
 
@@ -1072,6 +1280,7 @@ char *xwm_get_atom_name(struct wlr_xwm *xwm, xcb_atom_t atom) {
 		xcb_get_atom_name(xwm->xcb_conn, atom);
 	xcb_get_atom_name_reply_t *name_reply =
 		xcb_get_atom_name_reply(xwm->xcb_conn, name_cookie, NULL);
+	xwm_schedule_read(xwm);
 	if (name_reply == NULL) {
 		return NULL;
 	}
@@ -1126,19 +1335,22 @@ static void read_surface_property(struct wlr_xwm *xwm,
 
 static void xwayland_surface_handle_commit(struct wl_listener *listener, void *data) {
 	struct wlr_xwayland_surface *xsurface = wl_container_of(listener, xsurface, surface_commit);
-	if (wlr_surface_has_buffer(xsurface->surface)) {
+	// Mapping waits for the associate event
+	if (xsurface->associate_requests == 0 &&
+			wlr_surface_has_buffer(xsurface->surface)) {
 		wlr_surface_map(xsurface->surface);
 	}
 }
 
 static void xwayland_surface_handle_map(struct wl_listener *listener, void *data) {
 	struct wlr_xwayland_surface *xsurface = wl_container_of(listener, xsurface, surface_map);
-	xwm_set_net_client_list(xsurface->xwm);
+	xwm_net_client_list_add(xsurface->xwm, xsurface);
+	xwm_schedule_flush(xsurface->xwm);
 }
 
 static void xwayland_surface_handle_unmap(struct wl_listener *listener, void *data) {
 	struct wlr_xwayland_surface *xsurface = wl_container_of(listener, xsurface, surface_unmap);
-	xwm_set_net_client_list(xsurface->xwm);
+	xwm_net_client_list_remove(xsurface->xwm, xsurface);
 }
 
 static void xwayland_surface_handle_addon_destroy(struct wlr_addon *addon) {
@@ -1161,6 +1373,7 @@ bool wlr_xwayland_surface_fetch_icon(
 		0, UINT32_MAX);
 	xcb_get_property_reply_t *reply =
 		xcb_get_property_reply(xwm->xcb_conn, cookie, NULL);
+	xwm_schedule_read(xwm);
 	if (!reply) {
 		return false;
 	}
@@ -1173,14 +1386,105 @@ bool wlr_xwayland_surface_fetch_icon(
 	return true;
 }
 
-static xcb_get_property_cookie_t get_property(struct wlr_xwm *xwm,
-		xcb_window_t window_id, xcb_atom_t atom) {
+static void xwm_request_property(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *xsurface, xcb_atom_t atom,
+		bool associate) {
+	if (!associate) {
+		// Coalesce with the last request for this property, if it hasn't
+		// been answered yet
+		struct xwm_property_request *req;
+		wl_list_for_each_reverse(req, &xwm->property_requests, link) {
+			if (req->xsurface == xsurface && req->atom == atom) {
+				req->stale = true;
+				return;
+			}
+		}
+	}
+
+	struct xwm_property_request *req = calloc(1, sizeof(*req));
+	if (req == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return;
+	}
+
 	uint32_t len = 2048;
 	if (atom == xwm->atoms[NET_WM_ICON]) {
 		/* Compositors need to fetch icon data wlr_xwayland_surface_fetch_icon() */
 		len = 0;
 	}
-	return xcb_get_property(xwm->xcb_conn, 0, window_id, atom, XCB_ATOM_ANY, 0, len);
+
+	req->xsurface = xsurface;
+	req->atom = atom;
+	req->cookie = xcb_get_property(xwm->xcb_conn, 0, xsurface->window_id,
+		atom, XCB_ATOM_ANY, 0, len);
+	req->associate = associate;
+	wl_list_insert(xwm->property_requests.prev, &req->link);
+	xsurface->property_requests++;
+
+	if (associate) {
+		xsurface->associate_requests++;
+	}
+}
+
+static void xwayland_surface_emit_associate(
+		struct wlr_xwayland_surface *xsurface) {
+	wl_signal_emit_mutable(&xsurface->events.associate, NULL);
+
+	// Commits with a buffer may have happened while reading the properties
+	if (xsurface->surface != NULL && wlr_surface_has_buffer(xsurface->surface)) {
+		wlr_surface_map(xsurface->surface);
+	}
+}
+
+static void xwm_handle_property_reply(struct wlr_xwm *xwm,
+		struct xwm_property_request *req, xcb_get_property_reply_t *reply) {
+	struct wlr_xwayland_surface *xsurface = req->xsurface;
+	if (reply != NULL) {
+		read_surface_property(xwm, xsurface, req->atom, reply);
+	} else {
+		wlr_log(WLR_ERROR, "Failed to get window property");
+	}
+
+	if (req->stale) {
+		xwm_request_property(xwm, xsurface, req->atom, false);
+	}
+
+	if (req->associate) {
+		assert(xsurface->associate_requests > 0);
+		xsurface->associate_requests--;
+		if (xsurface->associate_requests == 0) {
+			xwayland_surface_emit_associate(xsurface);
+		}
+	}
+}
+
+static int read_property_replies(struct wlr_xwm *xwm) {
+	int count = 0;
+
+	// Handlers may add and remove requests
+	while (!wl_list_empty(&xwm->property_requests)) {
+		struct xwm_property_request *req =
+			wl_container_of(xwm->property_requests.next, req, link);
+
+		xcb_get_property_reply_t *reply = NULL;
+		xcb_generic_error_t *error = NULL;
+		if (!xcb_poll_for_reply(xwm->xcb_conn, req->cookie.sequence,
+				(void **)&reply, &error)) {
+			// Replies arrive in request order
+			break;
+		}
+		count++;
+
+		wl_list_remove(&req->link);
+		assert(req->xsurface->property_requests > 0);
+		req->xsurface->property_requests--;
+		xwm_handle_property_reply(xwm, req, reply);
+		free(reply);
+		free(error);
+		free(req);
+	}
+
+	return count;
 }
 
 static void xwayland_surface_associate(struct wlr_xwm *xwm,
@@ -1203,7 +1507,8 @@ static void xwayland_surface_associate(struct wlr_xwm *xwm,
 	xsurface->surface_unmap.notify = xwayland_surface_handle_unmap;
 	wl_signal_add(&surface->events.unmap, &xsurface->surface_unmap);
 
-	// read all surface properties
+	// read all surface properties, the associate event is emitted once
+	// all of them have been received
 	const xcb_atom_t props[] = {
 		XCB_ATOM_WM_CLASS,
 		XCB_ATOM_WM_NAME,
@@ -1220,23 +1525,14 @@ static void xwayland_surface_associate(struct wlr_xwm *xwm,
 		xwm->atoms[NET_WM_ICON],
 	};
 
-	xcb_get_property_cookie_t cookies[sizeof(props) / sizeof(props[0])] = {0};
 	for (size_t i = 0; i < sizeof(props) / sizeof(props[0]); i++) {
-		cookies[i] = get_property(xwm, xsurface->window_id, props[i]);
+		xwm_request_property(xwm, xsurface, props[i], true);
 	}
+	xwm_schedule_flush(xwm);
 
-	for (size_t i = 0; i < sizeof(props) / sizeof(props[0]); i++) {
-		xcb_get_property_reply_t *reply =
-			xcb_get_property_reply(xwm->xcb_conn, cookies[i], NULL);
-		if (reply == NULL) {
-			wlr_log(WLR_ERROR, "Failed to get window property");
-			continue;
-		}
-		read_surface_property(xwm, xsurface, props[i], reply);
-		free(reply);
+	if (xsurface->associate_requests == 0) {
+		xwayland_surface_emit_associate(xsurface);
 	}
-
-	wl_signal_emit_mutable(&xsurface->events.associate, NULL);
 }
 
 static void xwm_handle_create_notify(struct wlr_xwm *xwm,
@@ -1450,16 +1746,7 @@ static void xwm_handle_property_notify(struct wlr_xwm *xwm,
 		return;
 	}
 
-	xcb_get_property_cookie_t cookie = get_property(xwm, xsurface->window_id, ev->atom);
-	xcb_get_property_reply_t *reply =
-		xcb_get_property_reply(xwm->xcb_conn, cookie, NULL);
-	if (reply == NULL) {
-		wlr_log(WLR_ERROR, "Failed to get window property");
-		return;
-	}
-
-	read_surface_property(xwm, xsurface, ev->atom, reply);
-	free(reply);
+	xwm_request_property(xwm, xsurface, ev->atom, false);
 }
 
 static void xwm_handle_surface_id_message(struct wlr_xwm *xwm,
@@ -2014,6 +2301,33 @@ static void xwm_handle_unhandled_event(struct wlr_xwm *xwm, xcb_generic_event_t
 #endif
 }
 
+static xcb_window_t xwm_event_window(xcb_generic_event_t *event) {
+	switch (event->response_type & XCB_EVENT_RESPONSE_TYPE_MASK) {
+	case XCB_CREATE_NOTIFY:
+		return ((xcb_create_notify_event_t *)event)->window;
+	case XCB_DESTROY_NOTIFY:
+		return ((xcb_destroy_notify_event_t *)event)->window;
+	case XCB_CONFIGURE_REQUEST:
+		return ((xcb_configure_request_event_t *)event)->window;
+	case XCB_CONFIGURE_NOTIFY:
+		return ((xcb_configure_notify_event_t *)event)->window;
+	case XCB_MAP_REQUEST:
+		return ((xcb_map_request_event_t *)event)->window;
+	case XCB_MAP_NOTIFY:
+		return ((xcb_map_notify_event_t *)event)->window;
+	case XCB_UNMAP_NOTIFY:
+		return ((xcb_unmap_notify_event_t *)event)->window;
+	case XCB_PROPERTY_NOTIFY:
+		return ((xcb_property_notify_event_t *)event)->window;
+	case XCB_CLIENT_MESSAGE:
+		return ((xcb_client_message_event_t *)event)->window;
+	case XCB_FOCUS_IN:
+		return ((xcb_focus_in_event_t *)event)->event;
+	default:
+		return XCB_WINDOW_NONE;
+	}
+}
+
 static int read_x11_events(struct wlr_xwm *xwm) {
 	int count = 0;
 
@@ -2021,6 +2335,15 @@ static int read_x11_events(struct wlr_xwm *xwm) {
 	while ((event = xcb_poll_for_event(xwm->xcb_conn))) {
 		count++;
 
+		// Replies to property requests sent before the event was generated
+		// have been received already, handle them first so that the window
+		// state is up to date
+		struct wlr_xwayland_surface *xsurface =
+			lookup_surface(xwm, xwm_event_window(event));
+		if (xsurface != NULL && xsurface->property_requests > 0) {
+			count += read_property_replies(xwm);
+		}
+
 		if (xwm->xwayland->user_event_handler &&
 				xwm->xwayland->user_event_handler(xwm->xwayland, event)) {
 			free(event);
@@ -2076,6 +2399,9 @@ static int read_x11_events(struct wlr_xwm *xwm) {
 		free(event);
 	}
 
+	count += read_property_replies(xwm);
+	count += xwm_read_selection_replies(xwm);
+
 	return count;
 }
 
@@ -2105,6 +2431,27 @@ static int x11_event_handler(int fd, uint32_t mask, void *data) {
 	return count;
 }
 
+static void xwm_handle_read_idle(void *data) {
+	struct wlr_xwm *xwm = data;
+	xwm->read_idle = NULL;
+
+	if (read_x11_events(xwm) > 0) {
+		xwm_schedule_flush(xwm);
+	}
+}
+
+void xwm_schedule_read(struct wlr_xwm *xwm) {
+	if (xwm->read_idle != NULL) {
+		return;
+	}
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(xwm->xwayland->wl_display);
+	xwm->read_idle = wl_event_loop_add_idle(loop, xwm_handle_read_idle, xwm);
+	if (xwm->read_idle == NULL) {
+		wlr_log(WLR_ERROR, "Failed to add idle event source");
+	}
+}
+
 static void handle_compositor_new_surface(struct wl_listener *listener,
 		void *data) {
 	struct wlr_xwm *xwm =
@@ -2292,6 +2639,12 @@ void xwm_destroy(struct wlr_xwm *xwm) {
 	wl_list_for_each_safe(xsurface, tmp, &xwm->unpaired_surfaces, unpaired_link) {
 		xwayland_surface_destroy(xsurface);
 	}
+	free(xwm->surface_index);
+	// Destroying surfaces may schedule a _NET_CLIENT_LIST update
+	if (xwm->net_client_list_idle != NULL) {
+		wl_event_source_remove(xwm->net_client_list_idle);
+	}
+	wl_array_release(&xwm->net_client_list);
 	wl_list_remove(&xwm->compositor_new_surface.link);
 	wl_list_remove(&xwm->compositor_destroy.link);
 	wl_list_remove(&xwm->shell_v1_new_surface.link);
@@ -2303,6 +2656,11 @@ void xwm_destroy(struct wlr_xwm *xwm) {
 		pending_startup_id_destroy(pending);
 	}
 
+	// Any of the above may have scheduled a read
+	if (xwm->read_idle) {
+		wl_event_source_remove(xwm->read_idle);
+	}
+
 	xwm->xwayland->xwm = NULL;
 	free(xwm);
 }
@@ -2586,6 +2944,8 @@ struct wlr_xwm *xwm_create(struct wlr_xwayland *xwayland, int wm_fd) {
 	wl_list_init(&xwm->surfaces_in_stack_order);
 	wl_list_init(&xwm->unpaired_surfaces);
 	wl_list_init(&xwm->pending_startup_ids);
+	wl_list_init(&xwm->property_requests);
+	wl_array_init(&xwm->net_client_list);
 	wl_list_init(&xwm->seat_drag_source_destroy.link);
 	wl_list_init(&xwm->drag_focus_destroy.link);
 	wl_list_init(&xwm->drop_focus_destroy.link);
@@ -2701,6 +3061,8 @@ struct wlr_xwm *xwm_create(struct wlr_xwayland *xwayland, int wm_fd) {
 	xwm_create_no_focus_window(xwm);
 
 	xcb_flush(xwm->xcb_conn);
+	// Events may have been queued by the blocking replies above
+	xwm_schedule_read(xwm);
 
 	return xwm;
 }